@@ -26,6 +26,13 @@ ChanACL::ChanACL(Channel *chan) : QObject(chan) {
 		c->qlACL << this;
 }
 
+void ChanACL::setGroup(const QString &group) {
+	qsGroup = group;
+#ifdef MURMUR
+	groupSpecification = Group::Specification::parse(group);
+#endif
+}
+
 ChanACL::operator QString() const {
 	QString aclString;
 	bool isFirstEntry = true;
@@ -143,7 +150,7 @@ QFlags< ChanACL::Perm > ChanACL::effectivePermissions(ServerUser *p, Channel *ch
 
 		for (const ChanACL *acl : ch->qlACL) {
 			bool matchUser  = (acl->iUserId != -1) && (acl->iUserId == p->iId);
-			bool matchGroup = Group::appliesToUser(*chan, *ch, acl->qsGroup, *p);
+			bool matchGroup = Group::appliesToUser(*chan, *ch, acl->groupSpecification, *p);
 
 			bool applyFromSelf  = (ch == chan && acl->bApplyHere);
 			bool applyInherited = (ch != chan && acl->bApplySubs);
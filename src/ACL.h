@@ -9,6 +9,10 @@
 #include <QtCore/QHash>
 #include <QtCore/QObject>
 
+#ifdef MURMUR
+#	include "Group.h"
+#endif
+
 class Channel;
 class User;
 class ServerUser;
@@ -61,8 +65,17 @@ public:
 	Permissions pAllow;
 	Permissions pDeny;
 
+#ifdef MURMUR
+	/// The parsed form of qsGroup, which is what permissions are evaluated against
+	Group::Specification groupSpecification;
+#endif
+
 	ChanACL(Channel *c);
 
+	/// Sets qsGroup. On the server, this also updates groupSpecification, which is why the group must not be
+	/// assigned directly there.
+	void setGroup(const QString &group);
+
 	/// @returns Whether the given ChanACL represents a password.
 	bool isPassword() const;
 
@@ -7,9 +7,12 @@
 #include "Mumble.pb.h"
 #include "SSL.h"
 
+#include <QtCore/QThread>
 #include <QtCore/QtEndian>
 #include <QtNetwork/QHostAddress>
 
+#include <utility>
+
 #ifdef Q_OS_WIN
 #	include <qos2.h>
 #else
@@ -23,80 +26,24 @@
 HANDLE Connection::hQoS = nullptr;
 #endif
 
-Connection::Connection(QObject *p, QSslSocket *qtsSock) : QObject(p) {
-	qtsSocket = qtsSock;
+ConnectionSocket::ConnectionSocket(QSslSocket *socket) : QObject(nullptr), qtsSocket(socket), iPacketLength(-1) {
 	qtsSocket->setParent(this);
-	iPacketLength        = -1;
-	bDisconnectedEmitted = false;
-	csCrypt              = std::make_unique< CryptStateOCB2 >();
-
-	static bool bDeclared = false;
-	if (!bDeclared) {
-		bDeclared = true;
-		qRegisterMetaType< QAbstractSocket::SocketError >("QAbstractSocket::SocketError");
-	}
-
-	int nodelay = 1;
-	setsockopt(static_cast< int >(qtsSocket->socketDescriptor()), IPPROTO_TCP, TCP_NODELAY,
-			   reinterpret_cast< char * >(&nodelay), static_cast< socklen_t >(sizeof(nodelay)));
 
 	connect(qtsSocket, SIGNAL(errorOccurred(QAbstractSocket::SocketError)), this,
 			SLOT(socketError(QAbstractSocket::SocketError)));
-	connect(qtsSocket, SIGNAL(encrypted()), this, SIGNAL(encrypted()));
+	connect(qtsSocket, SIGNAL(encrypted()), this, SLOT(socketEncrypted()));
 	connect(qtsSocket, SIGNAL(readyRead()), this, SLOT(socketRead()));
 	connect(qtsSocket, SIGNAL(disconnected()), this, SLOT(socketDisconnected()));
 	connect(qtsSocket, SIGNAL(sslErrors(const QList< QSslError > &)), this,
 			SLOT(socketSslErrors(const QList< QSslError > &)));
-	qtLastPacket.restart();
-#ifdef Q_OS_WIN
-	dwFlow = 0;
-#endif
 }
 
-Connection::~Connection() {
-#ifdef Q_OS_WIN
-	if (dwFlow && hQoS) {
-		if (!QOSRemoveSocketFromFlow(hQoS, 0, dwFlow, 0))
-			qWarning("Connection: Failed to remove flow from QoS");
-	}
-#endif
+QSslSocket *ConnectionSocket::socket() const {
+	return qtsSocket;
 }
 
-void Connection::setToS() {
-#if defined(Q_OS_WIN)
-	if (dwFlow || !hQoS)
-		return;
-
-	dwFlow = 0;
-	if (!QOSAddSocketToFlow(hQoS, qtsSocket->socketDescriptor(), nullptr, QOSTrafficTypeAudioVideo,
-							QOS_NON_ADAPTIVE_FLOW, reinterpret_cast< PQOS_FLOWID >(&dwFlow)))
-		qWarning("Connection: Failed to add flow to QOS");
-#elif defined(Q_OS_UNIX)
-	int val = 0xa0;
-	if (setsockopt(static_cast< int >(qtsSocket->socketDescriptor()), IPPROTO_IP, IP_TOS, &val, sizeof(val))) {
-		val = 0x60;
-		if (setsockopt(static_cast< int >(qtsSocket->socketDescriptor()), IPPROTO_IP, IP_TOS, &val, sizeof(val)))
-			qWarning("Connection: Failed to set TOS for TCP Socket");
-	}
-#	if defined(SO_PRIORITY)
-	socklen_t optlen = sizeof(val);
-	if (getsockopt(static_cast< int >(qtsSocket->socketDescriptor()), SOL_SOCKET, SO_PRIORITY, &val, &optlen) == 0) {
-		if (val == 0) {
-			val = 6;
-			setsockopt(static_cast< int >(qtsSocket->socketDescriptor()), SOL_SOCKET, SO_PRIORITY, &val, sizeof(val));
-		}
-	}
-#	endif
-
-#endif
-}
-
-qint64 Connection::activityTime() const {
-	return qtLastPacket.elapsed();
-}
-
-void Connection::resetActivityTime() {
-	qtLastPacket.restart();
+void ConnectionSocket::setSslErrorFilter(std::function< bool(const QList< QSslError > &) > filter) {
+	m_sslErrorFilter = std::move(filter);
 }
 
 /**
@@ -110,7 +57,7 @@ void Connection::resetActivityTime() {
  * @see void ServerHandler::message(unsigned int msgType, const QByteArray &qbaMsg)
  * @see void Server::message(unsigned int uiType, const QByteArray &qbaMsg, ServerUser *u)
  */
-void Connection::socketRead() {
+void ConnectionSocket::socketRead() {
 	while (true) {
 		qint64 iAvailable = qtsSocket->bytesAvailable();
 		if (iPacketLength == -1) {
@@ -142,20 +89,188 @@ void Connection::socketRead() {
 	}
 }
 
-void Connection::socketError(QAbstractSocket::SocketError err) {
+void ConnectionSocket::socketError(QAbstractSocket::SocketError err) {
 	emit connectionClosed(err, qtsSocket->errorString());
 }
 
-void Connection::socketSslErrors(const QList< QSslError > &qlErr) {
-	emit handleSslErrors(qlErr);
+void ConnectionSocket::socketDisconnected() {
+	emit connectionClosed(QAbstractSocket::UnknownSocketError, QString());
 }
 
-void Connection::proceedAnyway() {
+void ConnectionSocket::socketEncrypted() {
+	emit encrypted(qtsSocket->peerCertificateChain(), qtsSocket->sessionCipher(), qtsSocket->sessionProtocol());
+}
+
+void ConnectionSocket::socketSslErrors(const QList< QSslError > &errors) {
+	if (m_sslErrorFilter && m_sslErrorFilter(errors)) {
+		qtsSocket->ignoreSslErrors();
+	}
+
+	emit sslErrors(errors);
+}
+
+void ConnectionSocket::write(const QByteArray &data) {
+	qtsSocket->write(data);
+}
+
+void ConnectionSocket::flush() {
+	if (qtsSocket->state() != QAbstractSocket::ConnectedState)
+		return;
+
+	if (!qtsSocket->isEncrypted())
+		return;
+
+	qtsSocket->flush();
+}
+
+void ConnectionSocket::disconnectSocket(bool force) {
+	if (qtsSocket->state() == QAbstractSocket::UnconnectedState) {
+		emit connectionClosed(QAbstractSocket::UnknownSocketError, QString());
+		return;
+	}
+
+	if (force)
+		qtsSocket->abort();
+	else
+		qtsSocket->disconnectFromHost();
+}
+
+void ConnectionSocket::ignoreSslErrors() {
 	qtsSocket->ignoreSslErrors();
 }
 
-void Connection::socketDisconnected() {
-	emit connectionClosed(QAbstractSocket::UnknownSocketError, QString());
+void ConnectionSocket::startServerEncryption() {
+	qtsSocket->startServerEncryption();
+}
+
+Connection::Connection(QObject *p, QSslSocket *qtsSock) : QObject(p) {
+	qtsSocket            = qtsSock;
+	m_socket             = new ConnectionSocket(qtsSocket);
+	bDisconnectedEmitted = false;
+	csCrypt              = std::make_unique< CryptStateOCB2 >();
+
+	static bool bDeclared = false;
+	if (!bDeclared) {
+		bDeclared = true;
+		qRegisterMetaType< QAbstractSocket::SocketError >("QAbstractSocket::SocketError");
+		// The following are only needed for sockets that live in another thread
+		qRegisterMetaType< Mumble::Protocol::TCPMessageType >("Mumble::Protocol::TCPMessageType");
+		qRegisterMetaType< QList< QSslError > >("QList<QSslError>");
+		qRegisterMetaType< QList< QSslCertificate > >("QList<QSslCertificate>");
+		qRegisterMetaType< QSslCipher >("QSslCipher");
+		qRegisterMetaType< QSsl::SslProtocol >("QSsl::SslProtocol");
+	}
+
+	int nodelay = 1;
+	setsockopt(static_cast< int >(qtsSocket->socketDescriptor()), IPPROTO_TCP, TCP_NODELAY,
+			   reinterpret_cast< char * >(&nodelay), static_cast< socklen_t >(sizeof(nodelay)));
+
+	// These signals are forwarded as-is, so that sender() refers to this Connection in the connected slots
+	connect(m_socket, &ConnectionSocket::connectionClosed, this, &Connection::connectionClosed);
+	connect(m_socket, &ConnectionSocket::message, this, &Connection::message);
+	connect(m_socket, &ConnectionSocket::sslErrors, this, &Connection::handleSslErrors);
+	connect(m_socket, &ConnectionSocket::encrypted, this, &Connection::socketEncrypted);
+	qtLastPacket.restart();
+#ifdef Q_OS_WIN
+	dwFlow = 0;
+#endif
+}
+
+Connection::~Connection() {
+#ifdef Q_OS_WIN
+	if (dwFlow && hQoS) {
+		if (!QOSRemoveSocketFromFlow(hQoS, 0, dwFlow, 0))
+			qWarning("Connection: Failed to remove flow from QoS");
+	}
+#endif
+	if (m_socketIsRemote) {
+		// The socket has to be destroyed by the thread it lives in
+		m_socket->deleteLater();
+	} else {
+		delete m_socket;
+	}
+}
+
+void Connection::moveSocketToThread(QThread *thread, std::function< bool(const QList< QSslError > &) > sslErrorFilter) {
+	if (!thread || m_socketIsRemote)
+		return;
+
+	m_socketDescriptor = qtsSocket->socketDescriptor();
+	m_peerAddress      = qtsSocket->peerAddress();
+	m_peerPort         = qtsSocket->peerPort();
+	m_localAddress     = qtsSocket->localAddress();
+	m_localPort        = qtsSocket->localPort();
+
+	m_socket->setSslErrorFilter(std::move(sslErrorFilter));
+	m_socket->moveToThread(thread);
+	m_socketIsRemote = true;
+}
+
+void Connection::invokeOnSocket(std::function< void(ConnectionSocket &) > func) {
+	if (!m_socketIsRemote) {
+		func(*m_socket);
+		return;
+	}
+
+	// Queued calls are executed in the order they have been made in, so messages can't overtake each other
+	ConnectionSocket *socket = m_socket;
+	QMetaObject::invokeMethod(
+		socket, [socket, func = std::move(func)]() { func(*socket); }, Qt::QueuedConnection);
+}
+
+void Connection::startServerEncryption() {
+	invokeOnSocket([](ConnectionSocket &socket) { socket.startServerEncryption(); });
+}
+
+void Connection::socketEncrypted(const QList< QSslCertificate > &peerCertificateChain, const QSslCipher &cipher,
+								 QSsl::SslProtocol protocol) {
+	m_peerCertificateChain = peerCertificateChain;
+	m_sessionCipher        = cipher;
+	m_sessionProtocol      = protocol;
+
+	emit encrypted();
+}
+
+void Connection::setToS() {
+	const qintptr descriptor = m_socketIsRemote ? m_socketDescriptor : qtsSocket->socketDescriptor();
+#if defined(Q_OS_WIN)
+	if (dwFlow || !hQoS)
+		return;
+
+	dwFlow = 0;
+	if (!QOSAddSocketToFlow(hQoS, static_cast< SOCKET >(descriptor), nullptr, QOSTrafficTypeAudioVideo,
+							QOS_NON_ADAPTIVE_FLOW, reinterpret_cast< PQOS_FLOWID >(&dwFlow)))
+		qWarning("Connection: Failed to add flow to QOS");
+#elif defined(Q_OS_UNIX)
+	int val = 0xa0;
+	if (setsockopt(static_cast< int >(descriptor), IPPROTO_IP, IP_TOS, &val, sizeof(val))) {
+		val = 0x60;
+		if (setsockopt(static_cast< int >(descriptor), IPPROTO_IP, IP_TOS, &val, sizeof(val)))
+			qWarning("Connection: Failed to set TOS for TCP Socket");
+	}
+#	if defined(SO_PRIORITY)
+	socklen_t optlen = sizeof(val);
+	if (getsockopt(static_cast< int >(descriptor), SOL_SOCKET, SO_PRIORITY, &val, &optlen) == 0) {
+		if (val == 0) {
+			val = 6;
+			setsockopt(static_cast< int >(descriptor), SOL_SOCKET, SO_PRIORITY, &val, sizeof(val));
+		}
+	}
+#	endif
+
+#endif
+}
+
+qint64 Connection::activityTime() const {
+	return qtLastPacket.elapsed();
+}
+
+void Connection::resetActivityTime() {
+	qtLastPacket.restart();
+}
+
+void Connection::proceedAnyway() {
+	invokeOnSocket([](ConnectionSocket &socket) { socket.ignoreSslErrors(); });
 }
 
 void Connection::messageToNetwork(const ::google::protobuf::Message &msg, Mumble::Protocol::TCPMessageType msgType,
@@ -186,46 +301,66 @@ void Connection::sendMessage(const ::google::protobuf::Message &msg, Mumble::Pro
 }
 
 void Connection::sendMessage(const QByteArray &qbaMsg) {
+	if (qbaMsg.isEmpty())
+		return;
+
+	if (!m_writesPending) {
+		sendUrgentMessage(qbaMsg);
+		return;
+	}
+
+	const bool wasPending = !m_pendingWrite.isEmpty();
+	m_pendingWrite.append(qbaMsg);
+
+	if (m_pendingWrite.size() >= MAX_PENDING_WRITE) {
+		writePending();
+	} else if (!wasPending) {
+		m_writesPending(*this);
+	}
+}
+
+void Connection::sendUrgentMessage(const QByteArray &qbaMsg) {
 	if (!qbaMsg.isEmpty())
-		qtsSocket->write(qbaMsg);
+		invokeOnSocket([qbaMsg](ConnectionSocket &socket) { socket.write(qbaMsg); });
 }
 
-void Connection::forceFlush() {
-	if (qtsSocket->state() != QAbstractSocket::ConnectedState)
-		return;
+void Connection::setWriteCoalescing(std::function< void(Connection &) > writesPending) {
+	m_writesPending = std::move(writesPending);
+}
 
-	if (!qtsSocket->isEncrypted())
-		return;
+void Connection::writePending() {
+	if (!m_pendingWrite.isEmpty()) {
+		sendUrgentMessage(std::exchange(m_pendingWrite, QByteArray()));
+	}
+}
 
-	qtsSocket->flush();
+void Connection::forceFlush() {
+	writePending();
+
+	invokeOnSocket([](ConnectionSocket &socket) { socket.flush(); });
 }
 
 void Connection::disconnectSocket(bool force) {
-	if (qtsSocket->state() == QAbstractSocket::UnconnectedState) {
-		emit connectionClosed(QAbstractSocket::UnknownSocketError, QString());
-		return;
-	}
+	// Messages sent right before disconnecting (e.g. the reason for a rejection) must not get lost
+	writePending();
 
-	if (force)
-		qtsSocket->abort();
-	else
-		qtsSocket->disconnectFromHost();
+	invokeOnSocket([force](ConnectionSocket &socket) { socket.disconnectSocket(force); });
 }
 
 QHostAddress Connection::peerAddress() const {
-	return qtsSocket->peerAddress();
+	return m_socketIsRemote ? m_peerAddress : qtsSocket->peerAddress();
 }
 
 quint16 Connection::peerPort() const {
-	return qtsSocket->peerPort();
+	return m_socketIsRemote ? m_peerPort : qtsSocket->peerPort();
 }
 
 QHostAddress Connection::localAddress() const {
-	return qtsSocket->localAddress();
+	return m_socketIsRemote ? m_localAddress : qtsSocket->localAddress();
 }
 
 quint16 Connection::localPort() const {
-	return qtsSocket->localPort();
+	return m_socketIsRemote ? m_localPort : qtsSocket->localPort();
 }
 
 QList< QSslCertificate > Connection::peerCertificateChain() const {
@@ -235,15 +370,15 @@ QList< QSslCertificate > Connection::peerCertificateChain() const {
 	// Through tests and by looking into Qt's source code it was validated,
 	// that these two functions do the same thing.
 	// See mumble-voip/mumble#5280 for more information.
-	return qtsSocket->peerCertificateChain();
+	return m_socketIsRemote ? m_peerCertificateChain : qtsSocket->peerCertificateChain();
 }
 
 QSslCipher Connection::sessionCipher() const {
-	return qtsSocket->sessionCipher();
+	return m_socketIsRemote ? m_sessionCipher : qtsSocket->sessionCipher();
 }
 
 QSsl::SslProtocol Connection::sessionProtocol() const {
-	return qtsSocket->sessionProtocol();
+	return m_socketIsRemote ? m_sessionProtocol : qtsSocket->sessionProtocol();
 }
 
 QString Connection::sessionProtocolString() const {
@@ -21,7 +21,10 @@
 #include <QtCore/QList>
 #include <QtCore/QMutex>
 #include <QtCore/QObject>
+#include <QtNetwork/QHostAddress>
 #include <QtNetwork/QSslSocket>
+
+#include <functional>
 #include <memory>
 
 #ifdef Q_OS_WIN
@@ -34,24 +37,91 @@ namespace protobuf {
 }
 } // namespace google
 
+class QThread;
+
+/// Owns the socket of a Connection and splits the incoming data stream into messages. Usually, this lives in the same
+/// thread as its Connection, but it may also be moved to a different thread (see Connection::moveSocketToThread). In
+/// that case, the socket must only be accessed by that thread and all communication with the Connection happens
+/// through queued signals.
+class ConnectionSocket : public QObject {
+private:
+	Q_OBJECT
+	Q_DISABLE_COPY(ConnectionSocket)
+protected:
+	QSslSocket *qtsSocket;
+	Mumble::Protocol::TCPMessageType m_type;
+	int iPacketLength;
+	std::function< bool(const QList< QSslError > &) > m_sslErrorFilter;
+protected slots:
+	void socketRead();
+	void socketError(QAbstractSocket::SocketError);
+	void socketDisconnected();
+	void socketEncrypted();
+	void socketSslErrors(const QList< QSslError > &errors);
+signals:
+	void encrypted(const QList< QSslCertificate > &peerCertificateChain, const QSslCipher &cipher,
+				   QSsl::SslProtocol protocol);
+	void connectionClosed(QAbstractSocket::SocketError, const QString &reason);
+	void message(Mumble::Protocol::TCPMessageType type, const QByteArray &);
+	void sslErrors(const QList< QSslError > &);
+
+public:
+	ConnectionSocket(QSslSocket *socket);
+
+	QSslSocket *socket() const;
+
+	/// Sets a filter that SSL errors are checked against as soon as they occur. If it returns true, the errors are
+	/// ignored right away. This is required if the socket lives in a different thread than the code deciding about
+	/// the errors, as errors can only be ignored while they are being reported.
+	void setSslErrorFilter(std::function< bool(const QList< QSslError > &) > filter);
+
+	void write(const QByteArray &data);
+	void flush();
+	void disconnectSocket(bool force);
+	void ignoreSslErrors();
+	void startServerEncryption();
+};
+
 class Connection : public QObject {
 private:
 	Q_OBJECT
 	Q_DISABLE_COPY(Connection)
 protected:
+	ConnectionSocket *m_socket;
+	/// The socket itself. This must only be accessed directly as long as the socket lives in our thread (i.e. if
+	/// m_socketIsRemote is false).
 	QSslSocket *qtsSocket;
+	bool m_socketIsRemote = false;
 	QElapsedTimer qtLastPacket;
-	Mumble::Protocol::TCPMessageType m_type;
-	int iPacketLength;
+
+	// Properties of the socket that are cached once it has been moved to another thread
+	qintptr m_socketDescriptor = -1;
+	QHostAddress m_peerAddress;
+	quint16 m_peerPort = 0;
+	QHostAddress m_localAddress;
+	quint16 m_localPort = 0;
+	QList< QSslCertificate > m_peerCertificateChain;
+	QSslCipher m_sessionCipher;
+	QSsl::SslProtocol m_sessionProtocol = QSsl::UnknownProtocol;
 #ifdef Q_OS_WIN
 	static HANDLE hQoS;
 	DWORD dwFlow;
 #endif
+	/// Runs the given function in the context of the socket's thread. If that is the current thread, the function is
+	/// run right away.
+	void invokeOnSocket(std::function< void(ConnectionSocket &) > func);
+
+	/// The maximum number of bytes that are gathered before they are written. As a TLS record can't hold more than
+	/// 16 KiB, gathering more than that doesn't save anything.
+	static constexpr qsizetype MAX_PENDING_WRITE = 16 * 1024;
+	/// Invoked whenever a message has been gathered while none were pending. Null, unless messages are gathered (see
+	/// setWriteCoalescing()).
+	std::function< void(Connection &) > m_writesPending;
+	/// The messages that have been sent, but have not been written to the socket yet
+	QByteArray m_pendingWrite;
 protected slots:
-	void socketRead();
-	void socketError(QAbstractSocket::SocketError);
-	void socketDisconnected();
-	void socketSslErrors(const QList< QSslError > &errors);
+	void socketEncrypted(const QList< QSslCertificate > &peerCertificateChain, const QSslCipher &cipher,
+						 QSsl::SslProtocol protocol);
 public slots:
 	void proceedAnyway();
 signals:
@@ -63,11 +133,31 @@ signals:
 public:
 	Connection(QObject *parent, QSslSocket *qtsSocket);
 	~Connection();
+	/// Moves the socket to the given thread, which has to run an event loop. From then on, all socket operations
+	/// (the TLS handshake, encrypting and decrypting records, splitting the data into messages) are performed by that
+	/// thread. This must be called before the connection is used. As the decision about SSL errors can then no longer
+	/// be made by whoever is connected to handleSslErrors, the given filter is used instead (see
+	/// ConnectionSocket::setSslErrorFilter).
+	void moveSocketToThread(QThread *thread, std::function< bool(const QList< QSslError > &) > sslErrorFilter);
+	void startServerEncryption();
 	static void messageToNetwork(const ::google::protobuf::Message &msg, Mumble::Protocol::TCPMessageType msgType,
 								 QByteArray &cache);
 	void sendMessage(const ::google::protobuf::Message &msg, Mumble::Protocol::TCPMessageType msgType,
 					 QByteArray &cache);
 	void sendMessage(const QByteArray &qbaMsg);
+	/// Sends the given message right away, ahead of any messages that are still being gathered. This is meant for
+	/// messages whose latency matters more than their order relative to other messages (i.e. tunnelled audio).
+	void sendUrgentMessage(const QByteArray &qbaMsg);
+	/// Makes sent messages be gathered instead of written right away, so that they can be written to the socket
+	/// together and are encrypted into as few TLS records as possible instead of one record each. Whenever a message
+	/// has been gathered while none were pending, the given function is invoked. It has to make sure that
+	/// writePending() is called later on (e.g. by a single flush for many connections, see WriteCoalescer).
+	///
+	/// Gathered messages are also written once they fill a TLS record and when the connection is flushed or
+	/// disconnected.
+	void setWriteCoalescing(std::function< void(Connection &) > writesPending);
+	/// Writes all gathered messages to the socket at once
+	void writePending();
 	void disconnectSocket(bool force = false);
 	void forceFlush();
 	qint64 activityTime() const;
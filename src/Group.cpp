@@ -98,155 +98,197 @@ QSet< QString > Group::groupNames(Channel *chan) {
 	return m;
 }
 
-#	define RET_FALSE (invert ? true : false)
-#	define RET_TRUE (invert ? false : true)
+namespace {
+/// @returns The number of ancestors of the given channel
+int depthOf(const Channel &channel) {
+	int depth = 0;
+	for (const Channel *parent = channel.cParent; parent; parent = parent->cParent) {
+		++depth;
+	}
 
-bool Group::appliesToUser(const Channel &currentChannel, const Channel &aclChannel, QString groupSpecification,
-						  const ServerUser &user) {
-	bool matches                  = false;
-	bool invert                   = false;
-	bool isAccessToken            = false;
-	bool isCertHash               = false;
-	const Channel *contextChannel = &currentChannel;
-
-	while (!groupSpecification.isEmpty()) {
-		if (groupSpecification.startsWith(QChar::fromLatin1('!'))) {
-			invert             = true;
-			groupSpecification = groupSpecification.remove(0, 1);
+	return depth;
+}
+
+/// @returns The ancestor (or the channel itself) of the given channel that is located at the given depth
+const Channel *ancestorAt(const Channel &channel, int channelDepth, int ancestorDepth) {
+	const Channel *ancestor = &channel;
+	for (int i = channelDepth; i > ancestorDepth && ancestor; --i) {
+		ancestor = ancestor->cParent;
+	}
+
+	return ancestor;
+}
+
+bool matchesSub(const Channel &currentChannel, const Channel &contextChannel, const Group::Specification &spec,
+				const ServerUser &user) {
+	if (!user.cChannel) {
+		return false;
+	}
+
+	// Depths are equivalent to indices into the channel hierarchy from the root channel to the respective channel.
+	// The context channel is always the current channel or one of its ancestors.
+	const int currentDepth = depthOf(currentChannel);
+	const int homeDepth    = depthOf(*user.cChannel);
+
+	int requiredDepth = depthOf(contextChannel) + spec.subOffset;
+	if (requiredDepth > currentDepth) {
+		return false;
+	} else if (requiredDepth < 0) {
+		requiredDepth = 0;
+	}
+
+	// The required channel has to be part of the hierarchy of the user's channel
+	if (requiredDepth > homeDepth
+		|| ancestorAt(currentChannel, currentDepth, requiredDepth)
+			   != ancestorAt(*user.cChannel, homeDepth, requiredDepth)) {
+		return false;
+	}
+
+	return homeDepth >= requiredDepth + spec.subMinLevel && homeDepth <= requiredDepth + spec.subMaxLevel;
+}
+
+bool isGroupMember(const Channel &contextChannel, const QString &groupName, const ServerUser &user) {
+	// Groups further down the hierarchy override the ones they inherit from, so the first group (starting at the
+	// context channel) that explicitly mentions the user decides. Within a group, removal takes precedence.
+	for (const Channel *channel = &contextChannel; channel; channel = channel->cParent) {
+		const Group *group = channel->qhGroups.value(groupName);
+		if (!group) {
 			continue;
 		}
 
-		if (groupSpecification.startsWith(QChar::fromLatin1('~'))) {
-			contextChannel     = &aclChannel;
-			groupSpecification = groupSpecification.remove(0, 1);
-			continue;
+		if ((channel != &contextChannel) && !group->bInheritable) {
+			break;
 		}
 
-		if (groupSpecification.startsWith(QChar::fromLatin1('#'))) {
-			isAccessToken      = true;
-			groupSpecification = groupSpecification.remove(0, 1);
-			continue;
+		if (group->qsRemove.contains(user.iId)) {
+			return false;
 		}
-		if (groupSpecification.startsWith(QChar::fromLatin1('$'))) {
-			isCertHash         = true;
-			groupSpecification = groupSpecification.remove(0, 1);
-			continue;
+		if (group->qsAdd.contains(user.iId) || group->qsTemporary.contains(user.iId)
+			|| group->qsTemporary.contains(-static_cast< int >(user.uiSession))) {
+			return true;
 		}
 
-		break;
+		if (!group->bInherit) {
+			break;
+		}
 	}
 
-	if (groupSpecification.isEmpty()) {
-		return false;
+	return false;
+}
+} // namespace
+
+Group::Specification Group::Specification::parse(QString specification) {
+	Specification spec;
+	bool isAccessToken = false;
+	bool isCertHash    = false;
+
+	qsizetype prefixLength = 0;
+	for (; prefixLength < specification.size(); ++prefixLength) {
+		const QChar current = specification[prefixLength];
+
+		if (current == QLatin1Char('!')) {
+			spec.invert = true;
+		} else if (current == QLatin1Char('~')) {
+			spec.useACLChannel = true;
+		} else if (current == QLatin1Char('#')) {
+			isAccessToken = true;
+		} else if (current == QLatin1Char('$')) {
+			isCertHash = true;
+		} else {
+			break;
+		}
 	}
+	specification.remove(0, prefixLength);
 
+	if (specification.isEmpty()) {
+		spec.type = Type::Empty;
+		return spec;
+	}
 
 	// First, all special cases that aren't even groups and meta groups (groups that don't actually exist as groups but
 	// have a special meaning based on their name
-	if (isAccessToken)
-		matches = user.qslAccessTokens.contains(groupSpecification, Group::accessTokenCaseSensitivity);
-	else if (isCertHash)
-		matches = user.qsHash == groupSpecification;
-	else if (groupSpecification == QLatin1String("none"))
-		matches = false;
-	else if (groupSpecification == QLatin1String("all"))
-		matches = true;
-	else if (groupSpecification == QLatin1String("auth"))
-		matches = (user.iId >= 0);
-	else if (groupSpecification == QLatin1String("strong"))
-		matches = user.bVerified;
-	else if (groupSpecification == QLatin1String("in"))
-		matches = (user.cChannel == contextChannel);
-	else if (groupSpecification == QLatin1String("out"))
-		matches = !(user.cChannel == contextChannel);
-	else if (groupSpecification == QLatin1String("sub") || groupSpecification.startsWith(QLatin1String("sub,"))) {
-		groupSpecification = groupSpecification.remove(0, 4);
-
-		int requiredChannelOffset = 0;
-		int minDescendantLevel    = 1;
-		int maxDescendantLevel    = 1000;
+	if (isAccessToken) {
+		spec.type = Type::AccessToken;
+		spec.name = specification;
+	} else if (isCertHash) {
+		spec.type = Type::CertificateHash;
+		spec.name = specification;
+	} else if (specification == QLatin1String("none")) {
+		spec.type = Type::None;
+	} else if (specification == QLatin1String("all")) {
+		spec.type = Type::All;
+	} else if (specification == QLatin1String("auth")) {
+		spec.type = Type::Registered;
+	} else if (specification == QLatin1String("strong")) {
+		spec.type = Type::Verified;
+	} else if (specification == QLatin1String("in")) {
+		spec.type = Type::In;
+	} else if (specification == QLatin1String("out")) {
+		spec.type = Type::Out;
+	} else if (specification == QLatin1String("sub") || specification.startsWith(QLatin1String("sub,"))) {
+		spec.type = Type::Sub;
 
 		// Parse arguments, if any
-		QStringList args = groupSpecification.split(QLatin1String(","));
+		const QStringList args = specification.mid(4).split(QLatin1String(","));
 		if (args.count() >= 1 && !args[0].isEmpty()) {
-			requiredChannelOffset = args[0].toInt();
+			spec.subOffset = args[0].toInt();
 		}
 		if (args.count() >= 2 && !args[1].isEmpty()) {
-			minDescendantLevel = args[1].toInt();
+			spec.subMinLevel = args[1].toInt();
 		}
 		if (args.count() >= 3 && !args[2].isEmpty()) {
-			maxDescendantLevel = args[2].toInt();
-		}
-
-		// Assemble channel hierarchy from root channel to the channel the player is currently in
-		QList< const Channel * > homeChannelHierarchy;
-		const Channel *channel = user.cChannel;
-		while (channel) {
-			homeChannelHierarchy.prepend(channel);
-			channel = channel->cParent;
-		}
-
-		// Assemble channel hierarchy from root channel to the channel the ACL containing this specification is
-		// evaluated for
-		QList< const Channel * > currentChannelHierarchy;
-		channel = &currentChannel;
-		while (channel) {
-			currentChannelHierarchy.prepend(channel);
-			channel = channel->cParent;
-		}
-
-		auto requiredChannelIndex = currentChannelHierarchy.indexOf(contextChannel);
-		Q_ASSERT(requiredChannelIndex != -1);
-
-		requiredChannelIndex += requiredChannelOffset;
-
-		if (requiredChannelIndex >= currentChannelHierarchy.count()) {
-			return RET_FALSE;
-		} else if (requiredChannelIndex < 0) {
-			requiredChannelIndex = 0;
-		}
-
-		const Channel *requiredChannel = currentChannelHierarchy[requiredChannelIndex];
-		if (homeChannelHierarchy.indexOf(requiredChannel) == -1) {
-			return RET_FALSE;
+			spec.subMaxLevel = args[2].toInt();
 		}
-
-		const auto minDepth = requiredChannelIndex + minDescendantLevel;
-		const auto maxDepth = requiredChannelIndex + maxDescendantLevel;
-
-		const auto totalDepth = homeChannelHierarchy.count() - 1;
-
-		matches = (totalDepth >= minDepth) && (totalDepth <= maxDepth);
 	} else {
 		// The group specification is an actual group name
-		QStack< const Group * > groupStack;
-
-		const Channel *channel = contextChannel;
-
-		while (channel) {
-			const Group *group = channel->qhGroups.value(groupSpecification);
+		spec.type = Type::Group;
+		spec.name = specification;
+	}
 
-			if (group) {
-				if ((channel != contextChannel) && !group->bInheritable)
-					break;
-				groupStack.push(group);
-				if (!group->bInherit)
-					break;
-			}
+	return spec;
+}
 
-			channel = channel->cParent;
-		}
+bool Group::appliesToUser(const Channel &currentChannel, const Channel &aclChannel,
+						  const Specification &groupSpecification, const ServerUser &user) {
+	const Channel &contextChannel = groupSpecification.useACLChannel ? aclChannel : currentChannel;
+	bool matches                  = false;
 
-		while (!groupStack.isEmpty()) {
-			const Group *group = groupStack.pop();
-			if (group->qsAdd.contains(user.iId) || group->qsTemporary.contains(user.iId)
-				|| group->qsTemporary.contains(-static_cast< int >(user.uiSession)))
-				matches = true;
-			if (group->qsRemove.contains(user.iId))
-				matches = false;
-		}
+	switch (groupSpecification.type) {
+		case Specification::Type::Empty:
+			return false;
+		case Specification::Type::AccessToken:
+			matches = user.qslAccessTokens.contains(groupSpecification.name, Group::accessTokenCaseSensitivity);
+			break;
+		case Specification::Type::CertificateHash:
+			matches = user.qsHash == groupSpecification.name;
+			break;
+		case Specification::Type::None:
+			matches = false;
+			break;
+		case Specification::Type::All:
+			matches = true;
+			break;
+		case Specification::Type::Registered:
+			matches = (user.iId >= 0);
+			break;
+		case Specification::Type::Verified:
+			matches = user.bVerified;
+			break;
+		case Specification::Type::In:
+			matches = (user.cChannel == &contextChannel);
+			break;
+		case Specification::Type::Out:
+			matches = !(user.cChannel == &contextChannel);
+			break;
+		case Specification::Type::Sub:
+			matches = matchesSub(currentChannel, contextChannel, groupSpecification, user);
+			break;
+		case Specification::Type::Group:
+			matches = isGroupMember(contextChannel, groupSpecification.name, user);
+			break;
 	}
-	return invert ? !matches : matches;
+
+	return groupSpecification.invert ? !matches : matches;
 }
 
 #endif
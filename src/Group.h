@@ -7,6 +7,7 @@
 #define MUMBLE_GROUP_H_
 
 #include <QtCore/QSet>
+#include <QtCore/QString>
 
 class Channel;
 class User;
@@ -29,12 +30,51 @@ public:
 	Group(Channel *assoc, const QString &name);
 
 #ifdef MURMUR
+	/// A group specification (as used in ACLs and whisper targets) in parsed form. Parsing is done once when the
+	/// specification is set, so that evaluating it for a user doesn't involve any string processing.
+	struct Specification {
+		enum class Type {
+			/// Matches nobody, regardless of whether it is inverted
+			Empty,
+			/// "#<token>": Users that have provided the given access token
+			AccessToken,
+			/// "$<hash>": Users whose certificate has the given hash
+			CertificateHash,
+			None,
+			All,
+			/// "auth"
+			Registered,
+			/// "strong"
+			Verified,
+			In,
+			Out,
+			/// "sub[,<offset>[,<min level>[,<max level>]]]"
+			Sub,
+			/// The name of an actual group
+			Group,
+		};
+
+		Type type = Type::Empty;
+		/// "!": The specification matches everyone it otherwise wouldn't match
+		bool invert = false;
+		/// "~": The specification is evaluated relative to the channel the ACL is defined in instead of the channel it
+		/// is evaluated for
+		bool useACLChannel = false;
+		/// The access token, certificate hash or group name
+		QString name;
+		int subOffset   = 0;
+		int subMinLevel = 1;
+		int subMaxLevel = 1000;
+
+		static Specification parse(QString specification);
+	};
+
 	QSet< int > members();
 	static QSet< QString > groupNames(Channel *c);
 	static Group *getGroup(Channel *c, QString name);
 
-	static bool appliesToUser(const Channel &currentChannel, const Channel &aclChannel, QString groupSpecification,
-							  const ServerUser &user);
+	static bool appliesToUser(const Channel &currentChannel, const Channel &aclChannel,
+							  const Specification &groupSpecification, const ServerUser &user);
 #endif
 };
 
@@ -0,0 +1,165 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include <benchmark/benchmark.h>
+
+#include "Channel.h"
+#include "Server.h"
+#include "ServerFixture.h"
+#include "ServerUser.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QCryptographicHash>
+
+#include <vector>
+
+// This benchmark measures how long it takes to send the state of a server (all channels and all users) to a client
+// that joins it, depending on the size of the server. A real Server instance is populated with channels and fake,
+// authenticated users, and in every iteration, the state is sent to a (fake) joining client. The joining client's
+// socket isn't connected, so sending the data is cheap and the work of the server dominates.
+//
+// The "cached" argument selects whether the serialized states may be reused from the previous join (which is the
+// case, unless they have changed in between) or have to be serialized from scratch.
+
+namespace {
+
+constexpr int CHANNELS_RANGE = 0;
+constexpr int USERS_RANGE    = 1;
+constexpr int CACHED_RANGE   = 2;
+
+/// The number of subchannels per channel, which determines the depth of the channel tree
+constexpr std::size_t SUBCHANNELS = 10;
+
+Server *server = nullptr;
+
+QByteArray hashOf(const QString &text) {
+	return QCryptographicHash::hash(text.toUtf8(), QCryptographicHash::Sha1);
+}
+
+class Fixture : public ::benchmark::Fixture {
+public:
+	std::vector< Channel * > channels;
+	std::vector< ServerUser * > users;
+	ServerUser *joiner = nullptr;
+
+	void SetUp(const ::benchmark::State &state) {
+		const std::size_t channelCount = static_cast< std::size_t >(state.range(CHANNELS_RANGE));
+		const std::size_t userCount    = static_cast< std::size_t >(state.range(USERS_RANGE));
+		Channel *const root            = server->qhChannels.value(0);
+
+		for (std::size_t i = 0; i < channelCount; ++i) {
+			Channel *parent = i < SUBCHANNELS ? root : channels[i / SUBCHANNELS - 1];
+
+			Channel *channel     = server->createNewChannel(parent, QString::fromLatin1("Channel %1").arg(i));
+			channel->qsDesc      = QString::fromLatin1("The description of channel %1").arg(i);
+			channel->qbaDescHash = hashOf(channel->qsDesc);
+
+			channels.push_back(channel);
+		}
+
+		for (std::size_t i = 0; i < userCount; ++i) {
+			ServerUser *user     = ServerFixture::createUser(*server);
+			user->qsComment      = QString::fromLatin1("The comment of user %1").arg(user->uiSession);
+			user->qbaCommentHash = hashOf(user->qsComment);
+			user->qsHash         = QString::fromLatin1(hashOf(user->qsName).toHex());
+			user->bSelfMute      = i % 3 == 0;
+
+			{
+				QWriteLocker wl(&server->qrwlVoiceThread);
+				server->qhUsers.insert(user->uiSession, user);
+			}
+			MumbleProto::UserState mpus;
+			server->userEnterChannel(user, channels.empty() ? root : channels[i % channels.size()], mpus);
+
+			users.push_back(user);
+		}
+
+		joiner           = ServerFixture::createUser(*server);
+		joiner->cChannel = root;
+	}
+
+	void TearDown(const ::benchmark::State &) {
+		for (ServerUser *user : users) {
+			{
+				QWriteLocker wl(&server->qrwlVoiceThread);
+				server->qhUsers.remove(user->uiSession);
+				user->cChannel->removeUser(user);
+			}
+			server->qqIds.enqueue(user->uiSession);
+
+			delete user;
+		}
+		users.clear();
+
+		clearPermissions();
+		server->qqIds.enqueue(joiner->uiSession);
+		delete joiner;
+		joiner = nullptr;
+
+		// Subchannels are removed along with their parent
+		Channel *const root = server->qhChannels.value(0);
+		for (Channel *channel : channels) {
+			if (channel->cParent == root) {
+				server->removeChannel(channel);
+			}
+		}
+		channels.clear();
+		server->m_joinStateCache.clear();
+	}
+
+	/// Every join starts with the permissions of the joining user not being cached
+	void clearPermissions() {
+		QMutexLocker qml(&server->qmCache);
+		delete server->acCache.take(joiner);
+	}
+};
+
+} // namespace
+
+BENCHMARK_DEFINE_F(Fixture, BM_joinState)(::benchmark::State &state) {
+	const bool cached = state.range(CACHED_RANGE) != 0;
+
+	for (auto _ : state) {
+		state.PauseTiming();
+		clearPermissions();
+		if (!cached) {
+			server->m_joinStateCache.clear();
+		}
+		state.ResumeTiming();
+
+		server->sendChannelStates(joiner);
+		server->sendUserStates(joiner);
+	}
+
+	state.counters["joins/s"] = ::benchmark::Counter(static_cast< double >(state.iterations()),
+													 ::benchmark::Counter::kIsRate);
+}
+
+BENCHMARK_REGISTER_F(Fixture, BM_joinState)
+	->ArgNames({ "channels", "users", "cached" })
+	->ArgsProduct({ { 100, 1000, 3000 }, { 100, 1000 }, { 0, 1 } })
+	->Unit(::benchmark::kMicrosecond)
+	->UseRealTime();
+
+int main(int argc, char **argv) {
+	QCoreApplication app(argc, argv);
+	qInstallMessageHandler(ServerFixture::silenceMessages);
+
+	::benchmark::Initialize(&argc, argv);
+	if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+		return 1;
+	}
+
+	ServerFixture serverFixture;
+	server = serverFixture.addServer();
+	if (!server) {
+		fprintf(stderr, "Failed to start the server\n");
+		return 1;
+	}
+
+	::benchmark::RunSpecifiedBenchmarks();
+
+	return 0;
+}
@@ -0,0 +1,135 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include <benchmark/benchmark.h>
+
+#include "ACL.h"
+#include "Channel.h"
+#include "Group.h"
+#include "Server.h"
+#include "ServerFixture.h"
+
+#include <QtCore/QCoreApplication>
+
+#include <map>
+#include <vector>
+
+// This benchmark measures how long it takes a server to load its channel tree (including the channels' properties,
+// groups, ACLs and links) from the database at boot, depending on the number of channels. Every channel has a
+// description, a group with members and a couple of ACLs, and every tenth channel is linked to its parent.
+//
+// For every channel count, a separate virtual server is populated once. In every iteration, the server's channels
+// are dropped and loaded from the (SQLite) database again, just like it is done when the server is started.
+
+namespace {
+
+constexpr int CHANNELS_RANGE = 0;
+
+/// The number of subchannels per channel, which determines the depth of the channel tree
+constexpr std::size_t SUBCHANNELS = 10;
+
+ServerFixture *serverFixture = nullptr;
+
+/// The populated servers (owned by serverFixture), by their number of channels
+std::map< std::size_t, Server * > servers;
+
+void populate(Server &server, std::size_t channelCount) {
+	Channel *const root = server.qhChannels.value(0);
+	std::vector< Channel * > channels;
+
+	for (std::size_t i = 0; i < channelCount; ++i) {
+		Channel *parent = i < SUBCHANNELS ? root : channels[i / SUBCHANNELS - 1];
+
+		Channel *channel = server.createNewChannel(parent, QString::fromLatin1("Channel %1").arg(i), false,
+												   static_cast< int >(i % SUBCHANNELS), 50);
+		channel->qsDesc  = QString::fromLatin1("The description of channel %1").arg(i);
+
+		Group *group = new Group(channel, QString::fromLatin1("members"));
+		group->qsAdd << 1 << 2 << 3;
+		group->qsRemove << 4;
+
+		ChanACL *acl = new ChanACL(channel);
+		acl->setGroup(QString::fromLatin1("members"));
+		acl->pAllow = ChanACL::Enter | ChanACL::Speak;
+
+		acl = new ChanACL(channel);
+		acl->setGroup(QString::fromLatin1("!~in"));
+		acl->pDeny = ChanACL::Speak;
+
+		server.m_dbWrapper.updateChannelData(server.iServerNum, *channel);
+
+		if (i % SUBCHANNELS == 0 && parent != root) {
+			server.m_dbWrapper.addChannelLink(server.iServerNum, *parent, *channel);
+		}
+
+		channels.push_back(channel);
+	}
+}
+
+void unloadChannels(Server &server) {
+	// Subchannels (and their groups and ACLs) are deleted along with their parent
+	delete server.qhChannels.value(0);
+	server.qhChannels.clear();
+}
+
+} // namespace
+
+static void BM_loadChannels(::benchmark::State &state) {
+	const std::size_t channelCount = static_cast< std::size_t >(state.range(CHANNELS_RANGE));
+
+	Server *&server = servers[channelCount];
+	if (!server) {
+		server = serverFixture->addServer();
+		if (!server) {
+			state.SkipWithError("Failed to start the server");
+			return;
+		}
+		populate(*server, channelCount);
+	}
+
+	for (auto _ : state) {
+		state.PauseTiming();
+		unloadChannels(*server);
+		state.ResumeTiming();
+
+		server->m_dbWrapper.initializeChannels(*server);
+		server->m_dbWrapper.initializeChannelLinks(*server);
+	}
+
+	if (static_cast< std::size_t >(server->qhChannels.size()) != channelCount + 1) {
+		state.SkipWithError("Not all channels have been loaded");
+	}
+
+	state.counters["channels/s"] = ::benchmark::Counter(static_cast< double >(state.iterations() * channelCount),
+														::benchmark::Counter::kIsRate);
+}
+
+BENCHMARK(BM_loadChannels)
+	->ArgNames({ "channels" })
+	->Arg(100)
+	->Arg(1000)
+	->Arg(5000)
+	->Unit(::benchmark::kMillisecond)
+	->UseRealTime();
+
+int main(int argc, char **argv) {
+	QCoreApplication app(argc, argv);
+	qInstallMessageHandler(ServerFixture::silenceMessages);
+
+	::benchmark::Initialize(&argc, argv);
+	if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+		return 1;
+	}
+
+	ServerFixture fixture;
+	serverFixture = &fixture;
+
+	::benchmark::RunSpecifiedBenchmarks();
+
+	servers.clear();
+	serverFixture = nullptr;
+
+	return 0;
+}
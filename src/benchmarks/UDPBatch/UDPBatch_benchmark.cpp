@@ -0,0 +1,240 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include <benchmark/benchmark.h>
+
+#include "HostAddress.h"
+#include "MumbleProtocol.h"
+#include "UDPBatch.h"
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <unistd.h>
+
+// This benchmark compares sending the datagrams of a single audio packet fan-out with one sendmsg call per receiver
+// (what Server::sendMessage does without a batch) against queueing them in a UDPSendBatch and flushing it with
+// sendmmsg. The same is done for receiving with recvmsg vs. UDPReceiveBatch (recvmmsg).
+// All traffic goes through the loopback interface. The "syscalls/packet" counter shows the number of system calls
+// that were needed per datagram.
+
+std::random_device rd;
+std::mt19937 rng(rd());
+std::uniform_int_distribution< unsigned int > random_byte(0, 255);
+
+constexpr int RECEIVER_COUNT_BEGIN = 1;
+constexpr int RECEIVER_COUNT_END   = 512;
+constexpr int MULTIPLIER           = 4;
+
+// The typical size of an encrypted Opus audio packet
+constexpr std::size_t PACKET_SIZE = 120;
+
+std::vector< unsigned char > payload;
+
+int createSocket(struct sockaddr_in &address) {
+	int sock = ::socket(AF_INET, SOCK_DGRAM, 0);
+
+	int sockopt = 1;
+	::setsockopt(sock, IPPROTO_IP, IP_PKTINFO, &sockopt, sizeof(sockopt));
+	sockopt = 4 * 1024 * 1024;
+	::setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &sockopt, sizeof(sockopt));
+
+	memset(&address, 0, sizeof(address));
+	address.sin_family      = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port        = 0;
+	::bind(sock, reinterpret_cast< struct sockaddr * >(&address), sizeof(address));
+
+	socklen_t len = sizeof(address);
+	::getsockname(sock, reinterpret_cast< struct sockaddr * >(&address), &len);
+
+	return sock;
+}
+
+void drain(int sock) {
+	unsigned char buffer[Mumble::Protocol::MAX_UDP_PACKET_SIZE];
+	while (::recv(sock, buffer, sizeof(buffer), MSG_DONTWAIT) > 0) {
+	}
+}
+
+class Fixture : public ::benchmark::Fixture {
+public:
+	int sender;
+	int receiver;
+	struct sockaddr_storage destination;
+	HostAddress localAddress;
+
+	void SetUp(const ::benchmark::State &) {
+		struct sockaddr_in senderAddress;
+		struct sockaddr_in receiverAddress;
+		sender   = createSocket(senderAddress);
+		receiver = createSocket(receiverAddress);
+
+		memset(&destination, 0, sizeof(destination));
+		memcpy(&destination, &receiverAddress, sizeof(receiverAddress));
+		localAddress.fromIPv4(INADDR_LOOPBACK);
+
+		payload.resize(PACKET_SIZE);
+		for (std::size_t i = 0; i < payload.size(); ++i) {
+			payload[i] = static_cast< unsigned char >(random_byte(rng));
+		}
+	}
+
+	void TearDown(const ::benchmark::State &) {
+		::close(sender);
+		::close(receiver);
+	}
+};
+
+BENCHMARK_DEFINE_F(Fixture, BM_sendmsg)(::benchmark::State &state) {
+	const std::size_t receivers = static_cast< std::size_t >(state.range(0));
+	std::uint64_t syscalls      = 0;
+	std::uint64_t packets       = 0;
+
+	for (auto _ : state) {
+		for (std::size_t i = 0; i < receivers; ++i) {
+			struct msghdr msg;
+			struct iovec iov[1];
+			alignas(struct cmsghdr) std::uint8_t controldata[UDPBatch::PKTINFO_CONTROL_SIZE];
+
+			iov[0].iov_base = payload.data();
+			iov[0].iov_len  = payload.size();
+
+			memset(&msg, 0, sizeof(msg));
+			msg.msg_iov     = iov;
+			msg.msg_iovlen  = 1;
+			msg.msg_control = controldata;
+			UDPBatch::setupMessageHeader(msg, destination, localAddress);
+
+			benchmark::DoNotOptimize(::sendmsg(sender, &msg, 0));
+			++syscalls;
+			++packets;
+		}
+
+		state.PauseTiming();
+		drain(receiver);
+		state.ResumeTiming();
+	}
+
+	state.counters["syscalls/packet"] = static_cast< double >(syscalls) / static_cast< double >(packets);
+	state.counters["packets"] = benchmark::Counter(static_cast< double >(packets), benchmark::Counter::kIsRate);
+}
+
+BENCHMARK_REGISTER_F(Fixture, BM_sendmsg)
+	->RangeMultiplier(MULTIPLIER)
+	->Range(RECEIVER_COUNT_BEGIN, RECEIVER_COUNT_END);
+
+BENCHMARK_DEFINE_F(Fixture, BM_sendmmsg)(::benchmark::State &state) {
+	const std::size_t receivers = static_cast< std::size_t >(state.range(0));
+	UDPSendBatch batch;
+
+	for (auto _ : state) {
+		for (std::size_t i = 0; i < receivers; ++i) {
+			unsigned char *buffer = batch.prepare();
+			memcpy(buffer, payload.data(), payload.size());
+			batch.commit(sender, destination, localAddress, payload.size());
+		}
+		batch.flush();
+
+		state.PauseTiming();
+		drain(receiver);
+		state.ResumeTiming();
+	}
+
+	state.counters["syscalls/packet"] =
+		static_cast< double >(batch.getSyscallCount()) / static_cast< double >(batch.getDatagramCount());
+	state.counters["packets"] =
+		benchmark::Counter(static_cast< double >(batch.getDatagramCount()), benchmark::Counter::kIsRate);
+}
+
+BENCHMARK_REGISTER_F(Fixture, BM_sendmmsg)
+	->RangeMultiplier(MULTIPLIER)
+	->Range(RECEIVER_COUNT_BEGIN, RECEIVER_COUNT_END);
+
+BENCHMARK_DEFINE_F(Fixture, BM_recvmsg)(::benchmark::State &state) {
+	const std::size_t datagrams = static_cast< std::size_t >(state.range(0));
+	std::uint64_t syscalls      = 0;
+	std::uint64_t packets       = 0;
+
+	for (auto _ : state) {
+		state.PauseTiming();
+		for (std::size_t i = 0; i < datagrams; ++i) {
+			::sendto(sender, payload.data(), payload.size(), 0, reinterpret_cast< struct sockaddr * >(&destination),
+					 sizeof(struct sockaddr_in));
+		}
+		state.ResumeTiming();
+
+		for (std::size_t i = 0; i < datagrams; ++i) {
+			struct sockaddr_storage from;
+			struct msghdr msg;
+			struct iovec iov[1];
+			unsigned char buffer[Mumble::Protocol::MAX_UDP_PACKET_SIZE];
+			alignas(struct cmsghdr) std::uint8_t controldata[UDPBatch::PKTINFO_CONTROL_SIZE];
+
+			iov[0].iov_base = buffer;
+			iov[0].iov_len  = sizeof(buffer);
+
+			memset(&msg, 0, sizeof(msg));
+			msg.msg_name       = &from;
+			msg.msg_namelen    = sizeof(from);
+			msg.msg_iov        = iov;
+			msg.msg_iovlen     = 1;
+			msg.msg_control    = controldata;
+			msg.msg_controllen = sizeof(controldata);
+
+			++syscalls;
+			if (::recvmsg(receiver, &msg, MSG_TRUNC | MSG_DONTWAIT) <= 0) {
+				break;
+			}
+			++packets;
+		}
+	}
+
+	state.counters["syscalls/packet"] = static_cast< double >(syscalls) / static_cast< double >(packets);
+	state.counters["packets"] = benchmark::Counter(static_cast< double >(packets), benchmark::Counter::kIsRate);
+}
+
+BENCHMARK_REGISTER_F(Fixture, BM_recvmsg)
+	->RangeMultiplier(MULTIPLIER)
+	->Range(RECEIVER_COUNT_BEGIN, RECEIVER_COUNT_END);
+
+BENCHMARK_DEFINE_F(Fixture, BM_recvmmsg)(::benchmark::State &state) {
+	const std::size_t datagrams = static_cast< std::size_t >(state.range(0));
+	UDPReceiveBatch batch;
+	std::uint64_t syscalls = 0;
+	std::uint64_t packets  = 0;
+
+	for (auto _ : state) {
+		state.PauseTiming();
+		for (std::size_t i = 0; i < datagrams; ++i) {
+			::sendto(sender, payload.data(), payload.size(), 0, reinterpret_cast< struct sockaddr * >(&destination),
+					 sizeof(struct sockaddr_in));
+		}
+		state.ResumeTiming();
+
+		std::size_t received = 0;
+		while (received < datagrams) {
+			++syscalls;
+			int count = batch.receive(receiver);
+			if (count <= 0) {
+				break;
+			}
+			received += static_cast< std::size_t >(count);
+		}
+		packets += received;
+	}
+
+	state.counters["syscalls/packet"] = static_cast< double >(syscalls) / static_cast< double >(packets);
+	state.counters["packets"] = benchmark::Counter(static_cast< double >(packets), benchmark::Counter::kIsRate);
+}
+
+BENCHMARK_REGISTER_F(Fixture, BM_recvmmsg)
+	->RangeMultiplier(MULTIPLIER)
+	->Range(RECEIVER_COUNT_BEGIN, RECEIVER_COUNT_END);
+
+
+BENCHMARK_MAIN();
@@ -0,0 +1,419 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include <benchmark/benchmark.h>
+
+#include "Channel.h"
+#include "MumbleProtocol.h"
+#include "Server.h"
+#include "ServerFixture.h"
+#include "ServerUser.h"
+#include "crypto/CryptStateOCB2.h"
+
+#include <QtCore/QCoreApplication>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <limits>
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// This benchmark measures the complete voice path of the server: A real Server instance is booted on the loopback
+// interface and populated with fake, authenticated users, each of which owns a UDP socket acting as its client.
+// In every iteration, each talker sends one encrypted audio frame to the server and the iteration ends once all
+// resulting datagrams have been received (and decrypted) by the respective clients. Thus, this covers
+// Server::runVoiceLoop, processDatagram, processMsg and sendMessage including the system calls.
+//
+// Besides the usual timings, the following counters are reported:
+// - "in_pkts/s" and "out_pkts/s": audio packets received respectively sent out by the server
+// - "p50_us", "p90_us", "p99_us": Latency between sending a frame and a client receiving it
+// - "server_us/pkt": CPU time spent by the server per incoming packet
+// - "core_%/talker": The share of a CPU core a single talker occupies, assuming the usual 100 frames/s
+
+namespace {
+
+/// The kinds of talker mixes that can be benchmarked
+enum class Scenario {
+	/// All users are in the same channel and the talkers use regular speech
+	Speech,
+	/// The users are spread over several channels and the talkers' channel is listened to by half of the others
+	Listeners,
+	/// The users are spread over several channels that are all linked to the talkers' channel
+	Links,
+	/// The users are spread over the subchannels of the talkers' channel and the talkers shout to all subchannels
+	Whisper,
+	/// Like Speech, but the talkers send positional data and everyone shares the same positional context
+	Positional,
+};
+
+constexpr int SCENARIO_RANGE = 0;
+constexpr int USERS_RANGE    = 1;
+constexpr int TALKERS_RANGE  = 2;
+
+/// The number of channels the users are spread over (if the scenario uses more than one)
+constexpr std::size_t CHANNEL_COUNT = 8;
+
+/// The typical size of an Opus frame (10 ms at 48 kbit/s)
+constexpr std::size_t PAYLOAD_SIZE = 60;
+
+/// The whisper target ID the talkers use in the Whisper scenario
+constexpr int WHISPER_TARGET = 1;
+
+/// How long to wait for outstanding datagrams before giving up on an iteration
+constexpr std::chrono::milliseconds RECEIVE_TIMEOUT(1000);
+
+class BenchmarkServer : public Server {
+public:
+	using Server::Server;
+
+	using Server::startThread;
+	using Server::stopThread;
+};
+
+BenchmarkServer *server = nullptr;
+
+double cpuSeconds(clockid_t clock) {
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+
+	return static_cast< double >(ts.tv_sec) + static_cast< double >(ts.tv_nsec) / 1e9;
+}
+
+/// The client side of a fake user
+struct Client {
+	ServerUser *user = nullptr;
+	int socket       = -1;
+	CryptStateOCB2 crypt;
+	Mumble::Protocol::UDPAudioEncoder< Mumble::Protocol::Role::Client > encoder;
+	Mumble::Protocol::UDPDecoder< Mumble::Protocol::Role::Client > decoder;
+};
+
+class Fixture : public ::benchmark::Fixture {
+public:
+	Scenario scenario;
+	std::vector< std::unique_ptr< Client > > clients;
+	std::vector< Channel * > channels;
+	std::vector< pollfd > pollFDs;
+	std::vector< unsigned char > payload;
+	struct sockaddr_in serverAddress;
+
+	/// The number of datagrams the clients receive per iteration
+	std::size_t expectedDatagrams = 0;
+
+	void SetUp(const ::benchmark::State &state) {
+		scenario                    = static_cast< Scenario >(state.range(SCENARIO_RANGE));
+		const std::size_t users     = static_cast< std::size_t >(state.range(USERS_RANGE));
+		const std::size_t talkers   = static_cast< std::size_t >(state.range(TALKERS_RANGE));
+		Channel *const root         = server->qhChannels.value(0);
+		const bool multipleChannels = scenario != Scenario::Speech && scenario != Scenario::Positional;
+
+		std::mt19937 rng(42);
+		std::uniform_int_distribution< unsigned int > randomByte(0, 255);
+		payload.resize(PAYLOAD_SIZE);
+		for (unsigned char &byte : payload) {
+			byte = static_cast< unsigned char >(randomByte(rng));
+		}
+
+		// The talkers are always placed in the first channel
+		channels.push_back(server->createNewChannel(root, "Talkers"));
+		if (multipleChannels) {
+			Channel *parent = scenario == Scenario::Whisper ? channels.front() : root;
+			for (std::size_t i = 1; i < CHANNEL_COUNT; ++i) {
+				channels.push_back(server->createNewChannel(parent, QString::fromLatin1("Channel %1").arg(i)));
+			}
+		}
+		if (scenario == Scenario::Links) {
+			for (std::size_t i = 1; i < channels.size(); ++i) {
+				server->linkChannels(*channels.front(), *channels[i]);
+			}
+		}
+
+		socklen_t addressLength = sizeof(serverAddress);
+		getsockname(server->qlUdpSocket.front(), reinterpret_cast< struct sockaddr * >(&serverAddress),
+					&addressLength);
+
+		for (std::size_t i = 0; i < users; ++i) {
+			// Spread everyone but the talkers over the other channels
+			const bool talker = i < talkers;
+			Channel *channel  = channels.front();
+			if (!talker && multipleChannels) {
+				channel = channels[1 + i % (channels.size() - 1)];
+			}
+
+			clients.push_back(createClient(*channel));
+			Client &client = *clients.back();
+
+			if (scenario == Scenario::Listeners && !talker && i % 2 == 0) {
+				server->addChannelListener(*client.user, *channels.front());
+			}
+			if (scenario == Scenario::Positional) {
+				client.user->ssContext = "benchmark";
+			}
+		}
+
+		if (scenario == Scenario::Whisper) {
+			WhisperTarget target;
+			WhisperTarget::Channel channelTarget;
+			channelTarget.id              = channels.front()->iId;
+			channelTarget.includeChildren = true;
+			target.channels.push_back(channelTarget);
+
+			for (std::size_t i = 0; i < talkers; ++i) {
+				clients[i]->user->qmTargets.insert(WHISPER_TARGET, target);
+			}
+		}
+
+		server->startThread();
+
+		// Determine the fan-out by sending a single round of frames, which also warms up the server's caches
+		std::vector< double > latencies;
+		sendFrames(talkers, 0);
+		expectedDatagrams = receiveDatagrams(std::numeric_limits< std::size_t >::max(), latencies);
+	}
+
+	void TearDown(const ::benchmark::State &) {
+		server->stopThread();
+
+		for (std::unique_ptr< Client > &client : clients) {
+			ServerUser *user = client->user;
+
+			if (scenario == Scenario::Listeners) {
+				server->disableChannelListener(*user, *channels.front());
+			}
+
+			{
+				QWriteLocker wl(&server->qrwlVoiceThread);
+				server->qhUsers.remove(user->uiSession);
+				server->m_peerUsers.remove(PeerKey::fromSockaddr(user->saiUdpAddress));
+				user->cChannel->removeUser(user);
+				server->clearWhisperTargetCacheFor(*user);
+			}
+			server->qqIds.enqueue(user->uiSession);
+
+			delete user;
+			close(client->socket);
+		}
+		clients.clear();
+		pollFDs.clear();
+
+		// Subchannels are removed along with their parent
+		Channel *const root = server->qhChannels.value(0);
+		for (Channel *channel : channels) {
+			if (channel->cParent != root) {
+				continue;
+			}
+			server->removeChannel(channel);
+		}
+		channels.clear();
+	}
+
+	std::unique_ptr< Client > createClient(Channel &channel) {
+		std::unique_ptr< Client > client = std::make_unique< Client >();
+
+		client->socket = ::socket(AF_INET, SOCK_DGRAM, 0);
+		int sockopt    = 4 * 1024 * 1024;
+		::setsockopt(client->socket, SOL_SOCKET, SO_RCVBUF, &sockopt, sizeof(sockopt));
+
+		struct sockaddr_in address;
+		memset(&address, 0, sizeof(address));
+		address.sin_family      = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		::bind(client->socket, reinterpret_cast< struct sockaddr * >(&address), sizeof(address));
+		::connect(client->socket, reinterpret_cast< struct sockaddr * >(&serverAddress), sizeof(serverAddress));
+
+		ServerUser *user = ServerFixture::createUser(*server);
+		user->sUdpSocket = server->qlUdpSocket.front();
+
+		socklen_t addressLength = sizeof(user->saiUdpAddress);
+		getsockname(client->socket, reinterpret_cast< struct sockaddr * >(&user->saiUdpAddress), &addressLength);
+
+		// What the server sends is decrypted by the client and vice versa
+		user->csCrypt->genKey();
+		client->crypt.setKey(user->csCrypt->getRawKey(), user->csCrypt->getDecryptIV(),
+							 user->csCrypt->getEncryptIV());
+		client->encoder.setProtocolVersion(user->m_version);
+		client->decoder.setProtocolVersion(user->m_version);
+		client->user = user;
+
+		{
+			QWriteLocker wl(&server->qrwlVoiceThread);
+			server->qhUsers.insert(user->uiSession, user);
+			server->m_peerUsers.insert(PeerKey::fromSockaddr(user->saiUdpAddress), user);
+		}
+		MumbleProto::UserState mpus;
+		server->userEnterChannel(user, &channel, mpus);
+
+		pollFDs.push_back({ client->socket, POLLIN, 0 });
+
+		return client;
+	}
+
+	void sendFrames(std::size_t talkers, std::uint64_t frameNumber) {
+		Mumble::Protocol::AudioData audioData;
+		audioData.usedCodec   = Mumble::Protocol::AudioCodec::Opus;
+		audioData.frameNumber = frameNumber;
+		audioData.payload     = { payload.data(), payload.size() };
+		if (scenario == Scenario::Whisper) {
+			audioData.targetOrContext = WHISPER_TARGET;
+		}
+		if (scenario == Scenario::Positional) {
+			audioData.containsPositionalData = true;
+			audioData.position               = { 1.0f, 2.0f, 3.0f };
+		}
+
+		unsigned char datagram[Mumble::Protocol::MAX_UDP_PACKET_SIZE];
+		for (std::size_t i = 0; i < talkers; ++i) {
+			Client &client = *clients[i];
+
+			std::span< const Mumble::Protocol::byte > encoded = client.encoder.encodeAudioPacket(audioData);
+			client.crypt.encrypt(encoded.data(), datagram, static_cast< unsigned int >(encoded.size()));
+
+			sendTimes[client.user->uiSession] = std::chrono::steady_clock::now();
+			::send(client.socket, datagram, encoded.size() + 4, 0);
+		}
+	}
+
+	/// Receives datagrams until the given number has been received or no more datagrams arrive
+	///
+	/// @returns The number of received datagrams
+	std::size_t receiveDatagrams(std::size_t expected, std::vector< double > &latencies) {
+		unsigned char datagram[Mumble::Protocol::MAX_UDP_PACKET_SIZE];
+		unsigned char plain[Mumble::Protocol::MAX_UDP_PACKET_SIZE];
+		std::size_t received = 0;
+
+		// If the number of expected datagrams is unknown, the end is detected by a short period of silence
+		const int timeout = expected == std::numeric_limits< std::size_t >::max()
+								? 100
+								: static_cast< int >(RECEIVE_TIMEOUT.count());
+
+		while (received < expected) {
+			if (::poll(pollFDs.data(), pollFDs.size(), timeout) <= 0) {
+				break;
+			}
+
+			for (std::size_t i = 0; i < pollFDs.size(); ++i) {
+				if (!(pollFDs[i].revents & POLLIN)) {
+					continue;
+				}
+
+				Client &client = *clients[i];
+				ssize_t length;
+				while ((length = ::recv(client.socket, datagram, sizeof(datagram), MSG_DONTWAIT)) > 4) {
+					const auto now = std::chrono::steady_clock::now();
+					++received;
+
+					if (!client.crypt.decrypt(datagram, plain, static_cast< unsigned int >(length))
+						|| !client.decoder.decode({ plain, static_cast< std::size_t >(length - 4) })) {
+						continue;
+					}
+
+					auto it = sendTimes.find(client.decoder.getAudioData().senderSession);
+					if (it != sendTimes.end()) {
+						latencies.push_back(std::chrono::duration< double, std::micro >(now - it->second).count());
+					}
+				}
+			}
+		}
+
+		return received;
+	}
+
+private:
+	std::unordered_map< unsigned int, std::chrono::steady_clock::time_point > sendTimes;
+};
+
+double percentile(std::vector< double > &values, double p) {
+	if (values.empty()) {
+		return 0;
+	}
+
+	const std::size_t index = std::min(values.size() - 1, static_cast< std::size_t >(p * values.size()));
+	std::nth_element(values.begin(), values.begin() + static_cast< std::ptrdiff_t >(index), values.end());
+
+	return values[index];
+}
+
+} // namespace
+
+BENCHMARK_DEFINE_F(Fixture, BM_voicePath)(::benchmark::State &state) {
+	const std::size_t talkers = static_cast< std::size_t >(state.range(TALKERS_RANGE));
+
+	if (expectedDatagrams == 0) {
+		state.SkipWithError("The server did not forward any audio");
+		return;
+	}
+
+	std::vector< double > latencies;
+	std::uint64_t frameNumber = 1;
+
+	// Everything this thread does is client work, so the remaining CPU time of the process has been spent by the server
+	const double processStart = cpuSeconds(CLOCK_PROCESS_CPUTIME_ID);
+	const double clientStart  = cpuSeconds(CLOCK_THREAD_CPUTIME_ID);
+
+	for (auto _ : state) {
+		sendFrames(talkers, frameNumber++);
+
+		if (receiveDatagrams(expectedDatagrams, latencies) != expectedDatagrams) {
+			state.SkipWithError("Timed out waiting for audio");
+			break;
+		}
+	}
+
+	const double serverSeconds = (cpuSeconds(CLOCK_PROCESS_CPUTIME_ID) - processStart)
+								 - (cpuSeconds(CLOCK_THREAD_CPUTIME_ID) - clientStart);
+	const double incoming = static_cast< double >(state.iterations() * talkers);
+
+	state.SetItemsProcessed(static_cast< std::int64_t >(incoming));
+	state.counters["in_pkts/s"]  = ::benchmark::Counter(incoming, ::benchmark::Counter::kIsRate);
+	state.counters["out_pkts/s"] = ::benchmark::Counter(
+		static_cast< double >(state.iterations() * expectedDatagrams), ::benchmark::Counter::kIsRate);
+	state.counters["p50_us"]        = percentile(latencies, 0.5);
+	state.counters["p90_us"]        = percentile(latencies, 0.9);
+	state.counters["p99_us"]        = percentile(latencies, 0.99);
+	state.counters["server_us/pkt"] = incoming > 0 ? serverSeconds * 1e6 / incoming : 0;
+	// A talker sends 100 frames per second
+	state.counters["core_%/talker"] = incoming > 0 ? serverSeconds / incoming * 100 * 100 : 0;
+}
+
+BENCHMARK_REGISTER_F(Fixture, BM_voicePath)
+	->ArgNames({ "scenario", "users", "talkers" })
+	->ArgsProduct({ { static_cast< int >(Scenario::Speech), static_cast< int >(Scenario::Listeners),
+					  static_cast< int >(Scenario::Links), static_cast< int >(Scenario::Whisper),
+					  static_cast< int >(Scenario::Positional) },
+					{ 16, 128 },
+					{ 1, 4 } })
+	->UseRealTime();
+
+int main(int argc, char **argv) {
+	QCoreApplication app(argc, argv);
+	qInstallMessageHandler(ServerFixture::silenceMessages);
+
+	::benchmark::Initialize(&argc, argv);
+	if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+		return 1;
+	}
+
+	ServerFixture serverFixture;
+
+	// The frames are sent as fast as possible, which would quickly exceed any realistic bandwidth limit
+	server = serverFixture.addServer< BenchmarkServer >({ { "bandwidth", "2000000000" } });
+	if (!server) {
+		fprintf(stderr, "Failed to start the server\n");
+		return 1;
+	}
+
+	::benchmark::RunSpecifiedBenchmarks();
+
+	return 0;
+}
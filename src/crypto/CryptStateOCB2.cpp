@@ -36,6 +36,7 @@ CryptStateOCB2::CryptStateOCB2()
 	memset(raw_key, 0, AES_KEY_SIZE_BYTES);
 	memset(encrypt_iv, 0, AES_BLOCK_SIZE);
 	memset(decrypt_iv, 0, AES_BLOCK_SIZE);
+	initCiphers();
 }
 
 CryptStateOCB2::~CryptStateOCB2() noexcept {
@@ -53,6 +54,7 @@ void CryptStateOCB2::genKey() {
 	CryptographicRandom::fillBuffer(raw_key, AES_KEY_SIZE_BYTES);
 	CryptographicRandom::fillBuffer(encrypt_iv, AES_BLOCK_SIZE);
 	CryptographicRandom::fillBuffer(decrypt_iv, AES_BLOCK_SIZE);
+	initCiphers();
 	bInit = true;
 }
 
@@ -61,6 +63,7 @@ bool CryptStateOCB2::setKey(const std::string &rkey, const std::string &eiv, con
 		memcpy(raw_key, rkey.data(), AES_KEY_SIZE_BYTES);
 		memcpy(encrypt_iv, eiv.data(), AES_BLOCK_SIZE);
 		memcpy(decrypt_iv, div.data(), AES_BLOCK_SIZE);
+		initCiphers();
 		bInit = true;
 		return true;
 	}
@@ -70,6 +73,7 @@ bool CryptStateOCB2::setKey(const std::string &rkey, const std::string &eiv, con
 bool CryptStateOCB2::setRawKey(const std::string &rkey) {
 	if (rkey.length() == AES_KEY_SIZE_BYTES) {
 		memcpy(raw_key, rkey.data(), AES_KEY_SIZE_BYTES);
+		initCiphers();
 		return true;
 	}
 	return false;
@@ -270,46 +274,57 @@ static void inline ZERO(keyblock &block) {
 		block[i] = 0;
 }
 
-#define AESencrypt_ctx(src, dst, key, enc_ctx)                                                      \
-	{                                                                                               \
-		int outlen = 0;                                                                             \
-		EVP_EncryptInit_ex(enc_ctx, EVP_aes_128_ecb(), NULL, key, NULL);                            \
-		EVP_CIPHER_CTX_set_padding(enc_ctx, 0);                                                     \
-		EVP_EncryptUpdate(enc_ctx, reinterpret_cast< unsigned char * >(dst), &outlen,               \
-						  reinterpret_cast< const unsigned char * >(src), AES_BLOCK_SIZE);          \
-		EVP_EncryptFinal_ex(enc_ctx, reinterpret_cast< unsigned char * >((dst) + outlen), &outlen); \
+/// Encrypts (or decrypts) the given number of consecutive blocks with a context that has been set up by initCiphers().
+/// Handing multiple blocks to OpenSSL at once allows it to process them in parallel (e.g. by interleaving the AES-NI
+/// rounds of up to 8 blocks), instead of waiting for the result of every block before starting the next one.
+static void inline AES_ECB(EVP_CIPHER_CTX *ctx, const void *src, void *dst, unsigned int blocks) {
+	int outlen = 0;
+	EVP_CipherUpdate(ctx, reinterpret_cast< unsigned char * >(dst), &outlen,
+					 reinterpret_cast< const unsigned char * >(src), static_cast< int >(blocks * AES_BLOCK_SIZE));
+}
+
+void CryptStateOCB2::initCiphers() {
+	for (EVP_CIPHER_CTX *ctx : { enc_ctx_ocb_enc, enc_ctx_ocb_dec }) {
+		EVP_EncryptInit_ex(ctx, EVP_aes_128_ecb(), nullptr, raw_key, nullptr);
+		EVP_CIPHER_CTX_set_padding(ctx, 0);
 	}
-#define AESdecrypt_ctx(src, dst, key, dec_ctx)                                                      \
-	{                                                                                               \
-		int outlen = 0;                                                                             \
-		EVP_DecryptInit_ex(dec_ctx, EVP_aes_128_ecb(), NULL, key, NULL);                            \
-		EVP_CIPHER_CTX_set_padding(dec_ctx, 0);                                                     \
-		EVP_DecryptUpdate(dec_ctx, reinterpret_cast< unsigned char * >(dst), &outlen,               \
-						  reinterpret_cast< const unsigned char * >(src), AES_BLOCK_SIZE);          \
-		EVP_DecryptFinal_ex(dec_ctx, reinterpret_cast< unsigned char * >((dst) + outlen), &outlen); \
+	for (EVP_CIPHER_CTX *ctx : { dec_ctx_ocb_enc, dec_ctx_ocb_dec }) {
+		EVP_DecryptInit_ex(ctx, EVP_aes_128_ecb(), nullptr, raw_key, nullptr);
+		EVP_CIPHER_CTX_set_padding(ctx, 0);
 	}
+}
 
-#define AESencrypt(src, dst, key) AESencrypt_ctx(src, dst, key, enc_ctx_ocb_enc)
-#define AESdecrypt(src, dst, key) AESdecrypt_ctx(src, dst, key, dec_ctx_ocb_enc)
+#define AESencrypt(src, dst) AES_ECB(enc_ctx_ocb_enc, src, dst, 1)
+#define AESencryptBlocks(src, dst, blocks) AES_ECB(enc_ctx_ocb_enc, src, dst, blocks)
 
 bool CryptStateOCB2::ocb_encrypt(const unsigned char *plain, unsigned char *encrypted, unsigned int len,
 								 const unsigned char *nonce, unsigned char *tag, bool modifyPlainOnXEXStarAttack) {
-	keyblock checksum, delta, tmp, pad;
+	keyblock checksum, delta, tmp, pad, offset;
 	bool success = true;
 
 	// Initialize
-	AESencrypt(nonce, delta, raw_key);
+	AESencrypt(nonce, delta);
 	ZERO(checksum);
 
-	while (len > AES_BLOCK_SIZE) {
+	// All full blocks except for the last (possibly also full) one. The encryption of these blocks only depends on
+	// their offset (delta), so they are first masked in the output buffer, then encrypted all at once and finally
+	// masked a second time.
+	const unsigned int blocks = len > 0 ? (len - 1) / AES_BLOCK_SIZE : 0;
+
+	memcpy(offset, delta, AES_BLOCK_SIZE);
+	for (unsigned int i = 0; i < blocks; ++i) {
+		const subblock *in = reinterpret_cast< const subblock * >(plain + i * AES_BLOCK_SIZE);
+		subblock *out      = reinterpret_cast< subblock * >(encrypted + i * AES_BLOCK_SIZE);
+
 		// Counter-cryptanalysis described in section 9 of https://eprint.iacr.org/2019/311
 		// For an attack, the second to last block (i.e. the last iteration of this loop)
 		// must be all 0 except for the last byte (which may be 0 - 128).
 		bool flipABit = false; // *plain is const, so we can't directly modify it
-		if (len - AES_BLOCK_SIZE <= AES_BLOCK_SIZE) {
-			unsigned char sum = 0;
-			for (int i = 0; i < AES_BLOCK_SIZE - 1; ++i) {
-				sum |= plain[i];
+		if (i + 1 == blocks) {
+			const unsigned char *bytes = reinterpret_cast< const unsigned char * >(in);
+			unsigned char sum          = 0;
+			for (int j = 0; j < AES_BLOCK_SIZE - 1; ++j) {
+				sum |= bytes[j];
 			}
 			if (sum == 0) {
 				if (modifyPlainOnXEXStarAttack) {
@@ -326,27 +341,35 @@ bool CryptStateOCB2::ocb_encrypt(const unsigned char *plain, unsigned char *encr
 		}
 
 		S2(delta);
-		XOR(tmp, delta, reinterpret_cast< const subblock * >(plain));
-		if (flipABit) {
-			*reinterpret_cast< unsigned char * >(tmp) ^= 1;
-		}
-		AESencrypt(tmp, tmp, raw_key);
-		XOR(reinterpret_cast< subblock * >(encrypted), delta, tmp);
-		XOR(checksum, checksum, reinterpret_cast< const subblock * >(plain));
+		// The checksum has to be updated before writing the output, as plain and encrypted may be the same buffer
+		XOR(checksum, checksum, in);
+		XOR(out, delta, in);
 		if (flipABit) {
+			*reinterpret_cast< unsigned char * >(out) ^= 1;
 			*reinterpret_cast< unsigned char * >(checksum) ^= 1;
 		}
+	}
 
-		len -= AES_BLOCK_SIZE;
-		plain += AES_BLOCK_SIZE;
-		encrypted += AES_BLOCK_SIZE;
+	if (blocks > 0) {
+		AESencryptBlocks(encrypted, encrypted, blocks);
 	}
 
+	for (unsigned int i = 0; i < blocks; ++i) {
+		subblock *out = reinterpret_cast< subblock * >(encrypted + i * AES_BLOCK_SIZE);
+
+		S2(offset);
+		XOR(out, offset, out);
+	}
+
+	len -= blocks * AES_BLOCK_SIZE;
+	plain += blocks * AES_BLOCK_SIZE;
+	encrypted += blocks * AES_BLOCK_SIZE;
+
 	S2(delta);
 	ZERO(tmp);
 	tmp[BLOCKSIZE - 1] = SWAPPED(len * 8);
 	XOR(tmp, tmp, delta);
-	AESencrypt(tmp, pad, raw_key);
+	AESencrypt(tmp, pad);
 	memcpy(tmp, plain, len);
 	memcpy(reinterpret_cast< unsigned char * >(tmp) + len, reinterpret_cast< const unsigned char * >(pad) + len,
 		   AES_BLOCK_SIZE - len);
@@ -356,42 +379,57 @@ bool CryptStateOCB2::ocb_encrypt(const unsigned char *plain, unsigned char *encr
 
 	S3(delta);
 	XOR(tmp, delta, checksum);
-	AESencrypt(tmp, tag, raw_key);
+	AESencrypt(tmp, tag);
 
 	return success;
 }
 
 #undef AESencrypt
-#undef AESdecrypt
+#undef AESencryptBlocks
 
-#define AESencrypt(src, dst, key) AESencrypt_ctx(src, dst, key, enc_ctx_ocb_dec)
-#define AESdecrypt(src, dst, key) AESdecrypt_ctx(src, dst, key, dec_ctx_ocb_dec)
+#define AESencrypt(src, dst) AES_ECB(enc_ctx_ocb_dec, src, dst, 1)
+#define AESdecryptBlocks(src, dst, blocks) AES_ECB(dec_ctx_ocb_dec, src, dst, blocks)
 
 bool CryptStateOCB2::ocb_decrypt(const unsigned char *encrypted, unsigned char *plain, unsigned int len,
 								 const unsigned char *nonce, unsigned char *tag) {
-	keyblock checksum, delta, tmp, pad;
+	keyblock checksum, delta, tmp, pad, offset;
 	bool success = true;
 
 	// Initialize
-	AESencrypt(nonce, delta, raw_key);
+	AESencrypt(nonce, delta);
 	ZERO(checksum);
 
-	while (len > AES_BLOCK_SIZE) {
+	// Just like for the encryption, all blocks but the last one are decrypted at once (see ocb_encrypt)
+	const unsigned int blocks = len > 0 ? (len - 1) / AES_BLOCK_SIZE : 0;
+
+	memcpy(offset, delta, AES_BLOCK_SIZE);
+	for (unsigned int i = 0; i < blocks; ++i) {
 		S2(delta);
-		XOR(tmp, delta, reinterpret_cast< const subblock * >(encrypted));
-		AESdecrypt(tmp, tmp, raw_key);
-		XOR(reinterpret_cast< subblock * >(plain), delta, tmp);
-		XOR(checksum, checksum, reinterpret_cast< const subblock * >(plain));
-		len -= AES_BLOCK_SIZE;
-		plain += AES_BLOCK_SIZE;
-		encrypted += AES_BLOCK_SIZE;
+		XOR(reinterpret_cast< subblock * >(plain + i * AES_BLOCK_SIZE), delta,
+			reinterpret_cast< const subblock * >(encrypted + i * AES_BLOCK_SIZE));
+	}
+
+	if (blocks > 0) {
+		AESdecryptBlocks(plain, plain, blocks);
 	}
 
+	for (unsigned int i = 0; i < blocks; ++i) {
+		subblock *out = reinterpret_cast< subblock * >(plain + i * AES_BLOCK_SIZE);
+
+		S2(offset);
+		XOR(out, offset, out);
+		XOR(checksum, checksum, out);
+	}
+
+	len -= blocks * AES_BLOCK_SIZE;
+	plain += blocks * AES_BLOCK_SIZE;
+	encrypted += blocks * AES_BLOCK_SIZE;
+
 	S2(delta);
 	ZERO(tmp);
 	tmp[BLOCKSIZE - 1] = SWAPPED(len * 8);
 	XOR(tmp, tmp, delta);
-	AESencrypt(tmp, pad, raw_key);
+	AESencrypt(tmp, pad);
 	memset(tmp, 0, AES_BLOCK_SIZE);
 	memcpy(tmp, encrypted, len);
 	XOR(tmp, tmp, pad);
@@ -409,13 +447,13 @@ bool CryptStateOCB2::ocb_decrypt(const unsigned char *encrypted, unsigned char *
 
 	S3(delta);
 	XOR(tmp, delta, checksum);
-	AESencrypt(tmp, tag, raw_key);
+	AESencrypt(tmp, tag);
 
 	return success;
 }
 
 #undef AESencrypt
-#undef AESdecrypt
+#undef AESdecryptBlocks
 #undef BLOCKSIZE
 #undef SHIFTBITS
 #undef SWAPPED
@@ -39,6 +39,10 @@ public:
 					 unsigned char *tag);
 
 private:
+	/// Sets up the cipher contexts for the current raw_key. This is done once per key (instead of once per AES block),
+	/// as expanding the key is a lot more expensive than encrypting a single block.
+	void initCiphers();
+
 	unsigned char raw_key[AES_KEY_SIZE_BYTES];
 	unsigned char encrypt_iv[AES_BLOCK_SIZE];
 	unsigned char decrypt_iv[AES_BLOCK_SIZE];
@@ -13,6 +13,7 @@
 #include "PostgreSQLConnectionParameter.h"
 #include "SQLiteConnectionParameter.h"
 #include "Savepoint.h"
+#include "StatementCache.h"
 
 #include <algorithm>
 #include <cassert>
@@ -537,6 +538,10 @@ namespace db {
 						throw InitException("Failed at enabling foreign key enforcement");
 					}
 
+					// Connections used by different threads (see DBWriteQueue) may have to wait for each other's write
+					// transactions to finish, instead of failing right away
+					m_sql << "PRAGMA busy_timeout = 10000";
+
 					const SQLiteConnectionParameter sqliteParam =
 						static_cast< const SQLiteConnectionParameter & >(parameter);
 					if (sqliteParam.useWAL) {
@@ -668,6 +673,13 @@ namespace db {
 		std::unordered_set< std::string > tablesToBeRemoved;
 		tablesToBeRemoved.reserve(tableNames.size());
 
+		// The tables are about to be renamed, which invalidates all statements referring to them
+		for (std::unique_ptr< Table > &currentTable : m_tables) {
+			if (currentTable) {
+				currentTable->getStatementCache().clear();
+			}
+		}
+
 		TransactionHolder transaction = ensureTransaction();
 
 		// Rename all existing tables
@@ -86,8 +86,9 @@ namespace db {
 
 	protected:
 		Backend m_backend;
-		std::vector< std::unique_ptr< Table > > m_tables;
+		// The session has to outlive the tables, as they may hold on to prepared statements
 		mutable soci::session m_sql;
+		std::vector< std::unique_ptr< Table > > m_tables;
 		mutable bool m_activeTransaction = false;
 
 		void connectToDB(const ConnectionParameter &parameter);
@@ -0,0 +1,22 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "StatementCache.h"
+
+namespace mumble::db {
+
+void StatementCache::clear() {
+	m_entries.clear();
+}
+
+std::size_t StatementCache::size() const {
+	return m_entries.size();
+}
+
+const StatementCache::Statistics &StatementCache::getStatistics() const {
+	return m_statistics;
+}
+
+} // namespace mumble::db
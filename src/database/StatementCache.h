@@ -0,0 +1,167 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_DATABASE_STATEMENTCACHE_H_
+#define MUMBLE_DATABASE_STATEMENTCACHE_H_
+
+#include "NonCopyable.h"
+
+#include <soci/soci.h>
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+
+namespace mumble::db {
+
+/**
+ * A cache of prepared statements belonging to a single session. Frequently used queries can be prepared once and
+ * then executed over and over again by only assigning new values to their parameters, which saves the backend from
+ * parsing (and planning) the same query text on every use.
+ *
+ * soci binds a statement's parameters and results to variables by reference, so every cached statement owns the
+ * values it is bound to. These are handed to the function preparing the statement, which has to bind them via
+ * soci::use and soci::into. Before executing the statement, the parameter values have to be assigned.
+ *
+ * Statements are identified by a key that is chosen by the code using the cache. The cache is not synchronized.
+ */
+class StatementCache : public NonCopyable {
+public:
+	struct Statistics {
+		/// The number of statements that had to be prepared
+		std::uint64_t prepared = 0;
+		/// The number of times a previously prepared statement has been reused
+		std::uint64_t reused = 0;
+	};
+
+	class Entry {
+	public:
+		virtual ~Entry() = default;
+
+	protected:
+		/// Whether executing the statement has failed, in which case it will be prepared anew the next time it is used
+		bool m_failed = false;
+
+		friend class StatementCache;
+	};
+
+	template< typename... Values > class Statement : public Entry {
+	public:
+		/// The values the statement's parameters and results are bound to
+		std::tuple< Values... > values;
+
+		template< typename Prepare > explicit Statement(Prepare &prepare) : m_statement(prepare(values)) {}
+
+		/**
+		 * Executes the statement with the current parameter values and fetches the first row of the result (if any)
+		 * into the bound result values. Any further rows are discarded, so that the statement doesn't hold on to its
+		 * result until it is executed the next time.
+		 *
+		 * @returns Whether a row has been fetched
+		 */
+		bool execute() {
+			try {
+				if (!m_statement.execute(true)) {
+					return false;
+				}
+
+				std::tuple< Values... > fetched = values;
+				while (m_statement.fetch()) {
+				}
+				values = std::move(fetched);
+
+				return true;
+			} catch (...) {
+				m_failed = true;
+				throw;
+			}
+		}
+
+		/**
+		 * Executes the statement with the current parameter values without fetching any rows. The rows then have to
+		 * be fetched one after another (until there are none left) via fetch().
+		 */
+		void query() {
+			try {
+				m_statement.execute(false);
+			} catch (...) {
+				m_failed = true;
+				throw;
+			}
+		}
+
+		/**
+		 * Fetches the next row of the result of query() into the bound result values
+		 *
+		 * @returns Whether there was another row
+		 */
+		bool fetch() {
+			try {
+				return m_statement.fetch();
+			} catch (...) {
+				m_failed = true;
+				throw;
+			}
+		}
+
+	protected:
+		soci::statement m_statement;
+	};
+
+	StatementCache()  = default;
+	~StatementCache() = default;
+
+	/**
+	 * @param key The key identifying the statement
+	 * @param prepare A function preparing the statement, if it isn't cached yet. It is passed a reference to the tuple
+	 * 	of values that the statement has to be bound to and has to return the prepared statement.
+	 * @returns The cached statement. The reference stays valid until the cache is cleared or the statement has to be
+	 * 	prepared anew, so it must not be stored.
+	 */
+	template< typename... Values, typename Prepare >
+	Statement< Values... > &get(const std::string &key, Prepare &&prepare) {
+		auto it = m_entries.find(key);
+		if (it != m_entries.end() && !it->second->m_failed) {
+			assert(dynamic_cast< Statement< Values... > * >(it->second.get()));
+
+			m_statistics.reused++;
+			return static_cast< Statement< Values... > & >(*it->second);
+		}
+
+		auto statement = std::make_unique< Statement< Values... > >(prepare);
+		Statement< Values... > &ref = *statement;
+
+		m_entries[key] = std::move(statement);
+		m_statistics.prepared++;
+
+		return ref;
+	}
+
+	/**
+	 * Drops all cached statements. This has to be done whenever the statements may have become invalid, e.g. because
+	 * a table they refer to has been renamed or dropped.
+	 */
+	void clear();
+
+	/**
+	 * @returns The number of currently cached statements
+	 */
+	std::size_t size() const;
+
+	const Statistics &getStatistics() const;
+
+protected:
+	std::unordered_map< std::string, std::unique_ptr< Entry > > m_entries;
+	Statistics m_statistics;
+};
+
+} // namespace mumble::db
+
+#endif // MUMBLE_DATABASE_STATEMENTCACHE_H_
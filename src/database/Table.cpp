@@ -8,6 +8,7 @@
 #include "ConversionUtils.h"
 #include "Database.h"
 #include "FormatException.h"
+#include "StatementCache.h"
 #include "Trigger.h"
 #include "Utils.h"
 
@@ -32,10 +33,13 @@ namespace db {
 	Table::Table(soci::session &sql, Backend backend, Database *database) : Table(sql, backend, {}, {}, database) {}
 	Table::Table(soci::session &sql, Backend backend, const std::string &name, const std::vector< Column > &columns,
 				 Database *database)
-		: m_name(name), m_columns(columns), m_sql(sql), m_backend(backend), m_database(database) {
+		: m_name(name), m_columns(columns), m_sql(sql), m_backend(backend), m_database(database),
+		  m_statementCache(std::make_unique< StatementCache >()) {
 		performCtorAssertions();
 	}
 
+	Table::~Table() = default;
+
 	const std::string &Table::getName() const { return m_name; }
 	void Table::setName(const std::string &name) { m_name = name; }
 
@@ -225,6 +229,9 @@ namespace db {
 	void Table::destroy() {
 		assert(!m_name.empty());
 
+		// Statements referring to the table must not outlive it
+		m_statementCache->clear();
+
 		try {
 			TransactionHolder transaction = ensureTransaction();
 
@@ -371,6 +378,8 @@ namespace db {
 		return m_database ? m_database->ensureTransaction() : TransactionHolder(m_sql, true);
 	}
 
+	StatementCache &Table::getStatementCache() { return *m_statementCache; }
+
 #define THROW_FORMATERROR(msg) throw FormatException(std::string("JSON-Import (table \"") + m_name + "\"): " + msg)
 	void Table::importFromJSON(const nlohmann::json &json, bool create) {
 		assert(!m_name.empty());
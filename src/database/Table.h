@@ -14,6 +14,7 @@
 #include "TransactionHolder.h"
 #include "Trigger.h"
 
+#include <memory>
 #include <string>
 #include <unordered_set>
 #include <vector>
@@ -28,6 +29,7 @@ namespace mumble {
 namespace db {
 
 	class Database;
+	class StatementCache;
 
 	class Table {
 	public:
@@ -36,7 +38,7 @@ namespace db {
 		Table(soci::session &sql, Backend backend, Database *database);
 		Table(soci::session &sql, Backend backend, const std::string &name = {},
 			  const std::vector< Column > &columns = {}, Database *database = nullptr);
-		virtual ~Table() = default;
+		virtual ~Table();
 
 		const std::string &getName() const;
 		void setName(const std::string &name);
@@ -89,6 +91,11 @@ namespace db {
 
 		TransactionHolder ensureTransaction();
 
+		/**
+		 * @returns The cache for the prepared statements this table uses for its most frequent queries
+		 */
+		StatementCache &getStatementCache();
+
 		/**
 		 * Imports the data from the given JSON into the table represented by this object. Note
 		 * that the caller of this function is expected to already have initiated a database
@@ -111,6 +118,7 @@ namespace db {
 		PrimaryKey m_primaryKey;
 		std::vector< ForeignKey > m_foreignKeys;
 		Database *m_database = nullptr;
+		std::unique_ptr< StatementCache > m_statementCache;
 
 		void performCtorAssertions();
 	};
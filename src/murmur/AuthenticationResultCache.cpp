@@ -0,0 +1,100 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "AuthenticationResultCache.h"
+
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QHashFunctions>
+
+AuthenticationResultCache::AuthenticationResultCache(std::chrono::seconds ttl, std::size_t maxEntries)
+	: m_ttl(ttl), m_maxEntries(maxEntries) {
+}
+
+bool AuthenticationResultCache::isEnabled() const {
+	return m_ttl.count() > 0 && m_maxEntries > 0;
+}
+
+void AuthenticationResultCache::insert(const QString &name, const QString &certHash, const QString &password,
+									   const ExternalAuthenticationResult &result, Clock::time_point now) {
+	if (!isEnabled() || result.failed || result.userID < 0) {
+		return;
+	}
+
+	const QByteArray entryKey     = key(name, certHash, password);
+	const Clock::time_point expiry = now + m_ttl;
+
+	m_entries[entryKey] = { result, expiry };
+	m_insertionOrder.emplace_back(entryKey, expiry);
+
+	prune(now);
+}
+
+std::optional< ExternalAuthenticationResult > AuthenticationResultCache::find(const QString &name,
+																			   const QString &certHash,
+																			   const QString &password,
+																			   Clock::time_point now) {
+	if (!isEnabled()) {
+		return std::nullopt;
+	}
+
+	prune(now);
+
+	auto it = m_entries.find(key(name, certHash, password));
+	if (it == m_entries.end()) {
+		m_misses++;
+		return std::nullopt;
+	}
+
+	m_hits++;
+	return it->second.result;
+}
+
+void AuthenticationResultCache::clear() {
+	m_entries.clear();
+	m_insertionOrder.clear();
+}
+
+std::size_t AuthenticationResultCache::size() const {
+	return m_entries.size();
+}
+
+std::uint64_t AuthenticationResultCache::hits() const {
+	return m_hits;
+}
+
+std::uint64_t AuthenticationResultCache::misses() const {
+	return m_misses;
+}
+
+std::size_t AuthenticationResultCache::KeyHash::operator()(const QByteArray &key) const {
+	return qHash(key);
+}
+
+QByteArray AuthenticationResultCache::key(const QString &name, const QString &certHash, const QString &password) {
+	QCryptographicHash hash(QCryptographicHash::Sha256);
+
+	// The separators keep e.g. ("ab", "c") and ("a", "bc") apart
+	hash.addData(name.toUtf8());
+	hash.addData(QByteArray(1, '\0'));
+	hash.addData(certHash.toUtf8());
+	hash.addData(QByteArray(1, '\0'));
+	hash.addData(password.toUtf8());
+
+	return hash.result();
+}
+
+void AuthenticationResultCache::prune(Clock::time_point now) {
+	while (!m_insertionOrder.empty()
+		   && (m_insertionOrder.front().second <= now || m_entries.size() > m_maxEntries)) {
+		const auto &oldest = m_insertionOrder.front();
+
+		auto it = m_entries.find(oldest.first);
+		if (it != m_entries.end() && it->second.expiry == oldest.second) {
+			m_entries.erase(it);
+		}
+
+		m_insertionOrder.pop_front();
+	}
+}
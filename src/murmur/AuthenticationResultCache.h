@@ -0,0 +1,103 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_AUTHENTICATIONRESULTCACHE_H_
+#define MUMBLE_MURMUR_AUTHENTICATIONRESULTCACHE_H_
+
+#include <QtCore/QByteArray>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <unordered_map>
+
+/// The result of authenticating a user with an external authenticator (see Server::authenticateAsyncSig)
+struct ExternalAuthenticationResult {
+	/// Whether the authenticator could not be asked, in which case the other fields are meaningless
+	bool failed = false;
+	/// The user's ID, -1 for authentication failures and -2 for users unknown to the authenticator
+	int userID = -2;
+	/// The name the user is known by from now on. Empty to keep the provided one.
+	QString name;
+	/// The temporary groups the user is to be added to
+	QStringList groups;
+};
+
+/// Invoked on the main thread once an external authentication has finished
+using ExternalAuthenticationCallback = std::function< void(const ExternalAuthenticationResult &) >;
+
+/// How the receiver of Server::authenticateAsyncSig has dealt with a request
+enum class ExternalAuthenticationRequest {
+	/// Not taken, e.g. because there is no authenticator that can be asked asynchronously
+	NotTaken,
+	/// The authenticator is going to be asked. The callback is invoked once it has answered.
+	Started,
+	/// Too many requests are waiting for the authenticator already. The callback is never invoked.
+	Rejected,
+};
+
+/**
+ * Remembers successful external authentications for a limited time, so that users reconnecting with the same
+ * credentials don't require another round trip to the authenticator.
+ *
+ * Entries are keyed by a SHA-256 digest over the name, the certificate hash and the password, so the cache doesn't
+ * keep the passwords around. All entries share the same time to live, so they expire in the order they have been
+ * inserted.
+ */
+class AuthenticationResultCache {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	/// @param ttl How long a result is kept. Zero disables the cache.
+	/// @param maxEntries The maximum number of kept results. The oldest ones are evicted first.
+	explicit AuthenticationResultCache(std::chrono::seconds ttl = std::chrono::seconds(0),
+									   std::size_t maxEntries    = 10000);
+
+	bool isEnabled() const;
+
+	/// Caches the given result, if it belongs to a successful authentication
+	void insert(const QString &name, const QString &certHash, const QString &password,
+				const ExternalAuthenticationResult &result, Clock::time_point now = Clock::now());
+	/// @returns The cached result for the given credentials, if any and not expired yet
+	std::optional< ExternalAuthenticationResult > find(const QString &name, const QString &certHash,
+														const QString &password, Clock::time_point now = Clock::now());
+
+	/// Forgets all results, e.g. because the authenticator has changed
+	void clear();
+	std::size_t size() const;
+
+	std::uint64_t hits() const;
+	std::uint64_t misses() const;
+
+protected:
+	struct Entry {
+		ExternalAuthenticationResult result;
+		Clock::time_point expiry;
+	};
+
+	struct KeyHash {
+		std::size_t operator()(const QByteArray &key) const;
+	};
+
+	std::chrono::seconds m_ttl;
+	std::size_t m_maxEntries;
+	std::unordered_map< QByteArray, Entry, KeyHash > m_entries;
+	/// The keys in the order they have been inserted along with the expiry they have been inserted with. An
+	/// entry that has been inserted again is only removed when its latest record is reached.
+	std::deque< std::pair< QByteArray, Clock::time_point > > m_insertionOrder;
+	std::uint64_t m_hits   = 0;
+	std::uint64_t m_misses = 0;
+
+	static QByteArray key(const QString &name, const QString &certHash, const QString &password);
+	/// Removes the expired entries and, if there are too many, the oldest ones
+	void prune(Clock::time_point now);
+};
+
+#endif // MUMBLE_MURMUR_AUTHENTICATIONRESULTCACHE_H_
@@ -0,0 +1,296 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "CallbackDispatcher.h"
+#include "PrometheusWriter.h"
+
+#include <algorithm>
+#include <cassert>
+#include <unordered_set>
+#include <utility>
+
+CallbackDispatcher::CallbackDispatcher(const Parameters &params, FailureHandler failureHandler)
+	: m_params(params), m_failureHandler(std::move(failureHandler)) {
+	assert(m_params.queueLimit > 0);
+
+	for (unsigned int i = 0; i < std::max(m_params.threads, 1u); ++i) {
+		m_threads.emplace_back([this]() { run(); });
+	}
+}
+
+CallbackDispatcher::~CallbackDispatcher() {
+	{
+		std::lock_guard< std::mutex > lock(m_mutex);
+		m_stop = true;
+	}
+	m_callsAvailable.notify_all();
+
+	for (std::thread &thread : m_threads) {
+		thread.join();
+	}
+}
+
+unsigned int CallbackDispatcher::addConsumer() {
+	std::lock_guard< std::mutex > lock(m_mutex);
+
+	const unsigned int id = m_nextConsumerID++;
+	m_consumers.emplace(id, Consumer());
+
+	return id;
+}
+
+void CallbackDispatcher::removeConsumer(unsigned int consumer) {
+	std::lock_guard< std::mutex > lock(m_mutex);
+
+	// The consumer may still be contained in m_ready, which is dealt with when it is its turn
+	m_consumers.erase(consumer);
+}
+
+void CallbackDispatcher::enqueue(unsigned int consumer, Call call, std::optional< std::uint64_t > key,
+								 bool coalescable) {
+	bool failed = false;
+
+	{
+		std::lock_guard< std::mutex > lock(m_mutex);
+
+		auto it = m_consumers.find(consumer);
+		if (it == m_consumers.end() || it->second.failed) {
+			return;
+		}
+		Consumer &current = it->second;
+
+		if (key) {
+			auto queued = current.coalescable.find(*key);
+			if (queued != current.coalescable.end()) {
+				if (coalescable && m_params.coalesce) {
+					current.queue[static_cast< std::size_t >(queued->second - current.frontSequence)].call =
+						std::move(call);
+					m_statistics.coalesced++;
+					return;
+				}
+
+				// Calls with this key that follow must not be merged into the queued one, as they belong after this one
+				current.coalescable.erase(queued);
+			}
+		}
+
+		if (current.queue.size() >= m_params.queueLimit) {
+			if (!m_params.disconnectOnOverflow && dropOne(current)) {
+				m_statistics.dropped++;
+			} else {
+				fail(current);
+				failed = true;
+			}
+		}
+
+		if (!failed) {
+			if (key && coalescable && m_params.coalesce) {
+				current.coalescable[*key] = current.frontSequence + current.queue.size();
+			}
+			current.queue.push_back({ std::move(call), key, key && coalescable });
+
+			schedule(consumer, current);
+		}
+	}
+
+	if (failed) {
+		m_failureHandler(consumer, Failure::QueueOverflow);
+	} else {
+		m_callsAvailable.notify_one();
+	}
+}
+
+void CallbackDispatcher::flush() {
+	std::unique_lock< std::mutex > lock(m_mutex);
+
+	m_callPerformed.wait(lock, [this]() { return m_stop || (m_ready.empty() && m_inProgress == 0); });
+}
+
+std::size_t CallbackDispatcher::queueDepth(unsigned int consumer) const {
+	std::lock_guard< std::mutex > lock(m_mutex);
+
+	auto it = m_consumers.find(consumer);
+
+	return it != m_consumers.end() ? it->second.queue.size() : 0;
+}
+
+CallbackDispatcher::Statistics CallbackDispatcher::getStatistics() const {
+	std::lock_guard< std::mutex > lock(m_mutex);
+
+	Statistics statistics = m_statistics;
+	for (const auto &current : m_consumers) {
+		statistics.queued += current.second.queue.size();
+		statistics.maxQueueDepth = std::max(statistics.maxQueueDepth, current.second.queue.size());
+	}
+
+	return statistics;
+}
+
+void CallbackDispatcher::writeStatistics(PrometheusWriter &writer, const std::string &prefix) const {
+	const Statistics statistics = getStatistics();
+
+	writer.family(prefix + "_queued", "gauge", "Calls waiting to be performed.");
+	writer.sample("", statistics.queued);
+	writer.family(prefix + "_max_queue_depth", "gauge", "Calls waiting for the slowest consumer.");
+	writer.sample("", statistics.maxQueueDepth);
+	writer.family(prefix + "_dispatched_total", "counter", "Calls that have been performed.");
+	writer.sample("", statistics.dispatched);
+	writer.family(prefix + "_coalesced_total", "counter", "Calls merged into a queued one with the same key.");
+	writer.sample("", statistics.coalesced);
+	writer.family(prefix + "_dropped_total", "counter", "Calls dropped because a queue was full.");
+	writer.sample("", statistics.dropped);
+	writer.family(prefix + "_failed_total", "counter",
+				  "Consumers removed because a call failed or their queue overflowed.");
+	writer.sample("", statistics.failed);
+}
+
+void CallbackDispatcher::run() {
+	while (true) {
+		unsigned int id;
+		Entry entry;
+
+		{
+			std::unique_lock< std::mutex > lock(m_mutex);
+			m_callsAvailable.wait(lock, [this]() { return m_stop || !m_ready.empty(); });
+
+			if (m_stop) {
+				return;
+			}
+
+			id = m_ready.front();
+			m_ready.pop_front();
+
+			auto it = m_consumers.find(id);
+			if (it == m_consumers.end()) {
+				// Removed in the meantime
+				m_callPerformed.notify_all();
+				continue;
+			}
+
+			it->second.scheduled = false;
+			it->second.busy      = true;
+			entry                = popFront(it->second);
+			m_inProgress++;
+		}
+
+		bool success = true;
+		try {
+			entry.call();
+		} catch (...) {
+			success = false;
+		}
+		// Whatever the call has captured must not outlive it for longer than necessary
+		entry = Entry();
+
+		bool failed = false;
+		{
+			std::lock_guard< std::mutex > lock(m_mutex);
+			m_inProgress--;
+			m_statistics.dispatched++;
+
+			auto it = m_consumers.find(id);
+			if (it != m_consumers.end()) {
+				it->second.busy = false;
+
+				if (!success) {
+					fail(it->second);
+					failed = true;
+				} else {
+					schedule(id, it->second);
+				}
+			}
+		}
+
+		m_callsAvailable.notify_one();
+		m_callPerformed.notify_all();
+
+		if (failed) {
+			m_failureHandler(id, Failure::CallFailed);
+		}
+	}
+}
+
+CallbackDispatcher::Entry CallbackDispatcher::popFront(Consumer &consumer) {
+	assert(!consumer.queue.empty());
+
+	Entry entry = std::move(consumer.queue.front());
+	consumer.queue.pop_front();
+
+	if (entry.key) {
+		auto it = consumer.coalescable.find(*entry.key);
+		if (it != consumer.coalescable.end() && it->second == consumer.frontSequence) {
+			consumer.coalescable.erase(it);
+		}
+	}
+	consumer.frontSequence++;
+
+	return entry;
+}
+
+bool CallbackDispatcher::dropOne(Consumer &consumer) {
+	// Walking the queue backwards, a coalescable call is superseded if a call with its key has been seen already. The
+	// last one found is the oldest one.
+	std::unordered_set< std::uint64_t > laterKeys;
+	auto victim = consumer.queue.end();
+	for (auto it = consumer.queue.end(); it != consumer.queue.begin();) {
+		--it;
+		if (!it->key) {
+			continue;
+		}
+		if (it->coalescable && laterKeys.count(*it->key) > 0) {
+			victim = it;
+		}
+		laterKeys.insert(*it->key);
+	}
+	if (victim == consumer.queue.end()) {
+		victim = std::find_if(consumer.queue.begin(), consumer.queue.end(),
+							  [](const Entry &entry) { return !entry.key; });
+	}
+	if (victim == consumer.queue.end()) {
+		return false;
+	}
+
+	if (victim == consumer.queue.begin()) {
+		popFront(consumer);
+		return true;
+	}
+
+	const std::uint64_t sequence =
+		consumer.frontSequence + static_cast< std::uint64_t >(victim - consumer.queue.begin());
+
+	if (victim->key) {
+		auto it = consumer.coalescable.find(*victim->key);
+		if (it != consumer.coalescable.end() && it->second == sequence) {
+			consumer.coalescable.erase(it);
+		}
+	}
+	consumer.queue.erase(victim);
+
+	// The entries behind the dropped one have moved up by one
+	for (auto &entry : consumer.coalescable) {
+		if (entry.second > sequence) {
+			entry.second--;
+		}
+	}
+
+	return true;
+}
+
+void CallbackDispatcher::fail(Consumer &consumer) {
+	consumer.failed = true;
+	consumer.queue.clear();
+	consumer.coalescable.clear();
+
+	m_statistics.failed++;
+}
+
+void CallbackDispatcher::schedule(unsigned int id, Consumer &consumer) {
+	if (consumer.busy || consumer.scheduled || consumer.queue.empty() || consumer.failed) {
+		return;
+	}
+
+	consumer.scheduled = true;
+	m_ready.push_back(id);
+}
@@ -0,0 +1,162 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_CALLBACKDISPATCHER_H_
+#define MUMBLE_MURMUR_CALLBACKDISPATCHER_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class PrometheusWriter;
+
+/**
+ * Performs calls to external consumers (e.g. the Ice callbacks registered by RPC clients) on dedicated threads, so that
+ * a slow or hung consumer doesn't block the thread producing the calls.
+ *
+ * Every consumer has its own bounded queue and its calls are performed one after another in the order they have been
+ * enqueued. Different consumers are served in parallel by as many threads as configured.
+ *
+ * Calls may carry a key. If coalescing is enabled, a coalescable call replaces a queued (not yet performed) call with
+ * the same key instead of being queued as well, as only the latest state matters for e.g. state change notifications.
+ * A call with a key that is not coalescable (e.g. the notification about a user disconnecting) acts as a barrier: later
+ * calls with the same key are never merged into calls queued before it.
+ *
+ * If the queue of a consumer is full, one queued call is dropped to make room, but only one whose loss the consumer
+ * can recover from:
+ * 1. The oldest coalescable call that is superseded, i.e. a later call with the same key is queued as well. With
+ *    coalescing, this is only the case if a barrier has been queued in between. The consumer still receives the later
+ *    call for that user or channel.
+ * 2. Otherwise, the oldest call without a key (e.g. a text message), which only concerns itself.
+ * The latest coalescable call for a key is never dropped, as the consumer would be left with an outdated state of that
+ * user or channel for good. Neither are barriers, as the consumer would otherwise miss e.g. a user disconnecting.
+ *
+ * If a call throws or the queue of a consumer overflows while disconnectOnOverflow is set or none of its queued calls
+ * may be dropped, the consumer is considered to have failed: its queued calls are discarded, no further calls are
+ * accepted for it and the failure handler is invoked. The failure handler is invoked without holding any locks, but
+ * possibly on one of the dispatcher's threads.
+ */
+class CallbackDispatcher {
+public:
+	using Call = std::function< void() >;
+
+	enum class Failure { CallFailed, QueueOverflow };
+	using FailureHandler = std::function< void(unsigned int consumer, Failure failure) >;
+
+	struct Parameters {
+		/// The maximum number of calls that may be queued per consumer
+		std::size_t queueLimit = 1000;
+		/// Whether coalescable calls replace queued calls with the same key
+		bool coalesce = true;
+		/// Whether a consumer whose queue is full fails (instead of one of its queued calls being dropped)
+		bool disconnectOnOverflow = false;
+		/// The number of threads performing the calls
+		unsigned int threads = 1;
+	};
+
+	struct Statistics {
+		/// The number of calls that are currently queued for all consumers
+		std::size_t queued = 0;
+		/// The number of calls queued for the consumer with the longest queue
+		std::size_t maxQueueDepth = 0;
+		/// The total number of calls that have been performed
+		std::uint64_t dispatched = 0;
+		/// The total number of calls that have replaced a queued call
+		std::uint64_t coalesced = 0;
+		/// The total number of queued calls that have been dropped because a queue was full
+		std::uint64_t dropped = 0;
+		/// The total number of consumers that have failed
+		std::uint64_t failed = 0;
+	};
+
+	CallbackDispatcher(const Parameters &params, FailureHandler failureHandler);
+	/// Discards all queued calls and waits for the calls in progress to return
+	~CallbackDispatcher();
+
+	CallbackDispatcher(const CallbackDispatcher &)            = delete;
+	CallbackDispatcher &operator=(const CallbackDispatcher &) = delete;
+
+	/// @returns The ID of the new consumer
+	unsigned int addConsumer();
+	/// Removes the given consumer and discards its queued calls. A call in progress is not interrupted.
+	void removeConsumer(unsigned int consumer);
+
+	/// Queues the given call for the given consumer. Calls for unknown or failed consumers are ignored.
+	void enqueue(unsigned int consumer, Call call, std::optional< std::uint64_t > key = std::nullopt,
+				 bool coalescable = false);
+
+	/// Blocks until all calls that have been queued before have been performed
+	void flush();
+
+	/// @returns The number of calls currently queued for the given consumer
+	std::size_t queueDepth(unsigned int consumer) const;
+	Statistics getStatistics() const;
+	/// Writes the statistics as metrics whose names start with the given prefix
+	void writeStatistics(PrometheusWriter &writer, const std::string &prefix) const;
+
+protected:
+	struct Entry {
+		Call call;
+		std::optional< std::uint64_t > key;
+		/// Whether the call has been enqueued as coalescable, i.e. it may be dropped on overflow once it is superseded
+		bool coalescable = false;
+	};
+
+	struct Consumer {
+		std::deque< Entry > queue;
+		/// The sequence number of the first entry in the queue. Entries are numbered consecutively.
+		std::uint64_t frontSequence = 0;
+		/// The sequence numbers of the queued entries that later calls with the same key may be merged into
+		std::unordered_map< std::uint64_t, std::uint64_t > coalescable;
+		/// Whether one of the consumer's calls is currently being performed
+		bool busy = false;
+		/// Whether the consumer is contained in m_ready
+		bool scheduled = false;
+		bool failed    = false;
+	};
+
+	const Parameters m_params;
+	const FailureHandler m_failureHandler;
+
+	mutable std::mutex m_mutex;
+	/// Signaled when consumers become ready or the dispatcher is stopped
+	std::condition_variable m_callsAvailable;
+	/// Signaled when a call has been performed
+	std::condition_variable m_callPerformed;
+	std::unordered_map< unsigned int, Consumer > m_consumers;
+	/// The consumers that have queued calls and none in progress, in the order in which they are to be served
+	std::deque< unsigned int > m_ready;
+	unsigned int m_nextConsumerID = 0;
+	/// The number of calls currently being performed
+	std::size_t m_inProgress = 0;
+	bool m_stop              = false;
+	Statistics m_statistics;
+
+	std::vector< std::thread > m_threads;
+
+	void run();
+	/// Pops the first entry of the given consumer's queue. Requires m_mutex to be locked.
+	static Entry popFront(Consumer &consumer);
+	/// Drops a queued call of the given consumer according to the policy described above. Requires m_mutex to be
+	/// locked.
+	///
+	/// @returns Whether a call has been dropped, which isn't the case if none of the queued calls may be dropped
+	static bool dropOne(Consumer &consumer);
+	/// Marks the given consumer as failed. Requires m_mutex to be locked.
+	void fail(Consumer &consumer);
+	/// Adds the given consumer to m_ready, if it has queued calls and isn't served already. Requires m_mutex to be
+	/// locked.
+	void schedule(unsigned int id, Consumer &consumer);
+};
+
+#endif // MUMBLE_MURMUR_CALLBACKDISPATCHER_H_
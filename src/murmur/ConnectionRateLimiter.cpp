@@ -0,0 +1,147 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "ConnectionRateLimiter.h"
+#include "PrometheusWriter.h"
+
+#include <algorithm>
+#include <iterator>
+
+ConnectionRateLimiter::ConnectionRateLimiter(const Parameters &parameters) : m_parameters(parameters) {
+	m_parameters.capacity         = std::max< std::size_t >(m_parameters.capacity, 1);
+	m_parameters.ipv4PrefixLength = std::min(m_parameters.ipv4PrefixLength, 32u);
+	m_parameters.ipv6PrefixLength = std::min(m_parameters.ipv6PrefixLength, 128u);
+
+	if (isEnabled()) {
+		m_index.reserve(m_parameters.capacity);
+	}
+}
+
+bool ConnectionRateLimiter::isEnabled() const {
+	return m_parameters.attempts > 0 && m_parameters.timeframe.count() > 0;
+}
+
+bool ConnectionRateLimiter::check(const HostAddress &address, Clock::time_point now) {
+	if (!isEnabled()) {
+		return false;
+	}
+
+	Entry &entry = touch(networkOf(address), now);
+
+	if (entry.banned) {
+		if (now < entry.bannedUntil) {
+			m_statistics.rejected++;
+			return true;
+		}
+		// The attempts that led to the ban are still taken into account, so a network that keeps on connecting
+		// right after its ban has expired is banned again
+		entry.banned = false;
+	}
+
+	const Clock::duration timeframe = m_parameters.timeframe;
+	const Clock::duration elapsed   = now - entry.windowStart;
+	if (elapsed >= 2 * timeframe) {
+		entry.windowStart      = now;
+		entry.previousAttempts = 0;
+		entry.currentAttempts  = 0;
+	} else if (elapsed >= timeframe) {
+		entry.windowStart      = entry.windowStart + timeframe;
+		entry.previousAttempts = entry.currentAttempts;
+		entry.currentAttempts  = 0;
+	}
+
+	entry.currentAttempts++;
+
+	// The part of the previous timeframe that is still covered by the sliding timeframe ending now
+	const double overlap  = 1.0 - std::chrono::duration< double >(now - entry.windowStart) / timeframe;
+	const double attempts = entry.previousAttempts * overlap + entry.currentAttempts;
+
+	if (attempts > m_parameters.attempts) {
+		entry.banned      = true;
+		entry.bannedUntil = now + m_parameters.banTime;
+
+		m_statistics.bans++;
+		m_statistics.rejected++;
+		return true;
+	}
+
+	return false;
+}
+
+void ConnectionRateLimiter::reset(const HostAddress &address) {
+	auto it = m_index.find(networkOf(address));
+	if (it != m_index.end()) {
+		it->second->previousAttempts = 0;
+		it->second->currentAttempts  = 0;
+	}
+}
+
+HostAddress ConnectionRateLimiter::networkOf(const HostAddress &address) const {
+	// IPv4 addresses are stored as IPv4-mapped IPv6 addresses, whose first 96 bits are always the same
+	unsigned int prefixLength = address.isV6() ? m_parameters.ipv6PrefixLength : 96 + m_parameters.ipv4PrefixLength;
+
+	HostAddress network = address;
+	for (std::size_t i = 0; i < address.getByteRepresentation().size(); ++i) {
+		if (prefixLength >= 8) {
+			prefixLength -= 8;
+		} else {
+			// Once the prefix has been passed (prefixLength is 0), the mask clears the whole byte
+			const std::uint8_t mask = static_cast< std::uint8_t >(0xff << (8 - prefixLength));
+			network.setByte(i, static_cast< std::uint8_t >(address.getByteRepresentation()[i] & mask));
+			prefixLength = 0;
+		}
+	}
+
+	return network;
+}
+
+std::size_t ConnectionRateLimiter::size() const {
+	return m_entries.size();
+}
+
+const ConnectionRateLimiter::Statistics &ConnectionRateLimiter::getStatistics() const {
+	return m_statistics;
+}
+
+void ConnectionRateLimiter::writeStatistics(PrometheusWriter &writer) const {
+	writer.family("murmur_autoban_rejected_connections_total", "counter",
+				  "Connections rejected due to the global autoban.");
+	writer.sample("", m_statistics.rejected);
+	writer.family("murmur_autoban_bans_total", "counter", "Networks banned by the global autoban.");
+	writer.sample("", m_statistics.bans);
+	writer.family("murmur_autoban_tracked_networks", "gauge",
+				  "Networks whose connection attempts are currently tracked.");
+	writer.sample("", size());
+	writer.family("murmur_autoban_evictions_total", "counter",
+				  "Tracked networks forgotten because the table was full.");
+	writer.sample("", m_statistics.evictions);
+}
+
+ConnectionRateLimiter::Entry &ConnectionRateLimiter::touch(const HostAddress &network, Clock::time_point now) {
+	auto it = m_index.find(network);
+	if (it != m_index.end()) {
+		m_entries.splice(m_entries.begin(), m_entries, it->second);
+		return m_entries.front();
+	}
+
+	if (m_entries.size() >= m_parameters.capacity) {
+		// Reuse the least recently seen entry
+		m_index.erase(m_entries.back().network);
+		m_entries.splice(m_entries.begin(), m_entries, std::prev(m_entries.end()));
+		m_entries.front() = Entry();
+
+		m_statistics.evictions++;
+	} else {
+		m_entries.emplace_front();
+	}
+
+	Entry &entry      = m_entries.front();
+	entry.network     = network;
+	entry.windowStart = now;
+
+	m_index.emplace(network, m_entries.begin());
+
+	return entry;
+}
@@ -0,0 +1,105 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_CONNECTIONRATELIMITER_H_
+#define MUMBLE_MURMUR_CONNECTIONRATELIMITER_H_
+
+#include "HostAddress.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+
+class PrometheusWriter;
+
+/// Tracks the connection attempts per network (IPv4 or IPv6 address prefix) and temporarily bans networks that
+/// attempt too many connections in a given timeframe (the global "autoban").
+///
+/// The memory used is bounded: at most a fixed number of networks is tracked and once that number is reached, the one
+/// that has been seen least recently is forgotten to make room for a new one. Instead of remembering every single
+/// attempt, every network only has two counters, one for the current and one for the previous timeframe. The number
+/// of attempts in the sliding timeframe ending now is estimated by weighting the previous timeframe's attempts with
+/// the share of it that still overlaps with the sliding one.
+///
+/// The limiter is not synchronized.
+class ConnectionRateLimiter {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	struct Parameters {
+		/// The number of attempts within the timeframe that are tolerated. Any attempt beyond that results in a ban.
+		/// Zero disables the limiter.
+		unsigned int attempts = 10;
+		std::chrono::seconds timeframe{ 120 };
+		std::chrono::seconds banTime{ 300 };
+		/// The length of the prefix that identifies the network of an IPv4 address
+		unsigned int ipv4PrefixLength = 24;
+		/// The length of the prefix that identifies the network of an IPv6 address
+		unsigned int ipv6PrefixLength = 64;
+		/// The maximum number of networks that are tracked at the same time
+		std::size_t capacity = 65536;
+	};
+
+	struct Statistics {
+		/// The number of connections that have been rejected because their network was banned
+		std::uint64_t rejected = 0;
+		/// The number of bans that have been issued
+		std::uint64_t bans = 0;
+		/// The number of networks that have been forgotten because the capacity was exhausted
+		std::uint64_t evictions = 0;
+	};
+
+	ConnectionRateLimiter(const Parameters &parameters);
+
+	bool isEnabled() const;
+
+	/// Records a connection attempt from the given address.
+	///
+	/// @returns Whether the connection has to be rejected, because the address' network is banned (either already or
+	/// 	due to this attempt)
+	bool check(const HostAddress &address, Clock::time_point now = Clock::now());
+
+	/// Forgets the connection attempts from the given address' network (an active ban is not lifted)
+	void reset(const HostAddress &address);
+
+	/// @returns The network the given address belongs to, i.e. the address with all bits after the prefix cleared
+	HostAddress networkOf(const HostAddress &address) const;
+
+	/// @returns The number of networks that are currently tracked
+	std::size_t size() const;
+
+	const Statistics &getStatistics() const;
+	void writeStatistics(PrometheusWriter &writer) const;
+
+protected:
+	struct Entry {
+		HostAddress network;
+		/// The start of the current timeframe
+		Clock::time_point windowStart;
+		unsigned int currentAttempts  = 0;
+		unsigned int previousAttempts = 0;
+		bool banned                   = false;
+		Clock::time_point bannedUntil;
+	};
+
+	struct NetworkHash {
+		std::size_t operator()(const HostAddress &address) const { return qHash(address); }
+	};
+
+	Parameters m_parameters;
+	Statistics m_statistics;
+
+	/// The tracked networks, ordered from the most to the least recently seen one
+	std::list< Entry > m_entries;
+	std::unordered_map< HostAddress, std::list< Entry >::iterator, NetworkHash > m_index;
+
+	/// @returns The entry of the given network, which becomes the most recently seen one. If the network isn't
+	/// 	tracked yet, a new entry is created (possibly evicting the least recently seen one).
+	Entry &touch(const HostAddress &network, Clock::time_point now);
+};
+
+#endif // MUMBLE_MURMUR_CONNECTIONRATELIMITER_H_
@@ -0,0 +1,45 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "ConnectionThreadPool.h"
+
+#include <QtCore/QString>
+
+ConnectionThreadPool::ConnectionThreadPool(unsigned int threadCount) {
+	m_threads.reserve(threadCount);
+
+	for (unsigned int i = 0; i < threadCount; ++i) {
+		auto thread = std::make_unique< QThread >();
+		thread->setObjectName(QString::fromLatin1("TLS%1").arg(i));
+		thread->start();
+
+		m_threads.push_back(std::move(thread));
+	}
+}
+
+ConnectionThreadPool::~ConnectionThreadPool() {
+	for (const std::unique_ptr< QThread > &thread : m_threads) {
+		// Pending deferred deletions are still processed when the event loop exits
+		thread->quit();
+	}
+	for (const std::unique_ptr< QThread > &thread : m_threads) {
+		thread->wait();
+	}
+}
+
+QThread *ConnectionThreadPool::next() {
+	if (m_threads.empty()) {
+		return nullptr;
+	}
+
+	QThread *thread = m_threads[m_next].get();
+	m_next          = (m_next + 1) % m_threads.size();
+
+	return thread;
+}
+
+std::size_t ConnectionThreadPool::size() const {
+	return m_threads.size();
+}
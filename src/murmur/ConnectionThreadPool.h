@@ -0,0 +1,40 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_CONNECTIONTHREADPOOL_H_
+#define MUMBLE_MURMUR_CONNECTIONTHREADPOOL_H_
+
+#include <QtCore/QThread>
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+/// A fixed set of threads running an event loop each, which the sockets of client connections are distributed across
+/// (see Connection::moveSocketToThread). These threads perform the TLS handshakes, encrypt and decrypt all TLS records
+/// and split the incoming data into messages, which keeps this work off the main event loop. The messages themselves
+/// are still handled by the main thread.
+class ConnectionThreadPool {
+public:
+	/// Starts the given number of threads. If it is zero, connections stay on the main thread.
+	explicit ConnectionThreadPool(unsigned int threadCount);
+	/// Stops all threads. Sockets that are still scheduled for deletion are deleted before the threads exit, but
+	/// there must not be any other sockets left in any of the threads.
+	~ConnectionThreadPool();
+
+	ConnectionThreadPool(const ConnectionThreadPool &)            = delete;
+	ConnectionThreadPool &operator=(const ConnectionThreadPool &) = delete;
+
+	/// @returns The thread the next connection should be handled by or nullptr if the pool doesn't have any threads
+	QThread *next();
+
+	std::size_t size() const;
+
+protected:
+	std::vector< std::unique_ptr< QThread > > m_threads;
+	std::size_t m_next = 0;
+};
+
+#endif // MUMBLE_MURMUR_CONNECTIONTHREADPOOL_H_
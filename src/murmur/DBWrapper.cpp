@@ -59,6 +59,7 @@
 #include <optional>
 #include <stdexcept>
 #include <thread>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -220,6 +221,8 @@ void DBWrapper::removeServer(unsigned int serverID) {
 
 	m_serverDB.getServerTable().removeServer(serverID);
 
+	m_registeredUserIndices.erase(serverID);
+
 	WRAPPER_END
 }
 
@@ -283,6 +286,11 @@ void DBWrapper::disableSuperUser(unsigned int serverID) {
 
 	m_serverDB.getUserTable().clearPassword(superUser);
 
+	RegisteredUserIndex *index = getRegisteredUserIndex(serverID);
+	if (index && index->contains(Mumble::SUPERUSER_ID)) {
+		index->setPassword(Mumble::SUPERUSER_ID, {});
+	}
+
 	WRAPPER_END
 }
 
@@ -379,31 +387,52 @@ void DBWrapper::saveBans(unsigned int serverID, const std::vector< Ban > &bans)
 	WRAPPER_END
 }
 
-void readChildren(::msdb::ServerDatabase &db, Channel *parent, Server &server) {
-	for (unsigned int currentChildID : db.getChannelTable().getChildrenOf(server.iServerNum, parent->iId)) {
-		::msdb::DBChannel channelInfo = db.getChannelTable().getChannelData(server.iServerNum, currentChildID);
+void DBWrapper::initializeChannels(Server &server) {
+	WRAPPER_BEGIN
 
-		Channel *currentChild     = new Channel(currentChildID, QString::fromStdString(channelInfo.name), parent);
-		currentChild->bInheritACL = channelInfo.inheritACL;
+	// All channels are fetched at once and the tree is assembled in memory
+	std::vector< ::msdb::DBChannel > dbChannels = m_serverDB.getChannelTable().getAllChannels(server.iServerNum);
 
-		server.qhChannels.insert(currentChildID, currentChild);
+	std::unordered_map< unsigned int, std::vector< const ::msdb::DBChannel * > > childrenOf;
+	const ::msdb::DBChannel *root = nullptr;
+	for (const ::msdb::DBChannel &currentChannel : dbChannels) {
+		if (currentChannel.channelID == Mumble::ROOT_CHANNEL_ID) {
+			root = &currentChannel;
+		} else {
+			childrenOf[currentChannel.parentID].push_back(&currentChannel);
+		}
+	}
 
-		// Recurse
-		readChildren(db, currentChild, server);
+	if (!root) {
+		throw ::mdb::NoDataException("No root channel on server with ID " + std::to_string(server.iServerNum));
 	}
-}
 
-void DBWrapper::initializeChannels(Server &server) {
-	WRAPPER_BEGIN
+	Channel *rootChannel     = new Channel(Mumble::ROOT_CHANNEL_ID, QString::fromStdString(root->name), &server);
+	rootChannel->bInheritACL = root->inheritACL;
 
-	::msdb::DBChannel root = m_serverDB.getChannelTable().getChannelData(server.iServerNum, Mumble::ROOT_CHANNEL_ID);
+	server.qhChannels.insert(rootChannel->iId, rootChannel);
 
-	Channel *rootChannel     = new Channel(Mumble::ROOT_CHANNEL_ID, QString::fromStdString(root.name), &server);
-	rootChannel->bInheritACL = root.inheritACL;
+	// Channels that can't be reached from the root channel are not loaded
+	std::vector< Channel * > pending = { rootChannel };
+	while (!pending.empty()) {
+		Channel *parent = pending.back();
+		pending.pop_back();
 
-	server.qhChannels.insert(rootChannel->iId, rootChannel);
+		auto it = childrenOf.find(parent->iId);
+		if (it == childrenOf.end()) {
+			continue;
+		}
 
-	readChildren(m_serverDB, rootChannel, server);
+		for (const ::msdb::DBChannel *channelInfo : it->second) {
+			Channel *currentChild =
+				new Channel(channelInfo->channelID, QString::fromStdString(channelInfo->name), parent);
+			currentChild->bInheritACL = channelInfo->inheritACL;
+
+			server.qhChannels.insert(currentChild->iId, currentChild);
+
+			pending.push_back(currentChild);
+		}
+	}
 
 	initializeChannelDetails(server);
 
@@ -413,55 +442,98 @@ void DBWrapper::initializeChannels(Server &server) {
 void DBWrapper::initializeChannelDetails(Server &server) {
 	WRAPPER_BEGIN
 
-	for (Channel *currentChannel : server.qhChannels) {
-		assert(currentChannel);
+	// Every kind of detail is fetched for all channels at once, instead of querying it for every channel separately
 
-		// Read and set channel properties
-		std::string description = m_serverDB.getChannelPropertyTable().getProperty< std::string, false >(
-			server.iServerNum, currentChannel->iId, ::msdb::ChannelProperty::Description);
-		if (!description.empty()) {
-			Server::hashAssign(currentChannel->qsDesc, currentChannel->qbaDescHash,
-							   QString::fromStdString(description));
+	// Read and set channel properties
+	for (const auto &currentEntry : m_serverDB.getChannelPropertyTable().getAllProperties(server.iServerNum)) {
+		Channel *currentChannel = server.qhChannels.value(currentEntry.first);
+		if (!currentChannel) {
+			continue;
 		}
 
-		currentChannel->iPosition = m_serverDB.getChannelPropertyTable().getProperty< int, false >(
-			server.iServerNum, currentChannel->iId, ::msdb::ChannelProperty::Position);
+		for (const auto &currentProperty : currentEntry.second) {
+			bool success = false;
+
+			switch (currentProperty.first) {
+				case ::msdb::ChannelProperty::Description:
+					if (!currentProperty.second.empty()) {
+						Server::hashAssign(currentChannel->qsDesc, currentChannel->qbaDescHash,
+										   QString::fromStdString(currentProperty.second));
+					}
+					break;
+				case ::msdb::ChannelProperty::Position: {
+					int position = ::mumble::StringConverter< int >::convert(currentProperty.second, &success);
+					if (success) {
+						currentChannel->iPosition = position;
+					}
+					break;
+				}
+				case ::msdb::ChannelProperty::MaxUsers: {
+					unsigned int maxUsers =
+						::mumble::StringConverter< unsigned int >::convert(currentProperty.second, &success);
+					if (success) {
+						currentChannel->uiMaxUsers = maxUsers;
+					}
+					break;
+				}
+			}
+		}
+	}
 
-		currentChannel->uiMaxUsers = m_serverDB.getChannelPropertyTable().getProperty< unsigned int, false >(
-			server.iServerNum, currentChannel->iId, ::msdb::ChannelProperty::MaxUsers);
+	// Read and initialize the groups defined for the channels
+	std::unordered_map< unsigned int, Group * > groups;
+	std::unordered_map< unsigned int, std::string > groupNames;
+	for (const ::msdb::DBGroup &currentGroup : m_serverDB.getGroupTable().getAllGroups(server.iServerNum)) {
+		groupNames[currentGroup.groupID] = currentGroup.name;
 
+		Channel *currentChannel = server.qhChannels.value(currentGroup.channelID);
+		if (!currentChannel) {
+			continue;
+		}
 
-		// Read and initialize the groups defined for the current channel
-		for (const ::msdb::DBGroup &currentGroup :
-			 m_serverDB.getGroupTable().getAllGroups(server.iServerNum, currentChannel->iId)) {
-			Group *group        = new Group(currentChannel, QString::fromStdString(currentGroup.name));
-			group->bInherit     = currentGroup.inherit;
-			group->bInheritable = currentGroup.is_inheritable;
+		Group *group        = new Group(currentChannel, QString::fromStdString(currentGroup.name));
+		group->bInherit     = currentGroup.inherit;
+		group->bInheritable = currentGroup.is_inheritable;
 
-			for (const ::msdb::DBGroupMember &currrentMember :
-				 m_serverDB.getGroupMemberTable().getEntries(server.iServerNum, currentGroup.groupID)) {
-				if (currrentMember.addToGroup) {
-					group->qsAdd << static_cast< int >(currrentMember.userID);
-				} else {
-					group->qsRemove << static_cast< int >(currrentMember.userID);
-				}
-			}
+		groups[currentGroup.groupID] = group;
+	}
+
+	for (const ::msdb::DBGroupMember &currentMember :
+		 m_serverDB.getGroupMemberTable().getAllEntries(server.iServerNum)) {
+		auto it = groups.find(currentMember.groupID);
+		if (it == groups.end()) {
+			continue;
 		}
 
-		// Read and set access control lists
-		for (const ::msdb::DBAcl &currentAcl :
-			 m_serverDB.getACLTable().getAllACLs(server.iServerNum, currentChannel->iId)) {
-			ChanACL *acl = new ChanACL(currentChannel);
-			acl->iUserId = currentAcl.affectedUserID ? static_cast< int >(currentAcl.affectedUserID.value()) : -1;
-			acl->qsGroup = QString::fromStdString(::msdb::getLegacyGroupData(currentAcl, m_serverDB.getGroupTable()));
-
-			acl->bApplyHere = currentAcl.applyInCurrentChannel;
-			acl->bApplySubs = currentAcl.applyInSubChannels;
-			acl->pAllow     = static_cast< ChanACL::Permissions >(currentAcl.grantedPrivilegeFlags);
-			acl->pDeny      = static_cast< ChanACL::Permissions >(currentAcl.revokedPrivilegeFlags);
+		if (currentMember.addToGroup) {
+			it->second->qsAdd << static_cast< int >(currentMember.userID);
+		} else {
+			it->second->qsRemove << static_cast< int >(currentMember.userID);
 		}
 	}
 
+	// Read and set access control lists (ordered by priority)
+	for (const ::msdb::DBAcl &currentAcl : m_serverDB.getACLTable().getAllACLs(server.iServerNum)) {
+		Channel *currentChannel = server.qhChannels.value(currentAcl.channelID);
+		if (!currentChannel) {
+			continue;
+		}
+
+		std::string affectedGroupName;
+		if (currentAcl.affectedGroupID) {
+			affectedGroupName = groupNames[currentAcl.affectedGroupID.value()];
+		}
+
+		ChanACL *acl = new ChanACL(currentChannel);
+		acl->iUserId = currentAcl.affectedUserID ? static_cast< int >(currentAcl.affectedUserID.value()) : -1;
+		acl->setGroup(QString::fromStdString(::msdb::getLegacyGroupData(currentAcl, affectedGroupName)));
+
+		acl->bApplyHere = currentAcl.applyInCurrentChannel;
+		acl->bApplySubs = currentAcl.applyInSubChannels;
+		acl->pAllow     = static_cast< ChanACL::Permissions >(currentAcl.grantedPrivilegeFlags);
+		acl->pDeny      = static_cast< ChanACL::Permissions >(currentAcl.revokedPrivilegeFlags);
+	}
+
 	WRAPPER_END
 }
 
@@ -953,6 +1025,93 @@ void DBWrapper::updateLastDisconnect(unsigned int serverID, unsigned int userID)
 	WRAPPER_END
 }
 
+void DBWrapper::performWrites(const std::vector< DBWrite > &writes) {
+	WRAPPER_BEGIN
+
+	::mdb::TransactionHolder transaction = m_serverDB.ensureTransaction();
+
+	// The writes may have been requested a while ago, so we can't rely on the referenced servers and users to still
+	// exist
+	std::unordered_map< unsigned int, bool > existingServers;
+	const auto serverExists = [&](unsigned int serverID) {
+		auto it = existingServers.find(serverID);
+		if (it == existingServers.end()) {
+			it = existingServers.emplace(serverID, m_serverDB.getServerTable().serverExists(serverID)).first;
+		}
+		return it->second;
+	};
+
+	std::vector< std::pair< unsigned int, ::msdb::DBLogEntry > > logEntries;
+
+	for (const DBWrite &write : writes) {
+		assertValidID(write.serverID);
+
+		if (!serverExists(write.serverID)) {
+			continue;
+		}
+
+		if (write.type == DBWrite::Type::LogMessage) {
+			logEntries.emplace_back(write.serverID, ::msdb::DBLogEntry(write.value, write.timestamp));
+			continue;
+		}
+
+		::msdb::DBUser user(write.serverID, write.userID);
+		if (!m_serverDB.getUserTable().userExists(user)) {
+			continue;
+		}
+
+		switch (write.type) {
+			case DBWrite::Type::LogMessage:
+				break;
+			case DBWrite::Type::LastDisconnect:
+				m_serverDB.getUserTable().setLastDisconnect(user, write.timestamp);
+				break;
+			case DBWrite::Type::LastChannel:
+				if (m_serverDB.getChannelTable().channelExists(write.serverID, write.channelID)) {
+					m_serverDB.getUserTable().setLastChannelID(user, write.channelID);
+				}
+				break;
+			case DBWrite::Type::UserProperty:
+				if (write.value.empty()) {
+					m_serverDB.getUserPropertyTable().clearProperty(user, write.property);
+				} else {
+					m_serverDB.getUserPropertyTable().setProperty(user, write.property, write.value);
+				}
+				updateRegisteredUserIndex(write);
+				break;
+		}
+	}
+
+	m_serverDB.getLogTable().logMessages(logEntries);
+
+	transaction.commit();
+
+	WRAPPER_END
+}
+
+void DBWrapper::updateRegisteredUserIndex(const DBWrite &write) {
+	if (write.type != DBWrite::Type::UserProperty) {
+		return;
+	}
+
+	RegisteredUserIndex *index = getRegisteredUserIndex(write.serverID);
+	if (!index || !index->contains(write.userID)) {
+		// Either there is no index or the user has been unregistered in the meantime
+		return;
+	}
+
+	switch (write.property) {
+		case ::msdb::UserProperty::CertificateHash:
+			index->setCertificateHash(write.userID, write.value);
+			break;
+		case ::msdb::UserProperty::Email:
+			index->setEmail(write.userID, write.value);
+			break;
+		default:
+			break;
+	}
+}
+
 void DBWrapper::addChannelListenerIfNotExists(unsigned int serverID, unsigned int userID, unsigned int channelID) {
 	WRAPPER_BEGIN
 
@@ -1138,6 +1297,10 @@ void DBWrapper::unregisterUser(unsigned int serverID, unsigned int userID) {
 	::msdb::DBUser user(serverID, userID);
 	m_serverDB.getUserTable().removeUser(user);
 
+	if (RegisteredUserIndex *index = getRegisteredUserIndex(serverID)) {
+		index->remove(userID);
+	}
+
 	WRAPPER_END
 }
 
@@ -1146,7 +1309,12 @@ int DBWrapper::registeredUserNameToID(unsigned int serverID, const std::string &
 
 	assertValidID(serverID);
 
-	std::optional< unsigned int > id = m_serverDB.getUserTable().findUser(serverID, name, false);
+	std::optional< unsigned int > id;
+	if (const RegisteredUserIndex *index = getRegisteredUserIndex(serverID)) {
+		id = index->findByName(name);
+	} else {
+		id = m_serverDB.getUserTable().findUser(serverID, name, false);
+	}
 
 	return id ? static_cast< int >(id.value()) : -1;
 
@@ -1206,12 +1374,28 @@ QMap< int, QString > DBWrapper::getRegisteredUserDetails(unsigned int serverID,
 
 
 void DBWrapper::addAllRegisteredUserInfoTo(std::vector< UserInfo > &userInfo, unsigned int serverID,
-										   const std::string &nameFilter) {
+										   const std::string &nameSubstring) {
 	WRAPPER_BEGIN
 
 	assertValidID(serverID);
 
-	for (const ::msdb::DBUser &currentUser : m_serverDB.getUserTable().getRegisteredUsers(serverID, nameFilter)) {
+	// Wildcards contained in the given string are honored
+	const std::string filter = "%" + nameSubstring + "%";
+
+	std::vector<::msdb::DBUser > users;
+	const RegisteredUserIndex *index = getRegisteredUserIndex(serverID);
+	// The index can only list all users, as LIKE behaves differently depending on the database backend
+	if (index && filter.find_first_not_of('%') == std::string::npos) {
+		for (unsigned int currentID : index->findByNamePrefix("")) {
+			users.push_back(::msdb::DBUser(serverID, currentID));
+		}
+	} else {
+		users = m_serverDB.getUserTable().getRegisteredUsers(serverID, filter);
+	}
+
+	::mdb::TransactionHolder transaction = m_serverDB.ensureTransaction();
+
+	for (const ::msdb::DBUser &currentUser : users) {
 		::msdb::DBUserData userData = m_serverDB.getUserTable().getData(currentUser);
 
 		UserInfo info;
@@ -1224,6 +1408,8 @@ void DBWrapper::addAllRegisteredUserInfoTo(std::vector< UserInfo > &userInfo, un
 		userInfo.push_back(std::move(info));
 	}
 
+	transaction.commit();
+
 	WRAPPER_END
 }
 
@@ -1232,6 +1418,10 @@ std::optional< unsigned int > DBWrapper::findRegisteredUserByCert(unsigned int s
 
 	assertValidID(serverID);
 
+	if (const RegisteredUserIndex *index = getRegisteredUserIndex(serverID)) {
+		return index->findByCertificateHash(certHash);
+	}
+
 	std::vector< unsigned int > candidates = m_serverDB.getUserPropertyTable().findUsersWithProperty(
 		serverID, ::msdb::UserProperty::CertificateHash, certHash);
 
@@ -1249,6 +1439,10 @@ std::optional< unsigned int > DBWrapper::findRegisteredUserByEmail(unsigned int
 
 	assertValidID(serverID);
 
+	if (const RegisteredUserIndex *index = getRegisteredUserIndex(serverID)) {
+		return index->findByEmail(email);
+	}
+
 	std::vector< unsigned int > candidates =
 		m_serverDB.getUserPropertyTable().findUsersWithProperty(serverID, ::msdb::UserProperty::Email, email);
 
@@ -1294,6 +1488,11 @@ void DBWrapper::storeRegisteredUserPassword(unsigned int serverID, unsigned int
 
 	m_serverDB.getUserTable().setPassword(user, pwData);
 
+	RegisteredUserIndex *index = getRegisteredUserIndex(serverID);
+	if (index && index->contains(userID)) {
+		index->setPassword(userID, pwData);
+	}
+
 	WRAPPER_END
 }
 
@@ -1317,6 +1516,66 @@ std::vector< unsigned int > DBWrapper::getRegisteredUserIDs(unsigned int serverI
 	WRAPPER_END
 }
 
+void DBWrapper::loadRegisteredUserIndex(unsigned int serverID) {
+	WRAPPER_BEGIN
+
+	assertValidID(serverID);
+
+	RegisteredUserIndex index;
+
+	::mdb::TransactionHolder transaction = m_serverDB.ensureTransaction();
+
+	for (const auto &current : m_serverDB.getUserTable().getNamesAndPasswords(serverID)) {
+		index.setName(current.first, current.second.name);
+		index.setPassword(current.first, current.second.password);
+	}
+
+	for (const auto &current :
+		 m_serverDB.getUserPropertyTable().getAllValues(serverID, ::msdb::UserProperty::CertificateHash)) {
+		if (index.contains(current.first)) {
+			index.setCertificateHash(current.first, current.second);
+		}
+	}
+
+	for (const auto &current : m_serverDB.getUserPropertyTable().getAllValues(serverID, ::msdb::UserProperty::Email)) {
+		if (index.contains(current.first)) {
+			index.setEmail(current.first, current.second);
+		}
+	}
+
+	transaction.commit();
+
+	m_registeredUserIndices[serverID] = std::move(index);
+
+	WRAPPER_END
+}
+
+::msdb::DBUserData::PasswordData DBWrapper::getRegisteredUserPassword(unsigned int serverID, unsigned int userID) {
+	WRAPPER_BEGIN
+
+	assertValidID(serverID);
+	assertRegisteredUserExists(serverID, userID);
+
+	if (const RegisteredUserIndex *index = getRegisteredUserIndex(serverID)) {
+		const ::msdb::DBUserData::PasswordData *password = index->getPassword(userID);
+		if (password) {
+			return *password;
+		}
+	}
+
+	::msdb::DBUser user(serverID, userID);
+
+	return m_serverDB.getUserTable().getPassword(user);
+
+	WRAPPER_END
+}
+
+RegisteredUserIndex *DBWrapper::getRegisteredUserIndex(unsigned int serverID) {
+	auto it = m_registeredUserIndices.find(serverID);
+
+	return it != m_registeredUserIndices.end() ? &it->second : nullptr;
+}
+
 void DBWrapper::setLastChannel(unsigned int serverID, const ServerUserInfo &userInfo) {
 	assertValidID(serverID);
 	assertRegisteredUserExists(serverID, userInfo.iId);
@@ -1450,6 +1709,8 @@ void DBWrapper::storeUserProperty(unsigned int serverID, unsigned int userID, ::
 		m_serverDB.getUserPropertyTable().setProperty(user, property, value);
 	}
 
+	updateRegisteredUserIndex(DBWrite::userProperty(serverID, userID, property, value));
+
 	WRAPPER_END
 }
 
@@ -1481,6 +1742,8 @@ void DBWrapper::setUserProperties(unsigned int serverID, unsigned int userID,
 		}
 
 		m_serverDB.getUserPropertyTable().setProperty(user, property, current.second);
+
+		updateRegisteredUserIndex(DBWrite::userProperty(serverID, userID, property, current.second));
 	}
 
 	WRAPPER_END
@@ -1542,6 +1805,13 @@ std::string DBWrapper::getUserName(unsigned int serverID, unsigned int userID) {
 	assertValidID(serverID);
 	assertRegisteredUserExists(serverID, userID);
 
+	if (const RegisteredUserIndex *index = getRegisteredUserIndex(serverID)) {
+		const std::string *name = index->getName(userID);
+		if (name) {
+			return *name;
+		}
+	}
+
 	::msdb::DBUser user(serverID, userID);
 
 	return m_serverDB.getUserTable().getData(user).name;
@@ -1569,6 +1839,12 @@ void DBWrapper::setUserData(unsigned int serverID, unsigned int userID, const ::
 
 	m_serverDB.getUserTable().updateData(user, data);
 
+	if (RegisteredUserIndex *index = getRegisteredUserIndex(serverID)) {
+		// This is also how newly registered users end up in the index
+		index->setName(userID, data.name);
+		index->setPassword(userID, data.password);
+	}
+
 	WRAPPER_END
 }
 
@@ -1585,6 +1861,19 @@ void DBWrapper::importFromJSON(const nlohmann::json &json, bool createMissingTab
 
 	m_serverDB.importFromJSON(json, createMissingTables);
 
+	// The imported data replaces whatever has been indexed so far
+	std::vector< unsigned int > indexedServers;
+	for (const auto &current : m_registeredUserIndices) {
+		indexedServers.push_back(current.first);
+	}
+	m_registeredUserIndices.clear();
+
+	for (unsigned int currentServer : indexedServers) {
+		if (m_serverDB.getServerTable().serverExists(currentServer)) {
+			loadRegisteredUserIndex(currentServer);
+		}
+	}
+
 	WRAPPER_END
 }
 
@@ -6,7 +6,9 @@
 #ifndef MUMBLE_SERVER_DBWRAPPER_H_
 #define MUMBLE_SERVER_DBWRAPPER_H_
 
+#include "DBWriteQueue.h"
 #include "NonCopyable.h"
+#include "RegisteredUserIndex.h"
 #include "murmur/database/DBChannel.h"
 #include "murmur/database/DBLogEntry.h"
 #include "murmur/database/DBUserData.h"
@@ -24,6 +26,7 @@
 #include <optional>
 #include <string>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 class Server;
@@ -97,6 +100,18 @@ public:
 	 */
 	void updateLastDisconnect(unsigned int serverID, unsigned int userID);
 
+	/**
+	 * Performs the given writes in a single transaction. Writes referring to servers or users that don't exist
+	 * (anymore) are skipped.
+	 */
+	void performWrites(const std::vector< DBWrite > &writes);
+
+	/**
+	 * Applies the given write to the registered user index without performing it. This is needed for writes that are
+	 * performed by another DBWrapper (e.g. the one of the DBWriteQueue).
+	 */
+	void updateRegisteredUserIndex(const DBWrite &write);
+
 	void addChannelListenerIfNotExists(unsigned int serverID, unsigned int userID, unsigned int channelID);
 	void disableChannelListenerIfExists(unsigned int serverID, unsigned int userID, unsigned int channelID);
 	void deleteChannelListener(unsigned int serverID, unsigned int userID, unsigned int channelID);
@@ -117,8 +132,12 @@ public:
 	bool registeredUserExists(unsigned int serverID, unsigned int userID);
 	::mumble::server::db::DBUserData getRegisteredUserData(unsigned int serverID, unsigned int userID);
 	QMap< int, QString > getRegisteredUserDetails(unsigned int serverID, unsigned int userID);
+	/**
+	 * Adds all registered users whose name contains the given string (compared case-insensitively) to the given list.
+	 * An empty string matches all users.
+	 */
 	void addAllRegisteredUserInfoTo(std::vector< UserInfo > &userInfo, unsigned int serverID,
-									const std::string &nameFilter);
+									const std::string &nameSubstring);
 	std::optional< unsigned int > findRegisteredUserByCert(unsigned int serverID, const std::string &certHash);
 	std::optional< unsigned int > findRegisteredUserByEmail(unsigned int serverID, const std::string &email);
 	void storeRegisteredUserPassword(unsigned int serverID, unsigned int userID, const QString &password,
@@ -127,6 +146,15 @@ public:
 									 unsigned int kdfIterations = 0);
 	std::vector< unsigned int > getRegisteredUserIDs(unsigned int serverID);
 
+	/**
+	 * Loads the names, passwords, certificate hashes and emails of all registered users of the given server into an
+	 * in-memory index. From then on, these are looked up in the index instead of the database. All functions of this
+	 * class modifying registered users keep the index up to date.
+	 */
+	void loadRegisteredUserIndex(unsigned int serverID);
+	::mumble::server::db::DBUserData::PasswordData getRegisteredUserPassword(unsigned int serverID,
+																			 unsigned int userID);
+
 	void setLastChannel(unsigned int serverID, const ServerUserInfo &userInfo);
 	void setLastChannel(unsigned int serverID, unsigned int userID, unsigned int channelID);
 	unsigned int getLastChannelID(unsigned int serverID, unsigned int userID, unsigned int maxRememberDuration = 0,
@@ -157,6 +185,13 @@ public:
 protected:
 	::mumble::server::db::ServerDatabase m_serverDB;
 	const std::thread::id m_threadID = std::this_thread::get_id();
+	/// The registered user indices of the servers for which they have been loaded
+	std::unordered_map< unsigned int, RegisteredUserIndex > m_registeredUserIndices;
+
+	/**
+	 * @returns The registered user index of the given server or nullptr, if it hasn't been loaded
+	 */
+	RegisteredUserIndex *getRegisteredUserIndex(unsigned int serverID);
 };
 
 #endif // MUMBLE_SERVER_DBWRAPPER_H_
@@ -0,0 +1,184 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "DBWriteQueue.h"
+#include "PrometheusWriter.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QMetaObject>
+
+#include <algorithm>
+#include <exception>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+DBWrite DBWrite::logMessage(unsigned int serverID, std::string message) {
+	DBWrite write;
+	write.type     = Type::LogMessage;
+	write.serverID = serverID;
+	write.value    = std::move(message);
+
+	return write;
+}
+
+DBWrite DBWrite::lastDisconnect(unsigned int serverID, unsigned int userID) {
+	DBWrite write;
+	write.type     = Type::LastDisconnect;
+	write.serverID = serverID;
+	write.userID   = userID;
+
+	return write;
+}
+
+DBWrite DBWrite::lastChannel(unsigned int serverID, unsigned int userID, unsigned int channelID) {
+	DBWrite write;
+	write.type      = Type::LastChannel;
+	write.serverID  = serverID;
+	write.userID    = userID;
+	write.channelID = channelID;
+
+	return write;
+}
+
+DBWrite DBWrite::userProperty(unsigned int serverID, unsigned int userID, ::mumble::server::db::UserProperty property,
+							  std::string value) {
+	DBWrite write;
+	write.type     = Type::UserProperty;
+	write.serverID = serverID;
+	write.userID   = userID;
+	write.property = property;
+	write.value    = std::move(value);
+
+	return write;
+}
+
+DBWriteQueue::DBWriteQueue(WriterFactory createWriter, std::size_t capacity)
+	: m_capacity(std::max< std::size_t >(capacity, 1)) {
+	m_thread = std::thread([this, createWriter = std::move(createWriter)]() { run(createWriter); });
+}
+
+DBWriteQueue::~DBWriteQueue() {
+	{
+		std::lock_guard< std::mutex > lock(m_mutex);
+		m_stop = true;
+	}
+	m_writesAvailable.notify_all();
+
+	// The thread only exits once the queue is empty
+	m_thread.join();
+}
+
+void DBWriteQueue::enqueue(DBWrite write) {
+	std::unique_lock< std::mutex > lock(m_mutex);
+
+	if (m_queue.size() + m_batch.size() >= m_capacity) {
+		// Backpressure: the database can't keep up, so the caller has to wait
+		++m_statistics.stalls;
+		m_writesPerformed.wait(lock, [this]() { return m_queue.size() + m_batch.size() < m_capacity; });
+	}
+
+	m_queue.push_back(std::move(write));
+	lock.unlock();
+
+	m_writesAvailable.notify_one();
+}
+
+void DBWriteQueue::flush() {
+	std::unique_lock< std::mutex > lock(m_mutex);
+
+	// The writer thread always performs the writes in the order they have been enqueued in, so all writes enqueued
+	// so far are done once this many more writes have been performed.
+	const std::uint64_t target = m_statistics.written + m_queue.size() + m_batch.size();
+
+	m_writesPerformed.wait(lock, [this, target]() { return m_statistics.written >= target; });
+}
+
+void DBWriteQueue::flush(const std::function< bool(const DBWrite &) > &affects) {
+	std::unique_lock< std::mutex > lock(m_mutex);
+
+	// The number of writes that have to be performed until the last matching one is done
+	std::size_t remaining = 0;
+	for (std::size_t i = m_queue.size(); i > 0; --i) {
+		if (affects(m_queue[i - 1])) {
+			remaining = m_batch.size() + i;
+			break;
+		}
+	}
+	if (remaining == 0 && std::any_of(m_batch.begin(), m_batch.end(), affects)) {
+		remaining = m_batch.size();
+	}
+
+	const std::uint64_t target = m_statistics.written + remaining;
+
+	m_writesPerformed.wait(lock, [this, target]() { return m_statistics.written >= target; });
+}
+
+DBWriteQueue::Statistics DBWriteQueue::getStatistics() const {
+	std::lock_guard< std::mutex > lock(m_mutex);
+
+	Statistics statistics = m_statistics;
+	statistics.pending    = m_queue.size() + m_batch.size();
+
+	return statistics;
+}
+
+void DBWriteQueue::writeStatistics(PrometheusWriter &writer) const {
+	const Statistics statistics = getStatistics();
+
+	writer.family("murmur_db_write_queue_pending", "gauge",
+				  "Database writes waiting to be performed in the background.");
+	writer.sample("", statistics.pending);
+	writer.family("murmur_db_writes_total", "counter", "Database writes performed in the background.");
+	writer.sample("", statistics.written);
+	writer.family("murmur_db_write_batches_total", "counter",
+				  "Transactions used for performing the background database writes.");
+	writer.sample("", statistics.batches);
+	writer.family("murmur_db_write_queue_stalls_total", "counter",
+				  "Times the main thread had to wait for a full write queue.");
+	writer.sample("", statistics.stalls);
+}
+
+void DBWriteQueue::run(const WriterFactory &createWriter) {
+	Writer writer;
+
+	while (true) {
+		{
+			std::unique_lock< std::mutex > lock(m_mutex);
+			m_writesAvailable.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+
+			if (m_queue.empty()) {
+				// Stopped and everything has been written
+				return;
+			}
+
+			m_batch.assign(std::make_move_iterator(m_queue.begin()), std::make_move_iterator(m_queue.end()));
+			m_queue.clear();
+		}
+
+		try {
+			if (!writer) {
+				writer = createWriter();
+			}
+
+			writer(m_batch);
+		} catch (const std::exception &e) {
+			// Database errors are fatal. The exception is re-thrown in the main thread, which terminates the
+			// application (see ServerApplication::notify).
+			const std::string message = e.what();
+			QMetaObject::invokeMethod(
+				QCoreApplication::instance(), [message]() { throw std::runtime_error(message); },
+				Qt::QueuedConnection);
+		}
+
+		{
+			std::lock_guard< std::mutex > lock(m_mutex);
+			m_statistics.written += m_batch.size();
+			m_statistics.batches += 1;
+			m_batch.clear();
+		}
+		m_writesPerformed.notify_all();
+	}
+}
@@ -0,0 +1,117 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_SERVER_DBWRITEQUEUE_H_
+#define MUMBLE_SERVER_DBWRITEQUEUE_H_
+
+#include "murmur/database/UserProperty.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class PrometheusWriter;
+
+/**
+ * A database write that nobody has to wait for, which is why it may be performed asynchronously (see DBWriteQueue)
+ */
+struct DBWrite {
+	enum class Type { LogMessage, LastDisconnect, LastChannel, UserProperty };
+
+	Type type;
+	unsigned int serverID;
+	unsigned int userID                         = 0;
+	unsigned int channelID                      = 0;
+	::mumble::server::db::UserProperty property = ::mumble::server::db::UserProperty::Name;
+	/// The message of a LogMessage or the new value of a UserProperty (an empty value clears the property)
+	std::string value;
+	/// The time at which the write has been requested
+	std::chrono::system_clock::time_point timestamp = std::chrono::system_clock::now();
+
+	static DBWrite logMessage(unsigned int serverID, std::string message);
+	static DBWrite lastDisconnect(unsigned int serverID, unsigned int userID);
+	static DBWrite lastChannel(unsigned int serverID, unsigned int userID, unsigned int channelID);
+	static DBWrite userProperty(unsigned int serverID, unsigned int userID,
+								::mumble::server::db::UserProperty property, std::string value);
+};
+
+/**
+ * A bounded queue of DBWrites that are performed by a dedicated thread using its own database connection. Everything
+ * that has piled up while the thread was busy is handed to the writer as a single batch (which DBWrapper::performWrites
+ * writes in a single transaction, with all log messages being inserted by multi-row inserts). This keeps the latency
+ * of the database off the main thread.
+ *
+ * If the queue is full, enqueue() blocks until there is room again (the number of times this happened is reported as
+ * stalls). In case of a database error, the application is terminated the same way it would be if the error had
+ * occurred on the main thread.
+ */
+class DBWriteQueue {
+public:
+	/// Performs the given batch of writes, throwing in case of a database error
+	using Writer = std::function< void(const std::vector< DBWrite > &) >;
+	/// Creates the Writer on the queue's thread, as e.g. a DBWrapper may only be used by the thread that has created it
+	using WriterFactory = std::function< Writer() >;
+
+	struct Statistics {
+		/// The number of writes that are currently queued or in progress
+		std::size_t pending = 0;
+		/// The total number of writes that have been performed
+		std::uint64_t written = 0;
+		/// The total number of transactions that have been used for performing the writes
+		std::uint64_t batches = 0;
+		/// The total number of times enqueue() had to wait for the queue to have room
+		std::uint64_t stalls = 0;
+	};
+
+	/// @param createWriter Invoked once (on the queue's thread) before the first batch is written
+	/// @param capacity The maximum number of writes that may be pending at the same time
+	DBWriteQueue(WriterFactory createWriter, std::size_t capacity);
+	/// Performs all writes that are still pending before returning
+	~DBWriteQueue();
+
+	DBWriteQueue(const DBWriteQueue &)            = delete;
+	DBWriteQueue &operator=(const DBWriteQueue &) = delete;
+
+	void enqueue(DBWrite write);
+	/// Blocks until all writes that have been enqueued before have been performed
+	void flush();
+	/// Blocks until all writes that have been enqueued before and that match the given predicate have been performed.
+	/// This has to be used before reading data that might be affected by pending writes. As the writes are performed in
+	/// order, the writes enqueued before the last matching one are waited for as well, but nothing is waited for if no
+	/// write matches.
+	///
+	/// @param affects Invoked for every pending write while the queue is locked
+	void flush(const std::function< bool(const DBWrite &) > &affects);
+
+	Statistics getStatistics() const;
+	void writeStatistics(PrometheusWriter &writer) const;
+
+protected:
+	std::size_t m_capacity;
+
+	mutable std::mutex m_mutex;
+	/// Signaled when writes are enqueued or the queue is stopped
+	std::condition_variable m_writesAvailable;
+	/// Signaled when a batch of writes has been performed
+	std::condition_variable m_writesPerformed;
+	std::deque< DBWrite > m_queue;
+	/// The writes currently being performed by the writer thread. They are only modified while m_mutex is locked.
+	std::vector< DBWrite > m_batch;
+	bool m_stop = false;
+	Statistics m_statistics;
+
+	std::thread m_thread;
+
+	void run(const WriterFactory &createWriter);
+};
+
+#endif // MUMBLE_SERVER_DBWRITEQUEUE_H_
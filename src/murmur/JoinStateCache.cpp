@@ -0,0 +1,68 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "JoinStateCache.h"
+
+#include <QtCore/QtEndian>
+
+#include <cstring>
+
+void JoinStateCache::update(const ::google::protobuf::Message &msg, Mumble::Protocol::TCPMessageType type) {
+	switch (type) {
+		case Mumble::Protocol::TCPMessageType::ChannelState: {
+			const MumbleProto::ChannelState &state = static_cast< const MumbleProto::ChannelState & >(msg);
+			if (state.has_channel_id()) {
+				invalidateChannel(state.channel_id());
+			}
+			break;
+		}
+		case Mumble::Protocol::TCPMessageType::ChannelRemove:
+			invalidateChannel(static_cast< const MumbleProto::ChannelRemove & >(msg).channel_id());
+			break;
+		case Mumble::Protocol::TCPMessageType::UserState: {
+			const MumbleProto::UserState &state = static_cast< const MumbleProto::UserState & >(msg);
+			if (state.has_session()) {
+				invalidateUser(state.session());
+			}
+			break;
+		}
+		case Mumble::Protocol::TCPMessageType::UserRemove:
+			invalidateUser(static_cast< const MumbleProto::UserRemove & >(msg).session());
+			break;
+		default:
+			break;
+	}
+}
+
+void JoinStateCache::invalidateChannel(unsigned int channelID) {
+	m_channelStates.erase(channelID);
+}
+
+void JoinStateCache::invalidateUser(unsigned int session) {
+	m_userStates.erase(session);
+}
+
+void JoinStateCache::clear() {
+	m_channelStates.clear();
+	m_userStates.clear();
+}
+
+const JoinStateCache::Statistics &JoinStateCache::getStatistics() const {
+	return m_statistics;
+}
+
+void JoinStateCache::appendMessage(QByteArray &buffer, Mumble::Protocol::TCPMessageType type,
+								   const std::string &body, const std::string &suffix) {
+	const std::size_t length = body.size() + suffix.size();
+	const qsizetype offset   = buffer.size();
+
+	buffer.resize(offset + static_cast< qsizetype >(length + 6));
+	unsigned char *uc = reinterpret_cast< unsigned char * >(buffer.data() + offset);
+	qToBigEndian< quint16 >(static_cast< quint16 >(type), &uc[0]);
+	qToBigEndian< quint32 >(static_cast< quint32 >(length), &uc[2]);
+
+	std::memcpy(uc + 6, body.data(), body.size());
+	std::memcpy(uc + 6 + body.size(), suffix.data(), suffix.size());
+}
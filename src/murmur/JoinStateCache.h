@@ -0,0 +1,86 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_JOINSTATECACHE_H_
+#define MUMBLE_MURMUR_JOINSTATECACHE_H_
+
+#include "Mumble.pb.h"
+#include "MumbleProtocol.h"
+
+#include <QtCore/QByteArray>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+/// The serialized ChannelState and UserState messages that describe a server's channels and users to clients joining
+/// the server. Only the parts that are the same for every joining client are cached, anything that depends on the
+/// joining client (e.g. whether it may enter a channel) is serialized separately and appended to the cached message
+/// (concatenated protobuf messages are merged when parsed).
+///
+/// Entries are created on demand and dropped whenever the respective channel's or user's state is broadcast to the
+/// clients (see update()), which every change of that state has to be. Thus, a join only has to serialize the
+/// channels and users that have changed since the previous join.
+///
+/// The cache is only valid for clients using the current protocol (version 1.2.2 and later), which receive hashes
+/// instead of large descriptions, comments and textures.
+class JoinStateCache {
+public:
+	struct Statistics {
+		/// The number of states that have been taken from the cache
+		std::uint64_t hits = 0;
+		/// The number of states that had to be serialized because they weren't cached
+		std::uint64_t misses = 0;
+	};
+
+	/// @returns The serialized state of the channel with the given ID. If it isn't cached, the given function is called
+	/// 	with an empty MumbleProto::ChannelState to fill in.
+	template< typename Fill > const std::string &channelState(unsigned int channelID, Fill &&fill) {
+		return get< MumbleProto::ChannelState >(m_channelStates, channelID, std::forward< Fill >(fill));
+	}
+	/// @returns The serialized state of the user with the given session. If it isn't cached, the given function is
+	/// 	called with an empty MumbleProto::UserState to fill in.
+	template< typename Fill > const std::string &userState(unsigned int session, Fill &&fill) {
+		return get< MumbleProto::UserState >(m_userStates, session, std::forward< Fill >(fill));
+	}
+
+	/// Drops the entries affected by the given message, which is about to be sent to all clients
+	void update(const ::google::protobuf::Message &msg, Mumble::Protocol::TCPMessageType type);
+
+	void invalidateChannel(unsigned int channelID);
+	void invalidateUser(unsigned int session);
+	void clear();
+
+	const Statistics &getStatistics() const;
+
+	/// Appends a message of the given type consisting of the given (serialized) parts to the given buffer in the
+	/// format used on the network (see Connection::messageToNetwork)
+	static void appendMessage(QByteArray &buffer, Mumble::Protocol::TCPMessageType type, const std::string &body,
+							  const std::string &suffix = std::string());
+
+protected:
+	std::unordered_map< unsigned int, std::string > m_channelStates;
+	std::unordered_map< unsigned int, std::string > m_userStates;
+	Statistics m_statistics;
+
+	template< typename Message, typename Fill >
+	const std::string &get(std::unordered_map< unsigned int, std::string > &states, unsigned int id, Fill &&fill) {
+		auto it = states.find(id);
+		if (it != states.end()) {
+			++m_statistics.hits;
+			return it->second;
+		}
+
+		++m_statistics.misses;
+
+		Message msg;
+		fill(msg);
+
+		return states.emplace(id, msg.SerializeAsString()).first->second;
+	}
+};
+
+#endif // MUMBLE_MURMUR_JOINSTATECACHE_H_
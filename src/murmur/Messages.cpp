@@ -24,7 +24,10 @@
 #include <algorithm>
 #include <cassert>
 #include <set>
+#include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <QtCore/QStack>
 #include <QtCore/QTimeZone>
@@ -166,6 +169,164 @@ bool isChannelEnterRestricted(Channel *c) {
 	return false;
 }
 
+void Server::fillChannelState(const Channel &channel, bool sendHashes, MumbleProto::ChannelState &mpcs) const {
+	mpcs.set_channel_id(channel.iId);
+	if (channel.cParent)
+		mpcs.set_parent(channel.cParent->iId);
+	if (channel.iId == 0)
+		mpcs.set_name(u8(qsRegName.isEmpty() ? QLatin1String("Root") : qsRegName));
+	else
+		mpcs.set_name(u8(channel.qsName));
+
+	mpcs.set_position(channel.iPosition);
+
+	if (sendHashes && !channel.qbaDescHash.isEmpty())
+		mpcs.set_description_hash(blob(channel.qbaDescHash));
+	else if (!channel.qsDesc.isEmpty())
+		mpcs.set_description(u8(channel.qsDesc));
+
+	mpcs.set_max_users(channel.uiMaxUsers);
+}
+
+void Server::fillUserState(const ServerUser &user, const ServerUser &recipient, MumbleProto::UserState &mpus) const {
+	const bool sendHashes = recipient.m_version >= Version::fromComponents(1, 2, 2);
+
+	mpus.set_session(user.uiSession);
+	mpus.set_name(u8(user.qsName));
+	if (user.iId >= 0)
+		mpus.set_user_id(static_cast< unsigned int >(user.iId));
+	if (sendHashes) {
+		if (!user.qbaTextureHash.isEmpty())
+			mpus.set_texture_hash(blob(user.qbaTextureHash));
+		else if (!user.qbaTexture.isEmpty())
+			mpus.set_texture(blob(user.qbaTexture));
+	} else if ((recipient.qbaTexture.length() >= 4)
+			   && (qFromBigEndian< unsigned int >(
+					   reinterpret_cast< const unsigned char * >(recipient.qbaTexture.constData()))
+				   == 600 * 60 * 4)) {
+		mpus.set_texture(blob(user.qbaTexture));
+	}
+	if (user.cChannel->iId != 0)
+		mpus.set_channel_id(user.cChannel->iId);
+	if (user.bDeaf)
+		mpus.set_deaf(true);
+	else if (user.bMute)
+		mpus.set_mute(true);
+	if (user.bSuppress)
+		mpus.set_suppress(true);
+	if (user.bPrioritySpeaker)
+		mpus.set_priority_speaker(true);
+	if (user.bRecording)
+		mpus.set_recording(true);
+	if (user.bSelfDeaf)
+		mpus.set_self_deaf(true);
+	else if (user.bSelfMute)
+		mpus.set_self_mute(true);
+	if (sendHashes && !user.qbaCommentHash.isEmpty())
+		mpus.set_comment_hash(blob(user.qbaCommentHash));
+	else if (!user.qsComment.isEmpty())
+		mpus.set_comment(u8(user.qsComment));
+	if (!user.qsHash.isEmpty())
+		mpus.set_hash(u8(user.qsHash));
+
+	for (unsigned int channelID : m_channelListenerManager.getListenedChannelsForUser(user.uiSession)) {
+		mpus.add_listening_channel_add(channelID);
+
+		if (broadcastListenerVolumeAdjustments) {
+			VolumeAdjustment volume = m_channelListenerManager.getListenerVolumeAdjustment(user.uiSession, channelID);
+			MumbleProto::UserState::VolumeAdjustment *adjustment = mpus.add_listening_volume_adjustment();
+			adjustment->set_listening_channel(channelID);
+			adjustment->set_volume_adjustment(volume.factor);
+		}
+	}
+}
+
+void Server::sendChannelStates(ServerUser *uSource) {
+	const bool useCache = uSource->m_version >= Version::fromComponents(1, 2, 2);
+
+	// All states are sent in one go
+	QByteArray buffer;
+	QQueue< Channel * > q;
+	QSet< Channel * > chans;
+	q << qhChannels.value(0);
+	MumbleProto::ChannelState mpcs;
+
+	while (!q.isEmpty()) {
+		Channel *c = q.dequeue();
+		chans.insert(c);
+
+		// Whether the joining user may enter the channel is the only part that depends on the user
+		mpcs.Clear();
+		mpcs.set_is_enter_restricted(isChannelEnterRestricted(c));
+		mpcs.set_can_enter(hasPermission(uSource, c, ChanACL::Enter));
+		const std::string userSpecific = mpcs.SerializeAsString();
+
+		if (useCache) {
+			const std::string &state = m_joinStateCache.channelState(
+				c->iId, [&](MumbleProto::ChannelState &state) { fillChannelState(*c, true, state); });
+
+			JoinStateCache::appendMessage(buffer, Mumble::Protocol::TCPMessageType::ChannelState, state, userSpecific);
+		} else {
+			mpcs.Clear();
+			fillChannelState(*c, false, mpcs);
+
+			JoinStateCache::appendMessage(buffer, Mumble::Protocol::TCPMessageType::ChannelState,
+										  mpcs.SerializeAsString(), userSpecific);
+		}
+
+		for (Channel *chan : c->qlChannels) {
+			q.enqueue(chan);
+		}
+	}
+
+	// Transmit links
+	for (Channel *chan : chans) {
+		if (chan->qhLinks.count() > 0) {
+			mpcs.Clear();
+			mpcs.set_channel_id(chan->iId);
+
+			for (Channel *l : chan->qhLinks.keys()) {
+				mpcs.add_links(l->iId);
+			}
+			JoinStateCache::appendMessage(buffer, Mumble::Protocol::TCPMessageType::ChannelState,
+										  mpcs.SerializeAsString());
+		}
+	}
+
+	uSource->sendMessage(buffer);
+}
+
+void Server::sendUserStates(ServerUser *uSource) {
+	const bool useCache = uSource->m_version >= Version::fromComponents(1, 2, 2);
+
+	// All states are sent in one go
+	QByteArray buffer;
+	MumbleProto::UserState mpus;
+
+	for (ServerUser *u : qhUsers) {
+		if (u->sState != ServerUser::Authenticated)
+			continue;
+
+		if (u == uSource)
+			continue;
+
+		if (useCache) {
+			const std::string &state = m_joinStateCache.userState(
+				u->uiSession, [&](MumbleProto::UserState &state) { fillUserState(*u, *uSource, state); });
+
+			JoinStateCache::appendMessage(buffer, Mumble::Protocol::TCPMessageType::UserState, state);
+		} else {
+			mpus.Clear();
+			fillUserState(*u, *uSource, mpus);
+
+			JoinStateCache::appendMessage(buffer, Mumble::Protocol::TCPMessageType::UserState,
+										  mpus.SerializeAsString());
+		}
+	}
+
+	uSource->sendMessage(buffer);
+}
+
 void Server::msgAuthenticate(ServerUser *uSource, MumbleProto::Authenticate &msg) {
 	ZoneScoped;
 
@@ -197,6 +358,15 @@ void Server::msgAuthenticate(ServerUser *uSource, MumbleProto::Authenticate &msg
 	}
 	MSG_SETUP(ServerUser::Connected);
 
+	if (deferExternalAuthentication(uSource, msg) || deferAuthentication(uSource, msg)) {
+		return;
+	}
+	// A precomputed hash or external result is only valid for the authentication attempt it has been obtained for
+	const std::optional< PrecomputedPasswordHash > precomputedHash =
+		std::exchange(uSource->m_precomputedPasswordHash, std::nullopt);
+	const std::optional< ExternalAuthenticationResult > externalAuthentication =
+		std::exchange(uSource->m_externalAuthentication, std::nullopt);
+
 	// As the first thing, assign a session ID to this client. Given that the client initiated
 	// the authentication procedure we can be sure that this is not just a random TCP connection.
 	// Thus it is about time we assign the ID to this client in order to be able to reference it
@@ -205,11 +375,10 @@ void Server::msgAuthenticate(ServerUser *uSource, MumbleProto::Authenticate &msg
 		QWriteLocker wl(&qrwlVoiceThread);
 		uSource->uiSession = qqIds.dequeue();
 		qhUsers.insert(uSource->uiSession, uSource);
-		qhHostUsers[uSource->haAddress].insert(uSource);
+		qhHostUsers[uSource->haAddress].append(uSource);
 	}
 
 	Channel *root = qhChannels.value(0);
-	Channel *c;
 
 	uSource->qsName = u8(msg.username()).trimmed();
 
@@ -217,13 +386,42 @@ void Server::msgAuthenticate(ServerUser *uSource, MumbleProto::Authenticate &msg
 	bool nameok = validateUserName(uSource->qsName);
 	QString pw  = u8(msg.password());
 
+	// Authentication might look the user up by a certificate hash or email that is still waiting to be written (e.g.
+	// because the user is reconnecting right away)
+	const std::string certHash = uSource->qsHash.toStdString();
+	std::vector< std::string > emails;
+	for (const QString &email : uSource->qslEmail) {
+		emails.push_back(email.toStdString());
+	}
+	flushDBWrites([&certHash, &emails](const DBWrite &write) {
+		if (write.type != DBWrite::Type::UserProperty) {
+			return false;
+		}
+
+		switch (write.property) {
+			case ::mumble::server::db::UserProperty::CertificateHash:
+				return write.value == certHash;
+			case ::mumble::server::db::UserProperty::Email:
+				return std::find(emails.begin(), emails.end(), write.value) != emails.end();
+			default:
+				return false;
+		}
+	});
+
 	// Fetch ID and stored username.
 	// This function needs to support the fact that sessions may go away.
 	int id = authenticate(uSource->qsName, pw, static_cast< int >(uSource->uiSession), uSource->qslEmail,
-						  uSource->qsHash, uSource->bVerified, uSource->peerCertificateChain());
+						  uSource->qsHash, uSource->bVerified, uSource->peerCertificateChain(),
+						  precomputedHash ? &precomputedHash.value() : nullptr,
+						  externalAuthentication ? &externalAuthentication.value() : nullptr);
 
 	uSource->iId = id >= 0 ? id : -1;
 
+	if (id >= 0) {
+		// The following setup reads data of the user (e.g. the last channel) that might still be waiting to be written
+		flushDBWrites(static_cast< unsigned int >(id));
+	}
+
 	QString reason;
 	MumbleProto::Reject_RejectType rtType = MumbleProto::Reject_RejectType_None;
 
@@ -380,57 +578,7 @@ void Server::msgAuthenticate(ServerUser *uSource, MumbleProto::Authenticate &msg
 	}
 
 	// Transmit channel tree
-	QQueue< Channel * > q;
-	QSet< Channel * > chans;
-	q << root;
-	MumbleProto::ChannelState mpcs;
-
-	while (!q.isEmpty()) {
-		c = q.dequeue();
-		chans.insert(c);
-
-		mpcs.Clear();
-
-		mpcs.set_channel_id(c->iId);
-		if (c->cParent)
-			mpcs.set_parent(c->cParent->iId);
-		if (c->iId == 0)
-			mpcs.set_name(u8(qsRegName.isEmpty() ? QLatin1String("Root") : qsRegName));
-		else
-			mpcs.set_name(u8(c->qsName));
-
-		mpcs.set_position(c->iPosition);
-
-		if ((uSource->m_version >= Version::fromComponents(1, 2, 2)) && !c->qbaDescHash.isEmpty())
-			mpcs.set_description_hash(blob(c->qbaDescHash));
-		else if (!c->qsDesc.isEmpty())
-			mpcs.set_description(u8(c->qsDesc));
-
-		mpcs.set_max_users(c->uiMaxUsers);
-
-		// Include info about enter restrictions of this channel
-		mpcs.set_is_enter_restricted(isChannelEnterRestricted(c));
-		mpcs.set_can_enter(hasPermission(uSource, c, ChanACL::Enter));
-
-		sendMessage(uSource, mpcs);
-
-		for (Channel *chan : c->qlChannels) {
-			q.enqueue(chan);
-		}
-	}
-
-	// Transmit links
-	for (Channel *chan : chans) {
-		if (chan->qhLinks.count() > 0) {
-			mpcs.Clear();
-			mpcs.set_channel_id(chan->iId);
-
-			for (Channel *l : chan->qhLinks.keys()) {
-				mpcs.add_links(l->iId);
-			}
-			sendMessage(uSource, mpcs);
-		}
-	}
+	sendChannelStates(uSource);
 
 	if (uSource->iId >= 0) {
 		m_dbWrapper.loadChannelListenersOf(iServerNum, *uSource, m_channelListenerManager);
@@ -483,66 +631,7 @@ void Server::msgAuthenticate(ServerUser *uSource, MumbleProto::Authenticate &msg
 	sendAll(mpus, Version::fromComponents(1, 2, 2), Version::CompareMode::LessThan);
 
 	// Transmit other users profiles
-	for (ServerUser *u : qhUsers) {
-		if (u->sState != ServerUser::Authenticated)
-			continue;
-
-		if (u == uSource)
-			continue;
-
-		mpus.Clear();
-		mpus.set_session(u->uiSession);
-		mpus.set_name(u8(u->qsName));
-		if (u->iId >= 0)
-			mpus.set_user_id(static_cast< unsigned int >(u->iId));
-		if (uSource->m_version >= Version::fromComponents(1, 2, 2)) {
-			if (!u->qbaTextureHash.isEmpty())
-				mpus.set_texture_hash(blob(u->qbaTextureHash));
-			else if (!u->qbaTexture.isEmpty())
-				mpus.set_texture(blob(u->qbaTexture));
-		} else if ((uSource->qbaTexture.length() >= 4)
-				   && (qFromBigEndian< unsigned int >(
-						   reinterpret_cast< const unsigned char * >(uSource->qbaTexture.constData()))
-					   == 600 * 60 * 4)) {
-			mpus.set_texture(blob(u->qbaTexture));
-		}
-		if (u->cChannel->iId != 0)
-			mpus.set_channel_id(u->cChannel->iId);
-		if (u->bDeaf)
-			mpus.set_deaf(true);
-		else if (u->bMute)
-			mpus.set_mute(true);
-		if (u->bSuppress)
-			mpus.set_suppress(true);
-		if (u->bPrioritySpeaker)
-			mpus.set_priority_speaker(true);
-		if (u->bRecording)
-			mpus.set_recording(true);
-		if (u->bSelfDeaf)
-			mpus.set_self_deaf(true);
-		else if (u->bSelfMute)
-			mpus.set_self_mute(true);
-		if ((uSource->m_version >= Version::fromComponents(1, 2, 2)) && !u->qbaCommentHash.isEmpty())
-			mpus.set_comment_hash(blob(u->qbaCommentHash));
-		else if (!u->qsComment.isEmpty())
-			mpus.set_comment(u8(u->qsComment));
-		if (!u->qsHash.isEmpty())
-			mpus.set_hash(u8(u->qsHash));
-
-
-		for (unsigned int channelID : m_channelListenerManager.getListenedChannelsForUser(u->uiSession)) {
-			mpus.add_listening_channel_add(channelID);
-
-			if (broadcastListenerVolumeAdjustments) {
-				VolumeAdjustment volume = m_channelListenerManager.getListenerVolumeAdjustment(u->uiSession, channelID);
-				MumbleProto::UserState::VolumeAdjustment *adjustment = mpus.add_listening_volume_adjustment();
-				adjustment->set_listening_channel(channelID);
-				adjustment->set_volume_adjustment(volume.factor);
-			}
-		}
-
-		sendMessage(uSource, mpus);
-	}
+	sendUserStates(uSource);
 
 	// Send synchronisation packet
 	MumbleProto::ServerSync mpss;
@@ -1143,13 +1232,6 @@ void Server::msgUserState(ServerUser *uSource, MumbleProto::UserState &msg) {
 	bool broadcastingBecauseOfVolumeChange = !bBroadcast && listenerVolumeChanged;
 	bBroadcast                             = bBroadcast || listenerChanged || listenerVolumeChanged;
 
-	if (listenerChanged || listenerVolumeChanged) {
-		// As whisper targets also contain information about ChannelListeners and
-		// their associated volume adjustment, we have to clear the target cache
-		clearWhisperTargetCache();
-	}
-
-
 	bool bDstAclChanged = false;
 	if (msg.has_user_id()) {
 		// Handle user (Self-)Registration
@@ -1207,10 +1289,6 @@ void Server::msgUserState(ServerUser *uSource, MumbleProto::UserState &msg) {
 
 		if (bDstAclChanged) {
 			clearACLCache(pDstServerUser);
-		} else if (listenerChanged || listenerVolumeChanged) {
-			// We only have to do this if the ACLs didn't change as
-			// clearACLCache calls clearWhisperTargetChache anyways
-			clearWhisperTargetCache();
 		}
 	}
 
@@ -1376,11 +1454,11 @@ void Server::msgChannelState(ServerUser *uSource, MumbleProto::ChannelState &msg
 			if (uSource->iId >= 0)
 				a->iUserId = uSource->iId;
 			else
-				a->qsGroup = QLatin1Char('$') + uSource->qsHash;
+				a->setGroup(QLatin1Char('$') + uSource->qsHash);
 			a->pDeny  = ChanACL::None;
 			a->pAllow = ChanACL::Write | ChanACL::Traverse;
 
-			clearACLCache();
+			clearACLCacheFor(*c);
 		}
 
 		if (!c->bTemporary) {
@@ -1514,9 +1592,15 @@ void Server::msgChannelState(ServerUser *uSource, MumbleProto::ChannelState &msg
 
 			{
 				QWriteLocker wl(&qrwlVoiceThread);
+				clearWhisperTargetCacheFor(*c->cParent);
 				c->cParent->removeChannel(c);
 				p->addChannel(c);
+				clearWhisperTargetCacheFor(*p);
+				clearWhisperTargetCacheFor(*c);
 			}
+
+			// The moved channels now inherit their ACLs and groups from different ancestors
+			clearACLCacheFor(*c);
 		}
 		if (!qsName.isNull()) {
 			log(uSource, QString("Renamed channel %1 to %2").arg(QString(*c), QString(qsName)));
@@ -1961,7 +2045,7 @@ void Server::msgACL(ServerUser *uSource, MumbleProto::ACL &msg) {
 				if (mpacl.has_user_id())
 					a->iUserId = static_cast< int >(mpacl.user_id());
 				else
-					a->qsGroup = u8(mpacl.group());
+					a->setGroup(u8(mpacl.group()));
 				a->pDeny  = static_cast< ChanACL::Permissions >(mpacl.deny()) & ChanACL::All;
 				a->pAllow = static_cast< ChanACL::Permissions >(mpacl.grant()) & ChanACL::All;
 			}
@@ -1971,7 +2055,7 @@ void Server::msgACL(ServerUser *uSource, MumbleProto::ACL &msg) {
 			}
 		}
 
-		clearACLCache();
+		clearACLCacheFor(*c);
 
 		if (!hasPermission(uSource, c, ChanACL::Write) && ((uSource->iId >= 0) || !uSource->qsHash.isEmpty())) {
 			{
@@ -1983,13 +2067,13 @@ void Server::msgACL(ServerUser *uSource, MumbleProto::ACL &msg) {
 				if (uSource->iId >= 0)
 					a->iUserId = uSource->iId;
 				else
-					a->qsGroup = QLatin1Char('$') + uSource->qsHash;
+					a->setGroup(QLatin1Char('$') + uSource->qsHash);
 				a->iUserId = uSource->iId;
 				a->pDeny   = ChanACL::None;
 				a->pAllow  = ChanACL::Write | ChanACL::Traverse;
 			}
 
-			clearACLCache();
+			clearACLCacheFor(*c);
 		}
 
 
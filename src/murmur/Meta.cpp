@@ -11,9 +11,11 @@
 #include "Net.h"
 #include "OSInfo.h"
 #include "PBKDF2.h"
+#include "PrometheusWriter.h"
 #include "SSL.h"
 #include "Server.h"
 #include "Version.h"
+#include "VoiceStats.h"
 
 #include "database/MySQLConnectionParameter.h"
 #include "database/PostgreSQLConnectionParameter.h"
@@ -21,12 +23,16 @@
 
 #include <boost/algorithm/string.hpp>
 
+#include <algorithm>
 #include <cassert>
 #include <chrono>
 #include <optional>
+#include <utility>
+#include <vector>
 
 #include <QDir>
 #include <QFile>
+#include <QSaveFile>
 #include <QStringList>
 #include <QtCore/QCoreApplication>
 #include <QtCore/QSettings>
@@ -93,10 +99,13 @@ MetaParams::MetaParams() {
 	bCertRequired      = false;
 	bForceExternalAuth = false;
 
-	iBanTries      = 10;
-	iBanTimeframe  = 120;
-	iBanTime       = 300;
-	bBanSuccessful = true;
+	iBanTries           = 10;
+	iBanTimeframe       = 120;
+	iBanTime            = 300;
+	bBanSuccessful      = true;
+	banIPv4PrefixLength = 24;
+	banIPv6PrefixLength = 64;
+	banTableSize        = 65536;
 
 #ifdef Q_OS_UNIX
 	uiUid = uiGid = 0;
@@ -127,6 +136,31 @@ MetaParams::MetaParams() {
 
 	rollingStatsWindow = 300;
 
+	voiceThreads = 1;
+	useIOUring   = false;
+
+	voiceStatsInterval = 15;
+
+	connectionThreads = 0;
+
+	passwordHashThreads    = 2;
+	passwordHashQueueLimit = 100;
+
+	dbWriteQueueSize = 1000;
+
+	registeredUserIndex = false;
+
+	iceCallbackQueue      = 1000;
+	iceCallbackThreads    = 2;
+	iceCallbackCoalesce   = true;
+	iceCallbackDisconnect = false;
+
+	authenticatorConcurrency = 16;
+	authenticatorQueueLimit  = 100;
+	authenticatorCacheTTL    = 0;
+
+	tcpWriteDelay = 0;
+
 	qsSettings = nullptr;
 }
 
@@ -325,10 +359,13 @@ void MetaParams::read(QString fname) {
 	qurlRegWeb    = QUrl(typeCheckedFromSettings("registerUrl", qurlRegWeb).toString());
 	bBonjour      = typeCheckedFromSettings("bonjour", bBonjour);
 
-	iBanTries      = typeCheckedFromSettings("autobanAttempts", iBanTries);
-	iBanTimeframe  = typeCheckedFromSettings("autobanTimeframe", iBanTimeframe);
-	iBanTime       = typeCheckedFromSettings("autobanTime", iBanTime);
-	bBanSuccessful = typeCheckedFromSettings("autobanSuccessfulConnections", bBanSuccessful);
+	iBanTries           = typeCheckedFromSettings("autobanAttempts", iBanTries);
+	iBanTimeframe       = typeCheckedFromSettings("autobanTimeframe", iBanTimeframe);
+	iBanTime            = typeCheckedFromSettings("autobanTime", iBanTime);
+	bBanSuccessful      = typeCheckedFromSettings("autobanSuccessfulConnections", bBanSuccessful);
+	banIPv4PrefixLength = typeCheckedFromSettings("autobanIPv4Prefix", banIPv4PrefixLength);
+	banIPv6PrefixLength = typeCheckedFromSettings("autobanIPv6Prefix", banIPv6PrefixLength);
+	banTableSize        = typeCheckedFromSettings("autobanTableSize", banTableSize);
 
 	m_suggestVersion = Version::fromConfig(qsSettings->value("suggestVersion"));
 
@@ -346,6 +383,32 @@ void MetaParams::read(QString fname) {
 
 	rollingStatsWindow = typeCheckedFromSettings("rollingStatsWindow", rollingStatsWindow);
 
+	voiceThreads = std::max(typeCheckedFromSettings("voicethreads", voiceThreads), 1u);
+	useIOUring   = typeCheckedFromSettings("iouring", useIOUring);
+
+	qsVoiceStatsFile   = typeCheckedFromSettings("voicestatsfile", qsVoiceStatsFile);
+	voiceStatsInterval = std::max(typeCheckedFromSettings("voicestatsinterval", voiceStatsInterval), 1u);
+
+	connectionThreads = typeCheckedFromSettings("tlsthreads", connectionThreads);
+
+	passwordHashThreads    = typeCheckedFromSettings("passwordhashthreads", passwordHashThreads);
+	passwordHashQueueLimit = typeCheckedFromSettings("passwordhashqueue", passwordHashQueueLimit);
+
+	dbWriteQueueSize = typeCheckedFromSettings("dbwritequeue", dbWriteQueueSize);
+
+	registeredUserIndex = typeCheckedFromSettings("registereduserindex", registeredUserIndex);
+
+	iceCallbackQueue      = typeCheckedFromSettings("icecallbackqueue", iceCallbackQueue);
+	iceCallbackThreads    = std::max(typeCheckedFromSettings("icecallbackthreads", iceCallbackThreads), 1u);
+	iceCallbackCoalesce   = typeCheckedFromSettings("icecallbackcoalesce", iceCallbackCoalesce);
+	iceCallbackDisconnect = typeCheckedFromSettings("icecallbackdisconnect", iceCallbackDisconnect);
+
+	authenticatorConcurrency = typeCheckedFromSettings("authenticatorconcurrency", authenticatorConcurrency);
+	authenticatorQueueLimit  = typeCheckedFromSettings("authenticatorqueue", authenticatorQueueLimit);
+	authenticatorCacheTTL    = typeCheckedFromSettings("authenticatorcachettl", authenticatorCacheTTL);
+
+	tcpWriteDelay = typeCheckedFromSettings("tcpwritedelay", tcpWriteDelay);
+
 	iOpusThreshold = typeCheckedFromSettings("opusthreshold", iOpusThreshold);
 
 	iChannelNestingLimit = typeCheckedFromSettings("channelnestinglimit", iChannelNestingLimit);
@@ -665,6 +728,34 @@ Meta::Meta(const ::mumble::db::ConnectionParameter &connectParam) : dbWrapper(co
 			Connection::setQoS(hQoS);
 	}
 #endif
+
+	if (!mp->qsVoiceStatsFile.isEmpty()) {
+		connect(&qtVoiceStats, &QTimer::timeout, this, &Meta::writeVoiceStatistics);
+		qtVoiceStats.start(std::chrono::seconds(mp->voiceStatsInterval));
+	}
+
+	connectionThreads = std::make_unique< ConnectionThreadPool >(mp->connectionThreads);
+	passwordHashes    = std::make_unique< PasswordHashPool >(mp->passwordHashThreads, mp->passwordHashQueueLimit);
+
+	if (mp->dbWriteQueueSize > 0) {
+		dbWriteQueue = std::make_unique< DBWriteQueue >(
+			[&connectParam]() -> DBWriteQueue::Writer {
+				// The queue uses its own database connection
+				auto wrapper = std::make_shared< DBWrapper >(connectParam);
+				return [wrapper](const std::vector< DBWrite > &writes) { wrapper->performWrites(writes); };
+			},
+			mp->dbWriteQueueSize);
+	}
+
+	ConnectionRateLimiter::Parameters banParameters;
+	banParameters.attempts         = static_cast< unsigned int >(std::max(mp->iBanTries, 0));
+	banParameters.timeframe        = std::chrono::seconds(std::max(mp->iBanTimeframe, 0));
+	banParameters.banTime          = std::chrono::seconds(mp->iBanTime);
+	banParameters.ipv4PrefixLength = mp->banIPv4PrefixLength;
+	banParameters.ipv6PrefixLength = mp->banIPv6PrefixLength;
+	banParameters.capacity         = mp->banTableSize;
+
+	connectionLimiter = std::make_unique< ConnectionRateLimiter >(banParameters);
 }
 
 Meta::~Meta() {
@@ -956,39 +1047,43 @@ void Meta::killAll() {
 	qhServers.clear();
 }
 
-void Meta::successfulConnectionFrom(const QHostAddress &addr) {
-	if (!mp->bBanSuccessful) {
-		QList< Timer > &ql = qhAttempts[addr];
-		// Seems like this is the most efficient way to clear the list, given:
-		// 1. ql.clear() allocates a new array
-		// 2. ql has less than iBanAttempts members
-		// 3. seems like ql.removeFirst() might actually copy elements to shift to the front
-		while (!ql.empty()) {
-			ql.removeLast();
-		}
+void Meta::writeVoiceStatistics() {
+	std::vector< const Server * > servers;
+	for (const Server *server : qhServers) {
+		servers.push_back(server);
 	}
-}
-
-bool Meta::banCheck(const QHostAddress &addr) {
-	if ((mp->iBanTries <= 0) || (mp->iBanTimeframe <= 0))
-		return false;
-
-	if (qhBans.contains(addr)) {
-		Timer t = qhBans.value(addr);
-		if (t.elapsed() < std::chrono::seconds(mp->iBanTime))
-			return true;
-		qhBans.remove(addr);
+	std::sort(servers.begin(), servers.end(),
+			  [](const Server *lhs, const Server *rhs) { return lhs->iServerNum < rhs->iServerNum; });
+
+	PrometheusWriter writer;
+	Server::writeStatistics(writer, servers);
+	passwordHashes->writeStatistics(writer);
+	if (dbWriteQueue) {
+		dbWriteQueue->writeStatistics(writer);
+	}
+	if (iceCallbacks) {
+		iceCallbacks->writeStatistics(writer, "murmur_ice_callback");
 	}
+	connectionLimiter->writeStatistics(writer);
 
-	QList< Timer > &ql = qhAttempts[addr];
+	const std::string &text = writer.text();
 
-	ql.append(Timer());
-	while (!ql.isEmpty() && (ql.at(0).elapsed() > std::chrono::seconds(mp->iBanTimeframe)))
-		ql.removeFirst();
+	// Scrapers (e.g. the textfile collector of the Prometheus node exporter) must never see a partially written file,
+	// so the new contents are written to a temporary file that then replaces the old one.
+	QSaveFile file(mp->qsVoiceStatsFile);
+	if (!file.open(QIODevice::WriteOnly) || file.write(text.data(), static_cast< qint64 >(text.size())) < 0
+		|| !file.commit()) {
+		qWarning("Meta: Failed to write voice statistics to %s: %s", qPrintable(mp->qsVoiceStatsFile),
+				 qPrintable(file.errorString()));
+	}
+}
 
-	if (ql.count() > mp->iBanTries) {
-		qhBans.insert(addr, Timer());
-		return true;
+void Meta::successfulConnectionFrom(const QHostAddress &addr) {
+	if (!mp->bBanSuccessful) {
+		connectionLimiter->reset(HostAddress(addr));
 	}
-	return false;
+}
+
+bool Meta::banCheck(const QHostAddress &addr) {
+	return connectionLimiter->check(HostAddress(addr));
 }
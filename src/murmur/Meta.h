@@ -6,8 +6,13 @@
 #ifndef MUMBLE_MURMUR_META_H_
 #define MUMBLE_MURMUR_META_H_
 
+#include "CallbackDispatcher.h"
+#include "ConnectionRateLimiter.h"
+#include "ConnectionThreadPool.h"
 #include "DBState.h"
 #include "DBWrapper.h"
+#include "DBWriteQueue.h"
+#include "PasswordHashPool.h"
 #include "Timer.h"
 #include "Version.h"
 
@@ -20,6 +25,7 @@
 #include <QtCore/QDir>
 #include <QtCore/QList>
 #include <QtCore/QRegularExpression>
+#include <QtCore/QTimer>
 #include <QtCore/QUrl>
 #include <QtCore/QVariant>
 #include <QtNetwork/QHostAddress>
@@ -72,6 +78,12 @@ public:
 	int iBanTimeframe;
 	int iBanTime;
 	bool bBanSuccessful;
+	/// The length of the prefix of IPv4 addresses whose connection attempts are counted together for the autoban
+	unsigned int banIPv4PrefixLength;
+	/// The length of the prefix of IPv6 addresses whose connection attempts are counted together for the autoban
+	unsigned int banIPv6PrefixLength;
+	/// The maximum number of networks whose connection attempts are tracked for the autoban
+	unsigned int banTableSize;
 
 	QString qsDatabase;
 	int iSQLiteWAL;
@@ -161,6 +173,60 @@ public:
 	/// The number of seconds to keep rolling stats for per client
 	unsigned int rollingStatsWindow;
 
+	/// The number of threads used for receiving and routing UDP voice packets
+	unsigned int voiceThreads;
+
+	/// Whether the voice threads should use io_uring for UDP I/O (only available on Linux, if built with io_uring
+	/// support)
+	bool useIOUring;
+
+	/// The file the voice statistics of all virtual servers, along with those of the server-wide facilities, are
+	/// periodically written to (in the Prometheus text exposition format). Empty, if the statistics should not be
+	/// written to a file.
+	QString qsVoiceStatsFile;
+	/// The number of seconds between two updates of qsVoiceStatsFile
+	unsigned int voiceStatsInterval;
+
+	/// The number of threads handling the TLS connections of clients (0 means that they are handled by the main
+	/// thread)
+	unsigned int connectionThreads;
+
+	/// The number of threads computing password hashes for logins (0 means that they are computed by the main thread)
+	unsigned int passwordHashThreads;
+	/// The maximum number of logins that may wait for their password hash at the same time
+	unsigned int passwordHashQueueLimit;
+
+	/// The maximum number of database writes that may be queued for being performed in the background (0 means that
+	/// they are performed synchronously)
+	unsigned int dbWriteQueueSize;
+
+	/// Whether the registered users of every virtual server are kept in an in-memory index, which is used for looking
+	/// them up during authentication (instead of querying the database)
+	bool registeredUserIndex;
+
+	/// The maximum number of calls that may be queued per Ice ServerCallback (0 means that the callbacks are invoked
+	/// synchronously by the main thread)
+	unsigned int iceCallbackQueue;
+	/// The number of threads invoking the Ice ServerCallbacks
+	unsigned int iceCallbackThreads;
+	/// Whether queued state change notifications about the same user or channel are merged
+	bool iceCallbackCoalesce;
+	/// Whether an Ice ServerCallback whose queue overflows is removed (instead of queued state changes being dropped)
+	bool iceCallbackDisconnect;
+
+	/// The maximum number of requests to an external authenticator that are in progress at the same time (0 means
+	/// that the authenticator is called synchronously by the main thread)
+	unsigned int authenticatorConcurrency;
+	/// The maximum number of requests that may wait for being sent to an external authenticator. Logins beyond that
+	/// are rejected.
+	unsigned int authenticatorQueueLimit;
+	/// The number of seconds successful authentications by an external authenticator are remembered (0 disables this)
+	unsigned int authenticatorCacheTTL;
+
+	/// The maximum number of milliseconds that messages to a client are held back in order to write them to the
+	/// connection together with the ones that follow (negative means that every message is written on its own)
+	int tcpWriteDelay;
+
 	/// qsAbsSettingsFilePath is the absolute path to
 	/// the murmur.ini used by this Meta instance.
 	QString qsAbsSettingsFilePath;
@@ -189,8 +255,6 @@ private:
 public:
 	static std::unique_ptr< MetaParams > mp;
 	QHash< unsigned int, Server * > qhServers;
-	QHash< QHostAddress, QList< Timer > > qhAttempts;
-	QHash< QHostAddress, Timer > qhBans;
 	QString qsOS, qsOSVersion;
 	Timer tUptime;
 
@@ -198,6 +262,24 @@ public:
 
 	DBState assumedDBState = DBState::Normal;
 
+	/// Triggers writeVoiceStatistics() (only active if MetaParams::qsVoiceStatsFile is set)
+	QTimer qtVoiceStats;
+
+	/// The threads the client connections of all virtual servers are distributed across
+	std::unique_ptr< ConnectionThreadPool > connectionThreads;
+
+	/// Computes the password hashes for the logins of all virtual servers
+	std::unique_ptr< PasswordHashPool > passwordHashes;
+
+	/// Performs log and bookkeeping writes of all virtual servers in the background. Null if disabled.
+	std::unique_ptr< DBWriteQueue > dbWriteQueue;
+
+	/// Invokes the Ice ServerCallbacks of all virtual servers. Set up by the Ice module, null if disabled.
+	std::unique_ptr< CallbackDispatcher > iceCallbacks;
+
+	/// Tracks the connection attempts to all virtual servers for the global autoban
+	std::unique_ptr< ConnectionRateLimiter > connectionLimiter;
+
 #ifdef Q_OS_WIN
 	static HANDLE hQoS;
 #endif
@@ -226,6 +308,9 @@ public:
 	void killAll();
 	void getOSInfo();
 	void connectListener(QObject *);
+	/// Writes the statistics of all booted virtual servers and of the server-wide facilities (e.g. the database write
+	/// queue) to MetaParams::qsVoiceStatsFile
+	void writeVoiceStatistics();
 	static void getVersion(Version::component_t &major, Version::component_t &minor, Version::component_t &patch,
 						   QString &string);
 signals:
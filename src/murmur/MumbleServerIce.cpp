@@ -18,6 +18,7 @@
 #include "ServerUserInfo.h"
 #include "User.h"
 #include "Utils.h"
+#include "VoiceStats.h"
 
 #include "murmur/database/ChronoUtils.h"
 #include "murmur/database/UserProperty.h"
@@ -32,10 +33,12 @@
 #include <Ice/SliceChecksums.h>
 #include <IceUtil/IceUtil.h>
 
+#include <algorithm>
 #include <cassert>
 #include <chrono>
 #include <limits>
 #include <sstream>
+#include <vector>
 
 using namespace std;
 using namespace MumbleServer;
@@ -253,6 +256,50 @@ static void textmessageToTextmessage(const ::TextMessage &tm, ::MumbleServer::Te
 	}
 }
 
+static ::MumbleServer::CertificateList certificatesToCertificateList(const QList< QSslCertificate > &certlist) {
+	::MumbleServer::CertificateList certs;
+	certs.reserve(static_cast< std::size_t >(certlist.size()));
+
+	for (const QSslCertificate &cert : certlist) {
+		const QByteArray qba     = cert.toDer();
+		const unsigned char *ptr = reinterpret_cast< const unsigned char * >(qba.constData());
+		certs.emplace_back(ptr, ptr + qba.size());
+	}
+
+	return certs;
+}
+
+/// Receives the answer to an asynchronous ServerAuthenticator::authenticate() call on one of Ice's threads and hands it
+/// over to the main thread
+class AuthenticateCallback : public IceUtil::Shared {
+public:
+	AuthenticateCallback(MumbleServerIce *ice, const MumbleServerIce::PendingAuthentication &authentication)
+		: m_ice(ice), m_authentication(authentication) {}
+
+	void response(::Ice::Int res, const ::std::string &newname, const ::MumbleServer::GroupNameList &groups) {
+		finish(true, res, newname, groups);
+	}
+
+	void exception(const ::Ice::Exception &) { finish(false, -2, ::std::string(), ::MumbleServer::GroupNameList()); }
+
+private:
+	MumbleServerIce *m_ice;
+	MumbleServerIce::PendingAuthentication m_authentication;
+
+	void finish(bool success, int res, const ::std::string &newname, const ::MumbleServer::GroupNameList &groups) {
+		MumbleServerIce *ice                                  = m_ice;
+		const MumbleServerIce::PendingAuthentication &pending = m_authentication;
+
+		QMetaObject::invokeMethod(
+			ice,
+			[ice, pending, success, res, newname, groups]() {
+				ice->finishAuthentication(pending, success, res, newname, groups);
+			},
+			Qt::QueuedConnection);
+	}
+};
+typedef IceUtil::Handle< AuthenticateCallback > AuthenticateCallbackPtr;
+
 ::MumbleServer::DBState dbstateToDBState(::DBState state) {
 	switch (state) {
 		case ::DBState::Normal:
@@ -332,6 +379,22 @@ MumbleServerIce::MumbleServerIce() {
 			qWarning("MumbleServerIce: Endpoint \"%s\" running", qPrintable(u8(ep->toString())));
 		}
 
+		if (::Meta::mp->iceCallbackQueue > 0) {
+			CallbackDispatcher::Parameters params;
+			params.queueLimit           = static_cast< std::size_t >(::Meta::mp->iceCallbackQueue);
+			params.coalesce             = ::Meta::mp->iceCallbackCoalesce;
+			params.disconnectOnOverflow = ::Meta::mp->iceCallbackDisconnect;
+			params.threads              = static_cast< unsigned int >(::Meta::mp->iceCallbackThreads);
+
+			meta->iceCallbacks = std::make_unique< CallbackDispatcher >(
+				params, [this](unsigned int consumer, CallbackDispatcher::Failure failure) {
+					// Called on one of the dispatcher's threads
+					QMetaObject::invokeMethod(
+						this, [this, consumer, failure]() { serverCallbackFailed(consumer, failure); },
+						Qt::QueuedConnection);
+				});
+		}
+
 		meta->connectListener(this);
 	} catch (Ice::Exception &e) {
 		std::stringstream stream;
@@ -348,6 +411,8 @@ MumbleServerIce::~MumbleServerIce() {
 		communicator = nullptr;
 		qWarning("MumbleServerIce: Shutdown complete");
 	}
+	// Destroying the communicator has aborted the callback invocations that were still in progress
+	meta->iceCallbacks.reset();
 	iopServer = nullptr;
 }
 
@@ -366,12 +431,60 @@ void MumbleServerIce::badServerProxy(const ::MumbleServer::ServerCallbackPrx &pr
 	removeServerCallback(server, prx);
 }
 
+void MumbleServerIce::dispatchServerCallbacks(
+	const ::Server *server, const std::function< void(const ::MumbleServer::ServerCallbackPrx &) > &invoke,
+	std::optional< std::uint64_t > key, bool coalescable) {
+	// Copy, as a failing callback is removed from the list
+	const QList< ServerCallback > callbacks = qmServerCallbacks.value(server->iServerNum);
+
+	for (const ServerCallback &cb : callbacks) {
+		if (meta->iceCallbacks) {
+			::MumbleServer::ServerCallbackPrx prx = cb.prx;
+			meta->iceCallbacks->enqueue(
+				cb.consumer, [invoke, prx]() { invoke(prx); }, key, coalescable);
+		} else {
+			try {
+				invoke(cb.prx);
+			} catch (...) {
+				badServerProxy(cb.prx, server);
+			}
+		}
+	}
+}
+
+void MumbleServerIce::serverCallbackFailed(unsigned int consumer, CallbackDispatcher::Failure failure) {
+	for (auto it = qmServerCallbacks.cbegin(); it != qmServerCallbacks.cend(); ++it) {
+		for (const ServerCallback &cb : it.value()) {
+			if (cb.consumer != consumer) {
+				continue;
+			}
+
+			const ::Server *server = meta->qhServers.value(it.key());
+			if (!server) {
+				return;
+			}
+
+			const ::MumbleServer::ServerCallbackPrx prx = cb.prx;
+			if (failure == CallbackDispatcher::Failure::QueueOverflow) {
+				server->log(QString("Ice ServerCallback %1 can't keep up with the server's events")
+								.arg(QString::fromStdString(communicator->proxyToString(prx))));
+				removeServerCallback(server, prx);
+			} else {
+				badServerProxy(prx, server);
+			}
+			return;
+		}
+	}
+}
+
 void MumbleServerIce::badAuthenticator(::Server *server) {
 	server->disconnectAuthenticator(this);
-	const ::MumbleServer::ServerAuthenticatorPrx &prx = qmServerAuthenticator.value(server->iServerNum);
+	const ::MumbleServer::ServerAuthenticatorPrx prx = qmServerAuthenticator.value(server->iServerNum);
 	server->log(QString("Ice Authenticator %1 failed").arg(QString::fromStdString(communicator->proxyToString(prx))));
 	removeServerAuthenticator(server);
 	removeServerUpdatingAuthenticator(server);
+
+	failWaitingAuthentications(server, prx);
 }
 
 void MumbleServerIce::addMetaCallback(const ::MumbleServer::MetaCallbackPrx &prx) {
@@ -388,17 +501,41 @@ void MumbleServerIce::removeMetaCallback(const ::MumbleServer::MetaCallbackPrx &
 }
 
 void MumbleServerIce::addServerCallback(const ::Server *server, const ::MumbleServer::ServerCallbackPrx &prx) {
-	QList<::MumbleServer::ServerCallbackPrx > &cbList = qmServerCallbacks[server->iServerNum];
+	QList< ServerCallback > &cbList = qmServerCallbacks[server->iServerNum];
 
-	if (!cbList.contains(prx)) {
-		server->log(
-			QString("Added Ice ServerCallback %1").arg(QString::fromStdString(communicator->proxyToString(prx))));
-		cbList.append(prx);
+	for (const ServerCallback &cb : cbList) {
+		if (cb.prx == prx) {
+			return;
+		}
+	}
+
+	server->log(QString("Added Ice ServerCallback %1").arg(QString::fromStdString(communicator->proxyToString(prx))));
+
+	ServerCallback cb;
+	cb.prx = prx;
+	if (meta->iceCallbacks) {
+		cb.consumer = meta->iceCallbacks->addConsumer();
 	}
+	cbList.append(cb);
 }
 
 void MumbleServerIce::removeServerCallback(const ::Server *server, const ::MumbleServer::ServerCallbackPrx &prx) {
-	if (qmServerCallbacks[server->iServerNum].removeAll(prx)) {
+	QList< ServerCallback > &cbList = qmServerCallbacks[server->iServerNum];
+
+	bool removed = false;
+	for (auto it = cbList.begin(); it != cbList.end();) {
+		if (it->prx == prx) {
+			if (meta->iceCallbacks) {
+				meta->iceCallbacks->removeConsumer(it->consumer);
+			}
+			it      = cbList.erase(it);
+			removed = true;
+		} else {
+			++it;
+		}
+	}
+
+	if (removed) {
 		server->log(
 			QString("Removed Ice ServerCallback %1").arg(QString::fromStdString(communicator->proxyToString(prx))));
 	}
@@ -407,6 +544,11 @@ void MumbleServerIce::removeServerCallback(const ::Server *server, const ::Mumbl
 void MumbleServerIce::removeServerCallbacks(const ::Server *server) {
 	if (qmServerCallbacks.contains(server->iServerNum)) {
 		server->log(QString("Removed all Ice ServerCallbacks"));
+		if (meta->iceCallbacks) {
+			for (const ServerCallback &cb : qmServerCallbacks.value(server->iServerNum)) {
+				meta->iceCallbacks->removeConsumer(cb.consumer);
+			}
+		}
 		qmServerCallbacks.remove(server->iServerNum);
 	}
 }
@@ -525,24 +667,27 @@ void MumbleServerIce::stopped(::Server *s) {
 	}
 }
 
+/// @returns The key identifying callback invocations about the given user in Meta::iceCallbacks
+static std::uint64_t userKey(const ::User *p) {
+	return p->uiSession;
+}
+
+/// @returns The key identifying callback invocations about the given channel in Meta::iceCallbacks
+static std::uint64_t channelKey(const ::Channel *c) {
+	return (static_cast< std::uint64_t >(1) << 32) | c->iId;
+}
+
 void MumbleServerIce::userConnected(const ::User *p) {
 	::Server *s = qobject_cast<::Server * >(sender());
 
-	const QList<::MumbleServer::ServerCallbackPrx > &qmList = qmServerCallbacks[s->iServerNum];
-
-	if (qmList.isEmpty())
+	if (qmServerCallbacks.value(s->iServerNum).isEmpty())
 		return;
 
 	::MumbleServer::User mp;
 	userToUser(p, mp);
 
-	for (const ::MumbleServer::ServerCallbackPrx &prx : qmList) {
-		try {
-			prx->userConnected(mp);
-		} catch (...) {
-			badServerProxy(prx, s);
-		}
-	}
+	dispatchServerCallbacks(
+		s, [mp](const ::MumbleServer::ServerCallbackPrx &prx) { prx->userConnected(mp); }, userKey(p));
 }
 
 void MumbleServerIce::userDisconnected(const ::User *p) {
@@ -550,49 +695,33 @@ void MumbleServerIce::userDisconnected(const ::User *p) {
 
 	qmServerContextCallbacks[s->iServerNum].remove(static_cast< int >(p->uiSession));
 
-	const QList<::MumbleServer::ServerCallbackPrx > &qmList = qmServerCallbacks[s->iServerNum];
-
-	if (qmList.isEmpty())
+	if (qmServerCallbacks.value(s->iServerNum).isEmpty())
 		return;
 
 	::MumbleServer::User mp;
 	userToUser(p, mp);
 
-	for (const ::MumbleServer::ServerCallbackPrx &prx : qmList) {
-		try {
-			prx->userDisconnected(mp);
-		} catch (...) {
-			badServerProxy(prx, s);
-		}
-	}
+	dispatchServerCallbacks(
+		s, [mp](const ::MumbleServer::ServerCallbackPrx &prx) { prx->userDisconnected(mp); }, userKey(p));
 }
 
 void MumbleServerIce::userStateChanged(const ::User *p) {
 	::Server *s = qobject_cast<::Server * >(sender());
 
-	const QList<::MumbleServer::ServerCallbackPrx > &qmList = qmServerCallbacks[s->iServerNum];
-
-	if (qmList.isEmpty())
+	if (qmServerCallbacks.value(s->iServerNum).isEmpty())
 		return;
 
 	::MumbleServer::User mp;
 	userToUser(p, mp);
 
-	for (const ::MumbleServer::ServerCallbackPrx &prx : qmList) {
-		try {
-			prx->userStateChanged(mp);
-		} catch (...) {
-			badServerProxy(prx, s);
-		}
-	}
+	dispatchServerCallbacks(
+		s, [mp](const ::MumbleServer::ServerCallbackPrx &prx) { prx->userStateChanged(mp); }, userKey(p), true);
 }
 
 void MumbleServerIce::userTextMessage(const ::User *p, const ::TextMessage &message) {
 	::Server *s = qobject_cast<::Server * >(sender());
 
-	const QList<::MumbleServer::ServerCallbackPrx > &qmList = qmServerCallbacks[s->iServerNum];
-
-	if (qmList.isEmpty())
+	if (qmServerCallbacks.value(s->iServerNum).isEmpty())
 		return;
 
 	::MumbleServer::User mp;
@@ -601,73 +730,47 @@ void MumbleServerIce::userTextMessage(const ::User *p, const ::TextMessage &mess
 	::MumbleServer::TextMessage textMessage;
 	textmessageToTextmessage(message, textMessage);
 
-	for (const ::MumbleServer::ServerCallbackPrx &prx : qmList) {
-		try {
-			prx->userTextMessage(mp, textMessage);
-		} catch (...) {
-			badServerProxy(prx, s);
-		}
-	}
+	dispatchServerCallbacks(
+		s, [mp, textMessage](const ::MumbleServer::ServerCallbackPrx &prx) { prx->userTextMessage(mp, textMessage); });
 }
 
 void MumbleServerIce::channelCreated(const ::Channel *c) {
 	::Server *s = qobject_cast<::Server * >(sender());
 
-	const QList<::MumbleServer::ServerCallbackPrx > &qmList = qmServerCallbacks[s->iServerNum];
-
-	if (qmList.isEmpty())
+	if (qmServerCallbacks.value(s->iServerNum).isEmpty())
 		return;
 
 	::MumbleServer::Channel mc;
 	channelToChannel(c, mc);
 
-	for (const ::MumbleServer::ServerCallbackPrx &prx : qmList) {
-		try {
-			prx->channelCreated(mc);
-		} catch (...) {
-			badServerProxy(prx, s);
-		}
-	}
+	dispatchServerCallbacks(
+		s, [mc](const ::MumbleServer::ServerCallbackPrx &prx) { prx->channelCreated(mc); }, channelKey(c));
 }
 
 void MumbleServerIce::channelRemoved(const ::Channel *c) {
 	::Server *s = qobject_cast<::Server * >(sender());
 
-	const QList<::MumbleServer::ServerCallbackPrx > &qmList = qmServerCallbacks[s->iServerNum];
-
-	if (qmList.isEmpty())
+	if (qmServerCallbacks.value(s->iServerNum).isEmpty())
 		return;
 
 	::MumbleServer::Channel mc;
 	channelToChannel(c, mc);
 
-	for (const ::MumbleServer::ServerCallbackPrx &prx : qmList) {
-		try {
-			prx->channelRemoved(mc);
-		} catch (...) {
-			badServerProxy(prx, s);
-		}
-	}
+	dispatchServerCallbacks(
+		s, [mc](const ::MumbleServer::ServerCallbackPrx &prx) { prx->channelRemoved(mc); }, channelKey(c));
 }
 
 void MumbleServerIce::channelStateChanged(const ::Channel *c) {
 	::Server *s = qobject_cast<::Server * >(sender());
 
-	const QList<::MumbleServer::ServerCallbackPrx > &qmList = qmServerCallbacks[s->iServerNum];
-
-	if (qmList.isEmpty())
+	if (qmServerCallbacks.value(s->iServerNum).isEmpty())
 		return;
 
 	::MumbleServer::Channel mc;
 	channelToChannel(c, mc);
 
-	for (const ::MumbleServer::ServerCallbackPrx &prx : qmList) {
-		try {
-			prx->channelStateChanged(mc);
-		} catch (...) {
-			badServerProxy(prx, s);
-		}
-	}
+	dispatchServerCallbacks(
+		s, [mc](const ::MumbleServer::ServerCallbackPrx &prx) { prx->channelStateChanged(mc); }, channelKey(c), true);
 }
 
 void MumbleServerIce::contextAction(const ::User *pSrc, const QString &action, unsigned int session, int iChannel) {
@@ -754,18 +857,7 @@ void MumbleServerIce::authenticateSlot(int &res, QString &uname, int sessionId,
 	const ServerAuthenticatorPrx prx = getServerAuthenticator(server);
 	::std::string newname;
 	::MumbleServer::GroupNameList groups;
-	::MumbleServer::CertificateList certs;
-
-	certs.resize(static_cast< std::size_t >(certlist.size()));
-	for (int i = 0; i < certlist.size(); ++i) {
-		::MumbleServer::CertificateDer der;
-		QByteArray qba = certlist.at(i).toDer();
-		der.resize(static_cast< std::size_t >(qba.size()));
-		const char *ptr = qba.constData();
-		for (int j = 0; j < qba.size(); ++j)
-			der[static_cast< std::size_t >(j)] = static_cast< unsigned char >(ptr[j]);
-		certs[static_cast< std::size_t >(i)] = der;
-	}
+	const ::MumbleServer::CertificateList certs = certificatesToCertificateList(certlist);
 
 	try {
 		res =
@@ -785,6 +877,135 @@ void MumbleServerIce::authenticateSlot(int &res, QString &uname, int sessionId,
 	}
 }
 
+void MumbleServerIce::authenticateAsyncSlot(ExternalAuthenticationRequest &request, ServerUser *user,
+											const QString &uname, const QList< QSslCertificate > &certlist,
+											const QString &certhash, bool certstrong, const QString &pw,
+											const ExternalAuthenticationCallback &done) {
+	if (::Meta::mp->authenticatorConcurrency == 0) {
+		// authenticateSlot is going to be used instead
+		return;
+	}
+
+	::Server *server = qobject_cast<::Server * >(sender());
+
+	PendingAuthentication authentication;
+	authentication.prx = getServerAuthenticator(server);
+	if (!authentication.prx) {
+		return;
+	}
+
+	if (m_authenticationsInProgress >= ::Meta::mp->authenticatorConcurrency
+		&& m_waitingAuthentications.size() >= ::Meta::mp->authenticatorQueueLimit) {
+		// Requests of users that have disconnected in the meantime don't count
+		pruneWaitingAuthentications();
+
+		if (m_waitingAuthentications.size() >= ::Meta::mp->authenticatorQueueLimit) {
+			request = ExternalAuthenticationRequest::Rejected;
+			return;
+		}
+	}
+
+	authentication.server     = server;
+	authentication.user       = user;
+	authentication.name       = iceString(uname);
+	authentication.password   = iceString(pw);
+	authentication.certs      = certificatesToCertificateList(certlist);
+	authentication.certhash   = iceString(certhash);
+	authentication.certstrong = certstrong;
+	authentication.done       = done;
+
+	m_waitingAuthentications.push_back(std::move(authentication));
+	request = ExternalAuthenticationRequest::Started;
+
+	startAuthentications();
+}
+
+void MumbleServerIce::startAuthentications() {
+	while (m_authenticationsInProgress < ::Meta::mp->authenticatorConcurrency && !m_waitingAuthentications.empty()) {
+		PendingAuthentication authentication = std::move(m_waitingAuthentications.front());
+		m_waitingAuthentications.pop_front();
+
+		if (!authentication.server || !authentication.user) {
+			// The server has been stopped or the user has disconnected in the meantime
+			continue;
+		}
+
+		m_authenticationsInProgress++;
+
+		AuthenticateCallbackPtr callback = new AuthenticateCallback(this, authentication);
+		try {
+			authentication.prx->begin_authenticate(
+				authentication.name, authentication.password, authentication.certs, authentication.certhash,
+				authentication.certstrong,
+				::MumbleServer::newCallback_ServerAuthenticator_authenticate(callback, &AuthenticateCallback::response,
+																			 &AuthenticateCallback::exception));
+		} catch (const ::Ice::Exception &e) {
+			// Usually, failures are reported to the callback later on, but e.g. a communicator that is being shut down
+			// is reported right away
+			callback->exception(e);
+		}
+	}
+}
+
+void MumbleServerIce::pruneWaitingAuthentications() {
+	m_waitingAuthentications.erase(std::remove_if(m_waitingAuthentications.begin(), m_waitingAuthentications.end(),
+												  [](const PendingAuthentication &authentication) {
+													  return !authentication.server || !authentication.user;
+												  }),
+								   m_waitingAuthentications.end());
+}
+
+void MumbleServerIce::failWaitingAuthentications(const ::Server *server,
+												  const ::MumbleServer::ServerAuthenticatorPrx &prx) {
+	std::vector< PendingAuthentication > failed;
+	for (auto it = m_waitingAuthentications.begin(); it != m_waitingAuthentications.end();) {
+		if (it->server == server && it->prx == prx) {
+			failed.push_back(std::move(*it));
+			it = m_waitingAuthentications.erase(it);
+		} else {
+			++it;
+		}
+	}
+
+	// The callbacks may lead to new requests, so they are only invoked once the queue is consistent again
+	ExternalAuthenticationResult result;
+	result.failed = true;
+	for (const PendingAuthentication &authentication : failed) {
+		if (authentication.server && authentication.user) {
+			authentication.done(result);
+		}
+	}
+}
+
+void MumbleServerIce::finishAuthentication(const PendingAuthentication &authentication, bool success, int res,
+										   const std::string &newname, const ::MumbleServer::GroupNameList &groups) {
+	m_authenticationsInProgress--;
+
+	ExternalAuthenticationResult result;
+	if (!success) {
+		result.failed = true;
+
+		// Unless it has been replaced in the meantime, the authenticator is broken
+		if (authentication.server && getServerAuthenticator(authentication.server) == authentication.prx) {
+			badAuthenticator(authentication.server);
+		}
+	} else {
+		result.userID = res;
+		if (res >= 0) {
+			result.name = u8(newname);
+			for (const ::std::string &str : groups) {
+				result.groups << u8(str);
+			}
+		}
+	}
+
+	if (authentication.server) {
+		authentication.done(result);
+	}
+
+	startAuthentications();
+}
+
 void MumbleServerIce::registerUserSlot(int &res, const QMap< int, QString > &info) {
 	::Server *server = qobject_cast<::Server * >(sender());
 
@@ -1173,6 +1394,9 @@ static void impl_Server_getLog(const ::MumbleServer::AMD_Server_getLogPtr cb, in
 
 	::MumbleServer::LogList ll;
 
+	if (meta->dbWriteQueue) {
+		meta->dbWriteQueue->flush();
+	}
 	std::vector< mumble::server::db::DBLogEntry > dblog = server->m_dbWrapper.getLogs(
 		static_cast< unsigned int >(server_id), static_cast< unsigned int >(min), max - min);
 	for (const mumble::server::db::DBLogEntry &entry : dblog) {
@@ -1192,6 +1416,9 @@ static void impl_Server_getLogLen(const ::MumbleServer::AMD_Server_getLogLenPtr
 	VERIFY_DB_NOT_IN_READONLY;
 	NEED_SERVER_EXISTS;
 
+	if (meta->dbWriteQueue) {
+		meta->dbWriteQueue->flush();
+	}
 	std::size_t len = server->m_dbWrapper.getLogSize(static_cast< unsigned int >(server_id));
 	cb->ice_response(static_cast< Ice::Int >(len));
 
@@ -1736,13 +1963,13 @@ static void impl_Server_setACL(const ::MumbleServer::AMD_Server_setACLPtr cb, in
 			acl->bApplyHere = ai.applyHere;
 			acl->bApplySubs = ai.applySubs;
 			acl->iUserId    = ai.userid;
-			acl->qsGroup    = u8(ai.group);
 			acl->pDeny      = static_cast< ChanACL::Permissions >(ai.deny) & ChanACL::All;
 			acl->pAllow     = static_cast< ChanACL::Permissions >(ai.allow) & ChanACL::All;
+			acl->setGroup(u8(ai.group));
 		}
 	}
 
-	server->clearACLCache();
+	server->clearACLCacheFor(*channel);
 	if (!channel->bTemporary) {
 		server->m_dbWrapper.updateChannelData(server->iServerNum, *channel);
 	}
@@ -1861,6 +2088,9 @@ static void impl_Server_getRegistration(const ::MumbleServer::AMD_Server_getRegi
 	VERIFY_DB_NOT_IN_READONLY;
 	NEED_SERVER;
 
+	if (userid >= 0) {
+		server->flushDBWrites(static_cast< unsigned int >(userid));
+	}
 	QMap< int, QString > info = server->getUserProperties(userid);
 
 	if (info.isEmpty()) {
@@ -1984,6 +2214,55 @@ static void impl_Server_getUptime(const ::MumbleServer::AMD_Server_getUptimePtr
 	ICE_IMPL_END
 }
 
+#define ACCESS_Server_getVoiceStatistics_READ
+static void impl_Server_getVoiceStatistics(const ::MumbleServer::AMD_Server_getVoiceStatisticsPtr cb, int server_id) {
+	ICE_IMPL_BEGIN
+
+	NEED_SERVER;
+
+	const VoiceStats::Snapshot snapshot = server->getVoiceStatistics();
+
+	::MumbleServer::VoiceStatistics vs;
+	for (std::size_t i = 0; i < VoiceStats::STAGE_COUNT; ++i) {
+		const LatencyHistogram::Snapshot &stage = snapshot.stages[i];
+
+		::MumbleServer::VoiceStageStatistics vss;
+		vss.stage = VoiceStats::name(static_cast< VoiceStage >(i));
+		vss.count = static_cast< ::Ice::Long >(stage.count);
+		vss.sum   = static_cast< ::Ice::Long >(stage.sum);
+		vss.p50   = static_cast< ::Ice::Long >(stage.percentile(0.5));
+		vss.p90   = static_cast< ::Ice::Long >(stage.percentile(0.9));
+		vss.p99   = static_cast< ::Ice::Long >(stage.percentile(0.99));
+		vss.p999  = static_cast< ::Ice::Long >(stage.percentile(0.999));
+		vss.max   = static_cast< ::Ice::Long >(stage.max);
+		vs.stages.push_back(vss);
+	}
+	for (std::size_t i = 0; i < VoiceStats::DROP_COUNT; ++i) {
+		vs.drops[VoiceStats::name(static_cast< VoiceDrop >(i))] = static_cast< ::Ice::Long >(snapshot.drops[i]);
+	}
+	for (std::size_t i = 0; i < VoiceStats::COUNTER_COUNT; ++i) {
+		vs.counters[VoiceStats::name(static_cast< VoiceCounter >(i))] =
+			static_cast< ::Ice::Long >(snapshot.counters[i]);
+	}
+
+	cb->ice_response(vs);
+
+	ICE_IMPL_END
+}
+
+#define ACCESS_Server_getVoiceStatisticsText_READ
+static void impl_Server_getVoiceStatisticsText(const ::MumbleServer::AMD_Server_getVoiceStatisticsTextPtr cb,
+											   int server_id) {
+	ICE_IMPL_BEGIN
+
+	NEED_SERVER;
+	PrometheusWriter writer;
+	VoiceStats::writeStatistics(writer, { { server->iServerNum, server->getVoiceStatistics() } });
+	cb->ice_response(writer.text());
+
+	ICE_IMPL_END
+}
+
 static void impl_Server_updateCertificate(const ::MumbleServer::AMD_Server_updateCertificatePtr cb, int server_id,
 										  const ::std::string &certificate, const ::std::string &privateKey,
 										  const ::std::string &passphrase) {
@@ -2436,6 +2715,8 @@ static void impl_Meta_setAssumedDatabaseState(const ::MumbleServer::AMD_Meta_set
 #undef ACCESS_Server_verifyPassword_READ
 #undef ACCESS_Server_getTexture_READ
 #undef ACCESS_Server_getUptime_READ
+#undef ACCESS_Server_getVoiceStatistics_READ
+#undef ACCESS_Server_getVoiceStatisticsText_READ
 #undef ACCESS_Server_isListening_READ
 #undef ACCESS_Server_getListeningChannels_READ
 #undef ACCESS_Server_getListeningUsers_READ
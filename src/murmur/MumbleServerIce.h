@@ -17,9 +17,19 @@
 #include <QtCore/QMap>
 #include <QtCore/QMutex>
 #include <QtCore/QObject>
+#include <QtCore/QPointer>
 #include <QtCore/QWaitCondition>
 #include <QtNetwork/QSslCertificate>
 
+#include "AuthenticationResultCache.h"
+#include "CallbackDispatcher.h"
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <string>
+
 #ifndef Q_MOC_RUN
 // When including this header in MOC runs, Qt gets confused and adds every following class to the MumbleServer
 // namespace, which will lead to compile errors because they don't actually exist in that namespace.
@@ -29,11 +39,13 @@
 
 class Channel;
 class Server;
+class ServerUser;
 class User;
 struct TextMessage;
 
 class MumbleServerIce : public QObject {
 	friend class MurmurLocker;
+	friend class AuthenticateCallback;
 	Q_OBJECT
 
 protected:
@@ -44,13 +56,60 @@ protected:
 	void badMetaProxy(const ::MumbleServer::MetaCallbackPrx &prx);
 	void badServerProxy(const ::MumbleServer::ServerCallbackPrx &prx, const ::Server *server);
 	void badAuthenticator(::Server *);
+
+	struct ServerCallback {
+		::MumbleServer::ServerCallbackPrx prx;
+		/// The ID of the callback's consumer in Meta::iceCallbacks (unused if that is disabled)
+		unsigned int consumer = 0;
+	};
+
+	/// Invokes the given function for all ServerCallbacks of the given server. If Meta::iceCallbacks is enabled, the
+	/// invocations are queued there, otherwise they are performed right away.
+	///
+	/// @param key Identifies the user or channel the invocation is about (see CallbackDispatcher)
+	/// @param coalescable Whether the invocation may replace a queued one with the same key
+	void dispatchServerCallbacks(const ::Server *server,
+								 const std::function< void(const ::MumbleServer::ServerCallbackPrx &) > &invoke,
+								 std::optional< std::uint64_t > key = std::nullopt, bool coalescable = false);
+	/// Removes the ServerCallback belonging to the given consumer of Meta::iceCallbacks
+	void serverCallbackFailed(unsigned int consumer, CallbackDispatcher::Failure failure);
+
 	QList<::MumbleServer::MetaCallbackPrx > qlMetaCallbacks;
-	QMap< unsigned int, QList<::MumbleServer::ServerCallbackPrx > > qmServerCallbacks;
+	QMap< unsigned int, QList< ServerCallback > > qmServerCallbacks;
 	QMap< unsigned int, QMap< int, QMap< QString, ::MumbleServer::ServerContextCallbackPrx > > >
 		qmServerContextCallbacks;
 	QMap< unsigned int, ::MumbleServer::ServerAuthenticatorPrx > qmServerAuthenticator;
 	QMap< unsigned int, ::MumbleServer::ServerUpdatingAuthenticatorPrx > qmServerUpdatingAuthenticator;
 
+	/// A request to a ServerAuthenticator that is performed asynchronously (see authenticateAsyncSlot)
+	struct PendingAuthentication {
+		QPointer<::Server > server;
+		/// The user to be authenticated. Requests of users that are gone by the time it is their turn are not sent.
+		QPointer< ServerUser > user;
+		::MumbleServer::ServerAuthenticatorPrx prx;
+		std::string name;
+		std::string password;
+		::MumbleServer::CertificateList certs;
+		std::string certhash;
+		bool certstrong = false;
+		ExternalAuthenticationCallback done;
+	};
+	/// The requests waiting for the number of requests in progress to drop below Meta::mp->authenticatorConcurrency.
+	/// There are at most Meta::mp->authenticatorQueueLimit of them.
+	std::deque< PendingAuthentication > m_waitingAuthentications;
+	unsigned int m_authenticationsInProgress = 0;
+
+	/// Sends waiting requests to their authenticators as long as the concurrency limit permits
+	void startAuthentications();
+	/// Removes the waiting requests whose user or server is gone
+	void pruneWaitingAuthentications();
+	/// Fails the waiting requests to the given authenticator of the given server right away (instead of sending them to
+	/// an authenticator that is known to be broken)
+	void failWaitingAuthentications(const ::Server *server, const ::MumbleServer::ServerAuthenticatorPrx &prx);
+	/// Hands the authenticator's answer to the given request to the server. Called on the main thread.
+	void finishAuthentication(const PendingAuthentication &authentication, bool success, int res,
+							  const std::string &newname, const ::MumbleServer::GroupNameList &groups);
+
 public:
 	Ice::CommunicatorPtr communicator;
 	Ice::ObjectAdapterPtr adapter;
@@ -81,6 +140,9 @@ public slots:
 
 	void authenticateSlot(int &res, QString &uname, int sessionId, const QList< QSslCertificate > &certlist,
 						  const QString &certhash, bool certstrong, const QString &pw);
+	void authenticateAsyncSlot(ExternalAuthenticationRequest &request, ServerUser *user, const QString &uname,
+							   const QList< QSslCertificate > &certlist, const QString &certhash, bool certstrong,
+							   const QString &pw, const ExternalAuthenticationCallback &done);
 	void registerUserSlot(int &res, const QMap< int, QString > &);
 	void unregisterUserSlot(int &res, int id);
 	void getRegisteredUsersSlot(const QString &filter, QMap< int, QString > &res);
@@ -0,0 +1,68 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "PasswordHashPool.h"
+#include "PBKDF2.h"
+#include "PrometheusWriter.h"
+
+#include <QtCore/QMetaObject>
+
+PasswordHashPool::PasswordHashPool(unsigned int threadCount, unsigned int maxPending, QObject *parent)
+	: QObject(parent), m_enabled(threadCount > 0 && maxPending > 0), m_maxPending(maxPending) {
+	if (threadCount > 0) {
+		m_threads.setMaxThreadCount(static_cast< int >(threadCount));
+	}
+}
+
+PasswordHashPool::~PasswordHashPool() {
+	// Results that are delivered after this point are discarded together with this object's pending events
+	m_threads.clear();
+	m_threads.waitForDone();
+}
+
+bool PasswordHashPool::isEnabled() const {
+	return m_enabled;
+}
+
+bool PasswordHashPool::submit(const QString &hexSalt, const QString &password, int iterationCount,
+							  Callback callback) {
+	// The counter is only ever modified by the thread this object lives in, so checking and incrementing it doesn't
+	// have to be a single atomic operation
+	if (m_pending.load() >= m_maxPending) {
+		++m_rejected;
+		return false;
+	}
+	++m_pending;
+
+	m_threads.start([this, hexSalt, password, iterationCount, callback = std::move(callback)]() {
+		QString hash = PBKDF2::getHash(hexSalt, password, iterationCount);
+
+		QMetaObject::invokeMethod(
+			this,
+			[this, callback, hash = std::move(hash)]() {
+				--m_pending;
+				callback(hash);
+			},
+			Qt::QueuedConnection);
+	});
+
+	return true;
+}
+
+std::size_t PasswordHashPool::pendingCount() const {
+	return m_pending.load();
+}
+
+std::uint64_t PasswordHashPool::rejectedCount() const {
+	return m_rejected.load();
+}
+
+void PasswordHashPool::writeStatistics(PrometheusWriter &writer) const {
+	writer.family("murmur_password_hash_pending", "gauge", "Logins waiting for their password hash to be computed.");
+	writer.sample("", pendingCount());
+	writer.family("murmur_password_hash_rejected_total", "counter",
+				  "Logins rejected due to too many pending password hashes.");
+	writer.sample("", rejectedCount());
+}
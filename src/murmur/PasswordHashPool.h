@@ -0,0 +1,62 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_PASSWORDHASHPOOL_H_
+#define MUMBLE_MURMUR_PASSWORDHASHPOOL_H_
+
+#include <QtCore/QObject>
+#include <QtCore/QString>
+#include <QtCore/QThreadPool>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+class PrometheusWriter;
+
+/// Computes PBKDF2 password hashes (see PBKDF2::getHash) on a set of worker threads. Hashing is deliberately expensive,
+/// so doing it on the main thread would stall all other clients whenever a lot of registered users log in at once.
+///
+/// The number of hashes that may be pending at any time is limited. Beyond that, requests are rejected right away, so
+/// that a flood of logins can't pile up an ever-growing backlog.
+class PasswordHashPool : public QObject {
+private:
+	Q_OBJECT
+	Q_DISABLE_COPY(PasswordHashPool)
+
+public:
+	using Callback = std::function< void(const QString &hash) >;
+
+	/// @param threadCount The number of worker threads. If this is zero, the pool is disabled (see isEnabled()).
+	/// @param maxPending The maximum number of hashes that may be queued or in progress at the same time
+	PasswordHashPool(unsigned int threadCount, unsigned int maxPending, QObject *parent = nullptr);
+	/// Waits for all hashes that are in progress. Their callbacks are not invoked anymore.
+	~PasswordHashPool() override;
+
+	bool isEnabled() const;
+
+	/// Queues the computation of a hash. Once it is done, the callback is invoked from the thread this object lives in.
+	///
+	/// @returns Whether the request has been queued. If too many hashes are pending already, it is rejected and the
+	/// 	callback is never invoked.
+	bool submit(const QString &hexSalt, const QString &password, int iterationCount, Callback callback);
+
+	/// @returns The number of hashes that are currently queued or in progress
+	std::size_t pendingCount() const;
+	/// @returns The total number of requests that have been rejected because too many hashes were pending
+	std::uint64_t rejectedCount() const;
+
+	void writeStatistics(PrometheusWriter &writer) const;
+
+protected:
+	QThreadPool m_threads;
+	bool m_enabled;
+	std::size_t m_maxPending;
+	std::atomic< std::size_t > m_pending    = 0;
+	std::atomic< std::uint64_t > m_rejected = 0;
+};
+
+#endif // MUMBLE_MURMUR_PASSWORDHASHPOOL_H_
@@ -0,0 +1,72 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "PeerTable.h"
+
+#include <QtCore/QtGlobal>
+
+#include <cstring>
+
+#ifdef Q_OS_WIN
+#	include "win.h"
+#	include <winsock2.h>
+#	include <ws2tcpip.h>
+#else
+#	include <netinet/in.h>
+#	include <sys/socket.h>
+#endif
+
+namespace {
+std::uint64_t mix(std::uint64_t value) {
+	// Finalizer of SplitMix64
+	value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+	return value ^ (value >> 31);
+}
+} // namespace
+
+PeerKey PeerKey::fromSockaddr(const struct sockaddr_storage &address) {
+	PeerKey key;
+
+	if (address.ss_family == AF_INET6) {
+		const struct sockaddr_in6 *in6 = reinterpret_cast< const struct sockaddr_in6 * >(&address);
+		memcpy(key.address.data(), in6->sin6_addr.s6_addr, key.address.size());
+		key.port = in6->sin6_port;
+	} else {
+		key.address[10] = 0xFF;
+		key.address[11] = 0xFF;
+
+		if (address.ss_family == AF_INET) {
+			const struct sockaddr_in *in = reinterpret_cast< const struct sockaddr_in * >(&address);
+			memcpy(&key.address[12], &in->sin_addr.s_addr, 4);
+			key.port = in->sin_port;
+		}
+	}
+
+	return key;
+}
+
+bool PeerKey::isV4() const {
+	static constexpr std::uint8_t V4_MAPPED_PREFIX[12] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF };
+
+	return memcmp(address.data(), V4_MAPPED_PREFIX, sizeof(V4_MAPPED_PREFIX)) == 0;
+}
+
+std::size_t PeerKey::hash() const {
+	std::uint32_t ipv4;
+	memcpy(&ipv4, &address[12], sizeof(ipv4));
+
+	if (isV4()) {
+		return static_cast< std::size_t >(mix((static_cast< std::uint64_t >(ipv4) << 16) | port));
+	}
+
+	std::uint64_t high;
+	memcpy(&high, address.data(), sizeof(high));
+	std::uint32_t low;
+	memcpy(&low, &address[8], sizeof(low));
+
+	return static_cast< std::size_t >(
+		mix(high ^ mix((static_cast< std::uint64_t >(low) << 32) | ipv4) ^ (static_cast< std::uint64_t >(port) << 48)));
+}
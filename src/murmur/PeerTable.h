@@ -0,0 +1,195 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_PEERTABLE_H_
+#define MUMBLE_MURMUR_PEERTABLE_H_
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+struct sockaddr_storage;
+
+/// Identifies a UDP peer by its address and port. IPv4 addresses are stored as IPv4-mapped IPv6 addresses (just like
+/// HostAddress does), so that a key can be compared and hashed without having to look at the address family.
+struct PeerKey {
+	std::array< std::uint8_t, 16 > address = {};
+	/// The port in network byte order
+	std::uint16_t port = 0;
+
+	/// Creates the key directly from the given socket address (without going through HostAddress). Addresses that are
+	/// neither IPv4 nor IPv6 yield the all-zero IPv4-mapped address.
+	static PeerKey fromSockaddr(const struct sockaddr_storage &address);
+
+	bool isV4() const;
+
+	/// @returns The hash of this key. For IPv4 keys, only the 4 address bytes and the port are mixed.
+	std::size_t hash() const;
+
+	friend bool operator==(const PeerKey &lhs, const PeerKey &rhs) {
+		return lhs.port == rhs.port && lhs.address == rhs.address;
+	}
+	friend bool operator!=(const PeerKey &lhs, const PeerKey &rhs) { return !(lhs == rhs); }
+};
+
+/// A flat hash table mapping UDP peers to a (trivially copyable) value, e.g. the ServerUser the datagrams of a peer
+/// belong to. Collisions are resolved by linear probing, so a lookup usually touches a single cache line. Removal uses
+/// backward shifting instead of tombstones, so lookups don't degrade over time as peers come and go.
+///
+/// The table itself is not synchronized.
+template< typename T > class PeerTable {
+	static_assert(std::is_trivially_copyable< T >::value, "PeerTable only supports trivially copyable values");
+
+public:
+	PeerTable() = default;
+
+	/// @returns The value stored for the given key or defaultValue, if there is none
+	T value(const PeerKey &key, T defaultValue = T()) const {
+		const T *v = find(key);
+		return v ? *v : defaultValue;
+	}
+
+	/// @returns A pointer to the value stored for the given key or nullptr, if there is none. The pointer is
+	/// 	invalidated by any modification of the table.
+	const T *find(const PeerKey &key) const {
+		if (m_size == 0) {
+			return nullptr;
+		}
+
+		for (std::size_t index = key.hash() & m_mask;; index = (index + 1) & m_mask) {
+			const Slot &slot = m_slots[index];
+			if (!slot.occupied) {
+				return nullptr;
+			}
+			if (slot.key == key) {
+				return &slot.value;
+			}
+		}
+	}
+
+	T *find(const PeerKey &key) {
+		return const_cast< T * >(static_cast< const PeerTable * >(this)->find(key));
+	}
+
+	bool contains(const PeerKey &key) const { return find(key) != nullptr; }
+
+	/// Stores the given value for the given key, replacing any value that has been stored for it before
+	void insert(const PeerKey &key, T value) { *slotFor(key) = std::move(value); }
+
+	/// @returns A reference to the value stored for the given key. If there is none, a value-initialized one is
+	/// 	inserted first. The reference is invalidated by any modification of the table.
+	T &operator[](const PeerKey &key) { return *slotFor(key); }
+
+	/// Removes the value stored for the given key (if any)
+	///
+	/// @returns Whether a value has been removed
+	bool remove(const PeerKey &key) {
+		if (m_size == 0) {
+			return false;
+		}
+
+		std::size_t index = key.hash() & m_mask;
+		for (;; index = (index + 1) & m_mask) {
+			if (!m_slots[index].occupied) {
+				return false;
+			}
+			if (m_slots[index].key == key) {
+				break;
+			}
+		}
+
+		// Move subsequent entries of the probe sequence back, so that no lookup has to skip over the gap
+		std::size_t hole = index;
+		for (std::size_t next = (hole + 1) & m_mask; m_slots[next].occupied; next = (next + 1) & m_mask) {
+			const std::size_t home = m_slots[next].key.hash() & m_mask;
+
+			// The entry at next may only be moved into the hole if its home slot does not lie cyclically within
+			// (hole, next]
+			const bool homeInRange = hole <= next ? (hole < home && home <= next) : (hole < home || home <= next);
+			if (!homeInRange) {
+				m_slots[hole] = m_slots[next];
+				hole          = next;
+			}
+		}
+
+		m_slots[hole] = Slot();
+		--m_size;
+
+		return true;
+	}
+
+	void clear() {
+		m_slots.clear();
+		m_mask = 0;
+		m_size = 0;
+	}
+
+	std::size_t size() const { return m_size; }
+	bool isEmpty() const { return m_size == 0; }
+
+	/// @returns The number of slots currently allocated
+	std::size_t capacity() const { return m_slots.size(); }
+
+protected:
+	struct Slot {
+		PeerKey key;
+		bool occupied = false;
+		T value       = T();
+	};
+
+	static constexpr std::size_t MIN_CAPACITY = 16;
+
+	std::vector< Slot > m_slots;
+	std::size_t m_mask = 0;
+	std::size_t m_size = 0;
+
+	T *slotFor(const PeerKey &key) {
+		if (T *existing = find(key)) {
+			return existing;
+		}
+
+		// Keep the load factor at or below 1/2 to keep the probe sequences short
+		if ((m_size + 1) * 2 > m_slots.size()) {
+			rehash(m_slots.empty() ? MIN_CAPACITY : m_slots.size() * 2);
+		}
+
+		Slot &slot    = probeFree(key);
+		slot.key      = key;
+		slot.occupied = true;
+		slot.value    = T();
+		++m_size;
+
+		return &slot.value;
+	}
+
+	Slot &probeFree(const PeerKey &key) {
+		std::size_t index = key.hash() & m_mask;
+		while (m_slots[index].occupied) {
+			index = (index + 1) & m_mask;
+		}
+
+		return m_slots[index];
+	}
+
+	void rehash(std::size_t capacity) {
+		assert((capacity & (capacity - 1)) == 0);
+
+		std::vector< Slot > old(capacity);
+		old.swap(m_slots);
+		m_mask = capacity - 1;
+
+		for (const Slot &slot : old) {
+			if (slot.occupied) {
+				probeFree(slot.key) = slot;
+			}
+		}
+	}
+};
+
+#endif // MUMBLE_MURMUR_PEERTABLE_H_
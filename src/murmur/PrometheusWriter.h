@@ -0,0 +1,55 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_PROMETHEUSWRITER_H_
+#define MUMBLE_MURMUR_PROMETHEUSWRITER_H_
+
+#include <cassert>
+#include <cstdint>
+#include <string>
+
+/// Assembles metrics in the Prometheus text format. Every subsystem that reports statistics writes its metric
+/// families to the writer passed to it (see Meta::writeVoiceStatistics()).
+///
+/// A family is always started with family(), which writes its HELP and TYPE lines, so no series can end up without a
+/// description.
+class PrometheusWriter {
+public:
+	/// Starts the metric family of the given name. All samples that follow belong to it.
+	///
+	/// @param type The metric type, e.g. "counter" or "gauge"
+	/// @param help A description of the metric
+	void family(const std::string &name, const char *type, const std::string &help) {
+		assert(!help.empty());
+
+		m_family = name;
+		m_text += "# HELP " + name + " " + help + "\n";
+		m_text += "# TYPE " + name + " " + type + "\n";
+	}
+
+	/// Appends a sample to the current family
+	///
+	/// @param labels The sample's labels without the surrounding braces (e.g. `server="1"`), may be empty
+	/// @param suffix Appended to the family's name, e.g. "_bucket" for the buckets of a histogram
+	void sample(const std::string &labels, const std::string &value, const char *suffix = "") {
+		assert(!m_family.empty());
+
+		m_text += m_family + suffix;
+		if (!labels.empty()) {
+			m_text += "{" + labels + "}";
+		}
+		m_text += " " + value + "\n";
+	}
+
+	void sample(const std::string &labels, std::uint64_t value) { sample(labels, std::to_string(value)); }
+
+	const std::string &text() const { return m_text; }
+
+protected:
+	std::string m_text;
+	std::string m_family;
+};
+
+#endif // MUMBLE_MURMUR_PROMETHEUSWRITER_H_
@@ -121,9 +121,14 @@ bool Server::setChannelState(Channel *cChannel, Channel *cParent, const QString
 
 		{
 			QWriteLocker wl(&qrwlVoiceThread);
+			clearWhisperTargetCacheFor(*cChannel->cParent);
 			cChannel->cParent->removeChannel(cChannel);
 			cParent->addChannel(cChannel);
+			clearWhisperTargetCacheFor(*cParent);
+			clearWhisperTargetCacheFor(*cChannel);
 		}
+		// The moved channels now inherit their ACLs and groups from different ancestors
+		clearACLCacheFor(*cChannel);
 
 		mpcs.set_parent(cParent->iId);
 
@@ -285,6 +290,9 @@ void Server::clearTempGroups(User *user, Channel *cChannel, bool recurse) {
 }
 
 void Server::connectAuthenticator(QObject *obj) {
+	// Cached results of a previous authenticator don't apply anymore
+	m_authenticationResultCache.clear();
+
 	connect(this, SIGNAL(registerUserSig(int &, const QMap< int, QString > &)), obj,
 			SLOT(registerUserSlot(int &, const QMap< int, QString > &)));
 	connect(this, SIGNAL(unregisterUserSig(int &, int)), obj, SLOT(unregisterUserSlot(int &, int)));
@@ -298,6 +306,14 @@ void Server::connectAuthenticator(QObject *obj) {
 			obj,
 			SLOT(authenticateSlot(int &, QString &, int, const QList< QSslCertificate > &, const QString &, bool,
 								  const QString &)));
+	connect(this,
+			SIGNAL(authenticateAsyncSig(ExternalAuthenticationRequest &, ServerUser *, const QString &,
+										const QList< QSslCertificate > &, const QString &, bool, const QString &,
+										const ExternalAuthenticationCallback &)),
+			obj,
+			SLOT(authenticateAsyncSlot(ExternalAuthenticationRequest &, ServerUser *, const QString &,
+									   const QList< QSslCertificate > &, const QString &, bool, const QString &,
+									   const ExternalAuthenticationCallback &)));
 	connect(this, SIGNAL(setInfoSig(int &, int, const QMap< int, QString > &)), obj,
 			SLOT(setInfoSlot(int &, int, const QMap< int, QString > &)));
 	connect(this, SIGNAL(setTextureSig(int &, int, const QByteArray &)), obj,
@@ -308,6 +324,8 @@ void Server::connectAuthenticator(QObject *obj) {
 }
 
 void Server::disconnectAuthenticator(QObject *obj) {
+	m_authenticationResultCache.clear();
+
 	disconnect(this, SIGNAL(registerUserSig(int &, const QMap< int, QString > &)), obj,
 			   SLOT(registerUserSlot(int &, const QMap< int, QString > &)));
 	disconnect(this, SIGNAL(unregisterUserSig(int &, int)), obj, SLOT(unregisterUserSlot(int &, int)));
@@ -321,6 +339,14 @@ void Server::disconnectAuthenticator(QObject *obj) {
 			   obj,
 			   SLOT(authenticateSlot(int &, QString &, int, const QList< QSslCertificate > &, const QString &, bool,
 									 const QString &)));
+	disconnect(this,
+			   SIGNAL(authenticateAsyncSig(ExternalAuthenticationRequest &, ServerUser *, const QString &,
+										   const QList< QSslCertificate > &, const QString &, bool, const QString &,
+										   const ExternalAuthenticationCallback &)),
+			   obj,
+			   SLOT(authenticateAsyncSlot(ExternalAuthenticationRequest &, ServerUser *, const QString &,
+										  const QList< QSslCertificate > &, const QString &, bool, const QString &,
+										  const ExternalAuthenticationCallback &)));
 	disconnect(this, SIGNAL(setInfoSig(int &, int, const QMap< int, QString > &)), obj,
 			   SLOT(setInfoSlot(int &, int, const QMap< int, QString > &)));
 	disconnect(this, SIGNAL(setTextureSig(int &, int, const QByteArray &)), obj,
@@ -0,0 +1,152 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "RegisteredUserIndex.h"
+
+#include <QtCore/QString>
+
+void RegisteredUserIndex::setName(unsigned int userID, const std::string &name) {
+	User &user = getOrAdd(userID);
+
+	if (!user.name.empty()) {
+		erase(m_byName, fold(user.name), userID);
+	}
+
+	user.name = name;
+
+	if (!name.empty()) {
+		m_byName.emplace(fold(name), userID);
+	}
+}
+
+void RegisteredUserIndex::setPassword(unsigned int userID, const PasswordData &password) {
+	getOrAdd(userID).password = password;
+}
+
+void RegisteredUserIndex::setCertificateHash(unsigned int userID, const std::string &hash) {
+	User &user = getOrAdd(userID);
+
+	if (!user.certificateHash.empty()) {
+		erase(m_byCertificateHash, user.certificateHash, userID);
+	}
+
+	user.certificateHash = hash;
+
+	if (!hash.empty()) {
+		m_byCertificateHash.emplace(hash, userID);
+	}
+}
+
+void RegisteredUserIndex::setEmail(unsigned int userID, const std::string &email) {
+	User &user = getOrAdd(userID);
+
+	if (!user.email.empty()) {
+		erase(m_byEmail, user.email, userID);
+	}
+
+	user.email = email;
+
+	if (!email.empty()) {
+		m_byEmail.emplace(email, userID);
+	}
+}
+
+void RegisteredUserIndex::remove(unsigned int userID) {
+	auto it = m_users.find(userID);
+	if (it == m_users.end()) {
+		return;
+	}
+
+	erase(m_byName, fold(it->second.name), userID);
+	erase(m_byCertificateHash, it->second.certificateHash, userID);
+	erase(m_byEmail, it->second.email, userID);
+
+	m_users.erase(it);
+}
+
+void RegisteredUserIndex::clear() {
+	m_users.clear();
+	m_byName.clear();
+	m_byCertificateHash.clear();
+	m_byEmail.clear();
+}
+
+bool RegisteredUserIndex::contains(unsigned int userID) const {
+	return m_users.find(userID) != m_users.end();
+}
+
+std::size_t RegisteredUserIndex::size() const {
+	return m_users.size();
+}
+
+const std::string *RegisteredUserIndex::getName(unsigned int userID) const {
+	auto it = m_users.find(userID);
+
+	return it != m_users.end() ? &it->second.name : nullptr;
+}
+
+const RegisteredUserIndex::PasswordData *RegisteredUserIndex::getPassword(unsigned int userID) const {
+	auto it = m_users.find(userID);
+
+	return it != m_users.end() ? &it->second.password : nullptr;
+}
+
+std::optional< unsigned int > RegisteredUserIndex::findByName(const std::string &name) const {
+	auto it = m_byName.find(fold(name));
+
+	return it != m_byName.end() ? std::optional< unsigned int >(it->second) : std::nullopt;
+}
+
+std::optional< unsigned int > RegisteredUserIndex::findByCertificateHash(const std::string &hash) const {
+	return findUnique(m_byCertificateHash, hash);
+}
+
+std::optional< unsigned int > RegisteredUserIndex::findByEmail(const std::string &email) const {
+	return findUnique(m_byEmail, email);
+}
+
+std::vector< unsigned int > RegisteredUserIndex::findByNamePrefix(const std::string &prefix) const {
+	const std::string folded = fold(prefix);
+
+	std::vector< unsigned int > userIDs;
+	// The map is sorted, so all names starting with the prefix are stored right after one another
+	for (auto it = m_byName.lower_bound(folded); it != m_byName.end(); ++it) {
+		if (it->first.compare(0, folded.size(), folded) != 0) {
+			break;
+		}
+
+		userIDs.push_back(it->second);
+	}
+
+	return userIDs;
+}
+
+std::string RegisteredUserIndex::fold(const std::string &name) {
+	return QString::fromStdString(name).toLower().toStdString();
+}
+
+RegisteredUserIndex::User &RegisteredUserIndex::getOrAdd(unsigned int userID) {
+	return m_users[userID];
+}
+
+template< typename Map > void RegisteredUserIndex::erase(Map &map, const std::string &key, unsigned int userID) {
+	auto range = map.equal_range(key);
+	for (auto it = range.first; it != range.second; ++it) {
+		if (it->second == userID) {
+			map.erase(it);
+			return;
+		}
+	}
+}
+
+std::optional< unsigned int >
+	RegisteredUserIndex::findUnique(const std::unordered_multimap< std::string, unsigned int > &map,
+									const std::string &key) {
+	if (key.empty() || map.count(key) != 1) {
+		return std::nullopt;
+	}
+
+	return map.find(key)->second;
+}
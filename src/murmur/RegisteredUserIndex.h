@@ -0,0 +1,92 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_REGISTEREDUSERINDEX_H_
+#define MUMBLE_MURMUR_REGISTEREDUSERINDEX_H_
+
+#include "murmur/database/DBUserData.h"
+
+#include <cstddef>
+#include <map>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// An in-memory index of the registered users of a virtual server, which allows to look them up by their name,
+/// certificate hash and email (and to get their name and password data) without querying the database. This is what
+/// authentication needs for every connection attempt.
+///
+/// The index doesn't access the database itself. Whoever writes the indexed data to the database has to update the
+/// index accordingly (see DBWrapper).
+///
+/// Names are compared case-insensitively by lower-casing them with QString::toLower(), which the database lookups
+/// mimic with SQL's LOWER(). This is the same for ASCII names, but SQLite's LOWER() leaves all other characters
+/// alone, so that e.g. "ÄNNE" only refers to a user called "änne" with the index. Searching names by patterns is left
+/// to the database, as its LIKE isn't consistent across backends either (e.g. it is case-sensitive with PostgreSQL).
+/// The index is not synchronized.
+class RegisteredUserIndex {
+public:
+	using PasswordData = ::mumble::server::db::DBUserData::PasswordData;
+
+	/// Sets the name of the given user, adding the user to the index if it isn't contained yet
+	void setName(unsigned int userID, const std::string &name);
+	/// Sets the password data of the given user, adding the user to the index if it isn't contained yet
+	void setPassword(unsigned int userID, const PasswordData &password);
+	/// Sets the certificate hash of the given user (an empty hash clears it), adding the user to the index if it isn't
+	/// contained yet
+	void setCertificateHash(unsigned int userID, const std::string &hash);
+	/// Sets the email of the given user (an empty email clears it), adding the user to the index if it isn't contained
+	/// yet
+	void setEmail(unsigned int userID, const std::string &email);
+
+	void remove(unsigned int userID);
+	void clear();
+
+	bool contains(unsigned int userID) const;
+	std::size_t size() const;
+
+	/// @returns The name of the given user or nullptr, if the user isn't contained in the index
+	const std::string *getName(unsigned int userID) const;
+	/// @returns The password data of the given user or nullptr, if the user isn't contained in the index
+	const PasswordData *getPassword(unsigned int userID) const;
+
+	/// @returns The ID of the user with the given name (compared case-insensitively)
+	std::optional< unsigned int > findByName(const std::string &name) const;
+	/// @returns The ID of the user with the given certificate hash, if there is exactly one such user
+	std::optional< unsigned int > findByCertificateHash(const std::string &hash) const;
+	/// @returns The ID of the user with the given email, if there is exactly one such user
+	std::optional< unsigned int > findByEmail(const std::string &email) const;
+
+	/// @returns The IDs of all users whose name starts with the given prefix (compared case-insensitively), ordered
+	/// 	by their name
+	std::vector< unsigned int > findByNamePrefix(const std::string &prefix) const;
+
+	/// @returns The given name in the form it is indexed in, i.e. lower-cased
+	static std::string fold(const std::string &name);
+
+protected:
+	struct User {
+		std::string name;
+		PasswordData password;
+		std::string certificateHash;
+		std::string email;
+	};
+
+	std::unordered_map< unsigned int, User > m_users;
+
+	/// Users by their lower-cased name. Names are unique (case-insensitively), but the database doesn't enforce that.
+	std::multimap< std::string, unsigned int > m_byName;
+	std::unordered_multimap< std::string, unsigned int > m_byCertificateHash;
+	std::unordered_multimap< std::string, unsigned int > m_byEmail;
+
+	User &getOrAdd(unsigned int userID);
+
+	template< typename Map > static void erase(Map &map, const std::string &key, unsigned int userID);
+	static std::optional< unsigned int > findUnique(const std::unordered_multimap< std::string, unsigned int > &map,
+													const std::string &key);
+};
+
+#endif // MUMBLE_MURMUR_REGISTEREDUSERINDEX_H_
@@ -19,6 +19,7 @@
 #include "MumbleConstants.h"
 #include "MumbleProtocol.h"
 #include "PBKDF2.h"
+#include "PrometheusWriter.h"
 #include "ProtoUtils.h"
 #include "QtUtils.h"
 #include "ServerUser.h"
@@ -29,14 +30,20 @@
 #	include "Zeroconf.h"
 #endif
 
+#ifdef USE_IO_URING
+#	include "UDPRing.h"
+#endif
+
 #include "Utils.h"
 
 #include "murmur/database/DBUserData.h"
 #include "murmur/database/UserProperty.h"
 
 #include <QtCore/QCoreApplication>
+#include <QtCore/QPointer>
 #include <QtCore/QRegularExpression>
 #include <QtCore/QSet>
+#include <QtCore/QStack>
 #include <QtCore/QXmlStreamAttributes>
 #include <QtCore/QtEndian>
 #include <QtNetwork/QHostInfo>
@@ -52,6 +59,7 @@
 #include <functional>
 #include <optional>
 #include <span>
+#include <string>
 #include <vector>
 
 #ifdef Q_OS_WIN
@@ -87,7 +95,8 @@ QSslSocket *SslServer::nextPendingSSLConnection() {
 
 
 Server::Server(unsigned int snum, const ::mumble::db::ConnectionParameter &connectionParam, QObject *p)
-	: QThread(p), m_dbWrapper(connectionParam) {
+	: QThread(p), m_authenticationResultCache(std::chrono::seconds(Meta::mp->authenticatorCacheTTL)),
+	  m_writeCoalescer(std::chrono::milliseconds(std::max(Meta::mp->tcpWriteDelay, 0))), m_dbWrapper(connectionParam) {
 	tracy::SetThreadName("mumble-server");
 
 	bValid     = true;
@@ -97,9 +106,7 @@ Server::Server(unsigned int snum, const ::mumble::db::ConnectionParameter &conne
 #endif
 	bUsingMetaCert = false;
 
-#ifdef Q_OS_UNIX
-	aiNotify[0] = aiNotify[1] = -1;
-#else
+#ifndef Q_OS_UNIX
 	hNotify = nullptr;
 #endif
 	qtTimeout = new QTimer(this);
@@ -112,6 +119,19 @@ Server::Server(unsigned int snum, const ::mumble::db::ConnectionParameter &conne
 
 	readParams();
 
+#ifndef Q_OS_LINUX
+	if (m_voiceThreadCount > 1) {
+		// Only Linux distributes incoming datagrams across sockets sharing a port (SO_REUSEPORT)
+		log("Multiple voice threads are not supported on this platform - using a single one");
+		m_voiceThreadCount = 1;
+	}
+#endif
+	for (unsigned int i = 0; i < m_voiceThreadCount; ++i) {
+		std::unique_ptr< VoiceWorker > worker = std::make_unique< VoiceWorker >();
+		worker->index                         = i;
+		m_voiceWorkers.push_back(std::move(worker));
+	}
+
 	for (const QHostAddress &qha : qlBind) {
 		SslServer *ss = new SslServer(this);
 
@@ -140,101 +160,115 @@ Server::Server(unsigned int snum, const ::mumble::db::ConnectionParameter &conne
 #endif
 		memset(&addr, 0, sizeof(addr));
 		getsockname(tcpsock, reinterpret_cast< struct sockaddr * >(&addr), &len);
+
+		for (std::unique_ptr< VoiceWorker > &worker : m_voiceWorkers) {
 #ifdef Q_OS_UNIX
-		int sock = ::socket(addr.ss_family, SOCK_DGRAM, 0);
+			int sock = ::socket(addr.ss_family, SOCK_DGRAM, 0);
 #	ifdef Q_OS_LINUX
-		int sockopt = 1;
-		if (setsockopt(sock, IPPROTO_IP, IP_PKTINFO, &sockopt, sizeof(sockopt)))
-			log(QString("Failed to set IP_PKTINFO for %1").arg(addressToString(ss->serverAddress(), usPort)));
-		sockopt = 1;
-		if (setsockopt(sock, IPPROTO_IPV6, IPV6_RECVPKTINFO, &sockopt, sizeof(sockopt)))
-			log(QString("Failed to set IPV6_RECVPKTINFO for %1").arg(addressToString(ss->serverAddress(), usPort)));
+			int sockopt = 1;
+			if (setsockopt(sock, IPPROTO_IP, IP_PKTINFO, &sockopt, sizeof(sockopt)))
+				log(QString("Failed to set IP_PKTINFO for %1").arg(addressToString(ss->serverAddress(), usPort)));
+			sockopt = 1;
+			if (setsockopt(sock, IPPROTO_IPV6, IPV6_RECVPKTINFO, &sockopt, sizeof(sockopt)))
+				log(QString("Failed to set IPV6_RECVPKTINFO for %1").arg(addressToString(ss->serverAddress(), usPort)));
+			if (m_voiceThreadCount > 1) {
+				// Every voice thread binds its own socket to the same address. The kernel then distributes the
+				// incoming datagrams among these sockets based on a hash of the sender's address and port.
+				sockopt = 1;
+				if (setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &sockopt, sizeof(sockopt)))
+					log(QString("Failed to set SO_REUSEPORT for %1").arg(addressToString(ss->serverAddress(), usPort)));
+			}
 #	endif
 #else
 #	ifndef SIO_UDP_CONNRESET
 #		define SIO_UDP_CONNRESET _WSAIOW(IOC_VENDOR, 12)
 #	endif
-		SOCKET sock           = ::WSASocket(addr.ss_family, SOCK_DGRAM, IPPROTO_UDP, nullptr, 0, WSA_FLAG_OVERLAPPED);
-		DWORD dwBytesReturned = 0;
-		BOOL bNewBehaviour    = FALSE;
-		if (WSAIoctl(sock, SIO_UDP_CONNRESET, &bNewBehaviour, sizeof(bNewBehaviour), nullptr, 0, &dwBytesReturned,
-					 nullptr, nullptr)
-			== SOCKET_ERROR) {
-			log(QString("Failed to set SIO_UDP_CONNRESET: %1").arg(WSAGetLastError()));
-		}
+			SOCKET sock =
+				::WSASocket(addr.ss_family, SOCK_DGRAM, IPPROTO_UDP, nullptr, 0, WSA_FLAG_OVERLAPPED);
+			DWORD dwBytesReturned = 0;
+			BOOL bNewBehaviour    = FALSE;
+			if (WSAIoctl(sock, SIO_UDP_CONNRESET, &bNewBehaviour, sizeof(bNewBehaviour), nullptr, 0,
+						 &dwBytesReturned, nullptr, nullptr)
+				== SOCKET_ERROR) {
+				log(QString("Failed to set SIO_UDP_CONNRESET: %1").arg(WSAGetLastError()));
+			}
 #endif
-		if (sock == INVALID_SOCKET) {
-			log("Failed to create UDP Socket");
-			bValid = false;
-			return;
-		} else {
-			if (addr.ss_family == AF_INET6) {
-				// Copy IPV6_V6ONLY attribute from tcp socket, it defaults to nonzero on Windows
-				// See https://msdn.microsoft.com/en-us/library/windows/desktop/ms738574%28v=vs.85%29.aspx
-				// This will fail for WindowsXP which is ok. Our TCP code will have split that up
-				// into two sockets.
-				int ipv6only     = 0;
-				socklen_t optlen = sizeof(ipv6only);
-				if (::getsockopt(tcpsock, IPPROTO_IPV6, IPV6_V6ONLY, reinterpret_cast< char * >(&ipv6only), &optlen)
-					== 0) {
-					if (::setsockopt(sock, IPPROTO_IPV6, IPV6_V6ONLY, reinterpret_cast< const char * >(&ipv6only),
-									 optlen)
-						== SOCKET_ERROR) {
-						log(QString("Failed to copy IPV6_V6ONLY socket attribute from tcp to udp socket"));
+			if (sock == INVALID_SOCKET) {
+				log("Failed to create UDP Socket");
+				bValid = false;
+				return;
+			} else {
+				if (addr.ss_family == AF_INET6) {
+					// Copy IPV6_V6ONLY attribute from tcp socket, it defaults to nonzero on Windows
+					// See https://msdn.microsoft.com/en-us/library/windows/desktop/ms738574%28v=vs.85%29.aspx
+					// This will fail for WindowsXP which is ok. Our TCP code will have split that up
+					// into two sockets.
+					int ipv6only     = 0;
+					socklen_t optlen = sizeof(ipv6only);
+					if (::getsockopt(tcpsock, IPPROTO_IPV6, IPV6_V6ONLY, reinterpret_cast< char * >(&ipv6only), &optlen)
+						== 0) {
+						if (::setsockopt(sock, IPPROTO_IPV6, IPV6_V6ONLY, reinterpret_cast< const char * >(&ipv6only),
+										 optlen)
+							== SOCKET_ERROR) {
+							log(QString("Failed to copy IPV6_V6ONLY socket attribute from tcp to udp socket"));
+						}
 					}
 				}
-			}
 
-			if (::bind(sock, reinterpret_cast< sockaddr * >(&addr), len) == SOCKET_ERROR) {
+				if (::bind(sock, reinterpret_cast< sockaddr * >(&addr), len) == SOCKET_ERROR) {
 #ifdef Q_OS_WIN
-				log(QString("Failed to bind UDP Socket to %1: %2")
-						.arg(addressToString(ss->serverAddress(), usPort), WSAGetLastError()));
+					log(QString("Failed to bind UDP Socket to %1: %2")
+							.arg(addressToString(ss->serverAddress(), usPort), WSAGetLastError()));
 #else
-				log(QString("Failed to bind UDP Socket to %1: %2")
-						.arg(addressToString(ss->serverAddress(), usPort), errno));
+					log(QString("Failed to bind UDP Socket to %1: %2")
+							.arg(addressToString(ss->serverAddress(), usPort), errno));
 #endif
-			} else {
+				} else {
 #ifdef Q_OS_UNIX
-				int val = 0xe0;
-				if (setsockopt(sock, IPPROTO_IP, IP_TOS, &val, sizeof(val))) {
-					val = 0x80;
-					if (setsockopt(sock, IPPROTO_IP, IP_TOS, &val, sizeof(val)))
-						log("Server: Failed to set TOS for UDP Socket");
-				}
+					int val = 0xe0;
+					if (setsockopt(sock, IPPROTO_IP, IP_TOS, &val, sizeof(val))) {
+						val = 0x80;
+						if (setsockopt(sock, IPPROTO_IP, IP_TOS, &val, sizeof(val)))
+							log("Server: Failed to set TOS for UDP Socket");
+					}
 #	if defined(SO_PRIORITY)
-				socklen_t optlen = sizeof(val);
-				if (getsockopt(sock, SOL_SOCKET, SO_PRIORITY, &val, &optlen) == 0) {
-					if (val == 0) {
-						val = 6;
-						setsockopt(sock, SOL_SOCKET, SO_PRIORITY, &val, sizeof(val));
+					socklen_t optlen = sizeof(val);
+					if (getsockopt(sock, SOL_SOCKET, SO_PRIORITY, &val, &optlen) == 0) {
+						if (val == 0) {
+							val = 6;
+							setsockopt(sock, SOL_SOCKET, SO_PRIORITY, &val, sizeof(val));
+						}
 					}
-				}
 #	endif
 #endif
+				}
+				QSocketNotifier *qsn = new QSocketNotifier(sock, QSocketNotifier::Read, this);
+				connect(qsn, SIGNAL(activated(int)), this, SLOT(udpActivated(int)));
+				qlUdpSocket << sock;
+				qlUdpNotifier << qsn;
+				worker->udpSockets << sock;
 			}
-			QSocketNotifier *qsn = new QSocketNotifier(sock, QSocketNotifier::Read, this);
-			connect(qsn, SIGNAL(activated(int)), this, SLOT(udpActivated(int)));
-			qlUdpSocket << sock;
-			qlUdpNotifier << qsn;
 		}
 	}
 
-	bValid = bValid && (qlServer.count() == qlBind.count()) && (qlUdpSocket.count() == qlBind.count());
+	bValid = bValid && (qlServer.count() == qlBind.count())
+			 && (qlUdpSocket.count() == qlBind.count() * static_cast< qsizetype >(m_voiceThreadCount));
 	if (!bValid)
 		return;
 
 #ifdef Q_OS_UNIX
-	if (socketpair(AF_UNIX, SOCK_STREAM, 0, aiNotify) != 0) {
-		log("Failed to create notify socket");
-		bValid = false;
-		return;
+	for (std::unique_ptr< VoiceWorker > &worker : m_voiceWorkers) {
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, worker->notify) != 0) {
+			log("Failed to create notify socket");
+			bValid = false;
+			return;
+		}
 	}
 #else
 	hNotify = CreateEvent(nullptr, FALSE, FALSE, nullptr);
 #endif
 
-	connect(this, SIGNAL(tcpTransmit(QByteArray, unsigned int)), this, SLOT(tcpTransmitData(QByteArray, unsigned int)),
-			Qt::QueuedConnection);
+	connect(this, &Server::tcpTransmit, this, &Server::tcpTransmitData, Qt::QueuedConnection);
 	connect(this, SIGNAL(reqSync(unsigned int)), this, SLOT(doSync(unsigned int)));
 
 	for (unsigned int i = 1; i < iMaxUsers * 2; ++i)
@@ -246,6 +280,10 @@ Server::Server(unsigned int snum, const ::mumble::db::ConnectionParameter &conne
 	m_dbWrapper.initializeChannels(*this);
 	m_dbWrapper.initializeChannelLinks(*this);
 
+	if (Meta::mp->registeredUserIndex) {
+		m_dbWrapper.loadRegisteredUserIndex(iServerNum);
+	}
+
 	initializeCert();
 
 	if (bValid) {
@@ -259,13 +297,24 @@ Server::Server(unsigned int snum, const ::mumble::db::ConnectionParameter &conne
 
 void Server::startThread() {
 	if (!isRunning()) {
-		log("Starting voice thread");
+		if (m_voiceWorkers.size() > 1) {
+			log(QString("Starting %1 voice threads").arg(m_voiceWorkers.size()));
+		} else {
+			log("Starting voice thread");
+		}
 		bRunning = true;
 
 		for (QSocketNotifier *qsn : qlUdpNotifier) {
 			qsn->setEnabled(false);
 		}
+		// The first worker is run by the Server thread itself, all others get a dedicated thread
 		start(QThread::HighestPriority);
+		for (std::size_t i = 1; i < m_voiceWorkers.size(); ++i) {
+			VoiceWorker *worker = m_voiceWorkers[i].get();
+			worker->thread.reset(QThread::create([this, worker]() { runVoiceLoop(*worker); }));
+			worker->thread->setObjectName(QString("Voice%1").arg(worker->index));
+			worker->thread->start(QThread::HighestPriority);
+		}
 #ifdef Q_OS_LINUX
 		// QThread::HighestPriority == Same as everything else...
 		int policy;
@@ -289,13 +338,21 @@ void Server::stopThread() {
 		log("Ending voice thread");
 
 #ifdef Q_OS_UNIX
-		unsigned char val = 0;
-		if (::write(aiNotify[1], &val, 1) != 1)
-			log("Failed to signal voice thread");
+		for (std::unique_ptr< VoiceWorker > &worker : m_voiceWorkers) {
+			unsigned char val = 0;
+			if (::write(worker->notify[1], &val, 1) != 1)
+				log("Failed to signal voice thread");
+		}
 #else
 		SetEvent(hNotify);
 #endif
 		wait();
+		for (std::unique_ptr< VoiceWorker > &worker : m_voiceWorkers) {
+			if (worker->thread) {
+				worker->thread->wait();
+				worker->thread.reset();
+			}
+		}
 
 		for (QSocketNotifier *qsn : qlUdpNotifier) {
 			qsn->setEnabled(true);
@@ -319,10 +376,12 @@ Server::~Server() {
 	for (int s : qlUdpSocket)
 		close(s);
 
-	if (aiNotify[0] >= 0)
-		close(aiNotify[0]);
-	if (aiNotify[1] >= 0)
-		close(aiNotify[1]);
+	for (std::unique_ptr< VoiceWorker > &worker : m_voiceWorkers) {
+		if (worker->notify[0] >= 0)
+			close(worker->notify[0]);
+		if (worker->notify[1] >= 0)
+			close(worker->notify[1]);
+	}
 #else
 	for (SOCKET s : qlUdpSocket) {
 		closesocket(s);
@@ -360,6 +419,8 @@ void Server::readParams() {
 	bAllowPing                         = Meta::mp->bAllowPing;
 	allowRecording                     = Meta::mp->allowRecording;
 	rollingStatsWindow                 = Meta::mp->rollingStatsWindow;
+	m_voiceThreadCount                 = Meta::mp->voiceThreads;
+	m_useIOUring                       = Meta::mp->useIOUring;
 	bCertRequired                      = Meta::mp->bCertRequired;
 	bForceExternalAuth                 = Meta::mp->bForceExternalAuth;
 	qrUserName                         = Meta::mp->qrUserName;
@@ -460,6 +521,10 @@ void Server::readParams() {
 	m_dbWrapper.getConfigurationTo(iServerNum, "suggestpushtotalk", m_suggestPushToTalk);
 	m_dbWrapper.getConfigurationTo(iServerNum, "rollingStatsWindow", rollingStatsWindow);
 
+	m_dbWrapper.getConfigurationTo(iServerNum, "voicethreads", m_voiceThreadCount);
+	m_voiceThreadCount = std::max(m_voiceThreadCount, 1u);
+	m_dbWrapper.getConfigurationTo(iServerNum, "iouring", m_useIOUring);
+
 	m_dbWrapper.getConfigurationTo(iServerNum, "opusthreshold", iOpusThreshold);
 
 	m_dbWrapper.getConfigurationTo(iServerNum, "channelnestinglimit", iChannelNestingLimit);
@@ -566,6 +631,8 @@ void Server::setLiveConf(const QString &key, const QString &value) {
 		QString text = !v.isNull() ? v : Meta::mp->qsRegName;
 		if (text != qsRegName) {
 			qsRegName = text;
+			// The name of the root channel is only broadcast if it isn't reset
+			m_joinStateCache.invalidateChannel(0);
 			if (!qsRegName.isEmpty()) {
 				MumbleProto::ChannelState mpcs;
 				mpcs.set_channel_id(0);
@@ -696,9 +763,15 @@ void Server::customEvent(QEvent *evt) {
 }
 
 void Server::udpActivated(int socket) {
+	// The socket notifiers are only enabled while the voice threads are stopped, so we can borrow the first worker's
+	// codec instances here.
+	Mumble::Protocol::UDPDecoder< Mumble::Protocol::Role::Server > &decoder = m_voiceWorkers.front()->decoder;
+	Mumble::Protocol::UDPPingEncoder< Mumble::Protocol::Role::Server > &pingEncoder =
+		m_voiceWorkers.front()->pingEncoder;
+
 	// At this part we are only expecting pings of clients we don't know yet -> thus we also don't know which protocol
 	// version they are using.
-	m_udpDecoder.setProtocolVersion(Version::UNKNOWN);
+	decoder.setProtocolVersion(Version::UNKNOWN);
 
 	qint32 len;
 
@@ -708,8 +781,8 @@ void Server::udpActivated(int socket) {
 	struct msghdr msg;
 	struct iovec iov[1];
 
-	iov[0].iov_base = m_udpDecoder.getBuffer().data();
-	iov[0].iov_len  = m_udpDecoder.getBuffer().size();
+	iov[0].iov_base = decoder.getBuffer().data();
+	iov[0].iov_len  = decoder.getBuffer().size();
 
 	uint8_t controldata[CMSG_SPACE(std::max(sizeof(struct in6_pktinfo), sizeof(struct in_pktinfo)))];
 
@@ -726,22 +799,22 @@ void Server::udpActivated(int socket) {
 #	else
 	socklen_t fromlen = sizeof(from);
 	int &sock         = socket;
-	len = static_cast< qint32 >(::recvfrom(sock, m_udpDecoder.getBuffer().data(), m_udpDecoder.getBuffer().size(),
-										   MSG_TRUNC, reinterpret_cast< struct sockaddr * >(&from), &fromlen));
+	len               = static_cast< qint32 >(::recvfrom(sock, decoder.getBuffer().data(), decoder.getBuffer().size(),
+                                           MSG_TRUNC, reinterpret_cast< struct sockaddr * >(&from), &fromlen));
 #	endif
 #else
 	int fromlen = static_cast< int >(sizeof(from));
 	SOCKET sock = static_cast< SOCKET >(socket);
-	len         = ::recvfrom(sock, reinterpret_cast< char * >(m_udpDecoder.getBuffer().data()),
-                     static_cast< int >(m_udpDecoder.getBuffer().size()), 0,
+	len         = ::recvfrom(sock, reinterpret_cast< char * >(decoder.getBuffer().data()),
+                     static_cast< int >(decoder.getBuffer().size()), 0,
                      reinterpret_cast< struct sockaddr * >(&from), &fromlen);
 #endif
 
-	std::span< Mumble::Protocol::byte > inputData(&m_udpDecoder.getBuffer()[0], static_cast< std::size_t >(len));
+	std::span< Mumble::Protocol::byte > inputData(&decoder.getBuffer()[0], static_cast< std::size_t >(len));
 
-	if (bAllowPing && m_udpDecoder.decodePing(inputData)
-		&& m_udpDecoder.getMessageType() == Mumble::Protocol::UDPMessageType::Ping) {
-		std::span< const Mumble::Protocol::byte > encodedPing = handlePing(m_udpDecoder, m_udpPingEncoder, true);
+	if (bAllowPing && decoder.decodePing(inputData)
+		&& decoder.getMessageType() == Mumble::Protocol::UDPMessageType::Ping) {
+		std::span< const Mumble::Protocol::byte > encodedPing = handlePing(decoder, pingEncoder, true);
 
 		if (!encodedPing.empty()) {
 #ifdef Q_OS_LINUX
@@ -765,32 +838,46 @@ void Server::udpActivated(int socket) {
 }
 
 void Server::run() {
-	tracy::SetThreadName("Audio");
+	runVoiceLoop(*m_voiceWorkers.front());
+}
+
+void Server::runVoiceLoop(VoiceWorker &worker) {
+	const std::string threadName = worker.index == 0 ? "Audio" : "Audio" + std::to_string(worker.index);
+	tracy::SetThreadName(threadName.c_str());
+
+#ifdef USE_IO_URING
+	if (m_useIOUring && runRingVoiceLoop(worker)) {
+		return;
+	}
+#endif
 
+#ifndef Q_OS_LINUX
 	qint32 len;
-#if defined(__LP64__)
+#	if defined(__LP64__)
 	unsigned char encbuff[Mumble::Protocol::MAX_UDP_PACKET_SIZE + 8];
 	unsigned char *encrypt = encbuff + 4;
-#else
+#	else
 	unsigned char encrypt[Mumble::Protocol::MAX_UDP_PACKET_SIZE];
-#endif
-	unsigned char buffer[Mumble::Protocol::MAX_UDP_PACKET_SIZE];
+#	endif
 
 	sockaddr_storage from;
-	unsigned int nfds = static_cast< unsigned int >(qlUdpSocket.count());
+#endif
+	unsigned int nfds = static_cast< unsigned int >(worker.udpSockets.count());
 
 #ifdef Q_OS_UNIX
+#	ifndef Q_OS_LINUX
 	socklen_t fromlen;
+#	endif
 	std::vector< struct pollfd > fds;
 	fds.resize(static_cast< std::size_t >(nfds + 1));
 
 	for (unsigned int i = 0; i < nfds; ++i) {
-		fds[i].fd      = qlUdpSocket.at(static_cast< int >(i));
+		fds[i].fd      = worker.udpSockets.at(static_cast< int >(i));
 		fds[i].events  = POLLIN;
 		fds[i].revents = 0;
 	}
 
-	fds[nfds].fd      = aiNotify[0];
+	fds[nfds].fd      = worker.notify[0];
 	fds[nfds].events  = POLLIN;
 	fds[nfds].revents = 0;
 #else
@@ -800,7 +887,7 @@ void Server::run() {
 	std::vector< HANDLE > events;
 	events.resize(nfds + 1);
 	for (unsigned int i = 0; i < nfds; ++i) {
-		fds[i]    = qlUdpSocket.at(i);
+		fds[i]    = worker.udpSockets.at(i);
 		events[i] = CreateEvent(nullptr, FALSE, FALSE, nullptr);
 		::WSAEventSelect(fds[i], events[i], FD_READ);
 	}
@@ -825,7 +912,7 @@ void Server::run() {
 		if (fds[nfds - 1].revents) {
 			// Drain pipe
 			unsigned char val;
-			while (::recv(aiNotify[0], &val, 1, MSG_DONTWAIT) == 1) {
+			while (::recv(worker.notify[0], &val, 1, MSG_DONTWAIT) == 1) {
 			};
 			break;
 		}
@@ -854,188 +941,303 @@ void Server::run() {
 				SOCKET sock = fds[ret - WAIT_OBJECT_0];
 #endif
 
-				fromlen = sizeof(from);
-#ifdef Q_OS_WIN
-				len = ::recvfrom(sock, reinterpret_cast< char * >(encrypt), Mumble::Protocol::MAX_UDP_PACKET_SIZE, 0,
-								 reinterpret_cast< struct sockaddr * >(&from), &fromlen);
-#else
-#	ifdef Q_OS_LINUX
-				struct msghdr msg;
-				struct iovec iov[1];
-
-				iov[0].iov_base = encrypt;
-				iov[0].iov_len  = Mumble::Protocol::MAX_UDP_PACKET_SIZE;
+#ifdef Q_OS_LINUX
+				// Drain all datagrams that are currently queued on the socket with a single system call
+				UDPReceiveBatch &receiveBatch = worker.receiveBatch;
+				const auto receiveStart       = VoiceStats::Clock::now();
+				const int count               = receiveBatch.receive(sock);
+				worker.stats.recordSince(VoiceStage::Receive, receiveStart);
+				if (count > 0) {
+					worker.stats.count(VoiceCounter::DatagramsReceived, static_cast< std::uint64_t >(count));
+				}
 
-				uint8_t controldata[CMSG_SPACE(std::max(sizeof(struct in6_pktinfo), sizeof(struct in_pktinfo)))];
+				for (int j = 0; j < count; ++j) {
+					const std::size_t index  = static_cast< std::size_t >(j);
+					const std::size_t length =
+						std::min(receiveBatch.getLength(index), Mumble::Protocol::MAX_UDP_PACKET_SIZE + 1);
 
-				memset(&msg, 0, sizeof(msg));
-				msg.msg_name       = reinterpret_cast< struct sockaddr * >(&from);
-				msg.msg_namelen    = sizeof(from);
-				msg.msg_iov        = iov;
-				msg.msg_iovlen     = 1;
-				msg.msg_control    = controldata;
-				msg.msg_controllen = sizeof(controldata);
+					processDatagram(worker, sock, receiveBatch.getSender(index), receiveBatch.getData(index),
+									static_cast< qint32 >(length), &receiveBatch.getHeader(index));
+				}
 
-				len = static_cast< qint32 >(::recvmsg(sock, &msg, MSG_TRUNC));
-				Q_UNUSED(fromlen);
+				// Send out all packets that have been produced while processing the received datagrams at once. Note
+				// that we are no longer holding the lock on qrwlVoiceThread at this point.
+				if (!worker.sendBatch.isEmpty()) {
+					const auto flushStart = VoiceStats::Clock::now();
+					worker.sendBatch.flush();
+					worker.stats.recordSince(VoiceStage::Flush, flushStart);
+				}
+#else
+				fromlen                 = sizeof(from);
+				const auto receiveStart = VoiceStats::Clock::now();
+#	ifdef Q_OS_WIN
+				len = ::recvfrom(sock, reinterpret_cast< char * >(encrypt), Mumble::Protocol::MAX_UDP_PACKET_SIZE, 0,
+								 reinterpret_cast< struct sockaddr * >(&from), &fromlen);
 #	else
 				len = static_cast< qint32 >(::recvfrom(sock, encrypt, Mumble::Protocol::MAX_UDP_PACKET_SIZE, MSG_TRUNC,
 													   reinterpret_cast< struct sockaddr * >(&from), &fromlen));
 #	endif
+				worker.stats.recordSince(VoiceStage::Receive, receiveStart);
+				if (len > 0) {
+					worker.stats.count(VoiceCounter::DatagramsReceived);
+				}
+
+				processDatagram(worker, sock, from, encrypt, len, nullptr);
+#endif
+#ifdef Q_OS_UNIX
+				fds[i].revents = 0;
+#endif
+			}
+		}
+	}
+#ifdef Q_OS_WIN
+	for (unsigned int i = 0; i < nfds - 1; ++i) {
+		::WSAEventSelect(fds[i], nullptr, 0);
+		CloseHandle(events[i]);
+	}
 #endif
+}
 
-				// Capture only the processing without the polling
-				ZoneScopedN(TracyConstants::UDP_PACKET_PROCESSING_ZONE);
+#ifdef USE_IO_URING
+bool Server::runRingVoiceLoop(VoiceWorker &worker) {
+	UDPRing ring;
 
-				if (len == 0) {
-					break;
-				} else if (len == SOCKET_ERROR) {
-					break;
-				} else if (len < 5) {
-					// 4 bytes crypt header + type + session
-					continue;
-				} else if (static_cast< unsigned int >(len) > Mumble::Protocol::MAX_UDP_PACKET_SIZE) {
-					// This will also catch the len == -1 case (indicating error)
-					static_assert(static_cast< unsigned int >(-1) > Mumble::Protocol::MAX_UDP_PACKET_SIZE,
-								  "Invalid assumption");
-					continue;
-				}
+	const std::vector< int > sockets(worker.udpSockets.cbegin(), worker.udpSockets.cend());
+	int error = ring.setup(sockets, worker.notify[0]);
 
-				QReadLocker rl(&qrwlVoiceThread);
+	while (error == 0 && bRunning) {
+		FrameMarkNamed(TracyConstants::UDP_FRAME);
 
-				quint16 port = (from.ss_family == AF_INET6) ? (reinterpret_cast< sockaddr_in6 * >(&from)->sin6_port)
-															: (reinterpret_cast< sockaddr_in * >(&from)->sin_port);
-				const HostAddress &ha = HostAddress(from);
+		// This submits the datagrams produced in the previous iteration and waits for new ones in a single system call.
+		// As waiting and receiving can't be told apart, the receive stage is not recorded for this loop.
+		const int count = ring.wait();
+		if (count < 0) {
+			error = count;
+			break;
+		}
+		worker.stats.count(VoiceCounter::DatagramsReceived, static_cast< std::uint64_t >(count));
 
-				const QPair< HostAddress, quint16 > &key = QPair< HostAddress, quint16 >(ha, port);
+		for (int i = 0; i < count; ++i) {
+			const std::size_t index  = static_cast< std::size_t >(i);
+			const std::size_t length = std::min(ring.getLength(index), Mumble::Protocol::MAX_UDP_PACKET_SIZE + 1);
 
-				ServerUser *u = qhPeerUsers.value(key);
+			processDatagram(worker, ring.getSocket(index), ring.getSender(index), ring.getData(index),
+							static_cast< qint32 >(length), &ring.getHeader(index));
+		}
+		ring.recycle();
 
-				if (u) {
-					m_udpDecoder.setProtocolVersion(u->m_version);
-				} else {
-					m_udpDecoder.setProtocolVersion(Version::UNKNOWN);
-				}
-				// This may be a general ping requesting server details, unencrypted.
-				if (bAllowPing
-					&& m_udpDecoder.decodePing(
-						std::span< Mumble::Protocol::byte >(encrypt, static_cast< std::size_t >(len)))
-					&& m_udpDecoder.getMessageType() == Mumble::Protocol::UDPMessageType::Ping) {
-					ZoneScopedN(TracyConstants::PING_PROCESSING_ZONE);
+		if (ring.isNotified()) {
+			worker.sendBatch.flush();
 
-					std::span< const Mumble::Protocol::byte > encodedPing =
-						handlePing(m_udpDecoder, m_udpPingEncoder, true);
+			// Drain pipe
+			unsigned char val;
+			while (::recv(worker.notify[0], &val, 1, MSG_DONTWAIT) == 1) {
+			};
+			return true;
+		}
+
+		ring.send(worker.sendBatch);
+	}
+
+	if (error != 0) {
+		qWarning("Voice thread %u of server %d: io_uring is not usable (%s), falling back to poll()", worker.index,
+				 iServerNum, strerror(-error));
+		return false;
+	}
+
+	return true;
+}
+#endif
+
+#ifdef Q_OS_UNIX
+void Server::processDatagram(VoiceWorker &worker, int sock, struct sockaddr_storage &from, unsigned char *encrypt,
+							 qint32 len, struct msghdr *header) {
+#else
+void Server::processDatagram(VoiceWorker &worker, SOCKET sock, struct sockaddr_storage &from, unsigned char *encrypt,
+							 qint32 len, struct msghdr *header) {
+#endif
+	// Capture only the processing without the polling
+	ZoneScopedN(TracyConstants::UDP_PACKET_PROCESSING_ZONE);
+
+	unsigned char buffer[Mumble::Protocol::MAX_UDP_PACKET_SIZE];
+
+	if (len == 0) {
+		return;
+	} else if (len == SOCKET_ERROR) {
+		return;
+	} else if (len < 5) {
+		// 4 bytes crypt header + type + session
+		return;
+	} else if (static_cast< unsigned int >(len) > Mumble::Protocol::MAX_UDP_PACKET_SIZE) {
+		// This will also catch the len == -1 case (indicating error)
+		static_assert(static_cast< unsigned int >(-1) > Mumble::Protocol::MAX_UDP_PACKET_SIZE, "Invalid assumption");
+		return;
+	}
+
+	QReadLocker rl(&qrwlVoiceThread);
+
+	const PeerKey key = PeerKey::fromSockaddr(from);
+
+	ServerUser *u = m_peerUsers.value(key);
+
+	if (u) {
+		worker.decoder.setProtocolVersion(u->m_version);
+	} else {
+		worker.decoder.setProtocolVersion(Version::UNKNOWN);
+	}
+	// This may be a general ping requesting server details, unencrypted.
+	if (bAllowPing
+		&& worker.decoder.decodePing(std::span< Mumble::Protocol::byte >(encrypt, static_cast< std::size_t >(len)))
+		&& worker.decoder.getMessageType() == Mumble::Protocol::UDPMessageType::Ping) {
+		ZoneScopedN(TracyConstants::PING_PROCESSING_ZONE);
 
-					if (!encodedPing.empty()) {
+		std::span< const Mumble::Protocol::byte > encodedPing = handlePing(worker.decoder, worker.pingEncoder, true);
+
+		if (!encodedPing.empty()) {
 #ifdef Q_OS_LINUX
-						// We are only reading from the buffer and thus the const_cast should be fine
-						iov[0].iov_base = const_cast< Mumble::Protocol::byte * >(encodedPing.data());
-						iov[0].iov_len  = encodedPing.size();
-						::sendmsg(sock, &msg, 0);
+			// Reply using the header the ping has been received with, so that the reply is sent from the same
+			// local address. We are only reading from the buffer and thus the const_cast should be fine.
+			header->msg_iov[0].iov_base = const_cast< Mumble::Protocol::byte * >(encodedPing.data());
+			header->msg_iov[0].iov_len  = encodedPing.size();
+			::sendmsg(sock, header, 0);
 #else
+			Q_UNUSED(header);
 #	ifdef Q_OS_WIN
-						using size_type = int;
+			using size_type = int;
+			using len_type  = int;
 #	else
-						using size_type = std::size_t;
+			using size_type = std::size_t;
+			using len_type  = socklen_t;
 #	endif
-						::sendto(sock, reinterpret_cast< const char * >(encodedPing.data()),
-								 static_cast< size_type >(encodedPing.size()), 0,
-								 reinterpret_cast< struct sockaddr * >(&from), fromlen);
+			::sendto(sock, reinterpret_cast< const char * >(encodedPing.data()),
+					 static_cast< size_type >(encodedPing.size()), 0, reinterpret_cast< struct sockaddr * >(&from),
+					 static_cast< len_type >((from.ss_family == AF_INET6) ? sizeof(struct sockaddr_in6)
+																		   : sizeof(struct sockaddr_in)));
 #endif
-					}
+		}
+
+		return;
+	}
+
+
+	if (u) {
+		const auto decryptStart = VoiceStats::Clock::now();
+		const bool decrypted    = checkDecrypt(u, encrypt, buffer, static_cast< unsigned int >(len));
+		worker.stats.recordSince(VoiceStage::Decrypt, decryptStart);
+
+		if (!decrypted) {
+			worker.stats.count(VoiceDrop::DecryptFailure);
+			return;
+		}
+	} else {
+		ZoneScopedN(TracyConstants::DECRYPT_UNKNOWN_PEER_ZONE);
 
-					continue;
+		// Unknown peer
+		const QList< ServerUser * > candidates = qhHostUsers.value(HostAddress(from));
+		if (candidates.isEmpty()) {
+			worker.stats.count(VoiceDrop::UnknownPeer);
+			return;
+		}
+
+		// Bound the amount of work per datagram. Otherwise, every datagram of a host with many unmatched users
+		// (e.g. lots of clients connecting from behind the same NAT) would be trial-decrypted for all of them.
+		const std::size_t candidateCount = static_cast< std::size_t >(candidates.size());
+		const std::size_t attempts       = std::min(candidateCount, MAX_TRIAL_DECRYPTS_PER_DATAGRAM);
+
+		if (worker.trialDecryptCursors.size() >= MAX_TRIAL_DECRYPT_CURSORS
+			&& !worker.trialDecryptCursors.contains(key)) {
+			// Most likely these are stale entries of peers that never turned out to be one of our users
+			worker.trialDecryptCursors.clear();
+		}
+		std::uint32_t &cursor   = worker.trialDecryptCursors[key];
+		const std::size_t first = cursor % candidateCount;
+		cursor                  = static_cast< std::uint32_t >((first + attempts) % candidateCount);
+
+		for (std::size_t i = 0; i < attempts; ++i) {
+			ServerUser *usr = candidates[static_cast< qsizetype >((first + i) % candidateCount)];
+
+			if (checkDecrypt(usr, encrypt, buffer,
+							 static_cast< unsigned int >(len))) { // checkDecrypt takes the User's qrwlCrypt lock.
+				worker.trialDecryptCursors.remove(key);
+
+				// Every time we relock, reverify users' existence.
+				// The main thread might delete the user while the lock isn't held.
+				unsigned int uiSession = usr->uiSession;
+				rl.unlock();
+				qrwlVoiceThread.lockForWrite();
+				if (qhUsers.contains(uiSession)) {
+					u             = usr;
+					u->sUdpSocket = sock;
+					memcpy(&u->saiUdpAddress, &from, sizeof(from));
+					removeUnmatchedHostUser(*u);
+					m_peerUsers.insert(key, u);
 				}
+				qrwlVoiceThread.unlock();
+				rl.relock();
+				if (u && !qhUsers.contains(uiSession))
+					u = nullptr;
+				break;
+			}
+		}
+		if (!u) {
+			worker.stats.count(VoiceDrop::UnknownPeer);
+			return;
+		}
+	}
+	len -= 4;
 
+	if (worker.decoder.decode(std::span< Mumble::Protocol::byte >(buffer, static_cast< std::size_t >(len)))) {
+		switch (worker.decoder.getMessageType()) {
+			case Mumble::Protocol::UDPMessageType::Audio: {
+				Mumble::Protocol::AudioData audioData = worker.decoder.getAudioData();
 
-				if (u) {
-					if (!checkDecrypt(u, encrypt, buffer, static_cast< unsigned int >(len))) {
-						continue;
-					}
-				} else {
-					ZoneScopedN(TracyConstants::DECRYPT_UNKNOWN_PEER_ZONE);
-
-					// Unknown peer
-					for (ServerUser *usr : qhHostUsers.value(ha)) {
-						if (checkDecrypt(
-								usr, encrypt, buffer,
-								static_cast< unsigned int >(len))) { // checkDecrypt takes the User's qrwlCrypt lock.
-							// Every time we relock, reverify users' existence.
-							// The main thread might delete the user while the lock isn't held.
-							unsigned int uiSession = usr->uiSession;
-							rl.unlock();
-							qrwlVoiceThread.lockForWrite();
-							if (qhUsers.contains(uiSession)) {
-								u             = usr;
-								u->sUdpSocket = sock;
-								memcpy(&u->saiUdpAddress, &from, sizeof(from));
-								qhHostUsers[from].remove(u);
-								qhPeerUsers.insert(key, u);
-							}
-							qrwlVoiceThread.unlock();
-							rl.relock();
-							if (u && !qhUsers.contains(uiSession))
-								u = nullptr;
-							break;
-						}
-					}
-					if (!u) {
-						continue;
-					}
+				// Allow all voice packets through by default.
+				bool ok = true;
+				// ...Unless we're in Opus mode. In Opus mode, only Opus packets are allowed.
+				if (bOpus && audioData.usedCodec != Mumble::Protocol::AudioCodec::Opus) {
+					ok = false;
 				}
-				len -= 4;
-
-				if (m_udpDecoder.decode(std::span< Mumble::Protocol::byte >(buffer, static_cast< std::size_t >(len)))) {
-					switch (m_udpDecoder.getMessageType()) {
-						case Mumble::Protocol::UDPMessageType::Audio: {
-							Mumble::Protocol::AudioData audioData = m_udpDecoder.getAudioData();
-
-							// Allow all voice packets through by default.
-							bool ok = true;
-							// ...Unless we're in Opus mode. In Opus mode, only Opus packets are allowed.
-							if (bOpus && audioData.usedCodec != Mumble::Protocol::AudioCodec::Opus) {
-								ok = false;
-							}
 
-							if (ok) {
-								u->aiUdpFlag = 1;
+				if (ok) {
+					u->aiUdpFlag = 1;
 
-								// Add session id
-								audioData.senderSession = u->uiSession;
+					// Add session id
+					audioData.senderSession = u->uiSession;
 
-								processMsg(u, audioData, m_udpAudioReceivers, m_udpAudioEncoder);
-							}
-							break;
-						}
-						case Mumble::Protocol::UDPMessageType::Ping: {
-							ZoneScopedN(TracyConstants::UDP_PING_PROCESSING_ZONE);
-
-							Mumble::Protocol::PingData pingData = m_udpDecoder.getPingData();
-							if (!pingData.requestAdditionalInformation && !pingData.containsAdditionalInformation) {
-								// At this point here, we only want to handle connectivity pings
-								std::span< const Mumble::Protocol::byte > encodedPing =
-									handlePing(m_udpDecoder, m_udpPingEncoder, false);
-
-								QByteArray cache;
-								sendMessage(*u, encodedPing.data(), static_cast< int >(encodedPing.size()), cache,
-											true);
-							}
-							break;
-						}
-					}
+					processMsg(u, audioData, worker.audioReceivers, worker.audioEncoder, worker.getSendBatch(),
+							   worker.stats);
 				}
-#ifdef Q_OS_UNIX
-				fds[i].revents = 0;
-#endif
+				break;
+			}
+			case Mumble::Protocol::UDPMessageType::Ping: {
+				ZoneScopedN(TracyConstants::UDP_PING_PROCESSING_ZONE);
+
+				Mumble::Protocol::PingData pingData = worker.decoder.getPingData();
+				if (!pingData.requestAdditionalInformation && !pingData.containsAdditionalInformation) {
+					// At this point here, we only want to handle connectivity pings
+					std::span< const Mumble::Protocol::byte > encodedPing =
+						handlePing(worker.decoder, worker.pingEncoder, false);
+
+					QByteArray cache;
+					sendMessage(*u, encodedPing.data(), static_cast< int >(encodedPing.size()), cache, true,
+								worker.getSendBatch());
+				}
+				break;
 			}
 		}
 	}
-#ifdef Q_OS_WIN
-	for (unsigned int i = 0; i < nfds - 1; ++i) {
-		::WSAEventSelect(fds[i], nullptr, 0);
-		CloseHandle(events[i]);
+}
+
+void Server::removeUnmatchedHostUser(ServerUser &user) {
+	auto it = qhHostUsers.find(user.haAddress);
+	if (it == qhHostUsers.end()) {
+		return;
+	}
+
+	it->removeOne(&user);
+	if (it->isEmpty()) {
+		qhHostUsers.erase(it);
 	}
-#endif
 }
 
 bool Server::checkDecrypt(ServerUser *u, const unsigned char *encrypt, unsigned char *plain, unsigned int len) {
@@ -1056,20 +1258,38 @@ bool Server::checkDecrypt(ServerUser *u, const unsigned char *encrypt, unsigned
 	return false;
 }
 
-void Server::sendMessage(ServerUser &u, const unsigned char *data, int len, QByteArray &cache, bool force) {
+void Server::sendMessage(ServerUser &u, const unsigned char *data, int len, QByteArray &cache, bool force,
+						 UDPSendBatch *batch, QList< unsigned int > *tcpReceivers) {
 	ZoneScoped;
 
 	if ((u.aiUdpFlag.loadRelaxed() == 1 || force) && (u.sUdpSocket != INVALID_SOCKET)) {
 #if defined(__LP64__)
-		static std::vector< char > ebuffer;
-		ebuffer.resize(static_cast< std::size_t >(len + 4 + 16));
-		char *buffer = reinterpret_cast< char * >(
-			((reinterpret_cast< quint64 >(ebuffer.data()) + 8) & static_cast< quint64 >(~7)) + 4);
+		// Every voice thread needs its own buffer
+		thread_local std::vector< char > ebuffer;
 #else
 		std::vector< char > bufVec;
-		bufVec.resize(static_cast< std::size_t >(len + 4));
-		char *buffer    = bufVec.data();
 #endif
+		char *buffer = nullptr;
+#ifdef Q_OS_LINUX
+		if (batch && static_cast< std::size_t >(len) + 4 <= UDPBatch::MAX_DATAGRAM_SIZE) {
+			// Encrypt right into the batch
+			buffer = reinterpret_cast< char * >(batch->prepare());
+		} else {
+			batch = nullptr;
+		}
+#else
+		Q_UNUSED(batch);
+#endif
+		if (!buffer) {
+#if defined(__LP64__)
+			ebuffer.resize(static_cast< std::size_t >(len + 4 + 16));
+			buffer = reinterpret_cast< char * >(
+				((reinterpret_cast< quint64 >(ebuffer.data()) + 8) & static_cast< quint64 >(~7)) + 4);
+#else
+			bufVec.resize(static_cast< std::size_t >(len + 4));
+			buffer = bufVec.data();
+#endif
+		}
 		{
 			QMutexLocker wl(&u.qmCrypt);
 
@@ -1089,46 +1309,27 @@ void Server::sendMessage(ServerUser &u, const unsigned char *data, int len, QByt
 							   QOSTrafficTypeVoice, QOS_NON_ADAPTIVE_FLOW, reinterpret_cast< PQOS_FLOWID >(&dwFlow));
 #endif
 #ifdef Q_OS_LINUX
+		if (batch) {
+			batch->commit(u.sUdpSocket, u.saiUdpAddress, HostAddress(u.saiTcpLocalAddress),
+						  static_cast< std::size_t >(len + 4));
+			return;
+		}
+
 		struct msghdr msg;
 		struct iovec iov[1];
 
 		iov[0].iov_base = buffer;
 		iov[0].iov_len  = static_cast< unsigned int >(len + 4);
 
-		uint8_t controldata[CMSG_SPACE(std::max(sizeof(struct in6_pktinfo), sizeof(struct in_pktinfo)))];
-		memset(controldata, 0, sizeof(controldata));
+		alignas(struct cmsghdr) uint8_t controldata[UDPBatch::PKTINFO_CONTROL_SIZE];
 
 		memset(&msg, 0, sizeof(msg));
-		msg.msg_name    = reinterpret_cast< struct sockaddr * >(&u.saiUdpAddress);
-		msg.msg_namelen = static_cast< socklen_t >(
-			(u.saiUdpAddress.ss_family == AF_INET6) ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in));
-		msg.msg_iov        = iov;
-		msg.msg_iovlen     = 1;
-		msg.msg_control    = controldata;
-		msg.msg_controllen = CMSG_SPACE((u.saiUdpAddress.ss_family == AF_INET6) ? sizeof(struct in6_pktinfo)
-																				: sizeof(struct in_pktinfo));
-
-		struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
-		HostAddress tcpha(u.saiTcpLocalAddress);
-		if (u.saiUdpAddress.ss_family == AF_INET6) {
-			cmsg->cmsg_level            = IPPROTO_IPV6;
-			cmsg->cmsg_type             = IPV6_PKTINFO;
-			cmsg->cmsg_len              = CMSG_LEN(sizeof(struct in6_pktinfo));
-			struct in6_pktinfo *pktinfo = reinterpret_cast< struct in6_pktinfo * >(CMSG_DATA(cmsg));
-			memset(pktinfo, 0, sizeof(*pktinfo));
-			memcpy(&pktinfo->ipi6_addr.s6_addr[0], tcpha.getByteRepresentation().data(),
-				   sizeof(pktinfo->ipi6_addr.s6_addr));
-		} else {
-			cmsg->cmsg_level           = IPPROTO_IP;
-			cmsg->cmsg_type            = IP_PKTINFO;
-			cmsg->cmsg_len             = CMSG_LEN(sizeof(struct in_pktinfo));
-			struct in_pktinfo *pktinfo = reinterpret_cast< struct in_pktinfo * >(CMSG_DATA(cmsg));
-			memset(pktinfo, 0, sizeof(*pktinfo));
-			if (tcpha.isV6())
-				return;
-			pktinfo->ipi_spec_dst.s_addr = tcpha.toIPv4();
-		}
+		msg.msg_iov     = iov;
+		msg.msg_iovlen  = 1;
+		msg.msg_control = controldata;
 
+		if (!UDPBatch::setupMessageHeader(msg, u.saiUdpAddress, HostAddress(u.saiTcpLocalAddress)))
+			return;
 
 		::sendmsg(u.sUdpSocket, &msg, 0);
 #else
@@ -1147,25 +1348,32 @@ void Server::sendMessage(ServerUser &u, const unsigned char *data, int len, QByt
 #else
 #endif
 	} else {
-		if (cache.isEmpty())
-			cache = QByteArray(reinterpret_cast< const char * >(data), len);
-		emit tcpTransmit(cache, u.uiSession);
+		if (cache.isEmpty()) {
+			// The message is built only once and shared (not copied) by all receivers it is sent to
+			cache.resize(len + 6);
+			unsigned char *uc = reinterpret_cast< unsigned char * >(cache.data());
+			qToBigEndian< quint16 >(static_cast< quint16 >(Mumble::Protocol::TCPMessageType::UDPTunnel), &uc[0]);
+			qToBigEndian< quint32 >(static_cast< quint32 >(len), &uc[2]);
+			memcpy(uc + 6, data, static_cast< std::size_t >(len));
+		}
+
+		if (tcpReceivers) {
+			tcpReceivers->append(u.uiSession);
+		} else {
+			emit tcpTransmit(cache, { u.uiSession });
+		}
 	}
 }
 
-void Server::addListener(QHash< ServerUser *, VolumeAdjustment > &listeners, ServerUser &user, const Channel &channel) {
-	const VolumeAdjustment &volumeAdjustment =
-		m_channelListenerManager.getListenerVolumeAdjustment(user.uiSession, channel.iId);
-
-	auto it = listeners.find(&user);
-
-	if (it == listeners.end() || it->factor < volumeAdjustment.factor) {
-		listeners[&user] = volumeAdjustment;
-	}
+void Server::addListener(std::vector< std::pair< ServerUser *, VolumeAdjustment > > &listeners, ServerUser &user,
+						 const Channel &channel) {
+	// Duplicates are resolved once the list is complete (see createWhisperTargetCacheFor)
+	listeners.emplace_back(&user, m_channelListenerManager.getListenerVolumeAdjustment(user.uiSession, channel.iId));
 }
 
 void Server::processMsg(ServerUser *u, Mumble::Protocol::AudioData audioData, AudioReceiverBuffer &buffer,
-						Mumble::Protocol::UDPAudioEncoder< Mumble::Protocol::Role::Server > &encoder) {
+						Mumble::Protocol::UDPAudioEncoder< Mumble::Protocol::Role::Server > &encoder,
+						UDPSendBatch *sendBatch, VoiceStats &stats) {
 	ZoneScoped;
 
 	// Note that in this function we never have to acquire a read-lock on qrwlVoiceThread
@@ -1176,6 +1384,8 @@ void Server::processMsg(ServerUser *u, Mumble::Protocol::AudioData audioData, Au
 	if (u->sState != ServerUser::Authenticated || u->bMute || u->bSuppress || u->bSelfMute)
 		return;
 
+	VoiceStats::Clock::time_point stageStart = VoiceStats::Clock::now();
+
 	// Check the voice data rate limit.
 	{
 		BandwidthRecord *bw = &u->bwr;
@@ -1185,10 +1395,13 @@ void Server::processMsg(ServerUser *u, Mumble::Protocol::AudioData audioData, Au
 
 		if (!bw->addFrame(static_cast< int >(packetsize), iMaxBandwidth / 8)) {
 			// Suppress packet.
+			stats.count(VoiceDrop::BandwidthLimit);
 			return;
 		}
 	}
 
+	stats.count(VoiceCounter::AudioPackets);
+
 	buffer.clear();
 
 	if (audioData.targetOrContext == Mumble::Protocol::ReservedTargetIDs::SERVER_LOOPBACK) {
@@ -1196,108 +1409,88 @@ void Server::processMsg(ServerUser *u, Mumble::Protocol::AudioData audioData, Au
 	} else if (audioData.targetOrContext == Mumble::Protocol::ReservedTargetIDs::REGULAR_SPEECH) {
 		Channel *c = u->cChannel;
 
-		// Send audio to all users that are listening to the channel
-		for (unsigned int currentSession : m_channelListenerManager.getListenersForChannel(c->iId)) {
-			ServerUser *pDst = static_cast< ServerUser * >(qhUsers.value(currentSession));
-			if (pDst) {
-				buffer.addReceiver(*u, *pDst, Mumble::Protocol::AudioContext::LISTEN, audioData.containsPositionalData,
-								   m_channelListenerManager.getListenerVolumeAdjustment(pDst->uiSession, c->iId));
+		std::shared_ptr< const SpeechTargetCache > cache;
+		{
+			QMutexLocker cacheLock(&u->m_speechTargetCacheMutex);
+			cache = u->m_speechTargetCache;
+		}
+
+		// Note: The epoch has to be read before collecting the targets. Otherwise we might store targets that have been
+		// computed before a change under an epoch that has been bumped because of that very change.
+		const std::uint64_t epoch = m_voiceRoutingEpoch.load();
+		if (!cache || cache->epoch != epoch || cache->channelID != c->iId) {
+			ZoneScopedN(TracyConstants::AUDIO_SPEECH_CACHE_CREATE);
+
+			// The targets are collected without holding the mutex, so other threads routing audio of this user don't
+			// have to wait for it (at worst, they collect the same targets concurrently). The read lock on
+			// qrwlVoiceThread keeps the collected users alive for as long as this packet is being routed.
+			auto newCache       = std::make_shared< SpeechTargetCache >();
+			newCache->epoch     = epoch;
+			newCache->channelID = c->iId;
+			collectSpeechTargets(*u, *c, newCache->targets);
+			cache = newCache;
+
+			QMutexLocker cacheLock(&u->m_speechTargetCacheMutex);
+			// Don't replace an entry that another thread has computed for a later epoch in the meantime
+			if (!u->m_speechTargetCache || u->m_speechTargetCache->epoch <= epoch) {
+				u->m_speechTargetCache = std::move(newCache);
 			}
 		}
 
-		// Send audio to all users in the same channel
-		for (User *p : c->qlUsers) {
-			ServerUser *pDst = static_cast< ServerUser * >(p);
-
-			buffer.addReceiver(*u, *pDst, Mumble::Protocol::AudioContext::NORMAL, audioData.containsPositionalData);
-		}
-
-		// Send audio to all linked channels the user has speak-permission
-		if (!c->qhLinks.isEmpty()) {
-			QSet< Channel * > chans = c->allLinks();
-			chans.remove(c);
-
-			QMutexLocker qml(&qmCache);
-
-			for (Channel *l : chans) {
-				if (ChanACL::hasPermission(u, l, ChanACL::Speak, &acCache)) {
-					// Send the audio stream to all users that are listening to the linked channel
-					for (unsigned int currentSession : m_channelListenerManager.getListenersForChannel(l->iId)) {
-						ServerUser *pDst = static_cast< ServerUser * >(qhUsers.value(currentSession));
-						if (pDst) {
-							buffer.addReceiver(
-								*u, *pDst, Mumble::Protocol::AudioContext::LISTEN, audioData.containsPositionalData,
-								m_channelListenerManager.getListenerVolumeAdjustment(pDst->uiSession, l->iId));
-						}
-					}
-
-					// Send audio to users in the linked channel
-					for (User *p : l->qlUsers) {
-						ServerUser *pDst = static_cast< ServerUser * >(p);
-
-						buffer.addReceiver(*u, *pDst, Mumble::Protocol::AudioContext::NORMAL,
-										   audioData.containsPositionalData);
-					}
-				}
-			}
+		for (const SpeechTarget &target : cache->targets) {
+			buffer.addReceiver(*u, *target.receiver, target.context, audioData.containsPositionalData,
+							   target.volumeAdjustment);
 		}
 	} else if (u->qmTargets.contains(static_cast< int >(audioData.targetOrContext))) { // Whisper/Shout
-		QSet< ServerUser * > channel;
-		QSet< ServerUser * > direct;
-		QHash< ServerUser *, VolumeAdjustment > cachedListeners;
+		std::shared_ptr< const WhisperTargetCache > cache;
 
-		if (u->qmTargetCache.contains(static_cast< int >(audioData.targetOrContext))) {
-			ZoneScopedN(TracyConstants::AUDIO_WHISPER_CACHE_STORE);
+		const int targetID = static_cast< int >(audioData.targetOrContext);
 
-			const WhisperTargetCache &cache = u->qmTargetCache.value(static_cast< int >(audioData.targetOrContext));
-			channel                         = cache.channelTargets;
-			direct                          = cache.directTargets;
-			cachedListeners                 = cache.listeningTargets;
-		} else {
+		QMutexLocker targetCacheLock(&u->m_targetCacheMutex);
+		auto cacheIt = u->qmTargetCache.constFind(targetID);
+		if (cacheIt == u->qmTargetCache.constEnd()) {
 			ZoneScopedN(TracyConstants::AUDIO_WHISPER_CACHE_CREATE);
 
-			const unsigned int uiSession = u->uiSession;
-			qrwlVoiceThread.unlock();
-			qrwlVoiceThread.lockForWrite();
-
-			if (!qhUsers.contains(uiSession)) {
-				return;
-			}
-
 			// Create cache entry for the given target
-			// Note: We have to compute the cache entry and add it to the user's cache store in an atomic
-			// transaction (ensured by the lock) to avoid running into situations in which a user from the cache
-			// gets deleted without this particular cache entry being purged (which happens, if the cache entry is
-			// in the store at the point of deleting the user).
-			const WhisperTarget &wt  = u->qmTargets.value(static_cast< int >(audioData.targetOrContext));
-			WhisperTargetCache cache = createWhisperTargetCacheFor(*u, wt);
-
-			u->qmTargetCache.insert(static_cast< int >(audioData.targetOrContext), std::move(cache));
+			// Note: The cache entry has to be computed and added to the user's cache store without releasing the read
+			// lock in between. Purging the cache (e.g. when a user is deleted) requires the write lock, so this ensures
+			// that we never store an entry that references a user that has been removed in the meantime.
+			// createWhisperTargetCacheFor only reads the server state (the ACL cache has its own mutex), so holding the
+			// read lock is sufficient and we don't have to stall the main thread by upgrading to the write lock.
+			targetCacheLock.unlock();
+			auto newCache = std::make_shared< const WhisperTargetCache >(
+				createWhisperTargetCacheFor(*u, u->qmTargets.value(targetID)));
+			targetCacheLock.relock();
+
+			// Another thread might have created the same entry in the meantime, in which case we use theirs
+			cacheIt = u->qmTargetCache.constFind(targetID);
+			if (cacheIt == u->qmTargetCache.constEnd()) {
+				cacheIt = u->qmTargetCache.insert(targetID, std::move(newCache));
+			}
+		}
 
+		{
+			ZoneScopedN(TracyConstants::AUDIO_WHISPER_CACHE_STORE);
 
-			qrwlVoiceThread.unlock();
-			qrwlVoiceThread.lockForRead();
-			if (!qhUsers.contains(uiSession))
-				return;
+			// Entries are immutable, so sharing ownership is enough to keep iterating over the entry after the mutex
+			// has been released, even if the entry gets dropped from the cache in the meantime. The users referenced by
+			// it stay valid as long as we are holding the read lock.
+			cache = cacheIt.value();
 		}
+		targetCacheLock.unlock();
 
 		// These users receive the audio because someone is shouting to their channel
-		for (ServerUser *pDst : channel) {
+		for (ServerUser *pDst : cache->channelTargets) {
 			buffer.addReceiver(*u, *pDst, Mumble::Protocol::AudioContext::SHOUT, audioData.containsPositionalData);
 		}
 		// These users receive audio because someone is whispering to them
-		for (ServerUser *pDst : direct) {
+		for (ServerUser *pDst : cache->directTargets) {
 			buffer.addReceiver(*u, *pDst, Mumble::Protocol::AudioContext::WHISPER, audioData.containsPositionalData);
 		}
 		// These users receive audio because someone is sending audio to one of their listeners
-		QHashIterator< ServerUser *, VolumeAdjustment > it(cachedListeners);
-		while (it.hasNext()) {
-			it.next();
-			ServerUser *user                         = it.key();
-			const VolumeAdjustment &volumeAdjustment = it.value();
-
-			buffer.addReceiver(*u, *user, Mumble::Protocol::AudioContext::LISTEN, audioData.containsPositionalData,
-							   volumeAdjustment);
+		for (const std::pair< ServerUser *, VolumeAdjustment > &listener : cache->listeningTargets) {
+			buffer.addReceiver(*u, *listener.first, Mumble::Protocol::AudioContext::LISTEN,
+							   audioData.containsPositionalData, listener.second);
 		}
 	}
 
@@ -1305,8 +1498,16 @@ void Server::processMsg(ServerUser *u, Mumble::Protocol::AudioData audioData, Au
 
 	buffer.preprocessBuffer();
 
+	stageStart = stats.recordSince(VoiceStage::Route, stageStart);
+	stats.count(VoiceCounter::AudioPacketsSent, buffer.getReceivers(true).size() + buffer.getReceivers(false).size());
+
+	// The encoding is interleaved with sending the packets, so its time is accumulated and subtracted from the time
+	// it took to send out the packet to all receivers
+	VoiceStats::Clock::duration encodeTime{};
+
 	bool isFirstIteration = true;
 	QByteArray tcpCache;
+	QList< unsigned int > tcpReceivers;
 	for (bool includePositionalData : { true, false }) {
 		std::vector< AudioReceiver > &receiverList = buffer.getReceivers(includePositionalData);
 
@@ -1328,6 +1529,8 @@ void Server::processMsg(ServerUser *u, Mumble::Protocol::AudioData audioData, Au
 																	currentRange.begin->getReceiver().m_version)) {
 				ZoneScopedN(TracyConstants::AUDIO_ENCODE);
 
+				const auto encodeStart = VoiceStats::Clock::now();
+
 				encoder.setProtocolVersion(currentRange.begin->getReceiver().m_version);
 
 				// We have to re-encode the "fixed" part of the audio message
@@ -1338,6 +1541,8 @@ void Server::processMsg(ServerUser *u, Mumble::Protocol::AudioData audioData, Au
 				}
 
 				isFirstIteration = false;
+
+				encodeTime += VoiceStats::Clock::now() - encodeStart;
 			}
 
 			audioData.targetOrContext  = currentRange.begin->getContext();
@@ -1345,7 +1550,9 @@ void Server::processMsg(ServerUser *u, Mumble::Protocol::AudioData audioData, Au
 
 			// Update data
 			TracyCZoneN(__tracy_zone, TracyConstants::AUDIO_UPDATE, true);
+			const auto updateStart                                  = VoiceStats::Clock::now();
 			std::span< const Mumble::Protocol::byte > encodedPacket = encoder.updateAudioPacket(audioData);
+			encodeTime += VoiceStats::Clock::now() - updateStart;
 			TracyCZoneEnd(__tracy_zone);
 
 			// Clear TCP cache
@@ -1354,13 +1561,22 @@ void Server::processMsg(ServerUser *u, Mumble::Protocol::AudioData audioData, Au
 			// Send encoded packet to all receivers of this range
 			for (auto it = currentRange.begin; it != currentRange.end; ++it) {
 				sendMessage(it->getReceiver(), encodedPacket.data(), static_cast< int >(encodedPacket.size()),
-							tcpCache);
+							tcpCache, false, sendBatch, &tcpReceivers);
+			}
+
+			// Receivers without a working UDP connection get the packet through their TCP connection instead
+			if (!tcpReceivers.isEmpty()) {
+				emit tcpTransmit(tcpCache, tcpReceivers);
+				tcpReceivers.clear();
 			}
 
 			// Find next range
 			currentRange = AudioReceiverBuffer::getReceiverRange(currentRange.end, receiverList.end());
 		}
 	}
+
+	stats.record(VoiceStage::Encode, encodeTime);
+	stats.record(VoiceStage::Send, VoiceStats::Clock::now() - stageStart - encodeTime);
 }
 
 void Server::log(ServerUser *u, const QString &str) const {
@@ -1370,12 +1586,41 @@ void Server::log(ServerUser *u, const QString &str) const {
 
 void Server::log(const QString &msg) const {
 	if (meta->assumedDBState == DBState::Normal && Meta::mp->iLogDays >= 0) {
+		writeToDB(DBWrite::logMessage(iServerNum, msg.toStdString()));
+	}
+
+	qWarning("%d => %s", iServerNum, msg.toUtf8().constData());
+}
+
+void Server::writeToDB(DBWrite write) const {
+	if (meta->dbWriteQueue) {
+		meta->dbWriteQueue->enqueue(std::move(write));
+	} else {
 		// New philosophy is that DB access can't be considered const, but old code requires this function
 		// to be const. Thus, we require a const_cast here.
-		const_cast< DBWrapper & >(m_dbWrapper).logMessage(iServerNum, msg.toStdString());
+		const_cast< DBWrapper & >(m_dbWrapper).performWrites({ std::move(write) });
 	}
+}
 
-	qWarning("%d => %s", iServerNum, msg.toUtf8().constData());
+void Server::writeUserPropertyToDB(DBWrite write) {
+	if (meta->dbWriteQueue) {
+		m_dbWrapper.updateRegisteredUserIndex(write);
+	}
+
+	writeToDB(std::move(write));
+}
+
+void Server::flushDBWrites(unsigned int userID) const {
+	flushDBWrites([userID](const DBWrite &write) {
+		return write.type != DBWrite::Type::LogMessage && write.userID == userID;
+	});
+}
+
+void Server::flushDBWrites(const std::function< bool(const DBWrite &) > &affects) const {
+	if (meta->dbWriteQueue) {
+		meta->dbWriteQueue->flush(
+			[this, &affects](const DBWrite &write) { return write.serverID == iServerNum && affects(write); });
+	}
 }
 
 void Server::newClient() {
@@ -1389,12 +1634,14 @@ void Server::newClient() {
 
 		QHostAddress adr = sock->peerAddress();
 
+		// This happens before the TLS handshake has even been started, so that a banned client costs as little as
+		// possible
 		if (meta->banCheck(adr)) {
 			log(QString("Ignoring connection: %1 (Global ban)")
 					.arg(addressToString(sock->peerAddress(), sock->peerPort())));
-			sock->disconnectFromHost();
+			sock->abort();
 			sock->deleteLater();
-			return;
+			continue;
 		}
 
 		HostAddress ha(adr);
@@ -1492,7 +1739,17 @@ void Server::newClient() {
 #else
 		sock->setProtocol(QSsl::TlsV1_0OrLater);
 #endif
-		sock->startServerEncryption();
+
+		if (Meta::mp->tcpWriteDelay >= 0) {
+			u->setWriteCoalescing([this](Connection &connection) { m_writeCoalescer.add(connection); });
+		}
+
+		// From here on, the socket must only be accessed through the ServerUser as it may live in another thread.
+		// Such a thread has to decide about SSL errors on its own (sslError() only learns about them afterwards).
+		u->moveSocketToThread(meta->connectionThreads->next(), [](const QList< QSslError > &errors) {
+			return std::all_of(errors.begin(), errors.end(), &Server::isTolerableSslError);
+		});
+		u->startServerEncryption();
 
 		meta->successfulConnectionFrom(adr);
 	}
@@ -1553,23 +1810,11 @@ void Server::sslError(const QList< QSslError > &errors) {
 
 	bool ok = true;
 	for (const QSslError &e : errors) {
-		switch (e.error()) {
-			case QSslError::InvalidPurpose:
-				// Allow email certificates.
-				break;
-			case QSslError::NoPeerCertificate:
-			case QSslError::SelfSignedCertificate:
-			case QSslError::SelfSignedCertificateInChain:
-			case QSslError::UnableToGetLocalIssuerCertificate:
-			case QSslError::UnableToVerifyFirstCertificate:
-			case QSslError::HostNameMismatch:
-			case QSslError::CertificateNotYetValid:
-			case QSslError::CertificateExpired:
-				u->bVerified = false;
-				break;
-			default:
-				log(u, QString("SSL Error: %1").arg(e.errorString()));
-				ok = false;
+		if (!isTolerableSslError(e)) {
+			log(u, QString("SSL Error: %1").arg(e.errorString()));
+			ok = false;
+		} else if (e.error() != QSslError::InvalidPurpose) {
+			u->bVerified = false;
 		}
 	}
 
@@ -1613,6 +1858,24 @@ void Server::sslError(const QList< QSslError > &errors) {
 	}
 }
 
+bool Server::isTolerableSslError(const QSslError &error) {
+	switch (error.error()) {
+		case QSslError::InvalidPurpose:
+			// Allow email certificates.
+		case QSslError::NoPeerCertificate:
+		case QSslError::SelfSignedCertificate:
+		case QSslError::SelfSignedCertificateInChain:
+		case QSslError::UnableToGetLocalIssuerCertificate:
+		case QSslError::UnableToVerifyFirstCertificate:
+		case QSslError::HostNameMismatch:
+		case QSslError::CertificateNotYetValid:
+		case QSslError::CertificateExpired:
+			return true;
+		default:
+			return false;
+	}
+}
+
 void Server::connectionClosed(QAbstractSocket::SocketError err, const QString &reason) {
 	if (reason.contains(QLatin1String("140E0197"))) {
 		// A severe bug was introduced in qt/qtbase@93a803a6de27d9eb57931c431b5f3d074914f693.
@@ -1639,7 +1902,7 @@ void Server::connectionClosed(QAbstractSocket::SocketError err, const QString &r
 	log(u, QString("Connection closed: %1 [%2]").arg(reason).arg(err));
 
 	if (meta->assumedDBState == DBState::Normal && u->iId >= 0) {
-		m_dbWrapper.updateLastDisconnect(iServerNum, static_cast< unsigned int >(u->iId));
+		writeToDB(DBWrite::lastDisconnect(iServerNum, static_cast< unsigned int >(u->iId)));
 	}
 
 	if (u->sState == ServerUser::Authenticated) {
@@ -1667,13 +1930,14 @@ void Server::connectionClosed(QAbstractSocket::SocketError err, const QString &r
 		QWriteLocker wl(&qrwlVoiceThread);
 
 		qhUsers.remove(u->uiSession);
-		qhHostUsers[u->haAddress].remove(u);
+		removeUnmatchedHostUser(*u);
+		// Make sure no cached whisper target references the user anymore
+		clearWhisperTargetCacheFor(*u);
 
-		quint16 port = (u->saiUdpAddress.ss_family == AF_INET6)
-						   ? (reinterpret_cast< sockaddr_in6 * >(&u->saiUdpAddress)->sin6_port)
-						   : (reinterpret_cast< sockaddr_in * >(&u->saiUdpAddress)->sin_port);
-		const QPair< HostAddress, quint16 > &key = QPair< HostAddress, quint16 >(u->haAddress, port);
-		qhPeerUsers.remove(key);
+		const PeerKey key = PeerKey::fromSockaddr(u->saiUdpAddress);
+		if (m_peerUsers.value(key) == u) {
+			m_peerUsers.remove(key);
+		}
 
 		if (old)
 			old->removeUser(u);
@@ -1738,7 +2002,8 @@ void Server::message(Mumble::Protocol::TCPMessageType type, const QByteArray &qb
 					// Add session id
 					audioData.senderSession = u->uiSession;
 
-					processMsg(u, std::move(audioData), m_tcpAudioReceivers, m_tcpAudioEncoder);
+					processMsg(u, std::move(audioData), m_tcpAudioReceivers, m_tcpAudioEncoder, nullptr,
+							   m_tcpVoiceStats);
 				}
 			}
 		}
@@ -1835,22 +2100,34 @@ void Server::checkTimeout() {
 	}
 }
 
-void Server::tcpTransmitData(QByteArray a, unsigned int id) {
-	Connection *c = qhUsers.value(id);
-	if (c) {
-		QByteArray qba;
-		const auto len = a.size();
+void Server::tcpTransmitData(QByteArray frame, QList< unsigned int > sessions) {
+	// A flush is queued as long as there are connections pending to be flushed
+	const bool flushQueued = !m_pendingTunnelFlushes.isEmpty();
+
+	for (unsigned int session : sessions) {
+		Connection *c = qhUsers.value(session);
+		if (c) {
+			c->sendUrgentMessage(frame);
+
+			m_pendingTunnelFlushes.insert(session);
+		}
+	}
 
-		qba.resize(len + 6);
-		unsigned char *uc = reinterpret_cast< unsigned char * >(qba.data());
-		*reinterpret_cast< quint16 * >(&uc[0]) =
-			qToBigEndian(static_cast< quint16 >(Mumble::Protocol::TCPMessageType::UDPTunnel));
-		*reinterpret_cast< quint32 * >(&uc[2]) = qToBigEndian(static_cast< quint32 >(len));
-		memcpy(uc + 6, a.constData(), static_cast< std::size_t >(len));
+	// Instead of flushing after every single packet, the flush is queued behind all audio that has already been
+	// requested to be transmitted, so that it is written out in one go.
+	if (!flushQueued && !m_pendingTunnelFlushes.isEmpty()) {
+		QMetaObject::invokeMethod(this, &Server::flushTunnelledAudio, Qt::QueuedConnection);
+	}
+}
 
-		c->sendMessage(qba);
-		c->forceFlush();
+void Server::flushTunnelledAudio() {
+	for (unsigned int session : m_pendingTunnelFlushes) {
+		Connection *c = qhUsers.value(session);
+		if (c) {
+			c->forceFlush();
+		}
 	}
+	m_pendingTunnelFlushes.clear();
 }
 
 void Server::doSync(unsigned int id) {
@@ -1876,6 +2153,8 @@ void Server::sendProtoAll(const ::google::protobuf::Message &msg, Mumble::Protoc
 void Server::sendProtoExcept(ServerUser *u, const ::google::protobuf::Message &msg,
 							 Mumble::Protocol::TCPMessageType msgType, Version::full_t version,
 							 Version::CompareMode mode) {
+	m_joinStateCache.update(msg, msgType);
+
 	QByteArray cache;
 	for (ServerUser *usr : qhUsers) {
 		if ((usr != u) && (usr->sState == ServerUser::Authenticated)) {
@@ -1904,6 +2183,7 @@ void Server::removeChannel(Channel *chan, Channel *dest) {
 	{
 		QWriteLocker wl(&qrwlVoiceThread);
 		chan->unlink(nullptr);
+		clearWhisperTargetCacheFor(*chan);
 	}
 
 	for (Channel *c : chan->qlChannels) {
@@ -1979,9 +2259,12 @@ bool Server::unregisterUser(int id) {
 	assert(details.contains(static_cast< int >(::mumble::server::db::UserProperty::Name)));
 	qhUserIDCache.remove(details.value(static_cast< int >(::mumble::server::db::UserProperty::Name)));
 	qhUserNameCache.remove(id);
+	m_registrationGeneration++;
 
 	int res = -2;
 	emit unregisterUserSig(res, id);
+	// Queued writes must not end up with a user that is registered with the same ID later on
+	flushDBWrites(static_cast< unsigned int >(id));
 	m_dbWrapper.unregisterUser(iServerNum, static_cast< unsigned int >(id));
 
 
@@ -2038,6 +2321,7 @@ void Server::userEnterChannel(User *p, Channel *c, MumbleProto::UserState &mpus)
 	{
 		QWriteLocker wl(&qrwlVoiceThread);
 		c->addUser(p);
+		invalidateVoiceRouting();
 
 		bool mayspeak = ChanACL::hasPermission(static_cast< ServerUser * >(p), c, ChanACL::Speak, nullptr);
 		bool sup      = p->bSuppress;
@@ -2058,7 +2342,7 @@ void Server::userEnterChannel(User *p, Channel *c, MumbleProto::UserState &mpus)
 	clearACLCache(p);
 
 	if (p->iId >= 0 && !p->cChannel->bTemporary) {
-		m_dbWrapper.setLastChannel(iServerNum, *static_cast< ServerUser * >(p));
+		writeToDB(DBWrite::lastChannel(iServerNum, static_cast< unsigned int >(p->iId), p->cChannel->iId));
 	}
 
 	if (old && old->bTemporary && old->qlUsers.isEmpty()) {
@@ -2159,6 +2443,21 @@ void Server::flushClientPermissionCache(ServerUser *u, MumbleProto::PermissionQu
 	sendMessage(u, mppq);
 }
 
+void Server::updateSuppression(ServerUser *user, MumbleProto::UserState &mpus) {
+	bool maySpeak = ChanACL::hasPermission(user, user->cChannel, ChanACL::Speak, &acCache);
+
+	if (maySpeak == user->bSuppress) {
+		// Mirror a user's ability to speak in the current channel (by means of the ACLs) in the suppress
+		// property (not being allowed to speak -> suppressed and vice versa)
+		user->bSuppress = !maySpeak;
+
+		mpus.Clear();
+		mpus.set_session(user->uiSession);
+		mpus.set_suppress(true);
+		sendAll(mpus);
+	}
+}
+
 void Server::clearACLCache(User *p) {
 	MumbleProto::PermissionQuery mppq;
 
@@ -2167,14 +2466,20 @@ void Server::clearACLCache(User *p) {
 
 		if (p) {
 			ChanACL::ChanCache *h = acCache.take(p);
+			if (h) {
+				m_aclCacheStatistics.droppedEntries += static_cast< std::uint64_t >(h->size());
+			}
 			delete h;
+			++m_aclCacheStatistics.userInvalidations;
 
 			flushClientPermissionCache(static_cast< ServerUser * >(p), mppq);
 		} else {
 			for (ChanACL::ChanCache *h : acCache) {
+				m_aclCacheStatistics.droppedEntries += static_cast< std::uint64_t >(h->size());
 				delete h;
 			}
 			acCache.clear();
+			++m_aclCacheStatistics.fullInvalidations;
 
 			for (ServerUser *u : qhUsers) {
 				if (u->sState == ServerUser::Authenticated) {
@@ -2185,33 +2490,107 @@ void Server::clearACLCache(User *p) {
 
 		// A change in ACLs could also change a user's suppression state
 		MumbleProto::UserState mpus;
-		auto processingFunction = [&](ServerUser *user) {
-			bool maySpeak = ChanACL::hasPermission(user, user->cChannel, ChanACL::Speak, &acCache);
-
-			if (maySpeak == user->bSuppress) {
-				// Mirror a user's ability to speak in the current channel (by means of the ACLs) in the suppress
-				// property (not being allowed to speak -> suppressed and vice versa)
-				user->bSuppress = !maySpeak;
-
-				mpus.Clear();
-				mpus.set_session(user->uiSession);
-				mpus.set_suppress(true);
-				sendAll(mpus);
-			}
-		};
-
 		if (p) {
-			processingFunction(static_cast< ServerUser * >(p));
+			updateSuppression(static_cast< ServerUser * >(p), mpus);
 		} else {
 			for (ServerUser *currentUser : qhUsers) {
-				processingFunction(currentUser);
+				updateSuppression(currentUser, mpus);
 			}
 		}
 	}
 
 	// A change in ACLs means that the user might be able to whisper
 	// to users it didn't have permission to do before (or vice versa)
-	clearWhisperTargetCache();
+	if (p) {
+		QWriteLocker lock(&qrwlVoiceThread);
+
+		clearWhisperTargetCacheFor(*static_cast< ServerUser * >(p));
+	} else {
+		clearWhisperTargetCache();
+	}
+}
+
+void Server::clearACLCacheFor(const Channel &channel) {
+	// The permissions in a channel only depend on the ACLs and groups of the channel itself and its ancestors
+	QSet< unsigned int > affectedChannels;
+	QStack< const Channel * > pending;
+	pending.push(&channel);
+	while (!pending.isEmpty()) {
+		const Channel *current = pending.pop();
+		affectedChannels.insert(current->iId);
+		for (const Channel *child : current->qlChannels) {
+			pending.push(child);
+		}
+	}
+
+	const auto isAffected = [&affectedChannels](const ServerUser &user) {
+		return user.cChannel && affectedChannels.contains(user.cChannel->iId);
+	};
+
+	MumbleProto::PermissionQuery mppq;
+
+	{
+		QMutexLocker qml(&qmCache);
+
+		for (ChanACL::ChanCache *h : acCache) {
+			for (auto it = h->begin(); it != h->end();) {
+				if (affectedChannels.contains(it.key()->iId)) {
+					it = h->erase(it);
+					++m_aclCacheStatistics.droppedEntries;
+				} else {
+					++it;
+				}
+			}
+		}
+		++m_aclCacheStatistics.channelInvalidations;
+
+		MumbleProto::UserState mpus;
+		for (ServerUser *u : qhUsers) {
+			if (u->sState != ServerUser::Authenticated) {
+				continue;
+			}
+
+			// Only users that have been sent permissions for one of the affected channels need to be updated
+			bool permissionsSent = affectedChannels.contains(static_cast< unsigned int >(u->iLastPermissionCheck));
+			for (auto it = u->qmPermissionSent.constBegin(); !permissionsSent && it != u->qmPermissionSent.constEnd();
+				 ++it) {
+				permissionsSent = affectedChannels.contains(static_cast< unsigned int >(it.key()));
+			}
+			if (permissionsSent) {
+				flushClientPermissionCache(u, mppq);
+			}
+
+			if (isAffected(*u)) {
+				updateSuppression(u, mpus);
+			}
+		}
+	}
+
+	// Whisper targets depend on the speaker's permission to whisper into the target channels and the channels of
+	// the users whispered to directly
+	QWriteLocker lock(&qrwlVoiceThread);
+
+	for (ServerUser *u : qhUsers) {
+		for (auto it = u->qmTargetCache.begin(); it != u->qmTargetCache.end();) {
+			const WhisperTargetCache &cache = *it.value();
+
+			bool affected = std::any_of(cache.channels.begin(), cache.channels.end(),
+										[&](unsigned int id) { return affectedChannels.contains(id); });
+			for (std::size_t i = 0; !affected && i < cache.sessions.size(); ++i) {
+				const ServerUser *target = qhUsers.value(cache.sessions[i]);
+				affected                 = target && isAffected(*target);
+			}
+
+			if (affected) {
+				it = u->qmTargetCache.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+
+	// Permissions also determine whether users may speak into linked channels
+	invalidateVoiceRouting();
 }
 
 void Server::clearWhisperTargetCache() {
@@ -2220,6 +2599,137 @@ void Server::clearWhisperTargetCache() {
 	for (ServerUser *u : qhUsers) {
 		u->qmTargetCache.clear();
 	}
+
+	// Everything that invalidates whisper targets also invalidates the receivers of regular speech
+	invalidateVoiceRouting();
+}
+
+void Server::clearWhisperTargetCacheFor(const ServerUser &user) {
+	for (ServerUser *u : qhUsers) {
+		if (u == &user) {
+			// The user's own targets depend on its permissions and its whisper redirects
+			u->qmTargetCache.clear();
+			continue;
+		}
+
+		for (auto it = u->qmTargetCache.begin(); it != u->qmTargetCache.end();) {
+			if (it.value()->dependsOn(user)) {
+				it = u->qmTargetCache.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+
+	invalidateVoiceRouting();
+}
+
+void Server::clearWhisperTargetCacheFor(const Channel &channel) {
+	for (ServerUser *u : qhUsers) {
+		for (auto it = u->qmTargetCache.begin(); it != u->qmTargetCache.end();) {
+			if (it.value()->dependsOnChannel(channel.iId)) {
+				it = u->qmTargetCache.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+
+	invalidateVoiceRouting();
+}
+
+void Server::invalidateVoiceRouting() {
+	++m_voiceRoutingEpoch;
+}
+
+VoiceStats::Snapshot Server::getVoiceStatistics() const {
+	VoiceStats::Snapshot snapshot;
+
+	for (const std::unique_ptr< VoiceWorker > &worker : m_voiceWorkers) {
+		worker->stats.addTo(snapshot);
+	}
+	m_tcpVoiceStats.addTo(snapshot);
+
+	return snapshot;
+}
+
+void Server::writeStatistics(PrometheusWriter &writer, const std::vector< const Server * > &servers) {
+	std::vector< std::pair< unsigned int, VoiceStats::Snapshot > > snapshots;
+	for (const Server *server : servers) {
+		snapshots.emplace_back(server->iServerNum, server->getVoiceStatistics());
+	}
+	VoiceStats::writeStatistics(writer, snapshots);
+
+	writer.family("murmur_acl_cache_invalidations_total", "counter", "Invalidations of cached permissions by scope.");
+	for (const Server *server : servers) {
+		const std::string labels = "server=\"" + std::to_string(server->iServerNum) + "\",scope=";
+
+		writer.sample(labels + "\"all\"", server->m_aclCacheStatistics.fullInvalidations);
+		writer.sample(labels + "\"user\"", server->m_aclCacheStatistics.userInvalidations);
+		writer.sample(labels + "\"channel\"", server->m_aclCacheStatistics.channelInvalidations);
+	}
+	writer.family("murmur_acl_cache_dropped_entries_total", "counter",
+				  "Cached permissions that had to be recomputed.");
+	for (const Server *server : servers) {
+		writer.sample("server=\"" + std::to_string(server->iServerNum) + "\"",
+					  server->m_aclCacheStatistics.droppedEntries);
+	}
+
+	writer.family("murmur_authenticator_cache_lookups_total", "counter",
+				  "Lookups of cached external authentications by result.");
+	for (const Server *server : servers) {
+		const std::string labels = "server=\"" + std::to_string(server->iServerNum) + "\",result=";
+
+		writer.sample(labels + "\"hit\"", server->m_authenticationResultCache.hits());
+		writer.sample(labels + "\"miss\"", server->m_authenticationResultCache.misses());
+	}
+}
+
+void Server::collectSpeechTargets(ServerUser &speaker, Channel &channel, std::vector< SpeechTarget > &targets) {
+	// Note: The caller is expected to hold a read lock on qrwlVoiceThread
+
+	// Send audio to all users that are listening to the channel
+	for (unsigned int currentSession : m_channelListenerManager.getListenersForChannel(channel.iId)) {
+		ServerUser *pDst = static_cast< ServerUser * >(qhUsers.value(currentSession));
+		if (pDst) {
+			targets.push_back({ pDst, Mumble::Protocol::AudioContext::LISTEN,
+								m_channelListenerManager.getListenerVolumeAdjustment(pDst->uiSession, channel.iId) });
+		}
+	}
+
+	// Send audio to all users in the same channel
+	for (User *p : channel.qlUsers) {
+		targets.push_back({ static_cast< ServerUser * >(p), Mumble::Protocol::AudioContext::NORMAL,
+							VolumeAdjustment::fromFactor(1.0f) });
+	}
+
+	// Send audio to all linked channels the user has speak-permission
+	if (!channel.qhLinks.isEmpty()) {
+		QSet< Channel * > chans = channel.allLinks();
+		chans.remove(&channel);
+
+		QMutexLocker qml(&qmCache);
+
+		for (Channel *l : chans) {
+			if (ChanACL::hasPermission(&speaker, l, ChanACL::Speak, &acCache)) {
+				// Send the audio stream to all users that are listening to the linked channel
+				for (unsigned int currentSession : m_channelListenerManager.getListenersForChannel(l->iId)) {
+					ServerUser *pDst = static_cast< ServerUser * >(qhUsers.value(currentSession));
+					if (pDst) {
+						targets.push_back(
+							{ pDst, Mumble::Protocol::AudioContext::LISTEN,
+							  m_channelListenerManager.getListenerVolumeAdjustment(pDst->uiSession, l->iId) });
+					}
+				}
+
+				// Send audio to users in the linked channel
+				for (User *p : l->qlUsers) {
+					targets.push_back({ static_cast< ServerUser * >(p), Mumble::Protocol::AudioContext::NORMAL,
+										VolumeAdjustment::fromFactor(1.0f) });
+				}
+			}
+		}
+	}
 }
 
 QString Server::addressToString(const QHostAddress &adr, unsigned short port) {
@@ -2476,6 +2986,9 @@ WhisperTargetCache Server::createWhisperTargetCacheFor(ServerUser &speaker, cons
 
 	if (!target.channels.empty()) {
 		for (const WhisperTarget::Channel &currentTarget : target.channels) {
+			// The entry also depends on channels that don't exist (yet)
+			cache.channels.push_back(currentTarget.id);
+
 			Channel *targetChannel = qhChannels.value(currentTarget.id);
 
 			if (targetChannel) {
@@ -2488,7 +3001,7 @@ WhisperTargetCache Server::createWhisperTargetCacheFor(ServerUser &speaker, cons
 					if (ChanACL::hasPermission(&speaker, targetChannel, ChanACL::Whisper, &acCache)) {
 						for (User *p : targetChannel->qlUsers) {
 							// Add users of the target channel
-							cache.channelTargets.insert(static_cast< ServerUser * >(p));
+							cache.channelTargets.push_back(static_cast< ServerUser * >(p));
 						}
 
 						for (unsigned int currentSession :
@@ -2520,15 +3033,21 @@ WhisperTargetCache Server::createWhisperTargetCacheFor(ServerUser &speaker, cons
 					// case the shout is sent to the redirection target instead the originally specified group
 					const QString &redirect    = speaker.qmWhisperRedirect.value(currentTarget.targetGroup);
 					const QString &targetGroup = redirect.isEmpty() ? currentTarget.targetGroup : redirect;
+					const Group::Specification targetGroupSpec =
+						restrictToGroup ? Group::Specification::parse(targetGroup) : Group::Specification();
+
+					cache.dependsOnGroups = cache.dependsOnGroups || restrictToGroup;
 
 					for (Channel *subTargetChan : channels) {
+						cache.channels.push_back(subTargetChan->iId);
+
 						if (ChanACL::hasPermission(&speaker, subTargetChan, ChanACL::Whisper, &acCache)) {
 							for (User *p : subTargetChan->qlUsers) {
 								ServerUser *su = static_cast< ServerUser * >(p);
 
 								if (!restrictToGroup
-									|| Group::appliesToUser(*subTargetChan, *subTargetChan, targetGroup, *su)) {
-									cache.channelTargets.insert(su);
+									|| Group::appliesToUser(*subTargetChan, *subTargetChan, targetGroupSpec, *su)) {
+									cache.channelTargets.push_back(su);
 								}
 							}
 
@@ -2538,7 +3057,8 @@ WhisperTargetCache Server::createWhisperTargetCacheFor(ServerUser &speaker, cons
 
 								if (pDst
 									&& (!restrictToGroup
-										|| Group::appliesToUser(*subTargetChan, *subTargetChan, targetGroup, *pDst))) {
+										|| Group::appliesToUser(*subTargetChan, *subTargetChan, targetGroupSpec,
+																*pDst))) {
 									// Only send audio to listener if the user exists and it is in the group the
 									// speech is directed at (if any)
 									addListener(cache.listeningTargets, *pDst, *subTargetChan);
@@ -2551,33 +3071,204 @@ WhisperTargetCache Server::createWhisperTargetCacheFor(ServerUser &speaker, cons
 		}
 	}
 
+	const auto sortUnique = [](auto &list) {
+		std::sort(list.begin(), list.end());
+		list.erase(std::unique(list.begin(), list.end()), list.end());
+	};
+
+	sortUnique(cache.channels);
+	sortUnique(cache.channelTargets);
+
 	for (unsigned int id : target.sessions) {
 		ServerUser *pDst = qhUsers.value(id);
 		if (pDst && ChanACL::hasPermission(&speaker, pDst->cChannel, ChanACL::Whisper, &acCache)
-			&& !cache.channelTargets.contains(pDst))
-			cache.directTargets.insert(pDst);
-	}
+			&& !std::binary_search(cache.channelTargets.begin(), cache.channelTargets.end(), pDst))
+			cache.directTargets.push_back(pDst);
+	}
+
+	cache.sessions = target.sessions;
+	sortUnique(cache.sessions);
+	sortUnique(cache.directTargets);
+
+	// A user listening to several of the target channels only receives the audio once, using the largest of the
+	// respective volume adjustments
+	std::sort(cache.listeningTargets.begin(), cache.listeningTargets.end(),
+			  [](const std::pair< ServerUser *, VolumeAdjustment > &lhs,
+				 const std::pair< ServerUser *, VolumeAdjustment > &rhs) {
+				  return lhs.first < rhs.first || (lhs.first == rhs.first && lhs.second.factor > rhs.second.factor);
+			  });
+	cache.listeningTargets.erase(std::unique(cache.listeningTargets.begin(), cache.listeningTargets.end(),
+											 [](const std::pair< ServerUser *, VolumeAdjustment > &lhs,
+												const std::pair< ServerUser *, VolumeAdjustment > &rhs) {
+												 return lhs.first == rhs.first;
+											 }),
+								 cache.listeningTargets.end());
 
 	// Make sure the speaker themselves is not contained in these lists
-	cache.channelTargets.remove(&speaker);
-	cache.directTargets.remove(&speaker);
-	cache.listeningTargets.remove(&speaker);
+	const auto isSpeaker = [&speaker](const ServerUser *user) { return user == &speaker; };
+	cache.channelTargets.erase(std::remove_if(cache.channelTargets.begin(), cache.channelTargets.end(), isSpeaker),
+							   cache.channelTargets.end());
+	cache.directTargets.erase(std::remove_if(cache.directTargets.begin(), cache.directTargets.end(), isSpeaker),
+							  cache.directTargets.end());
+	cache.listeningTargets.erase(
+		std::remove_if(cache.listeningTargets.begin(), cache.listeningTargets.end(),
+					   [&isSpeaker](const std::pair< ServerUser *, VolumeAdjustment > &listener) {
+						   return isSpeaker(listener.first);
+					   }),
+		cache.listeningTargets.end());
 
 	return cache;
 }
 
+bool Server::deferExternalAuthentication(ServerUser *uSource, MumbleProto::Authenticate &msg) {
+	if (uSource->m_externalAuthentication) {
+		return false;
+	}
+
+	const QString name     = u8(msg.username()).trimmed();
+	const QString password = u8(msg.password());
+	const QString certhash = uSource->qsHash;
+
+	std::optional< ExternalAuthenticationResult > cached =
+		m_authenticationResultCache.find(name, certhash, password);
+	if (cached) {
+		uSource->m_externalAuthentication = std::move(cached);
+		return false;
+	}
+
+	// The user might be gone by the time the authenticator has answered (which also covers this server being gone)
+	QPointer< ServerUser > user = uSource;
+
+	const ExternalAuthenticationCallback done = [this, user, msg, name, certhash,
+												 password](const ExternalAuthenticationResult &result) mutable {
+		if (!user || user->sState != ServerUser::AuthenticationPending) {
+			return;
+		}
+
+		m_authenticationResultCache.insert(name, certhash, password, result);
+
+		user->m_externalAuthentication = result;
+		user->sState                   = ServerUser::Connected;
+
+		msgAuthenticate(user, msg);
+	};
+
+	ExternalAuthenticationRequest request = ExternalAuthenticationRequest::NotTaken;
+	emit authenticateAsyncSig(request, uSource, name, uSource->peerCertificateChain(), certhash, uSource->bVerified,
+							  password, done);
+
+	if (request == ExternalAuthenticationRequest::NotTaken) {
+		// No authenticator that can be asked asynchronously
+		return false;
+	}
+	if (request == ExternalAuthenticationRequest::Rejected) {
+		rejectBusy(uSource, "Too many logins waiting for the authenticator");
+		return true;
+	}
+
+	uSource->sState = ServerUser::AuthenticationPending;
+
+	return true;
+}
+
+bool Server::deferAuthentication(ServerUser *uSource, MumbleProto::Authenticate &msg) {
+	if (uSource->m_precomputedPasswordHash || bForceExternalAuth || !meta->passwordHashes->isEnabled()) {
+		return false;
+	}
+
+	// If the external authenticator has handled the login, the password is not going to be checked internally
+	if (uSource->m_externalAuthentication && !uSource->m_externalAuthentication->failed
+		&& uSource->m_externalAuthentication->userID != -2) {
+		return false;
+	}
+
+	const QString password = u8(msg.password());
+	if (password.isEmpty()) {
+		return false;
+	}
+
+	// Only registered users with a PBKDF2 hash require an expensive hash operation. This is just a prediction though:
+	// an external authenticator may still handle the login instead, in which case the hash is simply not used.
+	PrecomputedPasswordHash request;
+	request.name                   = u8(msg.username()).trimmed();
+	request.registrationGeneration = m_registrationGeneration;
+	const int userID               = m_dbWrapper.registeredUserNameToID(iServerNum, request.name.toStdString());
+	if (userID < 0) {
+		return false;
+	}
+
+	request.userID       = static_cast< unsigned int >(userID);
+	request.passwordData = m_dbWrapper.getRegisteredUserPassword(iServerNum, request.userID);
+	if (request.passwordData.passwordHash.empty() || request.passwordData.kdfIterations <= 0) {
+		return false;
+	}
+
+	// The user might be gone by the time the hash is available (which also covers this server being gone)
+	QPointer< ServerUser > user = uSource;
+
+	const bool queued = meta->passwordHashes->submit(
+		QString::fromStdString(request.passwordData.salt), password,
+		static_cast< int >(request.passwordData.kdfIterations),
+		[this, user, msg, request](const QString &hash) mutable {
+			if (!user || user->sState != ServerUser::AuthenticationPending) {
+				return;
+			}
+
+			request.hash                    = hash;
+			user->m_precomputedPasswordHash = std::move(request);
+			user->sState                    = ServerUser::Connected;
+
+			msgAuthenticate(user, msg);
+		});
+
+	if (!queued) {
+		rejectBusy(uSource, "Too many logins waiting for their password hash");
+		return true;
+	}
+
+	uSource->sState = ServerUser::AuthenticationPending;
+
+	return true;
+}
+
+void Server::rejectBusy(ServerUser *uSource, const QString &reason) {
+	log(uSource, QString("Rejected connection from %1: %2")
+					 .arg(addressToString(uSource->peerAddress(), uSource->peerPort()))
+					 .arg(reason));
+	MumbleProto::Reject mpr;
+	mpr.set_reason("The server is busy. Please try again later");
+	mpr.set_type(MumbleProto::Reject_RejectType_None);
+	sendMessage(uSource, mpr);
+	uSource->disconnectSocket();
+}
+
 /// @return UserID of authenticated user, -1 for authentication failures, -2 for unknown user (fallthrough),
 ///         -3 for authentication failures where the data could (temporarily) not be verified.
 int Server::authenticate(QString &name, const QString &password, int sessionId, const QStringList &emails,
 						 const QString &certhash, bool certificatePassedVerification,
-						 const QList< QSslCertificate > &certs) {
+						 const QList< QSslCertificate > &certs, const PrecomputedPasswordHash *precomputedHash,
+						 const ExternalAuthenticationResult *externalAuthentication) {
 	constexpr const int AUTHENTICATION_FAILED  = -1;
 	constexpr const int UNKNOWN_USER           = -2;
 	constexpr const int TEMPORARY_UNVERIFIABLE = -3;
 
 	int userID = bForceExternalAuth ? TEMPORARY_UNVERIFIABLE : UNKNOWN_USER;
 
-	emit authenticateSig(userID, name, sessionId, certs, certhash, certificatePassedVerification, password);
+	if (!externalAuthentication) {
+		emit authenticateSig(userID, name, sessionId, certs, certhash, certificatePassedVerification, password);
+	} else if (!externalAuthentication->failed) {
+		// The authenticator has been asked in advance (see deferExternalAuthentication)
+		userID = externalAuthentication->userID;
+
+		if (userID >= 0) {
+			if (!externalAuthentication->name.isEmpty()) {
+				name = externalAuthentication->name;
+			}
+			if (!externalAuthentication->groups.isEmpty()) {
+				setTempGroups(userID, sessionId, nullptr, externalAuthentication->groups);
+			}
+		}
+	}
 
 	if (userID < UNKNOWN_USER) {
 		// External authentication is required, but could not be performed
@@ -2591,22 +3282,29 @@ int Server::authenticate(QString &name, const QString &password, int sessionId,
 					  "AUTHENTICATION_FAILURE is expected to be first invalid (negative) ID");
 		return userID;
 	} else {
-		// No authentication performed externally -> use internal method
-		int knownUserID = m_dbWrapper.registeredUserNameToID(iServerNum, name.toStdString());
+		// No authentication performed externally -> use internal method. If the password hash has been computed in
+		// advance, the registered user it has been computed for is looked up already.
+		const bool usePrecomputedHash = precomputedHash && precomputedHash->name == name
+										&& precomputedHash->registrationGeneration == m_registrationGeneration;
+
+		int knownUserID = usePrecomputedHash ? static_cast< int >(precomputedHash->userID)
+											 : m_dbWrapper.registeredUserNameToID(iServerNum, name.toStdString());
 
 		bool usedReservedName = knownUserID >= 0;
 
 		if (usedReservedName) {
 			// There exists a registered user with the given name
-			::mumble::server::db::DBUserData userData =
-				m_dbWrapper.getRegisteredUserData(iServerNum, static_cast< unsigned int >(knownUserID));
+			const ::mumble::server::db::DBUserData::PasswordData passwordData =
+				usePrecomputedHash
+					? precomputedHash->passwordData
+					: m_dbWrapper.getRegisteredUserPassword(iServerNum, static_cast< unsigned int >(knownUserID));
 
-			if (!userData.password.passwordHash.empty()) {
+			if (!passwordData.passwordHash.empty()) {
 				// User has password-based authentication enabled
-				if (userData.password.kdfIterations <= 0) {
+				if (passwordData.kdfIterations <= 0) {
 					// If kdfIterations is <=0 this means this is an old-style SHA1 hash
 					// that hasn't been converted yet. Or we are operating in legacy mode.
-					if (getLegacyPasswordHash(password).toStdString() == userData.password.passwordHash) {
+					if (getLegacyPasswordHash(password).toStdString() == passwordData.passwordHash) {
 						// Password matched
 						userID = knownUserID;
 
@@ -2629,10 +3327,12 @@ int Server::authenticate(QString &name, const QString &password, int sessionId,
 					}
 				} else {
 					// User uses modern PBKDF2 verification
-					if (PBKDF2::getHash(QString::fromStdString(userData.password.salt), password,
-										static_cast< int >(userData.password.kdfIterations))
-							.toStdString()
-						== userData.password.passwordHash) {
+					const QString salt   = QString::fromStdString(passwordData.salt);
+					const int iterations = static_cast< int >(passwordData.kdfIterations);
+					const QString hash =
+						usePrecomputedHash ? precomputedHash->hash : PBKDF2::getHash(salt, password, iterations);
+
+					if (hash.toStdString() == passwordData.passwordHash) {
 						// Password matched
 						userID = knownUserID;
 
@@ -2646,7 +3346,7 @@ int Server::authenticate(QString &name, const QString &password, int sessionId,
 								qWarning("Failed to downgrade user account to legacy hash -> rejecting login");
 								return AUTHENTICATION_FAILED;
 							}
-						} else if (static_cast< int >(userData.password.kdfIterations) != Meta::mp->kdfIterations) {
+						} else if (static_cast< int >(passwordData.kdfIterations) != Meta::mp->kdfIterations) {
 							// User's kdfIterations doesn't match the global setting -> update it
 							QMap< int, QString > properties;
 							properties.insert(static_cast< int >(::mumble::server::db::UserProperty::Password),
@@ -2716,24 +3416,22 @@ int Server::authenticate(QString &name, const QString &password, int sessionId,
 			return usedReservedName ? AUTHENTICATION_FAILED : UNKNOWN_USER;
 		}
 
-		// Ensure that the user will use the name exactly as we have stored it in our DB. For password
-		::mumble::server::db::DBUserData userData =
-			m_dbWrapper.getRegisteredUserData(iServerNum, static_cast< unsigned int >(userID));
-
 		// Make sure the user name uses the same casing that is stored in the DB
-		name = QString::fromStdString(userData.name);
+		name = QString::fromStdString(m_dbWrapper.getUserName(iServerNum, static_cast< unsigned int >(userID)));
 
 
 		// If provided, store this user's certificate hash
 		const bool isSuperUser = static_cast< unsigned int >(userID) == Mumble::SUPERUSER_ID;
 		if (!isSuperUser && !certhash.isEmpty()) {
-			m_dbWrapper.storeUserProperty(iServerNum, static_cast< unsigned int >(userID),
-										  ::mumble::server::db::UserProperty::CertificateHash, certhash.toStdString());
+			writeUserPropertyToDB(DBWrite::userProperty(iServerNum, static_cast< unsigned int >(userID),
+														::mumble::server::db::UserProperty::CertificateHash,
+														certhash.toStdString()));
 		}
 		// If provided, store this user's email
 		if (!isSuperUser && !emails.isEmpty()) {
-			m_dbWrapper.storeUserProperty(iServerNum, static_cast< unsigned int >(userID),
-										  ::mumble::server::db::UserProperty::Email, emails[0].toStdString());
+			writeUserPropertyToDB(DBWrite::userProperty(iServerNum, static_cast< unsigned int >(userID),
+														::mumble::server::db::UserProperty::Email,
+														emails[0].toStdString()));
 		}
 	}
 
@@ -2876,7 +3574,9 @@ void Server::addChannelListener(const ServerUser &user, const Channel &channel)
 				m_dbWrapper.getChannelListenerVolume(iServerNum, static_cast< unsigned int >(user.iId), channel.iId)));
 	}
 
+	QWriteLocker wl(&qrwlVoiceThread);
 	m_channelListenerManager.addListener(user.uiSession, channel.iId);
+	clearWhisperTargetCacheFor(channel);
 }
 
 void Server::setChannelListenerVolume(const ServerUser &user, const Channel &channel, float volume) {
@@ -2891,8 +3591,10 @@ void Server::setChannelListenerVolume(const ServerUser &user, const Channel &cha
 												   volume);
 		}
 
+		QWriteLocker wl(&qrwlVoiceThread);
 		m_channelListenerManager.setListenerVolumeAdjustment(user.uiSession, channel.iId,
 															 VolumeAdjustment::fromFactor(volume));
+		clearWhisperTargetCacheFor(channel);
 	} else {
 		log(QString::fromLatin1(
 				"Attempted to set volume adjustment on non-existent channel listener (\"%1\" listening to \"%2\")")
@@ -2910,7 +3612,9 @@ void Server::disableChannelListener(const ServerUser &user, const Channel &chann
 		m_dbWrapper.disableChannelListenerIfExists(iServerNum, static_cast< unsigned int >(user.iId), channel.iId);
 	}
 
+	QWriteLocker wl(&qrwlVoiceThread);
 	m_channelListenerManager.removeListener(user.uiSession, channel.iId);
+	clearWhisperTargetCacheFor(channel);
 }
 
 void Server::deleteChannelListener(const ServerUser &user, const Channel &channel) {
@@ -2918,7 +3622,9 @@ void Server::deleteChannelListener(const ServerUser &user, const Channel &channe
 		m_dbWrapper.deleteChannelListener(iServerNum, static_cast< unsigned int >(user.iId), channel.iId);
 	}
 
+	QWriteLocker wl(&qrwlVoiceThread);
 	m_channelListenerManager.removeListener(user.uiSession, channel.iId);
+	clearWhisperTargetCacheFor(channel);
 }
 
 bool Server::channelListenerExists(const ServerUser &user, const Channel &channel) {
@@ -2993,6 +3699,7 @@ bool Server::registerUser(ServerUser &user) {
 	user.iId = id;
 
 	if (!user.cChannel->bTemporary) {
+		flushDBWrites(static_cast< unsigned int >(id));
 		m_dbWrapper.setLastChannel(iServerNum, user);
 	}
 
@@ -3074,12 +3781,19 @@ bool Server::setUserProperties(int userID, QMap< int, QString > properties) {
 		qhUserNameCache.remove(id);
 		qhUserIDCache.remove(name);
 	}
+	if (properties.contains(static_cast< int >(::mumble::server::db::UserProperty::Name))
+		|| properties.contains(static_cast< int >(::mumble::server::db::UserProperty::Password))) {
+		m_registrationGeneration++;
+	}
 
 	emit setInfoSig(res, userID, properties);
 	if (res >= 0) {
 		return (res > 0);
 	}
 
+	// Queued writes (e.g. of the certificate hash) must not overwrite the properties set here
+	flushDBWrites(static_cast< unsigned int >(userID));
+
 	::mumble::server::db::DBUserData userData;
 	bool updateUserData = false;
 
@@ -3151,11 +3865,22 @@ Channel *Server::createNewChannel(Channel *parent, const QString &name, bool tem
 		id += iChannelCountLimit > 0 ? static_cast< unsigned int >(iChannelCountLimit) * 2 : 1'000'000u;
 	}
 
-	Channel *c    = new Channel(id, name, parent);
-	c->bTemporary = temporary;
-	c->iPosition  = position;
-	c->uiMaxUsers = maxUsers;
-	qhChannels.insert(id, c);
+	Channel *c;
+	{
+		QWriteLocker wl(&qrwlVoiceThread);
+
+		c             = new Channel(id, name, parent);
+		c->bTemporary = temporary;
+		c->iPosition  = position;
+		c->uiMaxUsers = maxUsers;
+		qhChannels.insert(id, c);
+
+		// Whispers to the parent's subchannels (or to the new channel's ID) now reach a different set of channels
+		clearWhisperTargetCacheFor(*c);
+		if (parent) {
+			clearWhisperTargetCacheFor(*parent);
+		}
+	}
 
 	if (!temporary) {
 		m_dbWrapper.createChannel(iServerNum, *c);
@@ -3168,6 +3893,8 @@ void Server::linkChannels(Channel &first, Channel &second) {
 	{
 		QWriteLocker wl(&qrwlVoiceThread);
 		first.link(&second);
+		clearWhisperTargetCacheFor(first);
+		clearWhisperTargetCacheFor(second);
 	}
 
 	if (first.bTemporary || second.bTemporary) {
@@ -3181,6 +3908,8 @@ void Server::unlinkChannels(Channel &first, Channel &second) {
 	{
 		QWriteLocker wl(&qrwlVoiceThread);
 		first.unlink(&second);
+		clearWhisperTargetCacheFor(first);
+		clearWhisperTargetCacheFor(second);
 	}
 
 	if (first.bTemporary || second.bTemporary) {
@@ -3200,14 +3929,6 @@ std::vector< UserInfo > Server::getAllRegisteredUserProperties(QString nameSubst
 		users.push_back(UserInfo(it.key(), it.value()));
 	}
 
-	// Make the nameSubstring ready to be processed by SQL as a filter
-	if (nameSubstring.isEmpty()) {
-		// Allow any name
-		nameSubstring = "%";
-	} else {
-		nameSubstring = "%" + nameSubstring + "%";
-	}
-
 	m_dbWrapper.addAllRegisteredUserInfoTo(users, iServerNum, nameSubstring.toStdString());
 
 	return users;
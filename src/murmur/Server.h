@@ -14,17 +14,22 @@
 
 #include "ACL.h"
 #include "AudioReceiverBuffer.h"
+#include "AuthenticationResultCache.h"
 #include "Ban.h"
 #include "ChannelListenerManager.h"
 #include "DBWrapper.h"
 #include "HostAddress.h"
+#include "JoinStateCache.h"
 #include "Mumble.pb.h"
 #include "MumbleProtocol.h"
+#include "PeerTable.h"
 #include "QtUtils.h"
 #include "Timer.h"
 #include "User.h"
 #include "Version.h"
+#include "VoiceStats.h"
 #include "VolumeAdjustment.h"
+#include "WriteCoalescer.h"
 
 #include "database/ConnectionParameter.h"
 
@@ -33,6 +38,7 @@
 #include <QtCore/QQueue>
 #include <QtCore/QReadWriteLock>
 #include <QtCore/QRegularExpression>
+#include <QtCore/QSet>
 #include <QtCore/QSocketNotifier>
 #include <QtCore/QStringList>
 #include <QtCore/QThread>
@@ -50,7 +56,14 @@
 #	include <winsock2.h>
 #endif
 
+#ifdef Q_OS_LINUX
+#	include "UDPBatch.h"
+#endif
+
+#include <atomic>
+#include <cstdint>
 #include <functional>
+#include <memory>
 #include <optional>
 #include <span>
 #include <vector>
@@ -59,8 +72,12 @@ class Zeroconf;
 class Channel;
 class PacketDataStream;
 class ServerUser;
+class PrometheusWriter;
+struct PrecomputedPasswordHash;
 class User;
+class UDPSendBatch;
 class QNetworkAccessManager;
+struct msghdr;
 
 struct TextMessage {
 	QList< unsigned int > qlSessions;
@@ -82,6 +99,49 @@ public:
 	SslServer(QObject *parent = nullptr);
 };
 
+/// The state owned by a single voice thread. Every voice thread has its own UDP socket for each bound address
+/// (sharing the port with the other voice threads via SO_REUSEPORT) as well as its own protocol codec instances, so
+/// that multiple voice threads can decode, route and encode packets in parallel.
+struct VoiceWorker {
+	unsigned int index = 0;
+	/// The thread executing this worker. This is nullptr for the first worker as that one is run by the Server
+	/// (which is a QThread) itself.
+	std::unique_ptr< QThread > thread;
+
+#ifdef Q_OS_UNIX
+	int notify[2] = { -1, -1 };
+	QList< int > udpSockets;
+#else
+	QList< SOCKET > udpSockets;
+#endif
+
+	Mumble::Protocol::UDPDecoder< Mumble::Protocol::Role::Server > decoder;
+	Mumble::Protocol::UDPPingEncoder< Mumble::Protocol::Role::Server > pingEncoder;
+	Mumble::Protocol::UDPAudioEncoder< Mumble::Protocol::Role::Server > audioEncoder;
+	AudioReceiverBuffer audioReceivers;
+
+	/// For every unknown peer, the index into its host's list of unmatched users at which the next trial decryption
+	/// starts. This way, consecutive datagrams of the same peer are tried against different users.
+	PeerTable< std::uint32_t > trialDecryptCursors;
+
+	VoiceStats stats;
+
+#ifdef Q_OS_LINUX
+	UDPReceiveBatch receiveBatch;
+	UDPSendBatch sendBatch;
+#endif
+
+	/// @returns The batch the outgoing datagrams of this worker are collected in or nullptr, if datagrams can't be
+	/// 	sent in batches on this platform
+	UDPSendBatch *getSendBatch() {
+#ifdef Q_OS_LINUX
+		return &sendBatch;
+#else
+		return nullptr;
+#endif
+	}
+};
+
 #define EXEC_QEVENT (QEvent::User + 959)
 
 class ExecEvent : public QEvent {
@@ -143,6 +203,9 @@ public:
 	bool bAllowPing;
 	bool allowRecording;
 	unsigned int rollingStatsWindow;
+	unsigned int m_voiceThreadCount;
+	/// Whether the voice threads should use io_uring instead of poll() for their UDP sockets (if available)
+	bool m_useIOUring;
 
 	QRegularExpression qrUserName;
 	QRegularExpression qrChannelName;
@@ -184,10 +247,7 @@ public:
 	ChannelListenerManager m_channelListenerManager;
 
 
-	Mumble::Protocol::UDPDecoder< Mumble::Protocol::Role::Server > m_udpDecoder;
 	Mumble::Protocol::UDPDecoder< Mumble::Protocol::Role::Server > m_tcpTunnelDecoder;
-	Mumble::Protocol::UDPPingEncoder< Mumble::Protocol::Role::Server > m_udpPingEncoder;
-	Mumble::Protocol::UDPAudioEncoder< Mumble::Protocol::Role::Server > m_udpAudioEncoder;
 	Mumble::Protocol::UDPAudioEncoder< Mumble::Protocol::Role::Server > m_tcpAudioEncoder;
 
 	std::span< const Mumble::Protocol::byte >
@@ -211,13 +271,61 @@ public:
 	void initRegister();
 
 	WhisperTargetCache createWhisperTargetCacheFor(ServerUser &speaker, const WhisperTarget &target);
+	void collectSpeechTargets(ServerUser &speaker, Channel &channel, std::vector< SpeechTarget > &targets);
+
+	/// Incremented whenever something changes that may affect who receives a user's regular speech (users
+	/// joining, moving or leaving, channel links, channel listeners, ACLs). Cached routing information is only valid
+	/// for the epoch it has been computed in.
+	std::atomic< std::uint64_t > m_voiceRoutingEpoch = 1;
+	void invalidateVoiceRouting();
+
+	/// @returns The statistics of this server's voice path, accumulated over all threads processing voice packets
+	VoiceStats::Snapshot getVoiceStatistics() const;
+	/// Writes the statistics of the given servers (ordered by ID) to the given writer
+	static void writeStatistics(PrometheusWriter &writer, const std::vector< const Server * > &servers);
+
+	/// How often (and how much of) the ACL cache has been invalidated, which is how often permissions had to be
+	/// recomputed
+	struct ACLCacheStatistics {
+		/// Invalidations of the cached permissions of all users (clearACLCache())
+		std::uint64_t fullInvalidations = 0;
+		/// Invalidations of the cached permissions of a single user (clearACLCache(User *))
+		std::uint64_t userInvalidations = 0;
+		/// Invalidations of the cached permissions for a channel tree (clearACLCacheFor())
+		std::uint64_t channelInvalidations = 0;
+		/// The number of cached permissions (one per user and channel) that have been dropped
+		std::uint64_t droppedEntries = 0;
+	};
+	/// Only to be accessed from the main thread
+	ACLCacheStatistics m_aclCacheStatistics;
+
+	/// The states of all channels and users as they are sent to joining clients. Kept up to date by
+	/// sendProtoExcept(), which every state change is broadcast through.
+	JoinStateCache m_joinStateCache;
+
+	/// The successful authentications by the external authenticator. Cleared whenever the authenticator changes.
+	AuthenticationResultCache m_authenticationResultCache;
+
+	/// The sessions of the users that audio has been tunnelled to through their TCP connection since their
+	/// connections have last been flushed. The flush is deferred until all audio that is pending for the current
+	/// iteration of the event loop has been written (see flushTunnelledAudio()).
+	QSet< unsigned int > m_pendingTunnelFlushes;
+
+	/// Writes the messages the users' connections have gathered (see Connection::setWriteCoalescing()). All
+	/// connections are written by a single flush (after tcpwritedelay) instead of each of them arming a timer.
+	WriteCoalescer m_writeCoalescer;
+
+	/// @returns Whether a client connection may be established despite the given error. Errors that only concern the
+	/// 	client's certificate are tolerated, but the client is not considered to be verified then.
+	static bool isTolerableSslError(const QSslError &error);
 
 private:
 	int iChannelNestingLimit;
 	int iChannelCountLimit;
 
-	AudioReceiverBuffer m_udpAudioReceivers;
 	AudioReceiverBuffer m_tcpAudioReceivers;
+	/// The voice statistics of audio packets tunneled through TCP (which are processed by the main thread)
+	VoiceStats m_tcpVoiceStats;
 
 public slots:
 	void regSslError(const QList< QSslError > &);
@@ -241,13 +349,15 @@ public slots:
 	void sslError(const QList< QSslError > &);
 	void message(Mumble::Protocol::TCPMessageType, const QByteArray &, ServerUser *cCon = nullptr);
 	void checkTimeout();
-	void tcpTransmitData(QByteArray, unsigned int);
+	void tcpTransmitData(QByteArray frame, QList< unsigned int > sessions);
+	void flushTunnelledAudio();
 	void doSync(unsigned int);
 	void encrypted();
 	void udpActivated(int);
 signals:
 	void reqSync(unsigned int);
-	void tcpTransmit(QByteArray, unsigned int id);
+	/// Requests the given UDPTunnel message (including its header) to be sent to the users with the given sessions
+	void tcpTransmit(QByteArray frame, QList< unsigned int > sessions);
 
 public:
 	unsigned int iServerNum;
@@ -256,7 +366,6 @@ public:
 	QTimer *qtTimeout;
 
 #ifdef Q_OS_UNIX
-	int aiNotify[2];
 	QList< int > qlUdpSocket;
 #else
 	HANDLE hNotify;
@@ -264,12 +373,18 @@ public:
 #endif
 	QList< QSocketNotifier * > qlUdpNotifier;
 
+	/// The voice workers of this server. The first one is run by the Server thread itself, any additional ones
+	/// (see m_voiceThreadCount) run in their own thread.
+	std::vector< std::unique_ptr< VoiceWorker > > m_voiceWorkers;
+
 	/// This lock provides synchronization between the
 	/// main thread (where control channel messages and
-	/// RPC happens), and the Server's voice thread.
+	/// RPC happens), and the Server's voice thread(s).
 	///
-	/// These are the only two threads in Murmur that
-	/// access a Server's data.
+	/// These are the only threads in Murmur that
+	/// access a Server's data. If more than one voice
+	/// thread is configured, all of them follow the
+	/// rules for "the voice thread" described below.
 	///
 	/// The easiest way to understand the locking strategy
 	/// and synchronization between the main thread and the
@@ -311,8 +426,9 @@ public:
 	///    other thread can write to that data.
 	QReadWriteLock qrwlVoiceThread;
 	QHash< unsigned int, ServerUser * > qhUsers;
-	QHash< QPair< HostAddress, quint16 >, ServerUser * > qhPeerUsers;
-	QHash< HostAddress, QSet< ServerUser * > > qhHostUsers;
+	PeerTable< ServerUser * > m_peerUsers;
+	/// The users that have not been associated with a UDP peer yet, grouped by their (TCP) host address
+	QHash< HostAddress, QList< ServerUser * > > qhHostUsers;
 	QHash< unsigned int, Channel * > qhChannels;
 
 	QMutex qmCache;
@@ -320,28 +436,90 @@ public:
 
 	QHash< int, QString > qhUserNameCache;
 	QHash< Mumble::QtUtils::CaseInsensitiveQString, int > qhUserIDCache;
+	/// Incremented whenever a registered user is renamed, gets a new password or is unregistered, which invalidates the
+	/// lookups carried by a PrecomputedPasswordHash
+	unsigned int m_registrationGeneration = 0;
 
 	std::vector< Ban > m_bans;
 
 	DBWrapper m_dbWrapper;
 
-	void addListener(QHash< ServerUser *, VolumeAdjustment > &listeners, ServerUser &user, const Channel &channel);
+	void addListener(std::vector< std::pair< ServerUser *, VolumeAdjustment > > &listeners, ServerUser &user,
+					 const Channel &channel);
+	/// Routes the given audio packet to all of its receivers. If sendBatch is not nullptr, the UDP datagrams are only
+	/// queued in it and the caller is responsible for flushing the batch. The time spent in the individual stages is
+	/// recorded in the given stats, which have to be owned by the calling thread.
 	void processMsg(ServerUser *u, Mumble::Protocol::AudioData audioData, AudioReceiverBuffer &buffer,
-					Mumble::Protocol::UDPAudioEncoder< Mumble::Protocol::Role::Server > &encoder);
-	void sendMessage(ServerUser &u, const unsigned char *data, int len, QByteArray &cache, bool force = false);
+					Mumble::Protocol::UDPAudioEncoder< Mumble::Protocol::Role::Server > &encoder,
+					UDPSendBatch *sendBatch, VoiceStats &stats);
+	/// Sends the given (unencrypted) audio or ping packet to the given user. If the user has no working UDP connection
+	/// (and force is false), the packet is tunnelled through the TCP connection instead: the UDPTunnel message is
+	/// built into cache (unless it already contains it) and, if tcpReceivers is not nullptr, only the user's session
+	/// is appended to it, so that the caller can transmit the message to all of them at once (see tcpTransmit()).
+	void sendMessage(ServerUser &u, const unsigned char *data, int len, QByteArray &cache, bool force = false,
+					 UDPSendBatch *batch = nullptr, QList< unsigned int > *tcpReceivers = nullptr);
 	void run();
+	void runVoiceLoop(VoiceWorker &worker);
+#ifdef USE_IO_URING
+	/// Runs the voice loop of the given worker on top of io_uring.
+	///
+	/// @returns Whether the loop ran until the voice thread has been stopped. If false is returned, io_uring is not
+	/// 	usable and the caller should fall back to the poll() based loop.
+	bool runRingVoiceLoop(VoiceWorker &worker);
+#endif
+	/// Handles a single datagram received by the given voice worker. On Linux, header is the message header the
+	/// datagram was received with (used to reply to pings from the same local address), otherwise it is nullptr.
+#ifdef Q_OS_UNIX
+	void processDatagram(VoiceWorker &worker, int sock, struct sockaddr_storage &from, unsigned char *encrypt,
+						 qint32 len, struct msghdr *header);
+#else
+	void processDatagram(VoiceWorker &worker, SOCKET sock, struct sockaddr_storage &from, unsigned char *encrypt,
+						 qint32 len, struct msghdr *header);
+#endif
 
 	bool validateChannelName(const QString &name);
 	bool validateUserName(const QString &name);
 
 	bool checkDecrypt(ServerUser *u, const unsigned char *encrypted, unsigned char *plain, unsigned int cryptlen);
+	/// Removes the given user from the list of users that have not been associated with a UDP peer yet. The caller
+	/// has to hold the write lock on qrwlVoiceThread.
+	void removeUnmatchedHostUser(ServerUser &user);
+
+	/// The maximum number of users a datagram from an unknown peer is trial-decrypted for. If there are more unmatched
+	/// users behind the peer's address (e.g. many clients behind the same NAT), consecutive datagrams of the peer
+	/// continue where the previous one left off.
+	static constexpr std::size_t MAX_TRIAL_DECRYPTS_PER_DATAGRAM = 16;
+	/// The maximum number of unknown peers a voice worker keeps trial decryption progress for
+	static constexpr std::size_t MAX_TRIAL_DECRYPT_CURSORS = 4096;
 
 	bool hasPermission(ServerUser *p, Channel *c, QFlags< ChanACL::Perm > perm);
 	QFlags< ChanACL::Perm > effectivePermissions(ServerUser *p, Channel *c);
 	void sendClientPermission(ServerUser *u, Channel *c, bool explicitlyRequested = false);
 	void flushClientPermissionCache(ServerUser *u, MumbleProto::PermissionQuery &mpqq);
+
+	/// Fills in the state of the given channel the way it is sent to joining clients (except for the parts that
+	/// depend on the joining client)
+	void fillChannelState(const Channel &channel, bool sendHashes, MumbleProto::ChannelState &mpcs) const;
+	/// Fills in the state of the given user the way it is sent to the given joining client
+	void fillUserState(const ServerUser &user, const ServerUser &recipient, MumbleProto::UserState &mpus) const;
+	/// Sends the states of all channels (including their links) to the given joining client
+	void sendChannelStates(ServerUser *uSource);
+	/// Sends the states of all other authenticated users to the given joining client
+	void sendUserStates(ServerUser *uSource);
+	/// Mirrors the user's permission to speak in its channel in its suppression state. Assumes qmCache is held.
+	void updateSuppression(ServerUser *user, MumbleProto::UserState &mpus);
 	void clearACLCache(User *p = nullptr);
+	/// Invalidates the cached permissions of all users for the given channel and its subchannels, which are the only
+	/// channels affected by changes to the channel's ACLs and groups. Only users whose sent permissions, suppression
+	/// state or whisper targets might have changed are updated.
+	void clearACLCacheFor(const Channel &channel);
 	void clearWhisperTargetCache();
+	/// Drops all cached whisper targets that might be affected by a change of the given user (see
+	/// WhisperTargetCache::dependsOn). The caller must hold the write lock on qrwlVoiceThread.
+	void clearWhisperTargetCacheFor(const ServerUser &user);
+	/// Drops all cached whisper targets that might be affected by a change of the users, listeners, links or
+	/// subchannels of the given channel. The caller must hold the write lock on qrwlVoiceThread.
+	void clearWhisperTargetCacheFor(const Channel &channel);
 
 	void sendProtoAll(const ::google::protobuf::Message &msg, Mumble::Protocol::TCPMessageType type,
 					  Version::full_t version, Version::CompareMode mode);
@@ -377,6 +555,16 @@ public:
 
 	void log(const QString &) const;
 	void log(ServerUser *u, const QString &) const;
+	/// Performs the given write through Meta::dbWriteQueue or, if that is disabled, right away. Writes of user
+	/// properties that are contained in the registered user index have to go through writeUserPropertyToDB instead.
+	void writeToDB(DBWrite write) const;
+	/// Like writeToDB, but also updates our registered user index right away, as the DBWriteQueue performs the write
+	/// using its own DBWrapper
+	void writeUserPropertyToDB(DBWrite write);
+	/// Waits for the writes passed to writeToDB that concern the given registered user to have been performed
+	void flushDBWrites(unsigned int userID) const;
+	/// Waits for the writes passed to writeToDB that match the given predicate to have been performed
+	void flushDBWrites(const std::function< bool(const DBWrite &) > &affects) const;
 
 	void removeChannel(unsigned int id);
 	void removeChannel(Channel *c, Channel *dest = nullptr);
@@ -390,9 +578,31 @@ public:
 
 	/// @return UserID of authenticated user, -1 for authentication failures, -2 for unknown user (fallthrough),
 	///         -3 for authentication failures where the data could (temporarily) not be verified.
+	/// If a precomputed hash for the given name is given, the registered user and password data it has been computed
+	/// for are used instead of looking them up and hashing the password again. If the result of an external
+	/// authentication is given, it is used instead of asking the external authenticator.
 	int authenticate(QString &name, const QString &password, int sessionId = 0, const QStringList &emails = {},
 					 const QString &certhash = {}, bool bStrongCert = false,
-					 const QList< QSslCertificate > &certs = {});
+					 const QList< QSslCertificate > &certs = {},
+					 const PrecomputedPasswordHash *precomputedHash = nullptr,
+					 const ExternalAuthenticationResult *externalAuthentication = nullptr);
+	/// Asks the external authenticator about the given authentication request asynchronously (unless a cached result
+	/// is available) and parks the user in the AuthenticationPending state until it has answered. Then, the request is
+	/// processed again (see msgAuthenticate). If too many requests are waiting for the authenticator already, the user
+	/// is rejected.
+	///
+	/// @returns Whether the request must not be processed any further for now
+	bool deferExternalAuthentication(ServerUser *uSource, MumbleProto::Authenticate &msg);
+	/// Hands the computation of the password hash required for the given authentication request to
+	/// Meta::passwordHashes and parks the user in the AuthenticationPending state until it is done. Then, the request
+	/// is processed again (see msgAuthenticate). If too many hashes are pending already, the user is rejected.
+	///
+	/// @returns Whether the request must not be processed any further for now
+	bool deferAuthentication(ServerUser *uSource, MumbleProto::Authenticate &msg);
+	/// Rejects the given user's login because the server is too busy to handle it right now
+	///
+	/// @param reason Why the server is busy, used for logging
+	void rejectBusy(ServerUser *uSource, const QString &reason);
 	bool setTexture(ServerUser &user, const QByteArray &texture);
 	bool storeTexture(const ServerUserInfo &userInfo, const QByteArray &texture);
 	void loadTexture(ServerUser &user);
@@ -446,6 +656,11 @@ signals:
 	void getRegistrationSig(int &, int, QMap< int, QString > &);
 	void authenticateSig(int &, QString &, int, const QList< QSslCertificate > &, const QString &, bool,
 						 const QString &);
+	/// Asks the external authenticator to authenticate the given user without blocking. A receiver that takes the
+	/// request sets the first argument accordingly and invokes the callback on the main thread once it is done.
+	void authenticateAsyncSig(ExternalAuthenticationRequest &, ServerUser *, const QString &,
+							  const QList< QSslCertificate > &, const QString &, bool, const QString &,
+							  const ExternalAuthenticationCallback &);
 	void setInfoSig(int &, int, const QMap< int, QString > &);
 	void setTextureSig(int &, int, const QByteArray &);
 	void idToNameSig(QString &, int);
@@ -5,6 +5,7 @@
 
 #include "ServerUser.h"
 
+#include "Channel.h"
 #include "ClientType.h"
 #include "Meta.h"
 #include "Server.h"
@@ -13,6 +14,7 @@
 #	include "Utils.h"
 #endif
 
+#include <algorithm>
 #include <chrono>
 
 ServerUser::ServerUser(Server *p, QSslSocket *socket)
@@ -41,6 +43,28 @@ ServerUser::ServerUser(Server *p, QSslSocket *socket)
 ServerUser::operator QString() const {
 	return QString::fromLatin1("%1:%2(%3)").arg(qsName).arg(uiSession).arg(iId);
 }
+
+bool WhisperTargetCache::dependsOn(const ServerUser &user) const {
+	ServerUser *const pointer = const_cast< ServerUser * >(&user);
+
+	if (dependsOnGroups || (user.cChannel && dependsOnChannel(user.cChannel->iId))
+		|| std::binary_search(sessions.begin(), sessions.end(), user.uiSession)
+		|| std::binary_search(channelTargets.begin(), channelTargets.end(), pointer)
+		|| std::binary_search(directTargets.begin(), directTargets.end(), pointer)) {
+		return true;
+	}
+
+	auto it = std::lower_bound(listeningTargets.begin(), listeningTargets.end(), pointer,
+							   [](const std::pair< ServerUser *, VolumeAdjustment > &listener, const ServerUser *u) {
+								   return listener.first < u;
+							   });
+	return it != listeningTargets.end() && it->first == pointer;
+}
+
+bool WhisperTargetCache::dependsOnChannel(unsigned int channelID) const {
+	return std::binary_search(channels.begin(), channels.end(), channelID);
+}
+
 BandwidthRecord::BandwidthRecord() {
 	iRecNum = 0;
 	iSum    = 0;
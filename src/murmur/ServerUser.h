@@ -12,13 +12,18 @@
 #	include "win.h"
 #endif
 
+#include "AuthenticationResultCache.h"
 #include "ClientType.h"
 #include "Connection.h"
 #include "HostAddress.h"
+#include "MumbleProtocol.h"
 #include "ServerUserInfo.h"
 #include "Timer.h"
+#include "VolumeAdjustment.h"
+#include "murmur/database/DBUserData.h"
 
 #include <QtCore/QElapsedTimer>
+#include <QtCore/QString>
 #include <QtCore/QStringList>
 
 #ifdef Q_OS_WIN
@@ -27,6 +32,10 @@
 #	include <sys/socket.h>
 #endif
 
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
 #include <vector>
 
 // Unfortunately, this needs to be "large enough" to hold
@@ -66,10 +75,56 @@ struct WhisperTarget {
 
 class ServerUser;
 
+/// A PBKDF2 password hash that has been computed before authenticating a user (see Server::deferAuthentication),
+/// along with the registered user it has been computed for
+struct PrecomputedPasswordHash {
+	/// The name the registered user has been looked up by and Server::m_registrationGeneration at that time
+	QString name;
+	unsigned int registrationGeneration = 0;
+	unsigned int userID = 0;
+	/// The password data stored for the user at the time of the lookup, whose salt and iteration count have been used
+	::mumble::server::db::DBUserData::PasswordData passwordData;
+	QString hash;
+};
+
+/// The receivers of a whisper/shout target of a given user. All lists are sorted (by pointer respectively ID) and free
+/// of duplicates, so they can be iterated in place and searched quickly.
 struct WhisperTargetCache {
-	QSet< ServerUser * > channelTargets;
-	QSet< ServerUser * > directTargets;
-	QHash< ServerUser *, VolumeAdjustment > listeningTargets;
+	/// Users receiving the audio because it is shouted to their channel
+	std::vector< ServerUser * > channelTargets;
+	/// Users receiving the audio because it is whispered to them directly
+	std::vector< ServerUser * > directTargets;
+	/// Users receiving the audio because they are listening to one of the target channels
+	std::vector< std::pair< ServerUser *, VolumeAdjustment > > listeningTargets;
+
+	/// The IDs of all channels whose users, listeners, links or subchannels have been taken into account
+	std::vector< unsigned int > channels;
+	/// The sessions of all users that the audio is whispered to directly
+	std::vector< unsigned int > sessions;
+	/// Whether group membership has been taken into account (i.e. shouting to a specific group)
+	bool dependsOnGroups = false;
+
+	/// @returns Whether this entry has to be recomputed if the given user's state (e.g. its channel or its
+	/// 	permissions) changes
+	bool dependsOn(const ServerUser &user) const;
+	/// @returns Whether this entry has to be recomputed if the users, listeners, links or subchannels of the channel
+	/// 	with the given ID change
+	bool dependsOnChannel(unsigned int channelID) const;
+};
+
+struct SpeechTarget {
+	ServerUser *receiver;
+	Mumble::Protocol::audio_context_t context;
+	VolumeAdjustment volumeAdjustment;
+};
+
+/// The flattened list of everyone that receives a user's regular speech: the users in and the listeners of the
+/// speaker's channel as well as of all linked channels the speaker may speak in. The list is only valid as long as
+/// channelID still is the speaker's channel and epoch matches the server's voice routing epoch.
+struct SpeechTargetCache {
+	std::uint64_t epoch    = 0;
+	unsigned int channelID = 0;
+	std::vector< SpeechTarget > targets;
 };
 
 class Server;
@@ -110,8 +165,13 @@ protected:
 	Server *s;
 
 public:
-	enum State { Connected, Authenticated };
+	/// While a user is in the AuthenticationPending state, its password hash is being computed in the background or an
+	/// external authenticator is being asked about it, and all of its messages are ignored.
+	enum State { Connected, AuthenticationPending, Authenticated };
 	State sState;
+	/// The results of deferring the authentication of this user, which the next authentication attempt consumes
+	std::optional< PrecomputedPasswordHash > m_precomputedPasswordHash;
+	std::optional< ExternalAuthenticationResult > m_externalAuthentication;
 	ClientType m_clientType;
 	operator QString() const;
 
@@ -137,9 +197,19 @@ public:
 	QStringList qslAccessTokens;
 
 	QMap< int, WhisperTarget > qmTargets;
-	QMap< int, WhisperTargetCache > qmTargetCache;
+	QMap< int, std::shared_ptr< const WhisperTargetCache > > qmTargetCache;
+	/// Whisper target caches are created by the voice threads while only holding qrwlVoiceThread for reading, so
+	/// accessing qmTargetCache requires either the write lock or the read lock plus this mutex.
+	QMutex m_targetCacheMutex;
 	QMap< QString, QString > qmWhisperRedirect;
 
+	/// Null until the user has spoken for the first time. Published entries are never modified, but replaced by a
+	/// new one, so routing can go on with an entry after the mutex has been released.
+	std::shared_ptr< const SpeechTargetCache > m_speechTargetCache;
+	/// Audio of the same user may be routed by different voice threads or by the main thread (UDP tunnel) at the
+	/// same time. This only guards replacing and taking m_speechTargetCache, not computing or iterating the entry.
+	QMutex m_speechTargetCacheMutex;
+
 	LeakyBucket leakyBucket;
 	LeakyBucket m_pluginMessageBucket;
 
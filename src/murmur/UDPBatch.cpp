@@ -0,0 +1,224 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "UDPBatch.h"
+#include "HostAddress.h"
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <numeric>
+
+namespace UDPBatch {
+bool setupMessageHeader(struct msghdr &msg, const struct sockaddr_storage &destination,
+						const HostAddress &localAddress) {
+	const bool isV6 = destination.ss_family == AF_INET6;
+
+	memset(msg.msg_control, 0, PKTINFO_CONTROL_SIZE);
+
+	// Note: The kernel does not write to msg_name when sending
+	msg.msg_name       = const_cast< struct sockaddr_storage * >(&destination);
+	msg.msg_namelen    = static_cast< socklen_t >(isV6 ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in));
+	msg.msg_controllen = CMSG_SPACE(isV6 ? sizeof(struct in6_pktinfo) : sizeof(struct in_pktinfo));
+
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	if (isV6) {
+		cmsg->cmsg_level            = IPPROTO_IPV6;
+		cmsg->cmsg_type             = IPV6_PKTINFO;
+		cmsg->cmsg_len              = CMSG_LEN(sizeof(struct in6_pktinfo));
+		struct in6_pktinfo *pktinfo = reinterpret_cast< struct in6_pktinfo * >(CMSG_DATA(cmsg));
+		memcpy(&pktinfo->ipi6_addr.s6_addr[0], localAddress.getByteRepresentation().data(),
+			   sizeof(pktinfo->ipi6_addr.s6_addr));
+	} else {
+		if (localAddress.isV6()) {
+			return false;
+		}
+
+		cmsg->cmsg_level             = IPPROTO_IP;
+		cmsg->cmsg_type              = IP_PKTINFO;
+		cmsg->cmsg_len               = CMSG_LEN(sizeof(struct in_pktinfo));
+		struct in_pktinfo *pktinfo   = reinterpret_cast< struct in_pktinfo * >(CMSG_DATA(cmsg));
+		pktinfo->ipi_spec_dst.s_addr = localAddress.toIPv4();
+	}
+
+	return true;
+}
+} // namespace UDPBatch
+
+
+UDPSendBatch::UDPSendBatch()
+	: m_slots(CAPACITY * UDPBatch::SLOT_SIZE / sizeof(std::uint64_t)), m_entries(CAPACITY), m_headers(CAPACITY),
+	  m_order(CAPACITY) {
+	static_assert(UDPBatch::SLOT_SIZE % sizeof(std::uint64_t) == 0, "Slots have to be 8-byte aligned");
+}
+
+unsigned char *UDPSendBatch::slot(std::size_t index) {
+	return reinterpret_cast< unsigned char * >(m_slots.data()) + index * UDPBatch::SLOT_SIZE + 4;
+}
+
+unsigned char *UDPSendBatch::prepare() {
+	if (m_size == CAPACITY) {
+		flush();
+	}
+
+	return slot(m_size);
+}
+
+void UDPSendBatch::commit(int socket, const struct sockaddr_storage &destination, const HostAddress &localAddress,
+						  std::size_t length) {
+	assert(m_size < CAPACITY);
+	assert(length <= UDPBatch::MAX_DATAGRAM_SIZE);
+
+	UDPBatch::Entry &entry = m_entries[m_size];
+
+	entry.socket = socket;
+	memcpy(&entry.address, &destination, sizeof(entry.address));
+	entry.iov.iov_base = slot(m_size);
+	entry.iov.iov_len  = length;
+
+	memset(&entry.header, 0, sizeof(entry.header));
+	entry.header.msg_iov     = &entry.iov;
+	entry.header.msg_iovlen  = 1;
+	entry.header.msg_control = entry.control;
+
+	if (!UDPBatch::setupMessageHeader(entry.header, entry.address, localAddress)) {
+		// Drop the datagram, just as sendmsg would have failed for it
+		return;
+	}
+
+	++m_size;
+}
+
+void UDPSendBatch::flush() {
+	if (m_size == 0) {
+		return;
+	}
+
+	// sendmmsg only works on a single socket, so we group the datagrams by socket. Datagrams for the same socket keep
+	// their relative order.
+	std::iota(m_order.begin(), m_order.begin() + static_cast< std::ptrdiff_t >(m_size), 0);
+	std::stable_sort(m_order.begin(), m_order.begin() + static_cast< std::ptrdiff_t >(m_size),
+					 [this](std::size_t lhs, std::size_t rhs) {
+						 return m_entries[lhs].socket < m_entries[rhs].socket;
+					 });
+
+	for (std::size_t i = 0; i < m_size; ++i) {
+		m_headers[i].msg_hdr = m_entries[m_order[i]].header;
+		m_headers[i].msg_len = 0;
+	}
+
+	std::size_t begin = 0;
+	while (begin < m_size) {
+		const int socket = m_entries[m_order[begin]].socket;
+
+		std::size_t end = begin + 1;
+		while (end < m_size && m_entries[m_order[end]].socket == socket) {
+			++end;
+		}
+
+		while (begin < end) {
+			int sent = ::sendmmsg(socket, &m_headers[begin], static_cast< unsigned int >(end - begin), 0);
+			++m_syscallCount;
+
+			if (sent > 0) {
+				m_datagramCount += static_cast< std::uint64_t >(sent);
+				begin += static_cast< std::size_t >(sent);
+			} else if (sent < 0 && errno == EINTR) {
+				continue;
+			} else {
+				// The first remaining datagram could not be sent. Just like the unbatched code path, we ignore send
+				// errors and skip it.
+				++begin;
+			}
+		}
+	}
+
+	m_size = 0;
+}
+
+std::size_t UDPSendBatch::size() const {
+	return m_size;
+}
+
+bool UDPSendBatch::isEmpty() const {
+	return m_size == 0;
+}
+
+int UDPSendBatch::getSocket(std::size_t index) const {
+	assert(index < m_size);
+
+	return m_entries[index].socket;
+}
+
+const struct msghdr &UDPSendBatch::getHeader(std::size_t index) const {
+	assert(index < m_size);
+
+	return m_entries[index].header;
+}
+
+void UDPSendBatch::clear() {
+	m_size = 0;
+}
+
+std::uint64_t UDPSendBatch::getSyscallCount() const {
+	return m_syscallCount;
+}
+
+std::uint64_t UDPSendBatch::getDatagramCount() const {
+	return m_datagramCount;
+}
+
+
+UDPReceiveBatch::UDPReceiveBatch()
+	: m_slots(CAPACITY * UDPBatch::SLOT_SIZE / sizeof(std::uint64_t)), m_entries(CAPACITY), m_headers(CAPACITY) {
+	for (std::size_t i = 0; i < CAPACITY; ++i) {
+		m_entries[i].iov.iov_base = slot(i);
+
+		memset(&m_headers[i], 0, sizeof(m_headers[i]));
+		m_headers[i].msg_hdr.msg_name    = &m_entries[i].address;
+		m_headers[i].msg_hdr.msg_iov     = &m_entries[i].iov;
+		m_headers[i].msg_hdr.msg_iovlen  = 1;
+		m_headers[i].msg_hdr.msg_control = m_entries[i].control;
+	}
+}
+
+unsigned char *UDPReceiveBatch::slot(std::size_t index) {
+	return reinterpret_cast< unsigned char * >(m_slots.data()) + index * UDPBatch::SLOT_SIZE + 4;
+}
+
+int UDPReceiveBatch::receive(int socket) {
+	for (std::size_t i = 0; i < CAPACITY; ++i) {
+		// Reset the fields that the kernel (or a ping reply reusing the header) may have changed
+		m_entries[i].iov.iov_base           = slot(i);
+		m_entries[i].iov.iov_len            = Mumble::Protocol::MAX_UDP_PACKET_SIZE;
+		m_headers[i].msg_hdr.msg_namelen    = sizeof(struct sockaddr_storage);
+		m_headers[i].msg_hdr.msg_controllen = UDPBatch::PKTINFO_CONTROL_SIZE;
+		m_headers[i].msg_hdr.msg_flags      = 0;
+		m_headers[i].msg_len                = 0;
+	}
+
+	return ::recvmmsg(socket, m_headers.data(), static_cast< unsigned int >(CAPACITY), MSG_DONTWAIT | MSG_TRUNC,
+					  nullptr);
+}
+
+unsigned char *UDPReceiveBatch::getData(std::size_t index) {
+	return slot(index);
+}
+
+std::size_t UDPReceiveBatch::getLength(std::size_t index) const {
+	if (m_headers[index].msg_hdr.msg_flags & MSG_TRUNC) {
+		return Mumble::Protocol::MAX_UDP_PACKET_SIZE + 1;
+	}
+
+	return m_headers[index].msg_len;
+}
+
+struct sockaddr_storage &UDPReceiveBatch::getSender(std::size_t index) {
+	return m_entries[index].address;
+}
+
+struct msghdr &UDPReceiveBatch::getHeader(std::size_t index) {
+	return m_headers[index].msg_hdr;
+}
@@ -0,0 +1,131 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_UDPBATCH_H_
+#define MUMBLE_MURMUR_UDPBATCH_H_
+
+#include "MumbleProtocol.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+struct HostAddress;
+
+namespace UDPBatch {
+/// The amount of control data needed to specify the source address of an outgoing datagram
+constexpr std::size_t PKTINFO_CONTROL_SIZE =
+	CMSG_SPACE(std::max(sizeof(struct in6_pktinfo), sizeof(struct in_pktinfo)));
+
+/// The size of a single datagram slot. The slots are 8-byte aligned and datagrams are placed at offset 4 into the
+/// slot, so that the payload following the 4-byte crypt header is 8-byte aligned.
+constexpr std::size_t SLOT_SIZE = Mumble::Protocol::MAX_UDP_PACKET_SIZE + 8;
+
+/// The maximum size of a datagram that fits into a slot
+constexpr std::size_t MAX_DATAGRAM_SIZE = SLOT_SIZE - 4;
+
+/// Fills in the name and control data of the given message header such that the datagram is sent to the given
+/// destination from the given local address. The message's msg_control has to point to at least
+/// PKTINFO_CONTROL_SIZE bytes.
+///
+/// @returns Whether the message header could be set up. This fails if an IPv4 destination is to be reached from an
+/// 	IPv6 local address.
+bool setupMessageHeader(struct msghdr &msg, const struct sockaddr_storage &destination,
+						const HostAddress &localAddress);
+
+/// The per-datagram state of a batch
+struct Entry {
+	int socket;
+	struct msghdr header;
+	struct sockaddr_storage address;
+	struct iovec iov;
+	alignas(struct cmsghdr) std::uint8_t control[PKTINFO_CONTROL_SIZE];
+};
+} // namespace UDPBatch
+
+/// Collects outgoing datagrams in order to send them using as few sendmmsg calls as possible
+class UDPSendBatch {
+public:
+	/// The maximum number of datagrams that are queued before the batch is flushed implicitly
+	static constexpr std::size_t CAPACITY = 64;
+
+	UDPSendBatch();
+
+	/// @returns A buffer of UDPBatch::MAX_DATAGRAM_SIZE bytes into which the next datagram can be written. The
+	/// 	datagram is only queued once commit() is called. If the batch is full, it is flushed first.
+	unsigned char *prepare();
+	/// Queues the datagram that has been written into the buffer returned by the last call to prepare()
+	void commit(int socket, const struct sockaddr_storage &destination, const HostAddress &localAddress,
+				std::size_t length);
+
+	/// Sends all queued datagrams. All datagrams for the same socket are sent with a single sendmmsg call.
+	void flush();
+
+	std::size_t size() const;
+	bool isEmpty() const;
+
+	/// @returns The socket the queued datagram at the given index is to be sent on
+	int getSocket(std::size_t index) const;
+	/// @returns The message header of the queued datagram at the given index. It (and the data it refers to) stays
+	/// 	valid until the next call to prepare().
+	const struct msghdr &getHeader(std::size_t index) const;
+	/// Drops all queued datagrams without sending them. This is meant to be used once the queued datagrams have been
+	/// handed to the kernel by other means.
+	void clear();
+
+	/// @returns The number of send system calls that have been issued by this batch so far
+	std::uint64_t getSyscallCount() const;
+	/// @returns The number of datagrams that have been handed to the kernel by this batch so far
+	std::uint64_t getDatagramCount() const;
+
+protected:
+	std::vector< std::uint64_t > m_slots;
+	std::vector< UDPBatch::Entry > m_entries;
+	std::vector< struct mmsghdr > m_headers;
+	/// The order in which the entries are sent (grouped by socket)
+	std::vector< std::size_t > m_order;
+	std::size_t m_size            = 0;
+	std::uint64_t m_syscallCount  = 0;
+	std::uint64_t m_datagramCount = 0;
+
+	unsigned char *slot(std::size_t index);
+};
+
+/// Receives multiple datagrams from a socket with a single recvmmsg call
+class UDPReceiveBatch {
+public:
+	/// The maximum number of datagrams received at once
+	static constexpr std::size_t CAPACITY = 32;
+
+	UDPReceiveBatch();
+
+	/// Receives as many datagrams as are pending on the given socket (up to CAPACITY) without blocking.
+	///
+	/// @returns The number of received datagrams or -1 if an error occurred (in which case errno is set)
+	int receive(int socket);
+
+	/// @returns The received datagram at the given index
+	unsigned char *getData(std::size_t index);
+	/// @returns The length of the received datagram at the given index. If the datagram was truncated, a length
+	/// 	larger than Mumble::Protocol::MAX_UDP_PACKET_SIZE is returned.
+	std::size_t getLength(std::size_t index) const;
+	struct sockaddr_storage &getSender(std::size_t index);
+	/// @returns The header the datagram at the given index has been received with. Its control data contains the
+	/// 	local address the datagram has been sent to, so it can be used to send a reply from the same address.
+	struct msghdr &getHeader(std::size_t index);
+
+protected:
+	std::vector< std::uint64_t > m_slots;
+	std::vector< UDPBatch::Entry > m_entries;
+	std::vector< struct mmsghdr > m_headers;
+
+	unsigned char *slot(std::size_t index);
+};
+
+#endif // MUMBLE_MURMUR_UDPBATCH_H_
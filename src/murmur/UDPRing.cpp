@@ -0,0 +1,284 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "UDPRing.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+#include <poll.h>
+
+namespace {
+/// The ID of the provided buffer group the receive buffers are registered as
+constexpr int BUFFER_GROUP = 0;
+
+/// The size of a single receive buffer. A multishot receive places the io_uring_recvmsg_out header, the sender's
+/// address and the control data in front of the payload.
+constexpr std::size_t BUFFER_SIZE = (sizeof(struct io_uring_recvmsg_out) + sizeof(struct sockaddr_storage)
+									 + UDPBatch::PKTINFO_CONTROL_SIZE + Mumble::Protocol::MAX_UDP_PACKET_SIZE + 7)
+									& ~static_cast< std::size_t >(7);
+
+/// The kind of operation a completion belongs to. This is stored in the upper half of the user data, the lower half
+/// contains the index of the socket (for receives).
+enum class Operation : std::uint32_t { Receive = 1, Send, Notify };
+
+std::uint64_t userData(Operation operation, std::size_t index = 0) {
+	return (static_cast< std::uint64_t >(operation) << 32) | static_cast< std::uint32_t >(index);
+}
+} // namespace
+
+UDPRing::UDPRing() : m_buffers(BUFFER_COUNT * BUFFER_SIZE / sizeof(std::uint64_t)), m_received(BUFFER_COUNT) {
+	memset(&m_ring, 0, sizeof(m_ring));
+
+	memset(&m_receiveTemplate, 0, sizeof(m_receiveTemplate));
+	m_receiveTemplate.msg_namelen    = sizeof(struct sockaddr_storage);
+	m_receiveTemplate.msg_controllen = UDPBatch::PKTINFO_CONTROL_SIZE;
+}
+
+UDPRing::~UDPRing() {
+	if (m_bufferRing) {
+		io_uring_free_buf_ring(&m_ring, m_bufferRing, BUFFER_COUNT, BUFFER_GROUP);
+	}
+	if (m_ringInitialized) {
+		// This also cancels all receives that are still armed
+		io_uring_queue_exit(&m_ring);
+	}
+}
+
+int UDPRing::setup(const std::vector< int > &sockets, int notifyFD) {
+	assert(!m_ringInitialized);
+
+	// The ring is only ever used by the thread that creates it, which allows the kernel to defer the completion work
+	// until we actually wait for completions.
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	params.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+
+	int ret = io_uring_queue_init_params(QUEUE_DEPTH, &m_ring, &params);
+	if (ret == -EINVAL) {
+		// Kernels older than 6.1 don't know about these flags
+		memset(&params, 0, sizeof(params));
+		ret = io_uring_queue_init_params(QUEUE_DEPTH, &m_ring, &params);
+	}
+	if (ret < 0) {
+		return ret;
+	}
+	m_ringInitialized = true;
+
+	m_bufferRing = io_uring_setup_buf_ring(&m_ring, BUFFER_COUNT, BUFFER_GROUP, 0, &ret);
+	if (!m_bufferRing) {
+		return ret < 0 ? ret : -ENOMEM;
+	}
+
+	const int mask = io_uring_buf_ring_mask(BUFFER_COUNT);
+	for (unsigned short i = 0; i < BUFFER_COUNT; ++i) {
+		io_uring_buf_ring_add(m_bufferRing, buffer(i), BUFFER_SIZE, i, mask, i);
+	}
+	io_uring_buf_ring_advance(m_bufferRing, BUFFER_COUNT);
+
+	m_sockets  = sockets;
+	m_notifyFD = notifyFD;
+
+	for (std::size_t i = 0; i < m_sockets.size(); ++i) {
+		armReceive(i);
+	}
+	armNotify();
+
+	return 0;
+}
+
+int UDPRing::wait() {
+	assert(m_receivedCount == 0);
+
+	while (m_error == 0) {
+		const int ret = io_uring_submit_and_wait(&m_ring, 1);
+		if (ret < 0 && ret != -EINTR && ret != -EAGAIN && ret != -EBUSY) {
+			return ret;
+		}
+
+		unsigned int head;
+		unsigned int seen = 0;
+		struct io_uring_cqe *cqe;
+		io_uring_for_each_cqe(&m_ring, head, cqe) {
+			handleCompletion(*cqe);
+			++seen;
+		}
+		io_uring_cq_advance(&m_ring, seen);
+
+		// The send batch may only be reused once the kernel is done with all datagrams in it
+		if (m_pendingSends == 0 && (m_receivedCount > 0 || m_notified)) {
+			return static_cast< int >(m_receivedCount);
+		}
+	}
+
+	return -m_error;
+}
+
+bool UDPRing::isNotified() const {
+	return m_notified;
+}
+
+int UDPRing::getSocket(std::size_t index) const {
+	assert(index < m_receivedCount);
+
+	return m_received[index].socket;
+}
+
+unsigned char *UDPRing::getData(std::size_t index) {
+	assert(index < m_receivedCount);
+
+	return m_received[index].data;
+}
+
+std::size_t UDPRing::getLength(std::size_t index) const {
+	assert(index < m_receivedCount);
+
+	return m_received[index].length;
+}
+
+struct sockaddr_storage &UDPRing::getSender(std::size_t index) {
+	assert(index < m_receivedCount);
+
+	return m_received[index].sender;
+}
+
+struct msghdr &UDPRing::getHeader(std::size_t index) {
+	assert(index < m_receivedCount);
+
+	return m_received[index].header;
+}
+
+void UDPRing::recycle() {
+	for (std::size_t i = 0; i < m_receivedCount; ++i) {
+		releaseBuffer(m_received[i].bufferID, static_cast< int >(i));
+	}
+	io_uring_buf_ring_advance(m_bufferRing, static_cast< int >(m_receivedCount));
+	m_receivedCount = 0;
+
+	for (std::size_t socketIndex : m_starvedSockets) {
+		armReceive(socketIndex);
+	}
+	m_starvedSockets.clear();
+}
+
+void UDPRing::send(UDPSendBatch &batch) {
+	for (std::size_t i = 0; i < batch.size(); ++i) {
+		io_uring_sqe *sqe = nextSubmission();
+		io_uring_prep_sendmsg(sqe, batch.getSocket(i), &batch.getHeader(i), 0);
+		io_uring_sqe_set_data64(sqe, userData(Operation::Send));
+
+		++m_pendingSends;
+	}
+
+	batch.clear();
+}
+
+unsigned char *UDPRing::buffer(unsigned short bufferID) {
+	return reinterpret_cast< unsigned char * >(m_buffers.data()) + bufferID * BUFFER_SIZE;
+}
+
+void UDPRing::releaseBuffer(unsigned short bufferID, int offset) {
+	io_uring_buf_ring_add(m_bufferRing, buffer(bufferID), BUFFER_SIZE, bufferID, io_uring_buf_ring_mask(BUFFER_COUNT),
+						  offset);
+}
+
+io_uring_sqe *UDPRing::nextSubmission() {
+	io_uring_sqe *sqe = io_uring_get_sqe(&m_ring);
+	if (!sqe) {
+		// The submission queue is full, so hand the queued entries to the kernel to make room
+		io_uring_submit(&m_ring);
+		sqe = io_uring_get_sqe(&m_ring);
+	}
+
+	assert(sqe);
+	return sqe;
+}
+
+void UDPRing::armReceive(std::size_t socketIndex) {
+	io_uring_sqe *sqe = nextSubmission();
+	io_uring_prep_recvmsg_multishot(sqe, m_sockets[socketIndex], &m_receiveTemplate, 0);
+	sqe->flags |= IOSQE_BUFFER_SELECT;
+	sqe->buf_group = BUFFER_GROUP;
+	io_uring_sqe_set_data64(sqe, userData(Operation::Receive, socketIndex));
+}
+
+void UDPRing::armNotify() {
+	io_uring_sqe *sqe = nextSubmission();
+	io_uring_prep_poll_add(sqe, m_notifyFD, POLLIN);
+	io_uring_sqe_set_data64(sqe, userData(Operation::Notify));
+}
+
+void UDPRing::handleCompletion(const struct io_uring_cqe &cqe) {
+	const std::uint64_t data = io_uring_cqe_get_data64(&cqe);
+
+	switch (static_cast< Operation >(data >> 32)) {
+		case Operation::Receive:
+			handleReceive(static_cast< std::size_t >(data & 0xFFFFFFFF), cqe);
+			break;
+		case Operation::Send:
+			// Just like with sendmmsg, send errors are ignored
+			assert(m_pendingSends > 0);
+			--m_pendingSends;
+			break;
+		case Operation::Notify:
+			m_notified = true;
+			break;
+	}
+}
+
+void UDPRing::handleReceive(std::size_t socketIndex, const struct io_uring_cqe &cqe) {
+	if (cqe.flags & IORING_CQE_F_BUFFER) {
+		const unsigned short bufferID = static_cast< unsigned short >(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+
+		struct io_uring_recvmsg_out *out =
+			cqe.res >= 0 ? io_uring_recvmsg_validate(buffer(bufferID), cqe.res, &m_receiveTemplate) : nullptr;
+
+		if (!out || m_receivedCount == m_received.size()) {
+			releaseBuffer(bufferID, 0);
+			io_uring_buf_ring_advance(m_bufferRing, 1);
+		} else {
+			Datagram &datagram = m_received[m_receivedCount++];
+			datagram.socket    = m_sockets[socketIndex];
+			datagram.bufferID  = bufferID;
+			datagram.data      = static_cast< unsigned char * >(io_uring_recvmsg_payload(out, &m_receiveTemplate));
+			datagram.length    = io_uring_recvmsg_payload_length(out, cqe.res, &m_receiveTemplate);
+			if (out->flags & MSG_TRUNC) {
+				datagram.length = Mumble::Protocol::MAX_UDP_PACKET_SIZE + 1;
+			}
+
+			const socklen_t nameLength =
+				std::min(static_cast< socklen_t >(out->namelen), static_cast< socklen_t >(sizeof(datagram.sender)));
+			memset(&datagram.sender, 0, sizeof(datagram.sender));
+			memcpy(&datagram.sender, io_uring_recvmsg_name(out), nameLength);
+
+			datagram.iov.iov_base = datagram.data;
+			datagram.iov.iov_len  = std::min(datagram.length, Mumble::Protocol::MAX_UDP_PACKET_SIZE);
+
+			struct cmsghdr *control = io_uring_recvmsg_cmsg_firsthdr(out, &m_receiveTemplate);
+
+			memset(&datagram.header, 0, sizeof(datagram.header));
+			datagram.header.msg_name       = &datagram.sender;
+			datagram.header.msg_namelen    = nameLength;
+			datagram.header.msg_iov        = &datagram.iov;
+			datagram.header.msg_iovlen     = 1;
+			datagram.header.msg_control    = control;
+			datagram.header.msg_controllen = control ? out->controllen : 0;
+		}
+	}
+
+	if (!(cqe.flags & IORING_CQE_F_MORE)) {
+		// The multishot receive has been terminated
+		if (cqe.res == -ENOBUFS) {
+			// All buffers are in use, so we have to wait until some of them are recycled
+			m_starvedSockets.push_back(socketIndex);
+		} else if (cqe.res >= 0 || cqe.res == -EINTR || cqe.res == -EAGAIN) {
+			armReceive(socketIndex);
+		} else {
+			m_error = -cqe.res;
+		}
+	}
+}
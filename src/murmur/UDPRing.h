@@ -0,0 +1,115 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_UDPRING_H_
+#define MUMBLE_MURMUR_UDPRING_H_
+
+#include "UDPBatch.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <liburing.h>
+
+/// Drives the UDP sockets of a voice thread through io_uring. Every socket has a multishot receive armed that places
+/// incoming datagrams into buffers from a provided buffer ring, so that waiting for and receiving any number of
+/// datagrams only takes a single system call. Outgoing datagrams are submitted along with that same call.
+///
+/// The interface mirrors UDPReceiveBatch: wait() returns the number of received datagrams, which can then be accessed
+/// by their index until recycle() is called.
+class UDPRing {
+public:
+	/// The number of receive buffers. This is also the maximum number of datagrams returned by a single wait().
+	static constexpr unsigned int BUFFER_COUNT = 256;
+	/// The number of submission queue entries
+	static constexpr unsigned int QUEUE_DEPTH = 256;
+
+	UDPRing();
+	~UDPRing();
+
+	UDPRing(const UDPRing &)            = delete;
+	UDPRing &operator=(const UDPRing &) = delete;
+
+	/// Sets up the ring for receiving on the given sockets. The ring also watches the given notification descriptor
+	/// for becoming readable (see isNotified()).
+	///
+	/// @returns 0 on success or a negative errno value if io_uring (or one of the required features) is not
+	/// 	supported by the running kernel
+	int setup(const std::vector< int > &sockets, int notifyFD);
+
+	/// Submits all pending operations (including the datagrams handed to send()) and waits until at least one
+	/// datagram has been received or the notification descriptor became readable. All previously submitted sends are
+	/// guaranteed to have completed once this function returns.
+	///
+	/// @returns The number of received datagrams or a negative errno value if the ring failed
+	int wait();
+
+	/// @returns Whether the notification descriptor has become readable
+	bool isNotified() const;
+
+	/// @returns The socket the datagram at the given index has been received on
+	int getSocket(std::size_t index) const;
+	/// @returns The received datagram at the given index
+	unsigned char *getData(std::size_t index);
+	/// @returns The length of the received datagram at the given index. If the datagram was truncated, a length
+	/// 	larger than Mumble::Protocol::MAX_UDP_PACKET_SIZE is returned.
+	std::size_t getLength(std::size_t index) const;
+	struct sockaddr_storage &getSender(std::size_t index);
+	/// @returns A message header whose control data contains the local address the datagram at the given index has
+	/// 	been sent to, so it can be used to send a reply from the same address.
+	struct msghdr &getHeader(std::size_t index);
+
+	/// Hands the buffers of all datagrams returned by the last call to wait() back to the kernel
+	void recycle();
+
+	/// Queues all datagrams of the given batch for sending and clears the batch. The datagrams are submitted with the
+	/// next call to wait(), so the batch must not be used before that.
+	void send(UDPSendBatch &batch);
+
+protected:
+	struct Datagram {
+		int socket;
+		unsigned short bufferID;
+		unsigned char *data;
+		std::size_t length;
+		struct sockaddr_storage sender;
+		struct iovec iov;
+		struct msghdr header;
+	};
+
+	struct io_uring m_ring;
+	bool m_ringInitialized                 = false;
+	struct io_uring_buf_ring *m_bufferRing = nullptr;
+	std::vector< std::uint64_t > m_buffers;
+	/// The template all multishot receives are prepared with (only the name and control lengths are used)
+	struct msghdr m_receiveTemplate;
+
+	std::vector< int > m_sockets;
+	int m_notifyFD = -1;
+
+	/// The datagrams returned by the last call to wait(). Every datagram holds one buffer, so there can't be more
+	/// than BUFFER_COUNT of them.
+	std::vector< Datagram > m_received;
+	std::size_t m_receivedCount = 0;
+	/// The sockets whose multishot receive has been terminated because all buffers were in use
+	std::vector< std::size_t > m_starvedSockets;
+
+	std::size_t m_pendingSends = 0;
+	bool m_notified            = false;
+	int m_error                = 0;
+
+	unsigned char *buffer(unsigned short bufferID);
+
+	io_uring_sqe *nextSubmission();
+	void armReceive(std::size_t socketIndex);
+	void armNotify();
+
+	void handleCompletion(const struct io_uring_cqe &cqe);
+	void handleReceive(std::size_t socketIndex, const struct io_uring_cqe &cqe);
+	void releaseBuffer(unsigned short bufferID, int offset);
+};
+
+#endif // MUMBLE_MURMUR_UDPRING_H_
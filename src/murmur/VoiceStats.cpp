@@ -0,0 +1,275 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "VoiceStats.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+/// Increments a value that is only ever written to by the calling thread
+void bump(std::atomic< std::uint64_t > &value, std::uint64_t amount = 1) {
+	value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+/// The bucket boundaries (in nanoseconds) used for the Prometheus export. These are a lot coarser than the buckets of
+/// the histogram itself to keep the number of exported series reasonable.
+constexpr std::uint64_t PROMETHEUS_BUCKETS[] = {
+	1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000, 25000000,
+	50000000, 100000000,
+};
+
+std::string seconds(std::uint64_t nanoseconds) {
+	std::ostringstream stream;
+	stream.imbue(std::locale::classic());
+	stream << std::setprecision(15) << static_cast< double >(nanoseconds) / 1e9;
+	return stream.str();
+}
+} // namespace
+
+std::size_t LatencyHistogram::bucketIndex(std::uint64_t value) {
+	if (value < SUB_BUCKET_COUNT) {
+		return static_cast< std::size_t >(value);
+	}
+
+	const unsigned int exponent = static_cast< unsigned int >(std::bit_width(value)) - 1;
+	if (exponent >= MAX_EXPONENT) {
+		return BUCKET_COUNT - 1;
+	}
+
+	// The leading bit is implied by the exponent, the next SUB_BUCKET_BITS bits select the linear sub-bucket
+	const std::size_t subBucket =
+		static_cast< std::size_t >(value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKET_COUNT - 1);
+
+	return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT + subBucket;
+}
+
+std::uint64_t LatencyHistogram::bucketUpperBound(std::size_t index) {
+	assert(index < BUCKET_COUNT);
+
+	if (index < SUB_BUCKET_COUNT) {
+		return index;
+	}
+
+	const unsigned int exponent   = static_cast< unsigned int >(index / SUB_BUCKET_COUNT) + SUB_BUCKET_BITS - 1;
+	const std::uint64_t subBucket = index % SUB_BUCKET_COUNT;
+	const unsigned int shift      = exponent - SUB_BUCKET_BITS;
+
+	return ((SUB_BUCKET_COUNT + subBucket + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(std::uint64_t nanoseconds) {
+	bump(m_buckets[bucketIndex(nanoseconds)]);
+	bump(m_sum, nanoseconds);
+
+	if (nanoseconds > m_max.load(std::memory_order_relaxed)) {
+		m_max.store(nanoseconds, std::memory_order_relaxed);
+	}
+}
+
+void LatencyHistogram::addTo(Snapshot &snapshot) const {
+	// The count is derived from the buckets (instead of being tracked separately), so that it is always consistent
+	// with them, even if the histogram is written to while we read it.
+	for (std::size_t i = 0; i < BUCKET_COUNT; ++i) {
+		const std::uint64_t count = m_buckets[i].load(std::memory_order_relaxed);
+
+		snapshot.buckets[i] += count;
+		snapshot.count += count;
+	}
+
+	snapshot.sum += m_sum.load(std::memory_order_relaxed);
+	snapshot.max = std::max(snapshot.max, m_max.load(std::memory_order_relaxed));
+}
+
+void LatencyHistogram::Snapshot::merge(const Snapshot &other) {
+	for (std::size_t i = 0; i < BUCKET_COUNT; ++i) {
+		buckets[i] += other.buckets[i];
+	}
+
+	count += other.count;
+	sum += other.sum;
+	max = std::max(max, other.max);
+}
+
+std::uint64_t LatencyHistogram::Snapshot::percentile(double fraction) const {
+	if (count == 0) {
+		return 0;
+	}
+
+	fraction = std::clamp(fraction, 0.0, 1.0);
+	// The rank of the value we are looking for (1-based)
+	const std::uint64_t rank =
+		std::max< std::uint64_t >(1, static_cast< std::uint64_t >(std::ceil(fraction * static_cast< double >(count))));
+
+	std::uint64_t seen = 0;
+	for (std::size_t i = 0; i < BUCKET_COUNT; ++i) {
+		seen += buckets[i];
+
+		if (seen >= rank) {
+			// Never report more than the largest value that has actually been recorded
+			return std::min(bucketUpperBound(i), max);
+		}
+	}
+
+	return max;
+}
+
+std::uint64_t LatencyHistogram::Snapshot::countAtOrBelow(std::uint64_t value) const {
+	const std::size_t last = bucketIndex(value);
+
+	std::uint64_t result = 0;
+	for (std::size_t i = 0; i <= last; ++i) {
+		result += buckets[i];
+	}
+
+	return result;
+}
+
+void VoiceStats::Snapshot::merge(const Snapshot &other) {
+	for (std::size_t i = 0; i < STAGE_COUNT; ++i) {
+		stages[i].merge(other.stages[i]);
+	}
+	for (std::size_t i = 0; i < DROP_COUNT; ++i) {
+		drops[i] += other.drops[i];
+	}
+	for (std::size_t i = 0; i < COUNTER_COUNT; ++i) {
+		counters[i] += other.counters[i];
+	}
+}
+
+void VoiceStats::record(VoiceStage stage, Clock::duration duration) {
+	// The clock is steady, so durations can't be negative
+	const auto nanoseconds = std::chrono::duration_cast< std::chrono::nanoseconds >(duration).count();
+
+	m_stages[static_cast< std::size_t >(stage)].record(static_cast< std::uint64_t >(nanoseconds));
+}
+
+VoiceStats::Clock::time_point VoiceStats::recordSince(VoiceStage stage, Clock::time_point start) {
+	const Clock::time_point now = Clock::now();
+
+	record(stage, now - start);
+
+	return now;
+}
+
+void VoiceStats::count(VoiceDrop drop) {
+	bump(m_drops[static_cast< std::size_t >(drop)]);
+}
+
+void VoiceStats::count(VoiceCounter counter, std::uint64_t amount) {
+	bump(m_counters[static_cast< std::size_t >(counter)], amount);
+}
+
+void VoiceStats::addTo(Snapshot &snapshot) const {
+	for (std::size_t i = 0; i < STAGE_COUNT; ++i) {
+		m_stages[i].addTo(snapshot.stages[i]);
+	}
+	for (std::size_t i = 0; i < DROP_COUNT; ++i) {
+		snapshot.drops[i] += m_drops[i].load(std::memory_order_relaxed);
+	}
+	for (std::size_t i = 0; i < COUNTER_COUNT; ++i) {
+		snapshot.counters[i] += m_counters[i].load(std::memory_order_relaxed);
+	}
+}
+
+const char *VoiceStats::name(VoiceStage stage) {
+	switch (stage) {
+		case VoiceStage::Receive:
+			return "receive";
+		case VoiceStage::Decrypt:
+			return "decrypt";
+		case VoiceStage::Route:
+			return "route";
+		case VoiceStage::Encode:
+			return "encode";
+		case VoiceStage::Send:
+			return "send";
+		case VoiceStage::Flush:
+			return "flush";
+	}
+
+	return "unknown";
+}
+
+const char *VoiceStats::name(VoiceDrop drop) {
+	switch (drop) {
+		case VoiceDrop::BandwidthLimit:
+			return "bandwidth_limit";
+		case VoiceDrop::DecryptFailure:
+			return "decrypt_failure";
+		case VoiceDrop::UnknownPeer:
+			return "unknown_peer";
+	}
+
+	return "unknown";
+}
+
+const char *VoiceStats::name(VoiceCounter counter) {
+	switch (counter) {
+		case VoiceCounter::DatagramsReceived:
+			return "datagrams_received";
+		case VoiceCounter::AudioPackets:
+			return "audio_packets";
+		case VoiceCounter::AudioPacketsSent:
+			return "audio_packets_sent";
+	}
+
+	return "unknown";
+}
+
+const char *VoiceStats::description(VoiceCounter counter) {
+	switch (counter) {
+		case VoiceCounter::DatagramsReceived:
+			return "Datagrams read from the UDP sockets.";
+		case VoiceCounter::AudioPackets:
+			return "Audio packets routed to their receivers.";
+		case VoiceCounter::AudioPacketsSent:
+			return "Audio packets forwarded to receivers (one per receiver of a routed packet).";
+	}
+
+	return "unknown";
+}
+
+void VoiceStats::writeStatistics(PrometheusWriter &writer,
+								 const std::vector< std::pair< unsigned int, Snapshot > > &servers) {
+	writer.family("murmur_voice_stage_seconds", "histogram", "Time spent in the individual stages of the voice path.");
+	for (const auto &[serverID, snapshot] : servers) {
+		for (std::size_t i = 0; i < STAGE_COUNT; ++i) {
+			const LatencyHistogram::Snapshot &stage = snapshot.stages[i];
+			const std::string labels =
+				"server=\"" + std::to_string(serverID) + "\",stage=\"" + name(static_cast< VoiceStage >(i)) + "\"";
+
+			for (std::uint64_t bound : PROMETHEUS_BUCKETS) {
+				writer.sample(labels + ",le=\"" + seconds(bound) + "\"", std::to_string(stage.countAtOrBelow(bound)),
+							  "_bucket");
+			}
+			writer.sample(labels + ",le=\"+Inf\"", std::to_string(stage.count), "_bucket");
+			writer.sample(labels, seconds(stage.sum), "_sum");
+			writer.sample(labels, std::to_string(stage.count), "_count");
+		}
+	}
+
+	writer.family("murmur_voice_dropped_total", "counter", "Incoming voice datagrams that have been dropped.");
+	for (const auto &[serverID, snapshot] : servers) {
+		for (std::size_t i = 0; i < DROP_COUNT; ++i) {
+			writer.sample("server=\"" + std::to_string(serverID) + "\",reason=\"" + name(static_cast< VoiceDrop >(i))
+							  + "\"",
+						  snapshot.drops[i]);
+		}
+	}
+
+	for (std::size_t i = 0; i < COUNTER_COUNT; ++i) {
+		const VoiceCounter counter = static_cast< VoiceCounter >(i);
+
+		writer.family(std::string("murmur_voice_") + name(counter) + "_total", "counter", description(counter));
+		for (const auto &[serverID, snapshot] : servers) {
+			writer.sample("server=\"" + std::to_string(serverID) + "\"", snapshot.counters[i]);
+		}
+	}
+}
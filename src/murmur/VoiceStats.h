@@ -0,0 +1,154 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_VOICESTATS_H_
+#define MUMBLE_MURMUR_VOICESTATS_H_
+
+#include "PrometheusWriter.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/// The stages a voice packet passes through on its way through the server
+enum class VoiceStage {
+	/// Reading datagrams from a socket (one sample per system call)
+	Receive,
+	/// Decrypting an incoming datagram
+	Decrypt,
+	/// Determining the receivers of an audio packet
+	Route,
+	/// Encoding an audio packet for its receivers
+	Encode,
+	/// Encrypting the datagrams of an audio packet and sending (or queueing) them
+	Send,
+	/// Sending a batch of queued datagrams (one sample per system call)
+	Flush,
+};
+
+/// The reasons for which incoming voice datagrams are dropped
+enum class VoiceDrop {
+	/// The sender exceeded the bandwidth limit
+	BandwidthLimit,
+	/// The datagram could not be decrypted with the sender's key
+	DecryptFailure,
+	/// The datagram could not be associated with any user
+	UnknownPeer,
+};
+
+/// Plain event counters of the voice path
+enum class VoiceCounter {
+	/// Datagrams read from the UDP sockets
+	DatagramsReceived,
+	/// Audio packets that have been routed to their receivers (including ones tunneled through TCP)
+	AudioPackets,
+	/// Audio packets forwarded to receivers (i.e. one per receiver of a routed packet)
+	AudioPacketsSent,
+};
+
+/// A histogram of durations with logarithmic bucket widths (in the spirit of HdrHistogram). Every power of two is
+/// subdivided into 2^SUB_BUCKET_BITS linear buckets, which bounds the relative error of any reported value to
+/// 1/2^SUB_BUCKET_BITS, while still covering everything from nanoseconds to minutes with a fixed number of buckets.
+///
+/// A histogram must only ever be written to by a single thread. This allows recording to get by without any atomic
+/// read-modify-write operations, while the histogram can still be read by other threads at any time.
+class LatencyHistogram {
+public:
+	static constexpr unsigned int SUB_BUCKET_BITS = 4;
+	static constexpr std::size_t SUB_BUCKET_COUNT = std::size_t(1) << SUB_BUCKET_BITS;
+	/// Values of 2^MAX_EXPONENT nanoseconds and above all end up in the last bucket
+	static constexpr unsigned int MAX_EXPONENT = 40;
+	static constexpr std::size_t BUCKET_COUNT  = (MAX_EXPONENT - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+	/// A copy of (one or more merged) histograms
+	struct Snapshot {
+		std::array< std::uint64_t, BUCKET_COUNT > buckets = {};
+		std::uint64_t count                               = 0;
+		std::uint64_t sum                                 = 0;
+		std::uint64_t max                                 = 0;
+
+		void merge(const Snapshot &other);
+
+		/// @returns The (upper bound of the) value below which the given fraction of all recorded values lies or 0 if
+		/// 	nothing has been recorded
+		std::uint64_t percentile(double fraction) const;
+		/// @returns The number of recorded values that are less than or equal to the given value. Values within the
+		/// 	bucket containing the given value are counted as well.
+		std::uint64_t countAtOrBelow(std::uint64_t value) const;
+	};
+
+	LatencyHistogram() = default;
+
+	LatencyHistogram(const LatencyHistogram &)            = delete;
+	LatencyHistogram &operator=(const LatencyHistogram &) = delete;
+
+	void record(std::uint64_t nanoseconds);
+
+	void addTo(Snapshot &snapshot) const;
+
+	static std::size_t bucketIndex(std::uint64_t value);
+	/// @returns The largest value that is mapped to the bucket with the given index
+	static std::uint64_t bucketUpperBound(std::size_t index);
+
+protected:
+	std::array< std::atomic< std::uint64_t >, BUCKET_COUNT > m_buckets = {};
+	std::atomic< std::uint64_t > m_sum                                 = 0;
+	std::atomic< std::uint64_t > m_max                                 = 0;
+};
+
+/// Always-on statistics of the voice path: a latency histogram per VoiceStage as well as counters for VoiceDrop and
+/// VoiceCounter events. Every thread that processes voice packets owns its own instance, so that recording never
+/// contends with other threads (see LatencyHistogram). Reading is possible at any time from any thread.
+class VoiceStats {
+public:
+	static constexpr std::size_t STAGE_COUNT   = static_cast< std::size_t >(VoiceStage::Flush) + 1;
+	static constexpr std::size_t DROP_COUNT    = static_cast< std::size_t >(VoiceDrop::UnknownPeer) + 1;
+	static constexpr std::size_t COUNTER_COUNT = static_cast< std::size_t >(VoiceCounter::AudioPacketsSent) + 1;
+
+	struct Snapshot {
+		std::array< LatencyHistogram::Snapshot, STAGE_COUNT > stages = {};
+		std::array< std::uint64_t, DROP_COUNT > drops                = {};
+		std::array< std::uint64_t, COUNTER_COUNT > counters          = {};
+
+		void merge(const Snapshot &other);
+	};
+
+	using Clock = std::chrono::steady_clock;
+
+	VoiceStats() = default;
+
+	VoiceStats(const VoiceStats &)            = delete;
+	VoiceStats &operator=(const VoiceStats &) = delete;
+
+	void record(VoiceStage stage, Clock::duration duration);
+	/// Records the time that has passed since the given start time and returns the current time
+	Clock::time_point recordSince(VoiceStage stage, Clock::time_point start);
+
+	void count(VoiceDrop drop);
+	void count(VoiceCounter counter, std::uint64_t amount = 1);
+
+	void addTo(Snapshot &snapshot) const;
+
+	static const char *name(VoiceStage stage);
+	static const char *name(VoiceDrop drop);
+	static const char *name(VoiceCounter counter);
+	static const char *description(VoiceCounter counter);
+
+	/// Writes the given snapshots (one per virtual server) to the given writer
+	static void writeStatistics(PrometheusWriter &writer,
+								const std::vector< std::pair< unsigned int, Snapshot > > &servers);
+
+protected:
+	std::array< LatencyHistogram, STAGE_COUNT > m_stages;
+	std::array< std::atomic< std::uint64_t >, DROP_COUNT > m_drops       = {};
+	std::array< std::atomic< std::uint64_t >, COUNTER_COUNT > m_counters = {};
+};
+
+#endif // MUMBLE_MURMUR_VOICESTATS_H_
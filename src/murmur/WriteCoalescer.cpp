@@ -0,0 +1,38 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "WriteCoalescer.h"
+
+#include <utility>
+
+WriteCoalescer::WriteCoalescer(std::chrono::milliseconds maxDelay) {
+	m_flushTimer.setSingleShot(true);
+	m_flushTimer.setInterval(maxDelay);
+	QObject::connect(&m_flushTimer, &QTimer::timeout, [this]() { flush(); });
+}
+
+void WriteCoalescer::add(Connection &connection) {
+	m_pending.append(&connection);
+
+	if (!m_flushTimer.isActive()) {
+		m_flushTimer.start();
+	}
+}
+
+void WriteCoalescer::flush() {
+	m_flushTimer.stop();
+
+	const QList< QPointer< Connection > > pending = std::exchange(m_pending, {});
+
+	for (const QPointer< Connection > &connection : pending) {
+		if (connection) {
+			connection->writePending();
+		}
+	}
+}
+
+std::size_t WriteCoalescer::pending() const {
+	return static_cast< std::size_t >(m_pending.size());
+}
@@ -0,0 +1,46 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_MURMUR_WRITECOALESCER_H_
+#define MUMBLE_MURMUR_WRITECOALESCER_H_
+
+#include "Connection.h"
+
+#include <QtCore/QList>
+#include <QtCore/QPointer>
+#include <QtCore/QTimer>
+
+#include <chrono>
+#include <cstddef>
+
+/// Writes the messages that the connections of a server have gathered (see Connection::setWriteCoalescing()) to their
+/// sockets. Instead of every connection arming a timer of its own, the connections with pending messages are collected
+/// and written by a single flush for all of them.
+///
+/// The flush is scheduled when the first connection is added after the previous flush and runs once the configured
+/// delay has passed. With a delay of zero, it runs after everything that is already pending in the event loop, so
+/// all messages produced while handling a single event end up in the same write.
+///
+/// Must only be used from the thread the WriteCoalescer has been created in.
+class WriteCoalescer {
+public:
+	explicit WriteCoalescer(std::chrono::milliseconds maxDelay);
+
+	/// Makes the messages gathered by the given connection be written by the next flush
+	void add(Connection &connection);
+	/// Writes the messages gathered by all connections that have been added since the previous flush
+	void flush();
+
+	/// @returns The number of connections waiting for the next flush
+	std::size_t pending() const;
+
+protected:
+	/// Triggers the flush. Running as long as there are connections waiting for it.
+	QTimer m_flushTimer;
+	/// Connections that are destroyed before the flush are skipped
+	QList< QPointer< Connection > > m_pending;
+};
+
+#endif // MUMBLE_MURMUR_WRITECOALESCER_H_
@@ -93,9 +93,18 @@ namespace server {
 		}
 
 		std::string getLegacyGroupData(const DBAcl &acl, GroupTable &groupTable) {
+			std::string affectedGroupName;
+			if (acl.affectedGroupID) {
+				affectedGroupName = groupTable.getGroup(acl.serverID, acl.affectedGroupID.value()).name;
+			}
+
+			return getLegacyGroupData(acl, affectedGroupName);
+		}
+
+		std::string getLegacyGroupData(const DBAcl &acl, const std::string &affectedGroupName) {
 			std::string groupData;
 			if (acl.affectedGroupID) {
-				groupData = groupTable.getGroup(acl.serverID, acl.affectedGroupID.value()).name;
+				groupData = affectedGroupName;
 			} else if (acl.affectedMetaGroup) {
 				// The main ChanACL class doesn't distinguish real groups from meta groups
 				groupData = metaGroupName(acl.affectedMetaGroup.value());
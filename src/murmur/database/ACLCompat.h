@@ -31,6 +31,10 @@ namespace server {
 		std::string metaGroupName(DBAcl::MetaGroup group);
 
 		std::string getLegacyGroupData(const DBAcl &acl, GroupTable &groupTable);
+		/**
+		 * Same as above, but with the name of the group affected by the given ACL (if any) already known
+		 */
+		std::string getLegacyGroupData(const DBAcl &acl, const std::string &affectedGroupName);
 
 	} // namespace db
 } // namespace server
@@ -255,26 +255,42 @@ namespace server {
 		}
 
 		std::vector< DBAcl > ACLTable::getAllACLs(unsigned int serverID, unsigned int channelID) {
+			return fetchACLs(serverID, channelID);
+		}
+
+		std::vector< DBAcl > ACLTable::getAllACLs(unsigned int serverID) { return fetchACLs(serverID, std::nullopt); }
+
+		std::vector< DBAcl > ACLTable::fetchACLs(unsigned int serverID, std::optional< unsigned int > channelID) {
 			try {
 				std::vector< DBAcl > acls;
 				soci::row row;
 
 				::mdb::TransactionHolder transaction = ensureTransaction();
 
-				soci::statement stmt =
-					(m_sql.prepare << "SELECT \"" << column::priority << "\", \"" << column::aff_user_id << "\", \""
-								   << column::aff_group_id << "\", \"" << column::aff_meta_group_id << "\", \""
-								   << column::access_token << "\", \"" << column::group_modifiers << "\", \""
-								   << column::apply_in_current << "\", \"" << column::apply_in_sub << "\", \""
-								   << column::granted_flags << "\", \"" << column::revoked_flags << "\" FROM \"" << NAME
-								   << "\" WHERE \"" << column::server_id << "\" = :serverID AND \""
-								   << column::channel_id << "\" = :channelID ORDER BY \"" << column::priority << "\"",
-					 soci::use(serverID), soci::use(channelID), soci::into(row));
+				std::string query = std::string("SELECT \"") + column::priority + "\", \"" + column::aff_user_id
+									+ "\", \"" + column::aff_group_id + "\", \"" + column::aff_meta_group_id + "\", \""
+									+ column::access_token + "\", \"" + column::group_modifiers + "\", \""
+									+ column::apply_in_current + "\", \"" + column::apply_in_sub + "\", \""
+									+ column::granted_flags + "\", \"" + column::revoked_flags + "\", \""
+									+ column::channel_id + "\" FROM \"" + NAME + "\" WHERE \"" + column::server_id
+									+ "\" = :serverID";
+				if (channelID) {
+					query += std::string(" AND \"") + column::channel_id + "\" = :channelID";
+				}
+				query += std::string(" ORDER BY \"") + column::channel_id + "\", \"" + column::priority + "\"";
+
+				soci::statement stmt = (m_sql.prepare << query);
+				stmt.exchange(soci::into(row));
+				stmt.exchange(soci::use(serverID));
+				if (channelID) {
+					stmt.exchange(soci::use(channelID.value()));
+				}
+				stmt.define_and_bind();
 
 				stmt.execute(false);
 
 				while (stmt.fetch()) {
-					assert(row.size() == 10);
+					assert(row.size() == 11);
 					assert(row.get_properties(0).get_data_type() == soci::dt_integer);
 					assert(row.get_properties(1).get_data_type() == soci::dt_integer);
 					assert(row.get_properties(2).get_data_type() == soci::dt_integer);
@@ -285,10 +301,11 @@ namespace server {
 					assert(row.get_properties(7).get_data_type() == soci::dt_integer);
 					assert(row.get_properties(8).get_data_type() == soci::dt_integer);
 					assert(row.get_properties(9).get_data_type() == soci::dt_integer);
+					assert(row.get_properties(10).get_data_type() == soci::dt_integer);
 
 					DBAcl acl;
 					acl.serverID  = serverID;
-					acl.channelID = channelID;
+					acl.channelID = static_cast< unsigned int >(row.get< int >(10));
 					acl.priority  = static_cast< unsigned int >(row.get< int >(0));
 					if (row.get_indicator(1) == soci::i_ok) {
 						acl.affectedUserID = static_cast< unsigned int >(row.get< int >(1));
@@ -345,9 +362,10 @@ namespace server {
 
 				return acls;
 			} catch (const soci::soci_error &) {
-				std::throw_with_nested(::mdb::AccessException("Failed at getting ACLs for channel with ID "
-															  + std::to_string(channelID) + " on server with ID "
-															  + std::to_string(serverID)));
+				std::throw_with_nested(::mdb::AccessException(
+					"Failed at getting ACLs for "
+					+ (channelID ? "channel with ID " + std::to_string(channelID.value()) : std::string("all channels"))
+					+ " on server with ID " + std::to_string(serverID)));
 			}
 		}
 
@@ -11,6 +11,7 @@
 #include "database/Backend.h"
 #include "database/Table.h"
 
+#include <optional>
 #include <vector>
 
 namespace soci {
@@ -64,10 +65,20 @@ namespace server {
 			void clearACLs(unsigned int serverID, unsigned int channelID);
 
 			std::vector< DBAcl > getAllACLs(unsigned int serverID, unsigned int channelID);
+			/**
+			 * @returns The ACLs of all channels on the given server, ordered by channel and priority
+			 */
+			std::vector< DBAcl > getAllACLs(unsigned int serverID);
 
 			std::size_t countOverallACLs(unsigned int serverID);
 
 			void migrate(unsigned int fromSchemeVersion, unsigned int toSchemeVersion) override;
+
+		protected:
+			/**
+			 * @returns The ACLs of the channel with the given ID or of all channels, if no ID is given
+			 */
+			std::vector< DBAcl > fetchACLs(unsigned int serverID, std::optional< unsigned int > channelID);
 		};
 
 	} // namespace db
@@ -173,6 +173,43 @@ namespace server {
 			}
 		}
 
+		std::unordered_map< unsigned int, std::unordered_map< ChannelProperty, std::string > >
+			ChannelPropertyTable::getAllProperties(unsigned int serverID) {
+			try {
+				::mdb::TransactionHolder transaction = ensureTransaction();
+
+				std::unordered_map< unsigned int, std::unordered_map< ChannelProperty, std::string > > properties;
+				soci::row row;
+
+				soci::statement stmt =
+					(m_sql.prepare << "SELECT \"" << column::channel_id << "\", \"" << column::key << "\", \""
+								   << column::value << "\" FROM \"" << NAME << "\" WHERE \"" << column::server_id
+								   << "\" = :serverID",
+					 soci::use(serverID), soci::into(row));
+
+				stmt.execute(false);
+
+				while (stmt.fetch()) {
+					assert(row.size() == 3);
+					assert(row.get_properties(0).get_data_type() == soci::dt_integer);
+					assert(row.get_properties(1).get_data_type() == soci::dt_integer);
+					assert(row.get_properties(2).get_data_type() == soci::dt_string);
+
+					const unsigned int channelID   = static_cast< unsigned int >(row.get< int >(0));
+					const ChannelProperty property = static_cast< ChannelProperty >(row.get< int >(1));
+
+					properties[channelID][property] = row.get< std::string >(2);
+				}
+
+				transaction.commit();
+
+				return properties;
+			} catch (const soci::soci_error &) {
+				std::throw_with_nested(::mdb::AccessException("Failed at fetching all channel properties on server "
+															  + std::to_string(serverID)));
+			}
+		}
+
 		void ChannelPropertyTable::migrate(unsigned int fromSchemeVersion, unsigned int toSchemeVersion) {
 			// Note: Always hard-code old table and column names in this function in order to ensure that this
 			// migration path always stays the same regardless of whether the respective named constants change.
@@ -16,6 +16,7 @@
 #include "database/Table.h"
 
 #include <string>
+#include <unordered_map>
 
 namespace soci {
 class session;
@@ -83,6 +84,13 @@ namespace server {
 
 			void clearAllProperties(unsigned int serverID, unsigned int channelID);
 
+			/**
+			 * @returns The raw values of all properties set for any channel on the given server, by channel ID. Use
+			 * 	StringConverter to convert them to the respective type.
+			 */
+			std::unordered_map< unsigned int, std::unordered_map< ChannelProperty, std::string > >
+				getAllProperties(unsigned int serverID);
+
 			void migrate(unsigned int fromSchemeVersion, unsigned int toSchemeVersion) override;
 
 		protected:
@@ -243,6 +243,48 @@ namespace server {
 		}
 
 
+		std::vector< DBChannel > ChannelTable::getAllChannels(unsigned int serverID) {
+			try {
+				::mdb::TransactionHolder transaction = ensureTransaction();
+
+				std::vector< DBChannel > channels;
+				soci::row row;
+
+				soci::statement stmt =
+					(m_sql.prepare << "SELECT \"" << column::channel_id << "\", \"" << column::parent_id << "\", \""
+								   << column::name << "\", \"" << column::inherit_acl << "\" FROM \"" << NAME
+								   << "\" WHERE \"" << column::server_id << "\" = :serverID ORDER BY \""
+								   << column::channel_id << "\"",
+					 soci::use(serverID), soci::into(row));
+
+				stmt.execute(false);
+
+				while (stmt.fetch()) {
+					assert(row.size() == 4);
+					assert(row.get_properties(0).get_data_type() == soci::dt_integer);
+					assert(row.get_properties(1).get_data_type() == soci::dt_integer);
+					assert(row.get_properties(2).get_data_type() == soci::dt_string);
+					assert(row.get_properties(3).get_data_type() == soci::dt_integer);
+
+					DBChannel channel;
+					channel.serverID   = serverID;
+					channel.channelID  = static_cast< unsigned int >(row.get< int >(0));
+					channel.parentID   = static_cast< unsigned int >(row.get< int >(1));
+					channel.name       = row.get< std::string >(2);
+					channel.inheritACL = row.get< int >(3);
+
+					channels.push_back(std::move(channel));
+				}
+
+				transaction.commit();
+
+				return channels;
+			} catch (const soci::soci_error &) {
+				std::throw_with_nested(::mdb::AccessException("Failed at fetching all channels on server with ID "
+															  + std::to_string(serverID)));
+			}
+		}
+
 		void ChannelTable::migrate(unsigned int fromSchemeVersion, unsigned int toSchemeVersion) {
 			// Note: Always hard-code old table and column names in this function in order to ensure that this
 			// migration path always stays the same regardless of whether the respective named constants change.
@@ -65,6 +65,11 @@ namespace server {
 
 			std::vector< unsigned int > getChildrenOf(unsigned int serverID, unsigned int channelID);
 
+			/**
+			 * @returns All channels (including the root channel) on the given server, ordered by their ID
+			 */
+			std::vector< DBChannel > getAllChannels(unsigned int serverID);
+
 			void migrate(unsigned int fromSchemeVersion, unsigned int toSchemeVersion) override;
 		};
 
@@ -176,6 +176,45 @@ namespace server {
 			}
 		}
 
+		std::vector< DBGroupMember > GroupMemberTable::getAllEntries(unsigned int serverID) {
+			try {
+				std::vector< DBGroupMember > members;
+				soci::row row;
+
+				::mdb::TransactionHolder transaction = ensureTransaction();
+
+				soci::statement stmt =
+					(m_sql.prepare << "SELECT \"" << column::group_id << "\", \"" << column::user_id << "\", \""
+								   << column::add_to_group << "\" FROM \"" << NAME << "\" WHERE \"" << column::server_id
+								   << "\" = :serverID",
+					 soci::use(serverID), soci::into(row));
+
+				stmt.execute(false);
+
+				while (stmt.fetch()) {
+					assert(row.size() == 3);
+					assert(row.get_properties(0).get_data_type() == soci::dt_integer);
+					assert(row.get_properties(1).get_data_type() == soci::dt_integer);
+					assert(row.get_properties(2).get_data_type() == soci::dt_integer);
+
+					DBGroupMember member;
+					member.serverID   = serverID;
+					member.groupID    = static_cast< unsigned int >(row.get< int >(0));
+					member.userID     = static_cast< unsigned int >(row.get< int >(1));
+					member.addToGroup = row.get< int >(2);
+
+					members.push_back(std::move(member));
+				}
+
+				transaction.commit();
+
+				return members;
+			} catch (const soci::soci_error &) {
+				std::throw_with_nested(::mdb::AccessException("Failed at getting all group entries on server with ID "
+															  + std::to_string(serverID)));
+			}
+		}
+
 		void GroupMemberTable::migrate(unsigned int fromSchemeVersion, unsigned int toSchemeVersion) {
 			// Note: Always hard-code table and column names in this function in order to ensure that this
 			// migration path always stays the same regardless of whether the respective named constants change.
@@ -54,6 +54,10 @@ namespace server {
 			bool entryExists(unsigned int serverID, unsigned int groupID, unsigned int userID);
 
 			std::vector< DBGroupMember > getEntries(unsigned int serverID, unsigned int groupID);
+			/**
+			 * @returns The entries of all groups on the given server
+			 */
+			std::vector< DBGroupMember > getAllEntries(unsigned int serverID);
 
 			void migrate(unsigned int fromSchemeVersion, unsigned int toSchemeVersion) override;
 		};
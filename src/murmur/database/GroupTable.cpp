@@ -333,6 +333,50 @@ namespace server {
 			}
 		}
 
+		std::vector< DBGroup > GroupTable::getAllGroups(unsigned int serverID) {
+			try {
+				std::vector< DBGroup > groups;
+				soci::row row;
+
+				::mdb::TransactionHolder transaction = ensureTransaction();
+
+				soci::statement stmt =
+					(m_sql.prepare << "SELECT \"" << column::group_id << "\", \"" << column::group_name << "\", \""
+								   << column::inherit << "\", \"" << column::is_inheritable << "\", \""
+								   << column::channel_id << "\" FROM \"" << NAME << "\" WHERE \"" << column::server_id
+								   << "\" = :serverID",
+					 soci::use(serverID), soci::into(row));
+
+				stmt.execute(false);
+
+				while (stmt.fetch()) {
+					assert(row.size() == 5);
+					assert(row.get_properties(0).get_data_type() == soci::dt_integer);
+					assert(row.get_properties(1).get_data_type() == soci::dt_string);
+					assert(row.get_properties(2).get_data_type() == soci::dt_integer);
+					assert(row.get_properties(3).get_data_type() == soci::dt_integer);
+					assert(row.get_properties(4).get_data_type() == soci::dt_integer);
+
+					DBGroup group;
+					group.serverID       = serverID;
+					group.channelID      = static_cast< unsigned int >(row.get< int >(4));
+					group.groupID        = static_cast< unsigned int >(row.get< int >(0));
+					group.name           = row.get< std::string >(1);
+					group.inherit        = row.get< int >(2);
+					group.is_inheritable = row.get< int >(3);
+
+					groups.push_back(std::move(group));
+				}
+
+				transaction.commit();
+
+				return groups;
+			} catch (const soci::soci_error &) {
+				std::throw_with_nested(::mdb::AccessException("Failed at getting all groups on server with ID "
+															  + std::to_string(serverID)));
+			}
+		}
+
 		void GroupTable::migrate(unsigned int fromSchemeVersion, unsigned int toSchemeVersion) {
 			// Note: Always hard-code table and column names in this function in order to ensure that this
 			// migration path always stays the same regardless of whether the respective named constants change.
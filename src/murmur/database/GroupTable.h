@@ -67,6 +67,10 @@ namespace server {
 			std::size_t countGroups(unsigned int serverID, unsigned int channelID);
 
 			std::vector< DBGroup > getAllGroups(unsigned int serverID, unsigned int channelID);
+			/**
+			 * @returns The groups of all channels on the given server
+			 */
+			std::vector< DBGroup > getAllGroups(unsigned int serverID);
 
 
 			void migrate(unsigned int fromSchemeVersion, unsigned int toSchemeVersion) override;
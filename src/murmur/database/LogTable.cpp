@@ -15,13 +15,17 @@
 #include "database/ForeignKey.h"
 #include "database/Index.h"
 #include "database/MigrationException.h"
+#include "database/StatementCache.h"
 #include "database/TransactionHolder.h"
 #include "database/Utils.h"
 
 #include <soci/soci.h>
 
+#include <algorithm>
 #include <cassert>
 #include <exception>
+#include <string>
+#include <tuple>
 
 namespace mdb = ::mumble::db;
 
@@ -64,9 +68,17 @@ namespace server {
 			try {
 				::mdb::TransactionHolder transaction = ensureTransaction();
 
-				m_sql << "INSERT INTO \"" << NAME << "\" (\"" << column::server_id << "\", \"" << column::message
-					  << "\", \"" << column::date << "\") VALUES (:id, :msg, :date)",
-					soci::use(serverID), soci::use(entry.message), soci::use(timeSinceEpoch);
+				auto &stmt = getStatementCache().get< unsigned int, std::string, std::size_t >(
+					"logMessage", [this](auto &values) -> soci::statement {
+						return (m_sql.prepare << "INSERT INTO \"" << NAME << "\" (\"" << column::server_id << "\", \""
+											  << column::message << "\", \"" << column::date
+											  << "\") VALUES (:id, :msg, :date)",
+								soci::use(std::get< 0 >(values)), soci::use(std::get< 1 >(values)),
+								soci::use(std::get< 2 >(values)));
+					});
+
+				stmt.values = { serverID, entry.message, timeSinceEpoch };
+				stmt.execute();
 
 				transaction.commit();
 			} catch (const soci::soci_error &) {
@@ -76,6 +88,55 @@ namespace server {
 			}
 		}
 
+		void LogTable::logMessages(const std::vector< std::pair< unsigned int, DBLogEntry > > &entries) {
+			// Some backends limit the number of parameters per statement (SQLite used to allow only 999), so larger
+			// batches are split across multiple statements
+			constexpr std::size_t ROWS_PER_STATEMENT = 100;
+
+			try {
+				::mdb::TransactionHolder transaction = ensureTransaction();
+
+				for (std::size_t begin = 0; begin < entries.size(); begin += ROWS_PER_STATEMENT) {
+					const std::size_t end = std::min(entries.size(), begin + ROWS_PER_STATEMENT);
+
+					// The bound values have to stay alive until the statement has been executed
+					std::vector< unsigned int > serverIDs;
+					std::vector< std::size_t > timestamps;
+					serverIDs.reserve(end - begin);
+					timestamps.reserve(end - begin);
+
+					std::string query = std::string("INSERT INTO \"") + NAME + "\" (\"" + column::server_id + "\", \""
+										+ column::message + "\", \"" + column::date + "\") VALUES ";
+					for (std::size_t i = begin; i < end; ++i) {
+						const std::string suffix = std::to_string(i - begin);
+
+						if (i != begin) {
+							query += ", ";
+						}
+						query += "(:id" + suffix + ", :msg" + suffix + ", :date" + suffix + ")";
+
+						serverIDs.push_back(entries[i].first);
+						timestamps.push_back(toEpochSeconds(entries[i].second.timestamp));
+					}
+
+					soci::statement stmt = (m_sql.prepare << query);
+					for (std::size_t i = begin; i < end; ++i) {
+						stmt.exchange(soci::use(serverIDs[i - begin]));
+						stmt.exchange(soci::use(entries[i].second.message));
+						stmt.exchange(soci::use(timestamps[i - begin]));
+					}
+
+					stmt.define_and_bind();
+					stmt.execute(true);
+				}
+
+				transaction.commit();
+			} catch (const soci::soci_error &) {
+				std::throw_with_nested(::mdb::AccessException("Failed at logging " + std::to_string(entries.size())
+															  + " messages"));
+			}
+		}
+
 		void LogTable::clearLog(unsigned int serverID) {
 			try {
 				::mdb::TransactionHolder transaction = ensureTransaction();
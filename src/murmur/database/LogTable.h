@@ -12,6 +12,8 @@
 #include "DBLogEntry.h"
 
 #include <limits>
+#include <utility>
+#include <vector>
 
 namespace soci {
 class session;
@@ -42,6 +44,11 @@ namespace server {
 			~LogTable() = default;
 
 			void logMessage(unsigned int serverID, const DBLogEntry &entry);
+			/**
+			 * Stores the given entries (pairs of server ID and entry) using multi-row inserts, which is a lot cheaper
+			 * than storing them one by one.
+			 */
+			void logMessages(const std::vector< std::pair< unsigned int, DBLogEntry > > &entries);
 
 			void clearLog(unsigned int serverID);
 
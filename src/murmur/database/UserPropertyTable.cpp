@@ -13,7 +13,9 @@
 #include "database/Database.h"
 #include "database/ForeignKey.h"
 #include "database/MigrationException.h"
+#include "database/NoDataException.h"
 #include "database/PrimaryKey.h"
+#include "database/StatementCache.h"
 #include "database/TransactionHolder.h"
 #include "database/Utils.h"
 
@@ -21,6 +23,9 @@
 
 #include <cassert>
 #include <exception>
+#include <string>
+#include <tuple>
+#include <unordered_map>
 #include <vector>
 
 namespace mdb = ::mumble::db;
@@ -66,20 +71,26 @@ namespace server {
 			try {
 				::mdb::TransactionHolder transaction = ensureTransaction();
 
-				std::string val;
-
-				int intProp = static_cast< int >(property);
-
-				m_sql << "SELECT \"" << column::value << "\" FROM \"" << NAME << "\" WHERE \"" << column::server_id
-					  << "\" = :serverID AND \"" << column::user_id << "\" = :userID AND \"" << column::key
-					  << "\" = :key",
-					soci::into(val), soci::use(user.serverID), soci::use(user.registeredUserID), soci::use(intProp);
-
-				::mdb::utils::verifyQueryResultedInData(m_sql);
+				auto &stmt = getStatementCache().get< unsigned int, unsigned int, int, std::string >(
+					"getProperty", [this](auto &values) -> soci::statement {
+						return (m_sql.prepare << "SELECT \"" << column::value << "\" FROM \"" << NAME << "\" WHERE \""
+											  << column::server_id << "\" = :serverID AND \"" << column::user_id
+											  << "\" = :userID AND \"" << column::key << "\" = :key",
+								soci::use(std::get< 0 >(values)), soci::use(std::get< 1 >(values)),
+								soci::use(std::get< 2 >(values)), soci::into(std::get< 3 >(values)));
+					});
+
+				stmt.values = { user.serverID, user.registeredUserID, static_cast< int >(property), std::string() };
+				if (!stmt.execute()) {
+					throw ::mdb::NoDataException("Property " + std::to_string(static_cast< int >(property))
+												 + " is not set for user with ID "
+												 + std::to_string(user.registeredUserID) + " on server "
+												 + std::to_string(user.serverID));
+				}
 
 				transaction.commit();
 
-				return val;
+				return std::get< 3 >(stmt.values);
 			} catch (const soci::soci_error &) {
 				std::throw_with_nested(::mdb::AccessException(
 					"Failed at fetching property " + std::to_string(static_cast< int >(property)) + " for user with ID "
@@ -180,23 +191,21 @@ namespace server {
 
 				::mdb::TransactionHolder transaction = ensureTransaction();
 
-				soci::row row;
-
-				int intProp = static_cast< int >(property);
+				// This is used to look users up by their certificate hash (and email) on every login
+				auto &stmt = getStatementCache().get< unsigned int, int, std::string, unsigned int >(
+					"findUsersWithProperty", [this](auto &values) -> soci::statement {
+						return (m_sql.prepare << "SELECT \"" << column::user_id << "\" FROM \"" << NAME
+											  << "\" WHERE \"" << column::server_id << "\" = :serverID AND \""
+											  << column::key << "\" = :key AND \"" << column::value << "\" = :value",
+								soci::use(std::get< 0 >(values)), soci::use(std::get< 1 >(values)),
+								soci::use(std::get< 2 >(values)), soci::into(std::get< 3 >(values)));
+					});
 
-				soci::statement stmt =
-					(m_sql.prepare << "SELECT \"" << column::user_id << "\" FROM \"" << NAME << "\" WHERE \""
-								   << column::server_id << "\" = :serverID AND \"" << column::key << "\" = :key AND \""
-								   << column::value << "\" = :value",
-					 soci::use(serverID), soci::use(intProp), soci::use(value), soci::into(row));
-
-				stmt.execute(false);
+				stmt.values = { serverID, static_cast< int >(property), value, 0 };
+				stmt.query();
 
 				while (stmt.fetch()) {
-					assert(row.size() == 1);
-					assert(row.get_properties(0).get_data_type() == soci::dt_integer);
-
-					matchingIDs.push_back(static_cast< unsigned int >(row.get< int >(0)));
+					matchingIDs.push_back(std::get< 3 >(stmt.values));
 				}
 
 				transaction.commit();
@@ -210,6 +219,39 @@ namespace server {
 			}
 		}
 
+		std::unordered_map< unsigned int, std::string > UserPropertyTable::getAllValues(unsigned int serverID,
+																						  UserProperty property) {
+			try {
+				std::unordered_map< unsigned int, std::string > values;
+
+				unsigned int userID = 0;
+				std::string value;
+				int key = static_cast< int >(property);
+
+				::mdb::TransactionHolder transaction = ensureTransaction();
+
+				soci::statement stmt =
+					(m_sql.prepare << "SELECT \"" << column::user_id << "\", \"" << column::value << "\" FROM \""
+								   << NAME << "\" WHERE \"" << column::server_id << "\" = :serverID AND \""
+								   << column::key << "\" = :key",
+					 soci::use(serverID), soci::use(key), soci::into(userID), soci::into(value));
+
+				stmt.execute(false);
+
+				while (stmt.fetch()) {
+					values[userID] = value;
+				}
+
+				transaction.commit();
+
+				return values;
+			} catch (const soci::soci_error &) {
+				std::throw_with_nested(::mdb::AccessException("Failed at getting all values of property "
+															  + std::to_string(static_cast< unsigned int >(property))
+															  + " on server " + std::to_string(serverID)));
+			}
+		}
+
 		void UserPropertyTable::migrate(unsigned int fromSchemeVersion, unsigned int toSchemeVersion) {
 			// Note: Always hard-code old table and column names in this function in order to ensure that this
 			// migration path always stays the same regardless of whether the respective named constants change.
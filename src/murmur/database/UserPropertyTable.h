@@ -17,6 +17,8 @@
 #include "database/Table.h"
 
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace soci {
 class session;
@@ -86,6 +88,12 @@ namespace server {
 			std::vector< unsigned int > findUsersWithProperty(unsigned int serverID, UserProperty property,
 															  const std::string &value);
 
+			/**
+			 * @returns The values of the given property of all users on the given server that have it set, by their
+			 * 	user ID
+			 */
+			std::unordered_map< unsigned int, std::string > getAllValues(unsigned int serverID, UserProperty property);
+
 			void migrate(unsigned int fromSchemeVersion, unsigned int toSchemeVersion) override;
 
 		protected:
@@ -16,6 +16,8 @@
 #include "database/ForeignKey.h"
 #include "database/FormatException.h"
 #include "database/MigrationException.h"
+#include "database/NoDataException.h"
+#include "database/StatementCache.h"
 #include "database/TransactionHolder.h"
 #include "database/Trigger.h"
 #include "database/Utils.h"
@@ -28,6 +30,8 @@
 #include <exception>
 #include <optional>
 #include <span>
+#include <tuple>
+#include <unordered_map>
 
 namespace mdb = ::mumble::db;
 
@@ -319,10 +323,17 @@ namespace server {
 
 				::mdb::TransactionHolder transaction = ensureTransaction();
 
-				m_sql << "UPDATE \"" << NAME << "\" SET \"" << column::last_disconnect
-					  << "\" = :lastDisconnect WHERE \"" << column::server_id << "\" = :serverID AND \""
-					  << column::user_id << "\" = :userID",
-					soci::use(lastDisconnect), soci::use(user.serverID), soci::use(user.registeredUserID);
+				auto &stmt = getStatementCache().get< std::size_t, unsigned int, unsigned int >(
+					"setLastDisconnect", [this](auto &values) -> soci::statement {
+						return (m_sql.prepare << "UPDATE \"" << NAME << "\" SET \"" << column::last_disconnect
+											  << "\" = :lastDisconnect WHERE \"" << column::server_id
+											  << "\" = :serverID AND \"" << column::user_id << "\" = :userID",
+								soci::use(std::get< 0 >(values)), soci::use(std::get< 1 >(values)),
+								soci::use(std::get< 2 >(values)));
+					});
+
+				stmt.values = { lastDisconnect, user.serverID, user.registeredUserID };
+				stmt.execute();
 
 				transaction.commit();
 			} catch (const soci::soci_error &) {
@@ -364,9 +375,17 @@ namespace server {
 
 				::mdb::TransactionHolder transaction = ensureTransaction();
 
-				m_sql << "UPDATE \"" << NAME << "\" SET \"" << column::last_active << "\" = :lastActive WHERE \""
-					  << column::server_id << "\" = :serverID AND \"" << column::user_id << "\" = :userID",
-					soci::use(lastActive), soci::use(user.serverID), soci::use(user.registeredUserID);
+				auto &stmt = getStatementCache().get< std::size_t, unsigned int, unsigned int >(
+					"setLastActive", [this](auto &values) -> soci::statement {
+						return (m_sql.prepare << "UPDATE \"" << NAME << "\" SET \"" << column::last_active
+											  << "\" = :lastActive WHERE \"" << column::server_id
+											  << "\" = :serverID AND \"" << column::user_id << "\" = :userID",
+								soci::use(std::get< 0 >(values)), soci::use(std::get< 1 >(values)),
+								soci::use(std::get< 2 >(values)));
+					});
+
+				stmt.values = { lastActive, user.serverID, user.registeredUserID };
+				stmt.execute();
 
 				transaction.commit();
 			} catch (const soci::soci_error &) {
@@ -414,11 +433,18 @@ namespace server {
 			try {
 				::mdb::TransactionHolder transaction = ensureTransaction();
 
-				m_sql << "UPDATE \"" << NAME << "\" SET \"" << column::last_channel_id << "\" = :lastChannel, \""
-					  << column::last_active << "\" = :lastActive WHERE \"" << column::server_id
-					  << "\" = :serverID AND \"" << column::user_id << "\" = :userID",
-					soci::use(channelID), soci::use(lastActive), soci::use(user.serverID),
-					soci::use(user.registeredUserID);
+				auto &stmt = getStatementCache().get< unsigned int, std::size_t, unsigned int, unsigned int >(
+					"setLastChannelID", [this](auto &values) -> soci::statement {
+						return (m_sql.prepare << "UPDATE \"" << NAME << "\" SET \"" << column::last_channel_id
+											  << "\" = :lastChannel, \"" << column::last_active
+											  << "\" = :lastActive WHERE \"" << column::server_id
+											  << "\" = :serverID AND \"" << column::user_id << "\" = :userID",
+								soci::use(std::get< 0 >(values)), soci::use(std::get< 1 >(values)),
+								soci::use(std::get< 2 >(values)), soci::use(std::get< 3 >(values)));
+					});
+
+				stmt.values = { channelID, lastActive, user.serverID, user.registeredUserID };
+				stmt.execute();
 
 				transaction.commit();
 			} catch (const soci::soci_error &) {
@@ -432,17 +458,24 @@ namespace server {
 			try {
 				::mdb::TransactionHolder transaction = ensureTransaction();
 
-				unsigned int last_channel_id = Mumble::ROOT_CHANNEL_ID;
-
-				m_sql << "SELECT \"" << column::last_channel_id << "\" FROM \"" << NAME << "\" WHERE \""
-					  << column::server_id << "\" = :serverID AND \"" << column::user_id << "\" = :userID",
-					soci::use(user.serverID), soci::use(user.registeredUserID), soci::into(last_channel_id);
-
-				::mdb::utils::verifyQueryResultedInData(m_sql);
+				auto &stmt = getStatementCache().get< unsigned int, unsigned int, unsigned int >(
+					"getLastChannelID", [this](auto &values) -> soci::statement {
+						return (m_sql.prepare << "SELECT \"" << column::last_channel_id << "\" FROM \"" << NAME
+											  << "\" WHERE \"" << column::server_id << "\" = :serverID AND \""
+											  << column::user_id << "\" = :userID",
+								soci::use(std::get< 0 >(values)), soci::use(std::get< 1 >(values)),
+								soci::into(std::get< 2 >(values)));
+					});
+
+				stmt.values = { user.serverID, user.registeredUserID, Mumble::ROOT_CHANNEL_ID };
+				if (!stmt.execute()) {
+					throw ::mdb::NoDataException("There is no user with ID " + std::to_string(user.registeredUserID)
+												 + " on server with ID " + std::to_string(user.serverID));
+				}
 
 				transaction.commit();
 
-				return last_channel_id;
+				return std::get< 2 >(stmt.values);
 			} catch (const soci::soci_error &) {
 				std::throw_with_nested(::mdb::AccessException("Failed at getting last_channel_id for user with ID "
 															  + std::to_string(user.registeredUserID)
@@ -623,21 +656,28 @@ namespace server {
 		std::optional< unsigned int > UserTable::findUser(unsigned int serverID, const std::string &name,
 														  bool caseSensitive) {
 			try {
-				unsigned int id;
-
 				::mdb::TransactionHolder transaction = ensureTransaction();
 
-				std::string nameCol =
-					caseSensitive ? column::user_name : std::string("LOWER(\"") + column::user_name + "\")";
-				std::string nameParam = caseSensitive ? ":userName" : "LOWER(:userName)";
+				auto &stmt = getStatementCache().get< unsigned int, std::string, unsigned int >(
+					caseSensitive ? "findUser" : "findUserCaseInsensitive",
+					[this, caseSensitive](auto &values) -> soci::statement {
+						std::string nameCol =
+							caseSensitive ? column::user_name : std::string("LOWER(\"") + column::user_name + "\")";
+						std::string nameParam = caseSensitive ? ":userName" : "LOWER(:userName)";
+
+						return (m_sql.prepare << "SELECT \"" << column::user_id << "\" FROM \"" << NAME << "\" WHERE \""
+											  << column::server_id << "\" = :serverID AND " << nameCol << " = "
+											  << nameParam,
+								soci::use(std::get< 0 >(values)), soci::use(std::get< 1 >(values)),
+								soci::into(std::get< 2 >(values)));
+					});
 
-				m_sql << "SELECT \"" << column::user_id << "\" FROM \"" << NAME << "\" WHERE \"" << column::server_id
-					  << "\" = :serverID AND " << nameCol << " = " << nameParam,
-					soci::use(serverID), soci::use(name), soci::into(id);
+				stmt.values = { serverID, name, 0 };
+				bool found  = stmt.execute();
 
 				transaction.commit();
 
-				return m_sql.got_data() ? id : std::optional< unsigned int >{};
+				return found ? std::get< 2 >(stmt.values) : std::optional< unsigned int >{};
 			} catch (const soci::soci_error &) {
 				std::throw_with_nested(::mdb::AccessException("Failed at searching for user with name \"" + name + "\""
 															  + " on server with ID " + std::to_string(serverID)));
@@ -677,6 +717,54 @@ namespace server {
 		}
 
 
+		std::unordered_map< unsigned int, DBUserData > UserTable::getNamesAndPasswords(unsigned int serverID) {
+			try {
+				std::unordered_map< unsigned int, DBUserData > users;
+
+				unsigned int userID = 0;
+				DBUserData data;
+
+				// These indicators are required in order to be able to handle NULL values
+				soci::indicator pwHashInd, pwSaltInd, kdfIterInd;
+
+				::mdb::TransactionHolder transaction = ensureTransaction();
+
+				soci::statement stmt =
+					(m_sql.prepare << "SELECT \"" << column::user_id << "\", \"" << column::user_name << "\", \""
+								   << column::password_hash << "\", \"" << column::salt << "\", \""
+								   << column::kdf_iterations << "\" FROM \"" << NAME << "\" WHERE \""
+								   << column::server_id << "\" = :serverID",
+					 soci::use(serverID), soci::into(userID), soci::into(data.name),
+					 soci::into(data.password.passwordHash, pwHashInd), soci::into(data.password.salt, pwSaltInd),
+					 soci::into(data.password.kdfIterations, kdfIterInd));
+
+				stmt.execute(false);
+
+				while (stmt.fetch()) {
+					// NULL values leave the bound variables untouched, so they might still hold the previous row's data
+					if (pwHashInd == soci::i_null) {
+						data.password.passwordHash.clear();
+					}
+					if (pwSaltInd == soci::i_null) {
+						data.password.salt.clear();
+					}
+					if (kdfIterInd == soci::i_null) {
+						data.password.kdfIterations = 0;
+					}
+
+					users[userID] = data;
+				}
+
+				transaction.commit();
+
+				return users;
+			} catch (const soci::soci_error &) {
+				std::throw_with_nested(::mdb::AccessException(
+					"Failed at getting names and passwords of registered users on server with ID "
+					+ std::to_string(serverID)));
+			}
+		}
+
 		void UserTable::migrate(unsigned int fromSchemeVersion, unsigned int toSchemeVersion) {
 			// Note: Always hard-code old table and column names in this function in order to ensure that this
 			// migration path always stays the same regardless of whether the respective named constants change.
@@ -17,6 +17,7 @@
 #include <optional>
 #include <span>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace soci {
@@ -103,6 +104,12 @@ namespace server {
 
 			std::vector< DBUser > getRegisteredUsers(unsigned int serverID, const std::string &filter = "%");
 
+			/**
+			 * @returns The name and password data of all registered users on the given server, by their user ID. All
+			 * 	other fields of the returned DBUserData objects are left at their default values.
+			 */
+			std::unordered_map< unsigned int, DBUserData > getNamesAndPasswords(unsigned int serverID);
+
 
 			void migrate(unsigned int fromSchemeVersion, unsigned int toSchemeVersion) override;
 		};
@@ -0,0 +1,97 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#ifndef MUMBLE_TEST_SERVERFIXTURE_H_
+#define MUMBLE_TEST_SERVERFIXTURE_H_
+
+#include "Meta.h"
+#include "Server.h"
+#include "ServerUser.h"
+#include "Version.h"
+#include "database/SQLiteConnectionParameter.h"
+
+#include <QtCore/QTemporaryDir>
+#include <QtNetwork/QSslSocket>
+
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Provides what tests and benchmarks need in order to work with real Server instances: a temporary SQLite database,
+ * the global Meta object and the servers themselves. A QCoreApplication has to exist for as long as the fixture does.
+ */
+class ServerFixture {
+public:
+	ServerFixture() : m_connectionParameter(m_dataDir.filePath("server.sqlite").toStdString()) {
+		Meta::mp           = std::make_unique< MetaParams >();
+		Meta::mp->bBonjour = false;
+
+		meta = new Meta(m_connectionParameter);
+	}
+
+	~ServerFixture() {
+		for (auto it = m_servers.rbegin(); it != m_servers.rend(); ++it) {
+			delete *it;
+		}
+
+		delete meta;
+		meta = nullptr;
+	}
+
+	ServerFixture(const ServerFixture &) = delete;
+	ServerFixture &operator=(const ServerFixture &) = delete;
+
+	const ::mumble::db::SQLiteConnectionParameter &connectionParameter() const { return m_connectionParameter; }
+
+	/// Adds a virtual server to the database and boots it on an ephemeral port of the loopback interface. The server
+	/// is owned by the fixture.
+	///
+	/// @param configuration Configuration of the server in addition to its address (e.g. "bandwidth")
+	/// @returns The server or nullptr, if it failed to start
+	template< typename ServerType = Server >
+	ServerType *addServer(const std::map< std::string, std::string > &configuration = {}) {
+		const unsigned int serverID = meta->dbWrapper.addServer();
+		meta->dbWrapper.setConfiguration(serverID, "host", "127.0.0.1");
+		meta->dbWrapper.setConfiguration(serverID, "port", "0");
+		for (const auto &[key, value] : configuration) {
+			meta->dbWrapper.setConfiguration(serverID, key, value);
+		}
+
+		ServerType *server = new ServerType(serverID, m_connectionParameter);
+		m_servers.push_back(server);
+
+		return server->bValid ? server : nullptr;
+	}
+
+	/// @returns A new user of the given server that counts as authenticated, but isn't connected to anything and hasn't
+	/// been added to the server's users or to a channel yet. The caller owns the user.
+	static ServerUser *createUser(Server &server) {
+		ServerUser *user = new ServerUser(&server, new QSslSocket());
+		user->sState     = ServerUser::Authenticated;
+		user->uiSession  = server.qqIds.dequeue();
+		user->qsName     = QString::fromLatin1("User %1").arg(user->uiSession);
+		user->m_version  = Version::get();
+
+		return user;
+	}
+
+	/// A message handler that drops everything but critical and fatal messages, which would otherwise drown the output
+	/// of benchmarks
+	static void silenceMessages(QtMsgType type, const QMessageLogContext &, const QString &msg) {
+		if (type == QtCriticalMsg || type == QtFatalMsg) {
+			fprintf(stderr, "%s\n", qPrintable(msg));
+		}
+	}
+
+protected:
+	QTemporaryDir m_dataDir;
+	::mumble::db::SQLiteConnectionParameter m_connectionParameter;
+	std::vector< Server * > m_servers;
+};
+
+#endif // MUMBLE_TEST_SERVERFIXTURE_H_
@@ -0,0 +1,471 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "ACL.h"
+#include "Channel.h"
+#include "Group.h"
+#include "Server.h"
+#include "ServerFixture.h"
+#include "ServerUser.h"
+
+#include <QtCore>
+#include <QtTest>
+
+#include <memory>
+
+// The channel tree and the groups all tests operate on:
+//
+// Root     staff: add 1, 2, temporary 5 and the anonymous user's session
+//          mixed: add 1, remove 1
+// - A      staff: add 3, remove 2
+//          mixed: add 1
+//          private (not inheritable): add 1
+//   - B    staff (doesn't inherit): add 4
+//     - C  private: add 2
+// - D
+//
+// Users (by ID): The anonymous user (-1) in C, 1 in A, 2 in B, 3 in Root, 4 in D and 5 in B
+//
+// ACLs (only used by effectivePermissions()):
+// Root     all: deny Speak; staff: allow Speak and MuteDeafen
+// - A      ~sub,1 (sub channels only): allow MakeChannel; !auth: deny TextMessage
+//   - B    #secret: allow Move
+// - D      ~out (this channel only): deny Traverse and Enter
+//
+// clearACLCacheFor() adds the users to the server and temporarily changes the ACLs of B.
+class TestACL : public QObject {
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void cleanupTestCase();
+
+	void appliesToUser_data();
+	void appliesToUser();
+	void effectivePermissions_data();
+	void effectivePermissions();
+	void clearACLCacheFor();
+
+private:
+	/// Users can't exist without a server, which is all the server is needed for
+	std::unique_ptr< ServerFixture > m_fixture;
+	Server *m_server = nullptr;
+
+	Channel *m_root = nullptr;
+	QHash< QString, Channel * > m_channels;
+	QMap< int, ServerUser * > m_users;
+
+	ServerUser *addUser(int id, const QString &channel);
+	Group *addGroup(const QString &channel, const QString &name, const QSet< int > &add,
+					const QSet< int > &remove = {});
+	ChanACL *addACL(const QString &channel, const QString &group, bool applyHere, bool applySubs,
+					ChanACL::Permissions allow, ChanACL::Permissions deny);
+};
+
+namespace {
+
+/// The implementation of Group::appliesToUser() from before group specifications were parsed ahead of time. The
+/// current implementation has to produce the same results.
+bool legacyAppliesToUser(const Channel &currentChannel, const Channel &aclChannel, QString groupSpecification,
+						 const ServerUser &user) {
+	bool matches                  = false;
+	bool invert                   = false;
+	bool isAccessToken            = false;
+	bool isCertHash               = false;
+	const Channel *contextChannel = &currentChannel;
+
+	while (!groupSpecification.isEmpty()) {
+		if (groupSpecification.startsWith(QChar::fromLatin1('!'))) {
+			invert             = true;
+			groupSpecification = groupSpecification.remove(0, 1);
+			continue;
+		}
+
+		if (groupSpecification.startsWith(QChar::fromLatin1('~'))) {
+			contextChannel     = &aclChannel;
+			groupSpecification = groupSpecification.remove(0, 1);
+			continue;
+		}
+
+		if (groupSpecification.startsWith(QChar::fromLatin1('#'))) {
+			isAccessToken      = true;
+			groupSpecification = groupSpecification.remove(0, 1);
+			continue;
+		}
+		if (groupSpecification.startsWith(QChar::fromLatin1('$'))) {
+			isCertHash         = true;
+			groupSpecification = groupSpecification.remove(0, 1);
+			continue;
+		}
+
+		break;
+	}
+
+	if (groupSpecification.isEmpty()) {
+		return false;
+	}
+
+	if (isAccessToken)
+		matches = user.qslAccessTokens.contains(groupSpecification, Group::accessTokenCaseSensitivity);
+	else if (isCertHash)
+		matches = user.qsHash == groupSpecification;
+	else if (groupSpecification == QLatin1String("none"))
+		matches = false;
+	else if (groupSpecification == QLatin1String("all"))
+		matches = true;
+	else if (groupSpecification == QLatin1String("auth"))
+		matches = (user.iId >= 0);
+	else if (groupSpecification == QLatin1String("strong"))
+		matches = user.bVerified;
+	else if (groupSpecification == QLatin1String("in"))
+		matches = (user.cChannel == contextChannel);
+	else if (groupSpecification == QLatin1String("out"))
+		matches = !(user.cChannel == contextChannel);
+	else if (groupSpecification == QLatin1String("sub") || groupSpecification.startsWith(QLatin1String("sub,"))) {
+		groupSpecification = groupSpecification.remove(0, 4);
+
+		int requiredChannelOffset = 0;
+		int minDescendantLevel    = 1;
+		int maxDescendantLevel    = 1000;
+
+		QStringList args = groupSpecification.split(QLatin1String(","));
+		if (args.count() >= 1 && !args[0].isEmpty()) {
+			requiredChannelOffset = args[0].toInt();
+		}
+		if (args.count() >= 2 && !args[1].isEmpty()) {
+			minDescendantLevel = args[1].toInt();
+		}
+		if (args.count() >= 3 && !args[2].isEmpty()) {
+			maxDescendantLevel = args[2].toInt();
+		}
+
+		QList< const Channel * > homeChannelHierarchy;
+		const Channel *channel = user.cChannel;
+		while (channel) {
+			homeChannelHierarchy.prepend(channel);
+			channel = channel->cParent;
+		}
+
+		QList< const Channel * > currentChannelHierarchy;
+		channel = &currentChannel;
+		while (channel) {
+			currentChannelHierarchy.prepend(channel);
+			channel = channel->cParent;
+		}
+
+		auto requiredChannelIndex = currentChannelHierarchy.indexOf(contextChannel);
+		requiredChannelIndex += requiredChannelOffset;
+
+		if (requiredChannelIndex >= currentChannelHierarchy.count()) {
+			return invert;
+		} else if (requiredChannelIndex < 0) {
+			requiredChannelIndex = 0;
+		}
+
+		const Channel *requiredChannel = currentChannelHierarchy[requiredChannelIndex];
+		if (homeChannelHierarchy.indexOf(requiredChannel) == -1) {
+			return invert;
+		}
+
+		const auto minDepth   = requiredChannelIndex + minDescendantLevel;
+		const auto maxDepth   = requiredChannelIndex + maxDescendantLevel;
+		const auto totalDepth = homeChannelHierarchy.count() - 1;
+
+		matches = (totalDepth >= minDepth) && (totalDepth <= maxDepth);
+	} else {
+		QStack< const Group * > groupStack;
+
+		const Channel *channel = contextChannel;
+
+		while (channel) {
+			const Group *group = channel->qhGroups.value(groupSpecification);
+
+			if (group) {
+				if ((channel != contextChannel) && !group->bInheritable)
+					break;
+				groupStack.push(group);
+				if (!group->bInherit)
+					break;
+			}
+
+			channel = channel->cParent;
+		}
+
+		while (!groupStack.isEmpty()) {
+			const Group *group = groupStack.pop();
+			if (group->qsAdd.contains(user.iId) || group->qsTemporary.contains(user.iId)
+				|| group->qsTemporary.contains(-static_cast< int >(user.uiSession)))
+				matches = true;
+			if (group->qsRemove.contains(user.iId))
+				matches = false;
+		}
+	}
+	return invert ? !matches : matches;
+}
+
+} // namespace
+
+void TestACL::initTestCase() {
+	m_fixture = std::make_unique< ServerFixture >();
+	m_server  = m_fixture->addServer();
+	QVERIFY(m_server);
+
+	Channel *root = new Channel(0, "Root");
+	Channel *a    = new Channel(1, "A", root);
+	Channel *b    = new Channel(2, "B", a);
+	Channel *c    = new Channel(3, "C", b);
+	Channel *d    = new Channel(4, "D", root);
+
+	m_root     = root;
+	m_channels = { { "Root", root }, { "A", a }, { "B", b }, { "C", c }, { "D", d } };
+
+	ServerUser *anonymous = addUser(-1, "C");
+	anonymous->qslAccessTokens << "Secret";
+	anonymous->qsHash    = "abcd";
+	anonymous->bVerified = false;
+	addUser(1, "A");
+	addUser(2, "B");
+	addUser(3, "Root");
+	addUser(4, "D");
+	addUser(5, "B");
+
+	Group *rootStaff = addGroup("Root", "staff", { 1, 2 });
+	rootStaff->qsTemporary << 5 << -static_cast< int >(anonymous->uiSession);
+	addGroup("Root", "mixed", { 1 }, { 1 });
+	addGroup("A", "staff", { 3 }, { 2 });
+	addGroup("A", "mixed", { 1 });
+	addGroup("A", "private", { 1 })->bInheritable = false;
+	addGroup("B", "staff", { 4 })->bInherit       = false;
+	addGroup("C", "private", { 2 });
+
+	using Perm = ChanACL::Perm;
+	addACL("Root", "all", true, true, Perm::None, Perm::Speak);
+	addACL("Root", "staff", true, true, Perm::Speak | Perm::MuteDeafen, Perm::None);
+	addACL("A", "~sub,1", false, true, Perm::MakeChannel, Perm::None);
+	addACL("A", "!auth", true, true, Perm::None, Perm::TextMessage);
+	addACL("B", "#secret", true, true, Perm::Move, Perm::None);
+	addACL("D", "~out", true, false, Perm::None, Perm::Traverse | Perm::Enter);
+}
+
+void TestACL::cleanupTestCase() {
+	delete m_root;
+	m_fixture.reset();
+}
+
+ServerUser *TestACL::addUser(int id, const QString &channel) {
+	ServerUser *user = ServerFixture::createUser(*m_server);
+	user->iId        = id;
+	user->cChannel   = m_channels.value(channel);
+
+	m_users.insert(id, user);
+
+	return user;
+}
+
+Group *TestACL::addGroup(const QString &channel, const QString &name, const QSet< int > &add,
+						 const QSet< int > &remove) {
+	Group *group    = new Group(m_channels.value(channel), name);
+	group->qsAdd    = add;
+	group->qsRemove = remove;
+
+	return group;
+}
+
+ChanACL *TestACL::addACL(const QString &channel, const QString &group, bool applyHere, bool applySubs,
+						 ChanACL::Permissions allow, ChanACL::Permissions deny) {
+	ChanACL *acl    = new ChanACL(m_channels.value(channel));
+	acl->bApplyHere = applyHere;
+	acl->bApplySubs = applySubs;
+	acl->pAllow     = allow;
+	acl->pDeny      = deny;
+	acl->setGroup(group);
+
+	return acl;
+}
+
+void TestACL::appliesToUser_data() {
+	QTest::addColumn< QString >("specification");
+	QTest::addColumn< QString >("currentChannel");
+	QTest::addColumn< QString >("aclChannel");
+	QTest::addColumn< int >("user");
+	QTest::addColumn< bool >("applies");
+
+	QTest::newRow("empty") << "" << "C" << "C" << 1 << false;
+	QTest::newRow("prefixes only") << "!~" << "C" << "C" << 1 << false;
+	QTest::newRow("none") << "none" << "C" << "C" << 1 << false;
+	QTest::newRow("!none") << "!none" << "C" << "C" << 1 << true;
+	QTest::newRow("all") << "all" << "C" << "C" << -1 << true;
+	QTest::newRow("!all") << "!all" << "C" << "C" << -1 << false;
+	QTest::newRow("auth, anonymous") << "auth" << "C" << "C" << -1 << false;
+	QTest::newRow("auth, registered") << "auth" << "C" << "C" << 1 << true;
+	QTest::newRow("!auth, anonymous") << "!auth" << "C" << "C" << -1 << true;
+	QTest::newRow("strong, unverified") << "strong" << "C" << "C" << -1 << false;
+	QTest::newRow("strong, verified") << "strong" << "C" << "C" << 1 << true;
+
+	QTest::newRow("in") << "in" << "A" << "Root" << 1 << true;
+	QTest::newRow("~in") << "~in" << "A" << "Root" << 1 << false;
+	QTest::newRow("out") << "out" << "A" << "Root" << 1 << false;
+	QTest::newRow("~out") << "~out" << "A" << "Root" << 1 << true;
+
+	QTest::newRow("#secret") << "#secret" << "C" << "C" << -1 << true;
+	QTest::newRow("#secret, without token") << "#secret" << "C" << "C" << 1 << false;
+	QTest::newRow("#other") << "#other" << "C" << "C" << -1 << false;
+	QTest::newRow("!#secret") << "!#secret" << "C" << "C" << -1 << false;
+	QTest::newRow("#!secret") << "#!secret" << "C" << "C" << -1 << false;
+	QTest::newRow("~#secret") << "~#secret" << "C" << "Root" << -1 << true;
+	QTest::newRow("#") << "#" << "C" << "C" << -1 << false;
+	QTest::newRow("$abcd") << "$abcd" << "C" << "C" << -1 << true;
+	QTest::newRow("$ABCD") << "$ABCD" << "C" << "C" << -1 << false;
+	QTest::newRow("$abcd, other hash") << "$abcd" << "C" << "C" << 1 << false;
+
+	QTest::newRow("sub, below") << "sub" << "A" << "A" << 2 << true;
+	QTest::newRow("sub, in") << "sub" << "A" << "A" << 1 << false;
+	QTest::newRow("sub,0,0") << "sub,0,0" << "A" << "A" << 1 << true;
+	QTest::newRow("sub,1, beyond current") << "sub,1" << "A" << "A" << 2 << false;
+	QTest::newRow("~sub,1") << "~sub,1" << "C" << "A" << -1 << true;
+	QTest::newRow("~sub,1, not deep enough") << "~sub,1" << "C" << "A" << 2 << false;
+	QTest::newRow("sub,-1") << "sub,-1" << "A" << "A" << 4 << true;
+	QTest::newRow("sub,-5,0") << "sub,-5,0" << "A" << "A" << 3 << true;
+	QTest::newRow("sub,0,1,1") << "sub,0,1,1" << "Root" << "Root" << 1 << true;
+	QTest::newRow("sub,0,1,1, too deep") << "sub,0,1,1" << "Root" << "Root" << -1 << false;
+	QTest::newRow("sub,,2") << "sub,,2" << "Root" << "Root" << 2 << true;
+	QTest::newRow("sub,,2, not deep enough") << "sub,,2" << "Root" << "Root" << 1 << false;
+	QTest::newRow("!sub") << "!sub" << "Root" << "Root" << 3 << true;
+	QTest::newRow("subway") << "subway" << "Root" << "Root" << 3 << false;
+
+	// Groups further down the hierarchy override the ones they inherit from
+	QTest::newRow("staff, added") << "staff" << "Root" << "Root" << 2 << true;
+	QTest::newRow("staff, removed in A") << "staff" << "A" << "A" << 2 << false;
+	QTest::newRow("staff, added in A") << "staff" << "A" << "A" << 3 << true;
+	QTest::newRow("staff, not added in Root") << "staff" << "Root" << "Root" << 3 << false;
+	QTest::newRow("staff, inherited by D") << "staff" << "D" << "D" << 2 << true;
+	QTest::newRow("!staff") << "!staff" << "A" << "A" << 2 << true;
+	// B doesn't inherit the members of Root and A, but C inherits the ones of B
+	QTest::newRow("staff, not inherited by B") << "staff" << "B" << "B" << 1 << false;
+	QTest::newRow("staff, added in B") << "staff" << "B" << "B" << 4 << true;
+	QTest::newRow("staff, inherited by C") << "staff" << "C" << "C" << 4 << true;
+	QTest::newRow("~staff, A") << "~staff" << "B" << "A" << 2 << false;
+	QTest::newRow("~staff, Root") << "~staff" << "B" << "Root" << 2 << true;
+	// Temporary members are referred to by user ID or, for unregistered users, by their negated session
+	QTest::newRow("staff, temporary user ID") << "staff" << "Root" << "Root" << 5 << true;
+	QTest::newRow("staff, temporary session") << "staff" << "Root" << "Root" << -1 << true;
+	QTest::newRow("staff, temporary not inherited by B") << "staff" << "B" << "B" << -1 << false;
+	// Within a group, removal takes precedence
+	QTest::newRow("mixed, added and removed") << "mixed" << "Root" << "Root" << 1 << false;
+	QTest::newRow("mixed, added again in A") << "mixed" << "A" << "A" << 1 << true;
+	QTest::newRow("mixed, inherited by C") << "mixed" << "C" << "C" << 1 << true;
+	QTest::newRow("mixed, D") << "mixed" << "D" << "D" << 1 << false;
+	// A group that isn't inheritable hides the groups of the same name further up the hierarchy
+	QTest::newRow("private, A") << "private" << "A" << "A" << 1 << true;
+	QTest::newRow("private, not inherited by B") << "private" << "B" << "B" << 1 << false;
+	QTest::newRow("private, C") << "private" << "C" << "C" << 2 << true;
+	QTest::newRow("private, not inherited by C") << "private" << "C" << "C" << 1 << false;
+	QTest::newRow("unknown") << "unknown" << "Root" << "Root" << 1 << false;
+	QTest::newRow("!unknown") << "!unknown" << "Root" << "Root" << 1 << true;
+}
+
+void TestACL::appliesToUser() {
+	QFETCH(QString, specification);
+	QFETCH(QString, currentChannel);
+	QFETCH(QString, aclChannel);
+	QFETCH(int, user);
+	QFETCH(bool, applies);
+
+	const Channel &current    = *m_channels.value(currentChannel);
+	const Channel &acl        = *m_channels.value(aclChannel);
+	const ServerUser &subject = *m_users.value(user);
+
+	QCOMPARE(Group::appliesToUser(current, acl, Group::Specification::parse(specification), subject), applies);
+	QCOMPARE(legacyAppliesToUser(current, acl, specification, subject), applies);
+}
+
+void TestACL::effectivePermissions_data() {
+	using Perm = ChanACL::Perm;
+
+	const ChanACL::Permissions def =
+		Perm::Traverse | Perm::Enter | Perm::Speak | Perm::Whisper | Perm::TextMessage | Perm::Listen;
+	const ChanACL::Permissions staff = def | Perm::MuteDeafen;
+	const ChanACL::Permissions muted = def & ~static_cast< ChanACL::Permissions >(Perm::Speak);
+
+	QTest::addColumn< QString >("channel");
+	QTest::addColumn< int >("user");
+	QTest::addColumn< int >("permissions");
+
+	// Group membership is evaluated in the context of the channel the permissions are computed for
+	QTest::newRow("staff in Root") << "Root" << 2 << static_cast< int >(staff);
+	QTest::newRow("removed from staff in A") << "A" << 2 << static_cast< int >(muted);
+	QTest::newRow("sub and token in C")
+		<< "C" << -1 << static_cast< int >((def | Perm::MakeChannel | Perm::Move) & ~(Perm::Speak | Perm::TextMessage));
+	QTest::newRow("out of D") << "D" << 1 << static_cast< int >(Perm::None);
+}
+
+void TestACL::effectivePermissions() {
+	QFETCH(QString, channel);
+	QFETCH(int, user);
+	QFETCH(int, permissions);
+
+	QCOMPARE(static_cast< int >(ChanACL::effectivePermissions(m_users.value(user), m_channels.value(channel), nullptr)),
+			 permissions);
+}
+
+void TestACL::clearACLCacheFor() {
+	using Perm = ChanACL::Perm;
+
+	Channel *a = m_channels.value("A");
+	Channel *b = m_channels.value("B");
+	Channel *c = m_channels.value("C");
+	Channel *d = m_channels.value("D");
+
+	for (ServerUser *user : m_users) {
+		m_server->qhUsers.insert(user->uiSession, user);
+	}
+
+	ServerUser *speaker = m_users.value(1);
+	for (ServerUser *user : { speaker, m_users.value(3) }) {
+		for (Channel *channel : m_channels) {
+			QVERIFY(ChanACL::hasPermission(user, channel, Perm::Enter, &m_server->acCache) == (channel != d));
+		}
+	}
+
+	const auto addTarget = [speaker](int id, std::vector< unsigned int > channels,
+									 std::vector< unsigned int > sessions) {
+		auto cache      = std::make_shared< WhisperTargetCache >();
+		cache->channels = std::move(channels);
+		cache->sessions = std::move(sessions);
+		speaker->qmTargetCache.insert(id, std::move(cache));
+	};
+	addTarget(1, { d->iId }, {});
+	addTarget(2, { c->iId }, {});
+	addTarget(3, {}, { m_users.value(2)->uiSession });
+	addTarget(4, { a->iId }, { m_users.value(3)->uiSession });
+
+	ChanACL *acl = addACL("B", "all", true, true, Perm::None, Perm::Enter);
+	m_server->clearACLCacheFor(*b);
+
+	// Only the permissions in B and its subchannels can have changed
+	for (ServerUser *user : { speaker, m_users.value(3) }) {
+		const ChanACL::ChanCache *cache = m_server->acCache.value(user);
+		QVERIFY(cache);
+		QVERIFY(cache->contains(m_root));
+		QVERIFY(cache->contains(a));
+		QVERIFY(cache->contains(d));
+		QVERIFY(!cache->contains(b));
+		QVERIFY(!cache->contains(c));
+	}
+	QVERIFY(!ChanACL::hasPermission(speaker, c, Perm::Enter, &m_server->acCache));
+
+	// The same goes for the whisper targets into the subtree or to users in it
+	QCOMPARE(speaker->qmTargetCache.keys(), (QList< int >{ 1, 4 }));
+
+	b->qlACL.removeOne(acl);
+	delete acl;
+	speaker->qmTargetCache.clear();
+	for (ServerUser *user : m_users) {
+		delete m_server->acCache.take(user);
+		m_server->qhUsers.remove(user->uiSession);
+	}
+}
+
+QTEST_MAIN(TestACL)
+#include "TestACL.moc"
@@ -0,0 +1,137 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "AuthenticationResultCache.h"
+
+#include <QtCore>
+#include <QtTest>
+
+class TestAuthenticationResultCache : public QObject {
+	Q_OBJECT
+private slots:
+	void disabled();
+	void lookup();
+	void onlySuccesses();
+	void expiry();
+	void reinsert();
+	void maxEntries();
+};
+
+using Clock = AuthenticationResultCache::Clock;
+
+namespace {
+
+ExternalAuthenticationResult result(int userID, const QString &name = {}, const QStringList &groups = {}) {
+	ExternalAuthenticationResult res;
+	res.userID = userID;
+	res.name   = name;
+	res.groups = groups;
+
+	return res;
+}
+
+} // namespace
+
+void TestAuthenticationResultCache::disabled() {
+	AuthenticationResultCache cache;
+	QVERIFY(!cache.isEnabled());
+
+	cache.insert("Alice", "aaaa", "secret", result(3));
+	QCOMPARE(cache.size(), static_cast< std::size_t >(0));
+	QVERIFY(!cache.find("Alice", "aaaa", "secret"));
+}
+
+void TestAuthenticationResultCache::lookup() {
+	AuthenticationResultCache cache(std::chrono::seconds(60));
+	QVERIFY(cache.isEnabled());
+
+	const Clock::time_point now = Clock::now();
+	cache.insert("Alice", "aaaa", "secret", result(3, "alice", { "admins" }), now);
+
+	std::optional< ExternalAuthenticationResult > cached = cache.find("Alice", "aaaa", "secret", now);
+	QVERIFY(cached);
+	QCOMPARE(cached->userID, 3);
+	QCOMPARE(cached->name, QString("alice"));
+	QCOMPARE(cached->groups, QStringList{ "admins" });
+
+	// All of the credentials must match
+	QVERIFY(!cache.find("alice", "aaaa", "secret", now));
+	QVERIFY(!cache.find("Alice", "bbbb", "secret", now));
+	QVERIFY(!cache.find("Alice", "aaaa", "Secret", now));
+	QVERIFY(!cache.find("Alice", "", "secret", now));
+	// The parts are kept apart from each other
+	QVERIFY(!cache.find("Alic", "eaaaa", "secret", now));
+
+	QCOMPARE(cache.hits(), static_cast< std::uint64_t >(1));
+	QCOMPARE(cache.misses(), static_cast< std::uint64_t >(5));
+
+	cache.clear();
+	QVERIFY(!cache.find("Alice", "aaaa", "secret", now));
+}
+
+void TestAuthenticationResultCache::onlySuccesses() {
+	AuthenticationResultCache cache(std::chrono::seconds(60));
+
+	cache.insert("Alice", "", "wrong", result(-1));
+	cache.insert("Bob", "", "", result(-2));
+
+	ExternalAuthenticationResult failed = result(5);
+	failed.failed                       = true;
+	cache.insert("Carol", "", "", failed);
+
+	QCOMPARE(cache.size(), static_cast< std::size_t >(0));
+}
+
+void TestAuthenticationResultCache::expiry() {
+	AuthenticationResultCache cache(std::chrono::seconds(60));
+
+	const Clock::time_point start = Clock::now();
+	cache.insert("Alice", "", "secret", result(3), start);
+	cache.insert("Bob", "", "secret", result(4), start + std::chrono::seconds(30));
+
+	QVERIFY(cache.find("Alice", "", "secret", start + std::chrono::seconds(59)));
+
+	QVERIFY(!cache.find("Alice", "", "secret", start + std::chrono::seconds(60)));
+	QVERIFY(cache.find("Bob", "", "secret", start + std::chrono::seconds(60)));
+	QCOMPARE(cache.size(), static_cast< std::size_t >(1));
+
+	QVERIFY(!cache.find("Bob", "", "secret", start + std::chrono::seconds(90)));
+	QCOMPARE(cache.size(), static_cast< std::size_t >(0));
+}
+
+void TestAuthenticationResultCache::reinsert() {
+	AuthenticationResultCache cache(std::chrono::seconds(60));
+
+	const Clock::time_point start = Clock::now();
+	cache.insert("Alice", "", "secret", result(3), start);
+	cache.insert("Alice", "", "secret", result(7), start + std::chrono::seconds(30));
+
+	// The first insertion expiring doesn't remove the renewed entry
+	std::optional< ExternalAuthenticationResult > cached =
+		cache.find("Alice", "", "secret", start + std::chrono::seconds(60));
+	QVERIFY(cached);
+	QCOMPARE(cached->userID, 7);
+	QCOMPARE(cache.size(), static_cast< std::size_t >(1));
+
+	QVERIFY(!cache.find("Alice", "", "secret", start + std::chrono::seconds(90)));
+}
+
+void TestAuthenticationResultCache::maxEntries() {
+	AuthenticationResultCache cache(std::chrono::seconds(60), 2);
+
+	const Clock::time_point now = Clock::now();
+	cache.insert("Alice", "", "", result(1), now);
+	cache.insert("Bob", "", "", result(2), now);
+	cache.insert("Carol", "", "", result(3), now);
+
+	// The oldest entry has been evicted
+	QCOMPARE(cache.size(), static_cast< std::size_t >(2));
+	QVERIFY(!cache.find("Alice", "", "", now));
+	QVERIFY(cache.find("Bob", "", "", now));
+	QVERIFY(cache.find("Carol", "", "", now));
+}
+
+QTEST_MAIN(TestAuthenticationResultCache)
+#include "TestAuthenticationResultCache.moc"
@@ -0,0 +1,352 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "CallbackDispatcher.h"
+
+#include <QtCore>
+#include <QtTest>
+
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+class TestCallbackDispatcher : public QObject {
+	Q_OBJECT
+private slots:
+	void order();
+	void blockedConsumer();
+	void coalescing();
+	void dropOldest();
+	void overflowKeepsLatestState();
+	void disconnectOnOverflow();
+	void failingCall();
+	void removeConsumer();
+};
+
+namespace {
+
+CallbackDispatcher::Parameters parameters(std::size_t queueLimit, unsigned int threads = 1) {
+	CallbackDispatcher::Parameters params;
+	params.queueLimit = queueLimit;
+	params.threads    = threads;
+
+	return params;
+}
+
+/// Records the values passed to the calls of a consumer
+struct Recorder {
+	std::mutex mutex;
+	std::vector< int > values;
+
+	CallbackDispatcher::Call record(int value) {
+		return [this, value]() {
+			std::lock_guard< std::mutex > lock(mutex);
+			values.push_back(value);
+		};
+	}
+
+	std::size_t count() {
+		std::lock_guard< std::mutex > lock(mutex);
+		return values.size();
+	}
+};
+
+/// A call that signals that it has started and then blocks until it is released
+CallbackDispatcher::Call blockingCall(std::promise< void > &started, std::shared_future< void > release) {
+	return [&started, release]() {
+		started.set_value();
+		release.wait();
+	};
+}
+
+} // namespace
+
+void TestCallbackDispatcher::order() {
+	CallbackDispatcher dispatcher(parameters(100, 4), [](unsigned int, CallbackDispatcher::Failure) {});
+	Recorder recorder;
+
+	const unsigned int consumer = dispatcher.addConsumer();
+	for (int i = 0; i < 50; ++i) {
+		dispatcher.enqueue(consumer, recorder.record(i));
+	}
+	dispatcher.flush();
+
+	// Despite multiple threads, the calls of a single consumer are performed in order
+	std::vector< int > expected;
+	for (int i = 0; i < 50; ++i) {
+		expected.push_back(i);
+	}
+	QCOMPARE(recorder.values, expected);
+	QCOMPARE(dispatcher.getStatistics().dispatched, static_cast< std::uint64_t >(50));
+	QCOMPARE(dispatcher.getStatistics().queued, static_cast< std::size_t >(0));
+}
+
+void TestCallbackDispatcher::blockedConsumer() {
+	CallbackDispatcher dispatcher(parameters(100, 2), [](unsigned int, CallbackDispatcher::Failure) {});
+	Recorder recorder;
+
+	const unsigned int slow = dispatcher.addConsumer();
+	const unsigned int fast = dispatcher.addConsumer();
+
+	std::promise< void > started;
+	std::promise< void > release;
+	dispatcher.enqueue(slow, blockingCall(started, release.get_future().share()));
+	dispatcher.enqueue(slow, recorder.record(-1));
+	started.get_future().wait();
+
+	// While the slow consumer hangs, the other one is still served
+	for (int i = 0; i < 10; ++i) {
+		dispatcher.enqueue(fast, recorder.record(i));
+	}
+	QTRY_COMPARE(recorder.count(), static_cast< std::size_t >(10));
+	QCOMPARE(dispatcher.queueDepth(slow), static_cast< std::size_t >(1));
+	QCOMPARE(dispatcher.getStatistics().maxQueueDepth, static_cast< std::size_t >(1));
+
+	release.set_value();
+	dispatcher.flush();
+
+	QCOMPARE(recorder.values.back(), -1);
+}
+
+void TestCallbackDispatcher::coalescing() {
+	CallbackDispatcher dispatcher(parameters(100), [](unsigned int, CallbackDispatcher::Failure) {});
+	Recorder recorder;
+
+	const unsigned int consumer = dispatcher.addConsumer();
+
+	std::promise< void > started;
+	std::promise< void > release;
+	dispatcher.enqueue(consumer, blockingCall(started, release.get_future().share()));
+	started.get_future().wait();
+
+	// State changes of the same user are merged, keeping the position of the first one
+	dispatcher.enqueue(consumer, recorder.record(1), 7, true);
+	dispatcher.enqueue(consumer, recorder.record(2), 8, true);
+	dispatcher.enqueue(consumer, recorder.record(3), 7, true);
+	// A barrier (e.g. the user disconnecting) must not be overtaken by later state changes
+	dispatcher.enqueue(consumer, recorder.record(4), 7, false);
+	dispatcher.enqueue(consumer, recorder.record(5), 7, true);
+	dispatcher.enqueue(consumer, recorder.record(6), 7, true);
+	dispatcher.enqueue(consumer, recorder.record(7));
+
+	QCOMPARE(dispatcher.queueDepth(consumer), static_cast< std::size_t >(5));
+	QCOMPARE(dispatcher.getStatistics().coalesced, static_cast< std::uint64_t >(2));
+
+	release.set_value();
+	dispatcher.flush();
+
+	QCOMPARE(recorder.values, (std::vector< int >{ 3, 2, 4, 6, 7 }));
+
+	// Once a call has been performed, later ones are queued again
+	dispatcher.enqueue(consumer, recorder.record(8), 7, true);
+	dispatcher.flush();
+	QCOMPARE(recorder.values.back(), 8);
+
+	// Without coalescing, every call is performed
+	CallbackDispatcher::Parameters params = parameters(100);
+	params.coalesce                       = false;
+	CallbackDispatcher other(params, [](unsigned int, CallbackDispatcher::Failure) {});
+	Recorder otherRecorder;
+
+	const unsigned int otherConsumer = other.addConsumer();
+	std::promise< void > otherStarted;
+	std::promise< void > otherRelease;
+	other.enqueue(otherConsumer, blockingCall(otherStarted, otherRelease.get_future().share()));
+	otherStarted.get_future().wait();
+
+	other.enqueue(otherConsumer, otherRecorder.record(1), 7, true);
+	other.enqueue(otherConsumer, otherRecorder.record(2), 7, true);
+
+	otherRelease.set_value();
+	other.flush();
+	QCOMPARE(otherRecorder.values, (std::vector< int >{ 1, 2 }));
+}
+
+void TestCallbackDispatcher::dropOldest() {
+	std::atomic< int > failures(0);
+	CallbackDispatcher dispatcher(parameters(3),
+								  [&failures](unsigned int, CallbackDispatcher::Failure) { failures++; });
+	Recorder recorder;
+
+	const unsigned int consumer = dispatcher.addConsumer();
+
+	std::promise< void > started;
+	std::promise< void > release;
+	dispatcher.enqueue(consumer, blockingCall(started, release.get_future().share()));
+	started.get_future().wait();
+
+	for (int i = 0; i < 5; ++i) {
+		dispatcher.enqueue(consumer, recorder.record(i));
+	}
+	QCOMPARE(dispatcher.queueDepth(consumer), static_cast< std::size_t >(3));
+	QCOMPARE(dispatcher.getStatistics().dropped, static_cast< std::uint64_t >(2));
+
+	release.set_value();
+	dispatcher.flush();
+
+	QCOMPARE(recorder.values, (std::vector< int >{ 2, 3, 4 }));
+	QCOMPARE(failures.load(), 0);
+}
+
+void TestCallbackDispatcher::overflowKeepsLatestState() {
+	std::mutex mutex;
+	std::vector< std::pair< unsigned int, CallbackDispatcher::Failure > > failures;
+
+	CallbackDispatcher dispatcher(parameters(5), [&](unsigned int consumer, CallbackDispatcher::Failure failure) {
+		std::lock_guard< std::mutex > lock(mutex);
+		failures.emplace_back(consumer, failure);
+	});
+	Recorder recorder;
+
+	const unsigned int consumer = dispatcher.addConsumer();
+
+	std::promise< void > started;
+	std::promise< void > release;
+	dispatcher.enqueue(consumer, blockingCall(started, release.get_future().share()));
+	started.get_future().wait();
+
+	dispatcher.enqueue(consumer, recorder.record(1));
+	dispatcher.enqueue(consumer, recorder.record(2), 1, true);
+	dispatcher.enqueue(consumer, recorder.record(3), 1, false);
+	// Not merged into the state change in front of the barrier, which is superseded by this one now
+	dispatcher.enqueue(consumer, recorder.record(4), 1, true);
+	dispatcher.enqueue(consumer, recorder.record(5), 2, true);
+	// The superseded state change is dropped, although the call without a key in front of it is older
+	dispatcher.enqueue(consumer, recorder.record(6));
+	QCOMPARE(dispatcher.getStatistics().dropped, static_cast< std::uint64_t >(1));
+	// The queued state changes are still found after they have moved up
+	dispatcher.enqueue(consumer, recorder.record(7), 2, true);
+	dispatcher.enqueue(consumer, recorder.record(8), 1, true);
+	QCOMPARE(dispatcher.getStatistics().coalesced, static_cast< std::uint64_t >(2));
+	// Without superseded state changes, the calls without a key are dropped, oldest first
+	dispatcher.enqueue(consumer, recorder.record(9));
+	dispatcher.enqueue(consumer, recorder.record(10), 3, false);
+	dispatcher.enqueue(consumer, recorder.record(11), 4, false);
+
+	QCOMPARE(dispatcher.queueDepth(consumer), static_cast< std::size_t >(5));
+	QCOMPARE(dispatcher.getStatistics().dropped, static_cast< std::uint64_t >(4));
+
+	release.set_value();
+	dispatcher.flush();
+
+	QCOMPARE(recorder.values, (std::vector< int >{ 3, 8, 7, 10, 11 }));
+	QVERIFY(failures.empty());
+
+	// Once only the latest state changes and barriers are queued, the consumer fails instead of missing one of them
+	std::promise< void > startedAgain;
+	std::promise< void > releaseAgain;
+	dispatcher.enqueue(consumer, blockingCall(startedAgain, releaseAgain.get_future().share()));
+	startedAgain.get_future().wait();
+
+	for (int i = 0; i < 5; ++i) {
+		dispatcher.enqueue(consumer, recorder.record(20 + i), static_cast< std::uint64_t >(i), i % 2 == 0);
+	}
+	dispatcher.enqueue(consumer, recorder.record(30));
+
+	{
+		std::lock_guard< std::mutex > lock(mutex);
+		QCOMPARE(failures.size(), static_cast< std::size_t >(1));
+		QCOMPARE(failures[0].first, consumer);
+		QVERIFY(failures[0].second == CallbackDispatcher::Failure::QueueOverflow);
+	}
+	QCOMPARE(dispatcher.queueDepth(consumer), static_cast< std::size_t >(0));
+
+	releaseAgain.set_value();
+	dispatcher.flush();
+
+	QCOMPARE(recorder.values, (std::vector< int >{ 3, 8, 7, 10, 11 }));
+	QCOMPARE(dispatcher.getStatistics().dropped, static_cast< std::uint64_t >(4));
+}
+
+void TestCallbackDispatcher::disconnectOnOverflow() {
+	std::mutex mutex;
+	std::vector< std::pair< unsigned int, CallbackDispatcher::Failure > > failures;
+
+	CallbackDispatcher::Parameters params = parameters(2);
+	params.disconnectOnOverflow           = true;
+	CallbackDispatcher dispatcher(params, [&](unsigned int consumer, CallbackDispatcher::Failure failure) {
+		std::lock_guard< std::mutex > lock(mutex);
+		failures.emplace_back(consumer, failure);
+	});
+	Recorder recorder;
+
+	const unsigned int consumer = dispatcher.addConsumer();
+
+	std::promise< void > started;
+	std::promise< void > release;
+	dispatcher.enqueue(consumer, blockingCall(started, release.get_future().share()));
+	started.get_future().wait();
+
+	dispatcher.enqueue(consumer, recorder.record(1));
+	dispatcher.enqueue(consumer, recorder.record(2));
+	dispatcher.enqueue(consumer, recorder.record(3));
+
+	QCOMPARE(failures.size(), static_cast< std::size_t >(1));
+	QCOMPARE(failures[0].first, consumer);
+	QVERIFY(failures[0].second == CallbackDispatcher::Failure::QueueOverflow);
+	QCOMPARE(dispatcher.queueDepth(consumer), static_cast< std::size_t >(0));
+	QCOMPARE(dispatcher.getStatistics().failed, static_cast< std::uint64_t >(1));
+
+	// Further calls for the failed consumer are ignored
+	dispatcher.enqueue(consumer, recorder.record(4));
+
+	release.set_value();
+	dispatcher.flush();
+
+	QVERIFY(recorder.values.empty());
+}
+
+void TestCallbackDispatcher::failingCall() {
+	std::mutex mutex;
+	std::vector< std::pair< unsigned int, CallbackDispatcher::Failure > > failures;
+
+	CallbackDispatcher dispatcher(parameters(10), [&](unsigned int consumer, CallbackDispatcher::Failure failure) {
+		std::lock_guard< std::mutex > lock(mutex);
+		failures.emplace_back(consumer, failure);
+	});
+	Recorder recorder;
+
+	const unsigned int failing = dispatcher.addConsumer();
+	const unsigned int working = dispatcher.addConsumer();
+
+	dispatcher.enqueue(failing, []() { throw std::runtime_error("Unreachable"); });
+	dispatcher.flush();
+	dispatcher.enqueue(failing, recorder.record(1));
+	dispatcher.enqueue(working, recorder.record(2));
+	dispatcher.flush();
+
+	std::lock_guard< std::mutex > lock(mutex);
+	QCOMPARE(failures.size(), static_cast< std::size_t >(1));
+	QCOMPARE(failures[0].first, failing);
+	QVERIFY(failures[0].second == CallbackDispatcher::Failure::CallFailed);
+	QCOMPARE(recorder.values, std::vector< int >{ 2 });
+}
+
+void TestCallbackDispatcher::removeConsumer() {
+	CallbackDispatcher dispatcher(parameters(10), [](unsigned int, CallbackDispatcher::Failure) {});
+	Recorder recorder;
+
+	const unsigned int consumer = dispatcher.addConsumer();
+
+	std::promise< void > started;
+	std::promise< void > release;
+	dispatcher.enqueue(consumer, blockingCall(started, release.get_future().share()));
+	started.get_future().wait();
+
+	dispatcher.enqueue(consumer, recorder.record(1));
+	dispatcher.removeConsumer(consumer);
+	dispatcher.enqueue(consumer, recorder.record(2));
+
+	release.set_value();
+	dispatcher.flush();
+
+	QVERIFY(recorder.values.empty());
+	QCOMPARE(dispatcher.getStatistics().queued, static_cast< std::size_t >(0));
+}
+
+QTEST_MAIN(TestCallbackDispatcher)
+#include "TestCallbackDispatcher.moc"
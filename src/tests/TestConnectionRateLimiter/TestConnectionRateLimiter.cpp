@@ -0,0 +1,164 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "ConnectionRateLimiter.h"
+
+#include <QtCore>
+#include <QtTest>
+
+using namespace std::chrono_literals;
+
+class TestConnectionRateLimiter : public QObject {
+	Q_OBJECT
+private slots:
+	void ban();
+	void slidingTimeframe();
+	void networks();
+	void eviction();
+	void reset();
+	void disabled();
+};
+
+namespace {
+
+ConnectionRateLimiter::Parameters parameters(unsigned int attempts, std::size_t capacity = 16) {
+	ConnectionRateLimiter::Parameters params;
+	params.attempts  = attempts;
+	params.timeframe = 10s;
+	params.banTime   = 60s;
+	params.capacity  = capacity;
+
+	return params;
+}
+
+HostAddress address(const char *text) {
+	return HostAddress(QHostAddress(QString::fromLatin1(text)));
+}
+
+} // namespace
+
+void TestConnectionRateLimiter::ban() {
+	ConnectionRateLimiter limiter(parameters(3));
+	const ConnectionRateLimiter::Clock::time_point start;
+
+	for (int i = 0; i < 3; ++i) {
+		QVERIFY(!limiter.check(address("192.0.2.1"), start + i * 1s));
+	}
+	QVERIFY(limiter.check(address("192.0.2.1"), start + 3s));
+	QCOMPARE(limiter.getStatistics().bans, static_cast< std::uint64_t >(1));
+
+	// The ban lasts for the ban time, regardless of the timeframe
+	QVERIFY(limiter.check(address("192.0.2.1"), start + 50s));
+	QCOMPARE(limiter.getStatistics().rejected, static_cast< std::uint64_t >(2));
+	QCOMPARE(limiter.getStatistics().bans, static_cast< std::uint64_t >(1));
+
+	QVERIFY(!limiter.check(address("192.0.2.1"), start + 64s));
+}
+
+void TestConnectionRateLimiter::slidingTimeframe() {
+	ConnectionRateLimiter limiter(parameters(4));
+	const ConnectionRateLimiter::Clock::time_point start;
+
+	// 4 attempts at the end of the first timeframe
+	for (int i = 0; i < 4; ++i) {
+		QVERIFY(!limiter.check(address("192.0.2.1"), start + 9s));
+	}
+
+	// Right after the timeframe has passed, these still count almost completely
+	QVERIFY(limiter.check(address("192.0.2.1"), start + 11s));
+
+	ConnectionRateLimiter other(parameters(4));
+	for (int i = 0; i < 4; ++i) {
+		QVERIFY(!other.check(address("192.0.2.1"), start + 9s));
+	}
+
+	// Once most of the previous timeframe has passed, they hardly count anymore
+	QVERIFY(!other.check(address("192.0.2.1"), start + 19s));
+	QVERIFY(!other.check(address("192.0.2.1"), start + 19s));
+
+	// And after two timeframes, they are forgotten completely
+	for (int i = 0; i < 4; ++i) {
+		QVERIFY(!other.check(address("192.0.2.1"), start + 40s));
+	}
+}
+
+void TestConnectionRateLimiter::networks() {
+	ConnectionRateLimiter limiter(parameters(2));
+	const ConnectionRateLimiter::Clock::time_point start;
+
+	QCOMPARE(limiter.networkOf(address("192.0.2.123")), address("192.0.2.0"));
+	QCOMPARE(limiter.networkOf(address("2001:db8:1:2:3:4:5:6")), address("2001:db8:1:2::"));
+
+	// Attempts from the same network are counted together
+	QVERIFY(!limiter.check(address("192.0.2.1"), start));
+	QVERIFY(!limiter.check(address("192.0.2.2"), start));
+	QVERIFY(limiter.check(address("192.0.2.3"), start));
+	QVERIFY(limiter.check(address("192.0.2.4"), start));
+	QVERIFY(!limiter.check(address("192.0.3.1"), start));
+
+	QVERIFY(!limiter.check(address("2001:db8:1:2::1"), start));
+	QVERIFY(!limiter.check(address("2001:db8:1:2::2"), start));
+	QVERIFY(limiter.check(address("2001:db8:1:2:ffff::3"), start));
+	QVERIFY(!limiter.check(address("2001:db8:1:3::1"), start));
+
+	QCOMPARE(limiter.size(), static_cast< std::size_t >(4));
+
+	ConnectionRateLimiter::Parameters params = parameters(2);
+	params.ipv4PrefixLength                  = 20;
+	params.ipv6PrefixLength                  = 127;
+	ConnectionRateLimiter other(params);
+
+	QCOMPARE(other.networkOf(address("192.0.31.123")), address("192.0.16.0"));
+	QCOMPARE(other.networkOf(address("2001:db8::7")), address("2001:db8::6"));
+}
+
+void TestConnectionRateLimiter::eviction() {
+	ConnectionRateLimiter limiter(parameters(1, 2));
+	const ConnectionRateLimiter::Clock::time_point start;
+
+	QVERIFY(!limiter.check(address("192.0.2.1"), start));
+	QVERIFY(!limiter.check(address("198.51.100.1"), start));
+	// Seeing the first network again makes the second one the least recently seen one
+	QVERIFY(limiter.check(address("192.0.2.1"), start));
+
+	QVERIFY(!limiter.check(address("203.0.113.1"), start));
+	QCOMPARE(limiter.size(), static_cast< std::size_t >(2));
+	QCOMPARE(limiter.getStatistics().evictions, static_cast< std::uint64_t >(1));
+
+	// The first network is still banned, the second one has been forgotten
+	QVERIFY(limiter.check(address("192.0.2.1"), start + 1s));
+	QVERIFY(!limiter.check(address("198.51.100.1"), start + 1s));
+	QCOMPARE(limiter.size(), static_cast< std::size_t >(2));
+}
+
+void TestConnectionRateLimiter::reset() {
+	ConnectionRateLimiter limiter(parameters(2));
+	const ConnectionRateLimiter::Clock::time_point start;
+
+	QVERIFY(!limiter.check(address("192.0.2.1"), start));
+	QVERIFY(!limiter.check(address("192.0.2.1"), start));
+	limiter.reset(address("192.0.2.1"));
+	QVERIFY(!limiter.check(address("192.0.2.1"), start));
+	QVERIFY(!limiter.check(address("192.0.2.1"), start));
+	QVERIFY(limiter.check(address("192.0.2.1"), start));
+
+	// An active ban is not lifted
+	limiter.reset(address("192.0.2.1"));
+	QVERIFY(limiter.check(address("192.0.2.1"), start));
+}
+
+void TestConnectionRateLimiter::disabled() {
+	ConnectionRateLimiter limiter(parameters(0));
+	const ConnectionRateLimiter::Clock::time_point start;
+
+	QVERIFY(!limiter.isEnabled());
+	for (int i = 0; i < 100; ++i) {
+		QVERIFY(!limiter.check(address("192.0.2.1"), start));
+	}
+	QCOMPARE(limiter.size(), static_cast< std::size_t >(0));
+}
+
+QTEST_MAIN(TestConnectionRateLimiter)
+#include "TestConnectionRateLimiter.moc"
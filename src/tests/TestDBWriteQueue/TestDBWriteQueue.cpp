@@ -0,0 +1,242 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "DBWriteQueue.h"
+
+#include <QtCore>
+#include <QtTest>
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class TestDBWriteQueue : public QObject {
+	Q_OBJECT
+private slots:
+	void batching();
+	void flush();
+	void flushAffected();
+	void stall();
+	void shutdown();
+};
+
+namespace {
+
+/// Records the batches passed to a DBWriteQueue. While a batch is blocked, the writer waits for it to be released.
+struct Recorder {
+	std::mutex mutex;
+	std::vector< std::vector< std::string > > batches;
+	std::thread::id thread;
+
+	std::promise< void > blocked;
+	std::future< void > blockedFuture;
+	std::shared_future< void > release;
+	bool block = false;
+
+	DBWriteQueue::WriterFactory factory() {
+		return [this]() -> DBWriteQueue::Writer {
+			{
+				std::lock_guard< std::mutex > lock(mutex);
+				thread = std::this_thread::get_id();
+			}
+
+			return [this](const std::vector< DBWrite > &writes) { record(writes); };
+		};
+	}
+
+	/// Makes the writer block on the next batch until the returned promise is fulfilled
+	std::promise< void > blockNext() {
+		std::promise< void > releasePromise;
+
+		std::lock_guard< std::mutex > lock(mutex);
+		release       = releasePromise.get_future().share();
+		blocked       = std::promise< void >();
+		blockedFuture = blocked.get_future();
+		block         = true;
+
+		return releasePromise;
+	}
+
+	/// Waits for the writer to block on the batch requested by blockNext()
+	void waitUntilBlocked() { blockedFuture.wait(); }
+
+	std::vector< std::vector< std::string > > recorded() {
+		std::lock_guard< std::mutex > lock(mutex);
+		return batches;
+	}
+
+private:
+	void record(const std::vector< DBWrite > &writes) {
+		std::vector< std::string > messages;
+		for (const DBWrite &write : writes) {
+			messages.push_back(write.value);
+		}
+
+		bool wait = false;
+		{
+			std::lock_guard< std::mutex > lock(mutex);
+			batches.push_back(std::move(messages));
+			std::swap(wait, block);
+		}
+
+		if (wait) {
+			blocked.set_value();
+			release.wait();
+		}
+	}
+};
+
+DBWrite userWrite(unsigned int userID, std::string value) {
+	return DBWrite::userProperty(1, userID, ::mumble::server::db::UserProperty::Comment, std::move(value));
+}
+
+bool isReady(std::future< void > &future) {
+	return future.wait_for(std::chrono::milliseconds(50)) == std::future_status::ready;
+}
+
+} // namespace
+
+void TestDBWriteQueue::batching() {
+	Recorder recorder;
+	DBWriteQueue queue(recorder.factory(), 100);
+
+	std::promise< void > release = recorder.blockNext();
+	queue.enqueue(DBWrite::logMessage(1, "first"));
+	recorder.waitUntilBlocked();
+
+	// Everything that piles up while the writer is busy is written as a single batch
+	for (int i = 0; i < 5; ++i) {
+		queue.enqueue(DBWrite::logMessage(1, std::to_string(i)));
+	}
+	QCOMPARE(queue.getStatistics().pending, static_cast< std::size_t >(6));
+
+	release.set_value();
+	queue.flush();
+
+	using Batches = std::vector< std::vector< std::string > >;
+	QCOMPARE(recorder.recorded(), (Batches{ { "first" }, { "0", "1", "2", "3", "4" } }));
+
+	const DBWriteQueue::Statistics statistics = queue.getStatistics();
+	QCOMPARE(statistics.pending, static_cast< std::size_t >(0));
+	QCOMPARE(statistics.written, static_cast< std::uint64_t >(6));
+	QCOMPARE(statistics.batches, static_cast< std::uint64_t >(2));
+	QCOMPARE(statistics.stalls, static_cast< std::uint64_t >(0));
+
+	// The writer is created on (and only used by) the queue's own thread
+	QVERIFY(recorder.thread != std::this_thread::get_id());
+}
+
+void TestDBWriteQueue::flush() {
+	Recorder recorder;
+	DBWriteQueue queue(recorder.factory(), 100);
+
+	std::promise< void > release = recorder.blockNext();
+	queue.enqueue(DBWrite::logMessage(1, "first"));
+	recorder.waitUntilBlocked();
+	queue.enqueue(DBWrite::logMessage(1, "second"));
+
+	std::future< void > flushed = std::async(std::launch::async, [&queue]() { queue.flush(); });
+	QVERIFY(!isReady(flushed));
+
+	release.set_value();
+	flushed.wait();
+
+	QCOMPARE(queue.getStatistics().written, static_cast< std::uint64_t >(2));
+
+	// Without pending writes, there is nothing to wait for
+	queue.flush();
+}
+
+void TestDBWriteQueue::flushAffected() {
+	Recorder recorder;
+	DBWriteQueue queue(recorder.factory(), 100);
+
+	std::promise< void > release = recorder.blockNext();
+	queue.enqueue(userWrite(1, "in progress"));
+	recorder.waitUntilBlocked();
+	queue.enqueue(userWrite(2, "queued"));
+	queue.enqueue(DBWrite::logMessage(1, "message"));
+
+	const auto affectsUser = [](unsigned int userID) {
+		return [userID](const DBWrite &write) {
+			return write.type == DBWrite::Type::UserProperty && write.userID == userID;
+		};
+	};
+
+	// Writes concerning other users don't hold the caller up
+	queue.flush(affectsUser(3));
+	QCOMPARE(queue.getStatistics().pending, static_cast< std::size_t >(3));
+
+	// A write that is in progress is waited for
+	std::future< void > inProgress = std::async(std::launch::async, [&]() { queue.flush(affectsUser(1)); });
+	// As is a queued one (along with all writes in front of it)
+	std::future< void > queued = std::async(std::launch::async, [&]() { queue.flush(affectsUser(2)); });
+	QVERIFY(!isReady(inProgress));
+	QVERIFY(!isReady(queued));
+
+	release.set_value();
+	inProgress.wait();
+	queued.wait();
+
+	QVERIFY(queue.getStatistics().written >= 2);
+	queue.flush();
+	QCOMPARE(queue.getStatistics().written, static_cast< std::uint64_t >(3));
+}
+
+void TestDBWriteQueue::stall() {
+	Recorder recorder;
+	DBWriteQueue queue(recorder.factory(), 2);
+
+	std::promise< void > release = recorder.blockNext();
+	queue.enqueue(DBWrite::logMessage(1, "first"));
+	recorder.waitUntilBlocked();
+	queue.enqueue(DBWrite::logMessage(1, "second"));
+
+	// The queue is full, so the caller has to wait for the writer
+	std::future< void > enqueued =
+		std::async(std::launch::async, [&queue]() { queue.enqueue(DBWrite::logMessage(1, "third")); });
+	QVERIFY(!isReady(enqueued));
+	QTRY_COMPARE(queue.getStatistics().stalls, static_cast< std::uint64_t >(1));
+
+	release.set_value();
+	enqueued.wait();
+	queue.flush();
+
+	QCOMPARE(queue.getStatistics().written, static_cast< std::uint64_t >(3));
+}
+
+void TestDBWriteQueue::shutdown() {
+	Recorder recorder;
+
+	{
+		DBWriteQueue queue(recorder.factory(), 100);
+
+		std::promise< void > release = recorder.blockNext();
+		queue.enqueue(DBWrite::logMessage(1, "first"));
+		recorder.waitUntilBlocked();
+		queue.enqueue(DBWrite::logMessage(1, "second"));
+		queue.enqueue(DBWrite::logMessage(1, "third"));
+
+		release.set_value();
+		// Destroying the queue performs the pending writes
+	}
+
+	using Batches = std::vector< std::vector< std::string > >;
+	QCOMPARE(recorder.recorded(), (Batches{ { "first" }, { "second", "third" } }));
+
+	// A queue that never had anything to write doesn't create a writer
+	Recorder unused;
+	{
+		DBWriteQueue queue(unused.factory(), 100);
+	}
+	QVERIFY(unused.thread == std::thread::id());
+}
+
+QTEST_MAIN(TestDBWriteQueue)
+#include "TestDBWriteQueue.moc"
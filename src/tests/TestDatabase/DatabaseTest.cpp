@@ -15,6 +15,7 @@
 #include "database/Index.h"
 #include "database/MetaTable.h"
 #include "database/Savepoint.h"
+#include "database/StatementCache.h"
 #include "database/Trigger.h"
 #include "database/UnsupportedOperationException.h"
 #include "database/Utils.h"
@@ -38,6 +39,7 @@
 #include <iomanip>
 #include <iostream>
 #include <sstream>
+#include <tuple>
 #include <unordered_set>
 #include <utility>
 #include <vector>
@@ -175,6 +177,7 @@ private slots:
 	void fetchMinimumFreeID();
 	void dateToEpoch();
 	void savepoints();
+	void statementCache();
 };
 
 void DatabaseTest::hexConversions() {
@@ -1008,5 +1011,71 @@ void DatabaseTest::savepoints() {
 	MUMBLE_END_TEST_CASE
 }
 
+void DatabaseTest::statementCache() {
+	MUMBLE_BEGIN_TEST_CASE_NO_INIT
+
+	Database::table_id id = db.addTable(std::make_unique< test::KeyValueTable >(db.getSQLHandle(), currentBackend));
+
+	db.init(test::utils::getConnectionParamter(currentBackend));
+
+	test::KeyValueTable *table = static_cast< test::KeyValueTable * >(db.getTable(id));
+
+	table->insert("first", "one");
+	table->insert("second", "two");
+
+	StatementCache &cache = table->getStatementCache();
+	QCOMPARE(cache.size(), static_cast< std::size_t >(0));
+
+	auto prepareQuery = [&](auto &values) -> soci::statement {
+		return (db.getSQLHandle().prepare << "SELECT \"value_col\" FROM \"" << table->getName()
+										  << "\" WHERE \"key_col\" = :key",
+				soci::use(std::get< 0 >(values)), soci::into(std::get< 1 >(values)));
+	};
+
+	auto query = [&](const std::string &key) {
+		auto &stmt  = cache.get< std::string, std::string >("query", prepareQuery);
+		stmt.values = { key, std::string() };
+
+		return stmt.execute() ? std::get< 1 >(stmt.values) : std::string("<none>");
+	};
+
+	// The statement is prepared once and then reused with different parameters
+	QCOMPARE(query("first"), std::string("one"));
+	QCOMPARE(query("second"), std::string("two"));
+	QCOMPARE(query("third"), std::string("<none>"));
+	QCOMPARE(query("first"), std::string("one"));
+
+	QCOMPARE(cache.size(), static_cast< std::size_t >(1));
+	QCOMPARE(cache.getStatistics().prepared, static_cast< std::uint64_t >(1));
+	QCOMPARE(cache.getStatistics().reused, static_cast< std::uint64_t >(3));
+
+	// Cached statements see changes made by other statements
+	table->insert("third", "three");
+	QCOMPARE(query("third"), std::string("three"));
+
+	// Fetching all rows one after another
+	auto &all = cache.get< std::string >("all", [&](auto &values) -> soci::statement {
+		return (db.getSQLHandle().prepare << "SELECT \"value_col\" FROM \"" << table->getName()
+										  << "\" ORDER BY \"key_col\"",
+				soci::into(std::get< 0 >(values)));
+	});
+
+	std::vector< std::string > fetched;
+	all.query();
+	while (all.fetch()) {
+		fetched.push_back(std::get< 0 >(all.values));
+	}
+	QCOMPARE(fetched, std::vector< std::string >({ "one", "two", "three" }));
+
+	QCOMPARE(cache.size(), static_cast< std::size_t >(2));
+	cache.clear();
+	QCOMPARE(cache.size(), static_cast< std::size_t >(0));
+
+	QCOMPARE(query("second"), std::string("two"));
+	QCOMPARE(cache.getStatistics().prepared, static_cast< std::uint64_t >(3));
+
+	MUMBLE_END_TEST_CASE
+}
+
 QTEST_MAIN(DatabaseTest)
 #include "DatabaseTest.moc"
@@ -52,6 +52,7 @@
 #include <iostream>
 #include <optional>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 
@@ -354,6 +355,27 @@ void ServerDatabaseTest::logTable_general() {
 		}
 	}
 
+	db.getLogTable().clearLog(existingServerID);
+
+	// Batched insertion (using enough entries to require more than a single statement)
+	std::vector< std::pair< unsigned int, ::msdb::DBLogEntry > > batch;
+	for (std::size_t i = 0; i < 250; ++i) {
+		batch.emplace_back(existingServerID,
+						   ::msdb::DBLogEntry(std::string("Batched message ") + std::to_string(i),
+											  std::chrono::system_clock::time_point(std::chrono::seconds(i))));
+	}
+	db.getLogTable().logMessages(batch);
+	db.getLogTable().logMessages({});
+
+	QCOMPARE(db.getLogTable().getLogSize(existingServerID), batch.size());
+
+	std::vector< ::msdb::DBLogEntry > fetchedBatch = db.getLogTable().getLogs(existingServerID);
+	QCOMPARE(fetchedBatch.size(), batch.size());
+	for (std::size_t i = 0; i < fetchedBatch.size(); ++i) {
+		QCOMPARE(fetchedBatch[i].message, batch[batch.size() - 1 - i].second.message);
+		QCOMPARE(fetchedBatch[i].timestamp, batch[batch.size() - 1 - i].second.timestamp);
+	}
+
 	MUMBLE_END_TEST_CASE
 }
 
@@ -498,6 +520,10 @@ void ServerDatabaseTest::channelTable_general() {
 
 	QCOMPARE(channelTable.getChildrenOf(existingServerID, rootChannel.channelID).size(), static_cast< std::size_t >(2));
 
+	std::vector<::msdb::DBChannel > expectedChannels = { rootChannel, updatedOther, third };
+	QCOMPARE(channelTable.getAllChannels(existingServerID), expectedChannels);
+	QVERIFY(channelTable.getAllChannels(otherServerID).empty());
+
 	channelTable.removeChannel(other);
 
 	// We expect to first re-use the ID 1 before moving on to ID 3
@@ -760,6 +786,17 @@ void ServerDatabaseTest::userTable_general() {
 	actualUsers = table.getRegisteredUsers(nonExistingServerID);
 	QVERIFY(actualUsers.empty());
 
+
+	// Test getNamesAndPasswords
+	std::unordered_map< unsigned int, ::msdb::DBUserData > namesAndPasswords =
+		table.getNamesAndPasswords(existingServerID);
+	QCOMPARE(namesAndPasswords.size(), static_cast< std::size_t >(2));
+	QCOMPARE(namesAndPasswords[testUser.registeredUserID].name, table.getName(testUser));
+	QCOMPARE(namesAndPasswords[testUser.registeredUserID].password, table.getPassword(testUser));
+	QCOMPARE(namesAndPasswords[additionalUser.registeredUserID].name, std::string("Dummy name"));
+	QCOMPARE(namesAndPasswords[additionalUser.registeredUserID].password, ::msdb::DBUserData::PasswordData());
+	QVERIFY(table.getNamesAndPasswords(nonExistingServerID).empty());
+
 	QCOMPARE(table.getFreeUserID(existingServerID), static_cast< unsigned int >(1));
 
 
@@ -826,6 +863,13 @@ void ServerDatabaseTest::userPropertyTable_general() {
 	QCOMPARE(table.findUsersWithProperty(existingServerID, ::msdb::UserProperty::Email, "pete@random.com")[0],
 			 user.registeredUserID);
 
+	std::unordered_map< unsigned int, std::string > emails =
+		table.getAllValues(existingServerID, ::msdb::UserProperty::Email);
+	QCOMPARE(emails.size(), static_cast< std::size_t >(1));
+	QCOMPARE(emails[user.registeredUserID], std::string("pete@random.com"));
+	QVERIFY(table.getAllValues(existingServerID, ::msdb::UserProperty::Comment).empty());
+	QVERIFY(table.getAllValues(nonExistingServerID, ::msdb::UserProperty::Email).empty());
+
 	QCOMPARE(table.getProperty< std::string >(user, ::msdb::UserProperty::Email), std::string("pete@random.com"));
 	QCOMPARE(table.getProperty< int >(user, ::msdb::UserProperty::kdfIterations), 5);
 	QCOMPARE(table.getProperty< unsigned int >(user, ::msdb::UserProperty::kdfIterations),
@@ -989,6 +1033,11 @@ void ServerDatabaseTest::groupTable_general() {
 	QVERIFY(fetchedGroups.size() == expectedGroups.size()
 			&& std::is_permutation(expectedGroups.begin(), expectedGroups.end(), fetchedGroups.begin()));
 
+	// Fetching the groups of all channels at once
+	fetchedGroups = table.getAllGroups(existingServerID);
+	QVERIFY(fetchedGroups.size() == expectedGroups.size()
+			&& std::is_permutation(expectedGroups.begin(), expectedGroups.end(), fetchedGroups.begin()));
+
 	QCOMPARE(table.countGroups(existingServerID, otherChannel.channelID), static_cast< std::size_t >(2));
 	table.clearGroups(existingServerID, otherChannel.channelID);
 	QCOMPARE(table.countGroups(existingServerID, otherChannel.channelID), static_cast< std::size_t >(0));
@@ -1089,6 +1138,12 @@ void ServerDatabaseTest::groupMemberTable_general() {
 	fetchedMembers  = table.getEntries(existingServerID, groupB.groupID);
 	QCOMPARE(fetchedMembers, expectedMembers);
 
+	// Fetching the entries of all groups at once
+	expectedMembers = { memberA, memberB };
+	fetchedMembers  = table.getAllEntries(existingServerID);
+	QVERIFY(fetchedMembers.size() == expectedMembers.size()
+			&& std::is_permutation(expectedMembers.begin(), expectedMembers.end(), fetchedMembers.begin()));
+
 	table.removeEntry(memberA);
 	QVERIFY(!table.entryExists(memberA));
 
@@ -0,0 +1,81 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "Group.h"
+
+#include <QtCore>
+#include <QtTest>
+
+Q_DECLARE_METATYPE(Group::Specification::Type)
+
+class TestGroup : public QObject {
+	Q_OBJECT
+private slots:
+	void parse_data();
+	void parse();
+};
+
+void TestGroup::parse_data() {
+	using Type = Group::Specification::Type;
+
+	QTest::addColumn< QString >("specification");
+	QTest::addColumn< Type >("type");
+	QTest::addColumn< bool >("invert");
+	QTest::addColumn< bool >("useACLChannel");
+	QTest::addColumn< QString >("name");
+	QTest::addColumn< int >("subOffset");
+	QTest::addColumn< int >("subMinLevel");
+	QTest::addColumn< int >("subMaxLevel");
+
+	QTest::newRow("empty") << "" << Type::Empty << false << false << "" << 0 << 1 << 1000;
+	QTest::newRow("prefixes only") << "!~" << Type::Empty << true << true << "" << 0 << 1 << 1000;
+	QTest::newRow("none") << "none" << Type::None << false << false << "" << 0 << 1 << 1000;
+	QTest::newRow("all") << "all" << Type::All << false << false << "" << 0 << 1 << 1000;
+	QTest::newRow("auth") << "auth" << Type::Registered << false << false << "" << 0 << 1 << 1000;
+	QTest::newRow("strong") << "strong" << Type::Verified << false << false << "" << 0 << 1 << 1000;
+	QTest::newRow("in") << "in" << Type::In << false << false << "" << 0 << 1 << 1000;
+	QTest::newRow("~out") << "~out" << Type::Out << false << true << "" << 0 << 1 << 1000;
+	QTest::newRow("!auth") << "!auth" << Type::Registered << true << false << "" << 0 << 1 << 1000;
+	QTest::newRow("sub") << "sub" << Type::Sub << false << false << "" << 0 << 1 << 1000;
+	QTest::newRow("sub,2") << "sub,2" << Type::Sub << false << false << "" << 2 << 1 << 1000;
+	QTest::newRow("sub,-1,0,3") << "sub,-1,0,3" << Type::Sub << false << false << "" << -1 << 0 << 3;
+	QTest::newRow("sub,,2") << "sub,,2" << Type::Sub << false << false << "" << 0 << 2 << 1000;
+	QTest::newRow("~!sub,1") << "~!sub,1" << Type::Sub << true << true << "" << 1 << 1 << 1000;
+	QTest::newRow("subway") << "subway" << Type::Group << false << false << "subway" << 0 << 1 << 1000;
+	QTest::newRow("#token") << "#token" << Type::AccessToken << false << false << "token" << 0 << 1 << 1000;
+	QTest::newRow("#!token") << "#!token" << Type::AccessToken << true << false << "token" << 0 << 1 << 1000;
+	QTest::newRow("#all") << "#all" << Type::AccessToken << false << false << "all" << 0 << 1 << 1000;
+	QTest::newRow("#") << "#" << Type::Empty << false << false << "" << 0 << 1 << 1000;
+	QTest::newRow("$hash") << "$hash" << Type::CertificateHash << false << false << "hash" << 0 << 1 << 1000;
+	QTest::newRow("!$hash") << "!$hash" << Type::CertificateHash << true << false << "hash" << 0 << 1 << 1000;
+	QTest::newRow("admin") << "admin" << Type::Group << false << false << "admin" << 0 << 1 << 1000;
+	QTest::newRow("!~admin") << "!~admin" << Type::Group << true << true << "admin" << 0 << 1 << 1000;
+	// Prefixes are only recognized at the start
+	QTest::newRow("ad!min") << "ad!min" << Type::Group << false << false << "ad!min" << 0 << 1 << 1000;
+}
+
+void TestGroup::parse() {
+	QFETCH(QString, specification);
+	QFETCH(Group::Specification::Type, type);
+	QFETCH(bool, invert);
+	QFETCH(bool, useACLChannel);
+	QFETCH(QString, name);
+	QFETCH(int, subOffset);
+	QFETCH(int, subMinLevel);
+	QFETCH(int, subMaxLevel);
+
+	const Group::Specification spec = Group::Specification::parse(specification);
+
+	QCOMPARE(spec.type, type);
+	QCOMPARE(spec.invert, invert);
+	QCOMPARE(spec.useACLChannel, useACLChannel);
+	QCOMPARE(spec.name, name);
+	QCOMPARE(spec.subOffset, subOffset);
+	QCOMPARE(spec.subMinLevel, subMinLevel);
+	QCOMPARE(spec.subMaxLevel, subMaxLevel);
+}
+
+QTEST_MAIN(TestGroup)
+#include "TestGroup.moc"
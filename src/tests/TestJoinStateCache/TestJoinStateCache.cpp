@@ -0,0 +1,142 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "JoinStateCache.h"
+
+#include <QtCore>
+#include <QtTest>
+
+#include <string>
+
+class TestJoinStateCache : public QObject {
+	Q_OBJECT
+private slots:
+	void cached();
+	void invalidation();
+	void appendMessage();
+};
+
+void TestJoinStateCache::cached() {
+	JoinStateCache cache;
+	int fills = 0;
+
+	auto fill = [&fills](MumbleProto::ChannelState &state) {
+		++fills;
+		state.set_channel_id(3);
+		state.set_name("Channel");
+	};
+
+	const std::string first = cache.channelState(3, fill);
+	const std::string again = cache.channelState(3, fill);
+
+	QCOMPARE(fills, 1);
+	QCOMPARE(again, first);
+	QCOMPARE(cache.getStatistics().hits, static_cast< std::uint64_t >(1));
+	QCOMPARE(cache.getStatistics().misses, static_cast< std::uint64_t >(1));
+
+	MumbleProto::ChannelState parsed;
+	QVERIFY(parsed.ParseFromString(first));
+	QCOMPARE(parsed.channel_id(), 3u);
+	QCOMPARE(parsed.name(), std::string("Channel"));
+
+	// Channels and users are cached independently of each other
+	cache.userState(3, [](MumbleProto::UserState &state) { state.set_session(3); });
+	cache.channelState(3, fill);
+	QCOMPARE(fills, 1);
+}
+
+void TestJoinStateCache::invalidation() {
+	JoinStateCache cache;
+	int channelFills = 0;
+	int userFills    = 0;
+
+	auto fillChannel = [&channelFills](MumbleProto::ChannelState &) { ++channelFills; };
+	auto fillUser    = [&userFills](MumbleProto::UserState &) { ++userFills; };
+
+	cache.channelState(1, fillChannel);
+	cache.channelState(2, fillChannel);
+	cache.userState(1, fillUser);
+	cache.userState(2, fillUser);
+
+	// Broadcasting a channel's state drops only that channel
+	MumbleProto::ChannelState channelState;
+	channelState.set_channel_id(1);
+	channelState.set_name("Renamed");
+	cache.update(channelState, Mumble::Protocol::TCPMessageType::ChannelState);
+
+	cache.channelState(1, fillChannel);
+	cache.channelState(2, fillChannel);
+	cache.userState(1, fillUser);
+	QCOMPARE(channelFills, 3);
+	QCOMPARE(userFills, 2);
+
+	MumbleProto::UserState userState;
+	userState.set_session(2);
+	userState.set_self_mute(true);
+	cache.update(userState, Mumble::Protocol::TCPMessageType::UserState);
+
+	cache.userState(1, fillUser);
+	cache.userState(2, fillUser);
+	QCOMPARE(userFills, 3);
+
+	MumbleProto::UserRemove userRemove;
+	userRemove.set_session(1);
+	cache.update(userRemove, Mumble::Protocol::TCPMessageType::UserRemove);
+
+	MumbleProto::ChannelRemove channelRemove;
+	channelRemove.set_channel_id(2);
+	cache.update(channelRemove, Mumble::Protocol::TCPMessageType::ChannelRemove);
+
+	cache.userState(1, fillUser);
+	cache.channelState(2, fillChannel);
+	QCOMPARE(userFills, 4);
+	QCOMPARE(channelFills, 4);
+
+	// Unrelated messages don't affect the cache
+	MumbleProto::TextMessage textMessage;
+	textMessage.set_message("Hello");
+	cache.update(textMessage, Mumble::Protocol::TCPMessageType::TextMessage);
+
+	cache.clear();
+	cache.channelState(1, fillChannel);
+	cache.userState(2, fillUser);
+	QCOMPARE(channelFills, 5);
+	QCOMPARE(userFills, 5);
+}
+
+void TestJoinStateCache::appendMessage() {
+	MumbleProto::ChannelState shared;
+	shared.set_channel_id(7);
+	shared.set_name("Lobby");
+
+	MumbleProto::ChannelState userSpecific;
+	userSpecific.set_can_enter(true);
+
+	QByteArray buffer;
+	JoinStateCache::appendMessage(buffer, Mumble::Protocol::TCPMessageType::ChannelState, shared.SerializeAsString(),
+								  userSpecific.SerializeAsString());
+	JoinStateCache::appendMessage(buffer, Mumble::Protocol::TCPMessageType::Ping, std::string());
+
+	const unsigned char *data = reinterpret_cast< const unsigned char * >(buffer.constData());
+	const quint32 length      = qFromBigEndian< quint32 >(&data[2]);
+
+	QCOMPARE(qFromBigEndian< quint16 >(&data[0]),
+			 static_cast< quint16 >(Mumble::Protocol::TCPMessageType::ChannelState));
+	QCOMPARE(static_cast< qsizetype >(length + 6 + 6), buffer.size());
+
+	// The concatenated parts are parsed as a single message
+	MumbleProto::ChannelState parsed;
+	QVERIFY(parsed.ParseFromArray(data + 6, static_cast< int >(length)));
+	QCOMPARE(parsed.channel_id(), 7u);
+	QCOMPARE(parsed.name(), std::string("Lobby"));
+	QVERIFY(parsed.can_enter());
+
+	QCOMPARE(qFromBigEndian< quint16 >(&data[6 + length]),
+			 static_cast< quint16 >(Mumble::Protocol::TCPMessageType::Ping));
+	QCOMPARE(qFromBigEndian< quint32 >(&data[6 + length + 2]), static_cast< quint32 >(0));
+}
+
+QTEST_MAIN(TestJoinStateCache)
+#include "TestJoinStateCache.moc"
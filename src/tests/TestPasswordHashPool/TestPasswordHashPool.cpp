@@ -0,0 +1,75 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "PBKDF2.h"
+#include "PasswordHashPool.h"
+
+#include <QtCore>
+#include <QtTest>
+
+class TestPasswordHashPool : public QObject {
+	Q_OBJECT
+private slots:
+	void hash();
+	void limit();
+	void disabled();
+};
+
+void TestPasswordHashPool::hash() {
+	PasswordHashPool pool(2, 10);
+	QVERIFY(pool.isEnabled());
+
+	const QString salt = PBKDF2::getSalt();
+
+	QStringList hashes;
+	QList< QThread * > threads;
+	for (const QString &password : { QStringLiteral("first"), QStringLiteral("second") }) {
+		QVERIFY(pool.submit(salt, password, 1000, [&](const QString &hash) {
+			hashes << hash;
+			threads << QThread::currentThread();
+		}));
+	}
+	QCOMPARE(pool.pendingCount(), static_cast< std::size_t >(2));
+
+	QTRY_COMPARE(hashes.size(), 2);
+	QCOMPARE(pool.pendingCount(), static_cast< std::size_t >(0));
+
+	// The callbacks are invoked by the thread owning the pool, but the order in which they are invoked is unspecified
+	QCOMPARE(threads, QList< QThread * >({ QThread::currentThread(), QThread::currentThread() }));
+	hashes.sort();
+	QStringList expected = { PBKDF2::getHash(salt, QStringLiteral("first"), 1000),
+							 PBKDF2::getHash(salt, QStringLiteral("second"), 1000) };
+	expected.sort();
+	QCOMPARE(hashes, expected);
+}
+
+void TestPasswordHashPool::limit() {
+	PasswordHashPool pool(1, 2);
+
+	const QString salt = PBKDF2::getSalt();
+
+	int completed = 0;
+	QVERIFY(pool.submit(salt, QStringLiteral("password"), 1000, [&](const QString &) { ++completed; }));
+	QVERIFY(pool.submit(salt, QStringLiteral("password"), 1000, [&](const QString &) { ++completed; }));
+	// Completed hashes are only counted as done once their callback has been invoked, which can't have happened yet
+	QVERIFY(!pool.submit(salt, QStringLiteral("password"), 1000, [&](const QString &) { ++completed; }));
+	QCOMPARE(pool.rejectedCount(), static_cast< std::uint64_t >(1));
+
+	QTRY_COMPARE(completed, 2);
+	QCOMPARE(pool.pendingCount(), static_cast< std::size_t >(0));
+
+	// There is room again
+	QVERIFY(pool.submit(salt, QStringLiteral("password"), 1000, [&](const QString &) { ++completed; }));
+	QTRY_COMPARE(completed, 3);
+	QCOMPARE(pool.rejectedCount(), static_cast< std::uint64_t >(1));
+}
+
+void TestPasswordHashPool::disabled() {
+	QVERIFY(!PasswordHashPool(0, 10).isEnabled());
+	QVERIFY(!PasswordHashPool(2, 0).isEnabled());
+}
+
+QTEST_MAIN(TestPasswordHashPool)
+#include "TestPasswordHashPool.moc"
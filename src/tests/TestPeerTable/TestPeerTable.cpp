@@ -0,0 +1,205 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "PeerTable.h"
+
+#include <QtCore>
+#include <QtTest>
+
+#include <cstring>
+#include <map>
+#include <random>
+
+#ifdef Q_OS_WIN
+#	include "win.h"
+#	include <winsock2.h>
+#	include <ws2tcpip.h>
+#else
+#	include <arpa/inet.h>
+#	include <netinet/in.h>
+#	include <sys/socket.h>
+#endif
+
+namespace {
+PeerKey v4Key(std::uint32_t address, std::uint16_t port) {
+	struct sockaddr_storage storage;
+	memset(&storage, 0, sizeof(storage));
+
+	struct sockaddr_in *in = reinterpret_cast< struct sockaddr_in * >(&storage);
+	in->sin_family         = AF_INET;
+	in->sin_addr.s_addr    = htonl(address);
+	in->sin_port           = htons(port);
+
+	return PeerKey::fromSockaddr(storage);
+}
+
+PeerKey v6Key(std::uint8_t lastByte, std::uint16_t port) {
+	struct sockaddr_storage storage;
+	memset(&storage, 0, sizeof(storage));
+
+	struct sockaddr_in6 *in6   = reinterpret_cast< struct sockaddr_in6 * >(&storage);
+	in6->sin6_family           = AF_INET6;
+	in6->sin6_addr.s6_addr[0]  = 0x20;
+	in6->sin6_addr.s6_addr[1]  = 0x01;
+	in6->sin6_addr.s6_addr[15] = lastByte;
+	in6->sin6_port             = htons(port);
+
+	return PeerKey::fromSockaddr(storage);
+}
+} // namespace
+
+class TestPeerTable : public QObject {
+	Q_OBJECT
+private slots:
+	void keyFromSockaddr();
+	void insertFindRemove();
+	void replace();
+	void grow();
+	void removeKeepsProbeSequences();
+	void randomized();
+};
+
+void TestPeerTable::keyFromSockaddr() {
+	const PeerKey v4 = v4Key(0x7F000001, 64738);
+	QVERIFY(v4.isV4());
+	QCOMPARE(v4.address[10], static_cast< std::uint8_t >(0xFF));
+	QCOMPARE(v4.address[11], static_cast< std::uint8_t >(0xFF));
+	QCOMPARE(v4.address[12], static_cast< std::uint8_t >(127));
+	QCOMPARE(v4.address[15], static_cast< std::uint8_t >(1));
+	QCOMPARE(v4.port, htons(64738));
+
+	const PeerKey v6 = v6Key(1, 64738);
+	QVERIFY(!v6.isV4());
+	QCOMPARE(v6.address[0], static_cast< std::uint8_t >(0x20));
+	QCOMPARE(v6.port, htons(64738));
+
+	// Same address, different port
+	QVERIFY(v4Key(0x7F000001, 1) != v4Key(0x7F000001, 2));
+	QVERIFY(v4Key(0x7F000001, 1) == v4Key(0x7F000001, 1));
+	QCOMPARE(v4Key(0x7F000001, 1).hash(), v4Key(0x7F000001, 1).hash());
+
+	// Unknown address families map to the all-zero IPv4 address
+	struct sockaddr_storage unspecified;
+	memset(&unspecified, 0, sizeof(unspecified));
+	QVERIFY(PeerKey::fromSockaddr(unspecified) == v4Key(0, 0));
+}
+
+void TestPeerTable::insertFindRemove() {
+	PeerTable< int > table;
+
+	QVERIFY(table.isEmpty());
+	QVERIFY(!table.contains(v4Key(1, 1)));
+	QVERIFY(!table.remove(v4Key(1, 1)));
+	QCOMPARE(table.value(v4Key(1, 1), -1), -1);
+
+	table.insert(v4Key(1, 1), 1);
+	table.insert(v4Key(1, 2), 2);
+	table.insert(v6Key(1, 1), 3);
+
+	QCOMPARE(table.size(), static_cast< std::size_t >(3));
+	QCOMPARE(table.value(v4Key(1, 1)), 1);
+	QCOMPARE(table.value(v4Key(1, 2)), 2);
+	QCOMPARE(table.value(v6Key(1, 1)), 3);
+	QVERIFY(!table.contains(v4Key(2, 1)));
+
+	QVERIFY(table.remove(v4Key(1, 2)));
+	QVERIFY(!table.remove(v4Key(1, 2)));
+	QVERIFY(!table.contains(v4Key(1, 2)));
+	QCOMPARE(table.size(), static_cast< std::size_t >(2));
+	QCOMPARE(table.value(v4Key(1, 1)), 1);
+	QCOMPARE(table.value(v6Key(1, 1)), 3);
+
+	table.clear();
+	QVERIFY(table.isEmpty());
+	QVERIFY(!table.contains(v4Key(1, 1)));
+}
+
+void TestPeerTable::replace() {
+	PeerTable< int > table;
+
+	table.insert(v4Key(1, 1), 1);
+	table.insert(v4Key(1, 1), 2);
+	QCOMPARE(table.size(), static_cast< std::size_t >(1));
+	QCOMPARE(table.value(v4Key(1, 1)), 2);
+
+	table[v4Key(1, 1)] += 3;
+	QCOMPARE(table.value(v4Key(1, 1)), 5);
+
+	// operator[] value-initializes new entries
+	QCOMPARE(table[v4Key(1, 2)], 0);
+	QCOMPARE(table.size(), static_cast< std::size_t >(2));
+}
+
+void TestPeerTable::grow() {
+	PeerTable< std::uint32_t > table;
+
+	// Many peers behind a single address
+	for (std::uint16_t port = 1; port <= 1000; ++port) {
+		table.insert(v4Key(0x0A000001, port), port);
+	}
+
+	QCOMPARE(table.size(), static_cast< std::size_t >(1000));
+	QVERIFY(table.capacity() >= 2 * table.size());
+	for (std::uint16_t port = 1; port <= 1000; ++port) {
+		QCOMPARE(table.value(v4Key(0x0A000001, port)), static_cast< std::uint32_t >(port));
+	}
+	QVERIFY(!table.contains(v4Key(0x0A000001, 1001)));
+}
+
+void TestPeerTable::removeKeepsProbeSequences() {
+	// Fill a small table, such that there are plenty of collisions, and remove every other key. All remaining keys
+	// have to be found afterwards.
+	PeerTable< int > table;
+	for (int i = 0; i < 8; ++i) {
+		table.insert(v6Key(static_cast< std::uint8_t >(i), 1), i);
+	}
+	QCOMPARE(table.capacity(), static_cast< std::size_t >(16));
+
+	for (int i = 0; i < 8; i += 2) {
+		QVERIFY(table.remove(v6Key(static_cast< std::uint8_t >(i), 1)));
+	}
+	for (int i = 0; i < 8; ++i) {
+		QCOMPARE(table.contains(v6Key(static_cast< std::uint8_t >(i), 1)), i % 2 == 1);
+	}
+}
+
+void TestPeerTable::randomized() {
+	PeerTable< std::uint32_t > table;
+	std::map< std::pair< std::uint32_t, std::uint16_t >, std::uint32_t > reference;
+
+	std::mt19937 rng(42);
+	std::uniform_int_distribution< std::uint32_t > addressDist(0, 63);
+	std::uniform_int_distribution< std::uint32_t > portDist(0, 15);
+	std::uniform_int_distribution< int > opDist(0, 2);
+
+	for (std::uint32_t i = 0; i < 20000; ++i) {
+		const std::uint32_t address = addressDist(rng);
+		const std::uint16_t port    = static_cast< std::uint16_t >(portDist(rng));
+		const PeerKey key           = v4Key(address, port);
+
+		if (opDist(rng) == 0) {
+			QCOMPARE(table.remove(key), reference.erase({ address, port }) == 1);
+		} else {
+			table.insert(key, i);
+			reference[{ address, port }] = i;
+		}
+
+		QCOMPARE(table.size(), reference.size());
+	}
+
+	for (std::uint32_t address = 0; address < 64; ++address) {
+		for (std::uint16_t port = 0; port < 16; ++port) {
+			auto it = reference.find({ address, port });
+			if (it == reference.end()) {
+				QVERIFY(!table.contains(v4Key(address, port)));
+			} else {
+				QCOMPARE(table.value(v4Key(address, port)), it->second);
+			}
+		}
+	}
+}
+
+QTEST_MAIN(TestPeerTable)
+#include "TestPeerTable.moc"
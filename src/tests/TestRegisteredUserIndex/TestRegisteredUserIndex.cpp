@@ -0,0 +1,171 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "RegisteredUserIndex.h"
+
+#include <QtCore>
+#include <QtTest>
+
+class TestRegisteredUserIndex : public QObject {
+	Q_OBJECT
+private slots:
+	void names();
+	void rename();
+	void passwords();
+	void certificateHashes();
+	void emails();
+	void search();
+	void remove();
+};
+
+using IDs = std::vector< unsigned int >;
+
+void TestRegisteredUserIndex::names() {
+	RegisteredUserIndex index;
+	index.setName(0, "SuperUser");
+	index.setName(3, "Pete");
+	index.setName(7, QString::fromUtf8("Straße").toStdString());
+
+	QCOMPARE(index.size(), static_cast< std::size_t >(3));
+	QVERIFY(index.contains(3));
+	QVERIFY(!index.contains(4));
+
+	QCOMPARE(index.findByName("Pete"), std::optional< unsigned int >(3));
+	// Names are compared case-insensitively
+	QCOMPARE(index.findByName("pETE"), std::optional< unsigned int >(3));
+	QCOMPARE(index.findByName("superuser"), std::optional< unsigned int >(0));
+	QCOMPARE(index.findByName(QString::fromUtf8("STRAßE").toStdString()), std::optional< unsigned int >(7));
+	// Just like SQL's LOWER(), the names are only lower-cased and not case-folded
+	QVERIFY(!index.findByName("STRASSE"));
+	QVERIFY(!index.findByName("Pet"));
+	QVERIFY(!index.findByName(""));
+
+	// The name is kept as it has been set
+	QVERIFY(index.getName(3));
+	QCOMPARE(*index.getName(3), std::string("Pete"));
+	QVERIFY(!index.getName(4));
+}
+
+void TestRegisteredUserIndex::rename() {
+	RegisteredUserIndex index;
+	index.setName(3, "Pete");
+	index.setName(3, "Peter");
+
+	QCOMPARE(index.size(), static_cast< std::size_t >(1));
+	QVERIFY(!index.findByName("Pete"));
+	QCOMPARE(index.findByName("peter"), std::optional< unsigned int >(3));
+	QCOMPARE(index.findByNamePrefix("pete"), IDs{ 3 });
+
+	// A changed casing is picked up as well
+	index.setName(3, "PETER");
+	QCOMPARE(*index.getName(3), std::string("PETER"));
+	QCOMPARE(index.findByNamePrefix(""), IDs{ 3 });
+}
+
+void TestRegisteredUserIndex::passwords() {
+	RegisteredUserIndex index;
+	index.setName(3, "Pete");
+
+	QVERIFY(index.getPassword(3));
+	QVERIFY(index.getPassword(3)->passwordHash.empty());
+	QVERIFY(!index.getPassword(4));
+
+	index.setPassword(3, RegisteredUserIndex::PasswordData("hash", "salt", 42));
+	QCOMPARE(index.getPassword(3)->passwordHash, std::string("hash"));
+	QCOMPARE(index.getPassword(3)->salt, std::string("salt"));
+	QCOMPARE(index.getPassword(3)->kdfIterations, 42u);
+
+	// Changing the name doesn't affect the password
+	index.setName(3, "Peter");
+	QCOMPARE(index.getPassword(3)->passwordHash, std::string("hash"));
+}
+
+void TestRegisteredUserIndex::certificateHashes() {
+	RegisteredUserIndex index;
+	index.setName(1, "Alice");
+	index.setName(2, "Bob");
+
+	QVERIFY(!index.findByCertificateHash("aaaa"));
+
+	index.setCertificateHash(1, "aaaa");
+	index.setCertificateHash(2, "bbbb");
+	QCOMPARE(index.findByCertificateHash("aaaa"), std::optional< unsigned int >(1));
+	QCOMPARE(index.findByCertificateHash("bbbb"), std::optional< unsigned int >(2));
+	// Hashes are compared case-sensitively
+	QVERIFY(!index.findByCertificateHash("AAAA"));
+
+	index.setCertificateHash(1, "cccc");
+	QVERIFY(!index.findByCertificateHash("aaaa"));
+	QCOMPARE(index.findByCertificateHash("cccc"), std::optional< unsigned int >(1));
+
+	// Ambiguous hashes don't yield a user
+	index.setCertificateHash(2, "cccc");
+	QVERIFY(!index.findByCertificateHash("cccc"));
+
+	index.setCertificateHash(2, "");
+	QCOMPARE(index.findByCertificateHash("cccc"), std::optional< unsigned int >(1));
+	QVERIFY(!index.findByCertificateHash(""));
+}
+
+void TestRegisteredUserIndex::emails() {
+	RegisteredUserIndex index;
+	index.setName(1, "Alice");
+	index.setName(2, "Bob");
+
+	index.setEmail(1, "alice@example.com");
+	QCOMPARE(index.findByEmail("alice@example.com"), std::optional< unsigned int >(1));
+	QVERIFY(!index.findByEmail("bob@example.com"));
+
+	index.setEmail(2, "alice@example.com");
+	QVERIFY(!index.findByEmail("alice@example.com"));
+
+	index.setEmail(1, "");
+	QCOMPARE(index.findByEmail("alice@example.com"), std::optional< unsigned int >(2));
+}
+
+void TestRegisteredUserIndex::search() {
+	RegisteredUserIndex index;
+	index.setName(1, "Peter");
+	index.setName(2, "alice");
+	index.setName(3, "Pete");
+	index.setName(4, "Bob");
+	index.setName(5, "Alicia");
+	index.setName(6, "repeat");
+
+	// Results are ordered by the (lower-cased) names
+	QCOMPARE(index.findByNamePrefix("pete"), (IDs{ 3, 1 }));
+	QCOMPARE(index.findByNamePrefix("ALI"), (IDs{ 2, 5 }));
+	QCOMPARE(index.findByNamePrefix("x"), IDs{});
+	QCOMPARE(index.findByNamePrefix(""), (IDs{ 2, 5, 4, 3, 1, 6 }));
+}
+
+void TestRegisteredUserIndex::remove() {
+	RegisteredUserIndex index;
+	index.setName(1, "Alice");
+	index.setPassword(1, RegisteredUserIndex::PasswordData("hash"));
+	index.setCertificateHash(1, "aaaa");
+	index.setEmail(1, "alice@example.com");
+	index.setName(2, "Bob");
+
+	index.remove(1);
+	// Removing a user that isn't contained is a no-op
+	index.remove(3);
+
+	QCOMPARE(index.size(), static_cast< std::size_t >(1));
+	QVERIFY(!index.contains(1));
+	QVERIFY(!index.getName(1));
+	QVERIFY(!index.getPassword(1));
+	QVERIFY(!index.findByName("Alice"));
+	QVERIFY(!index.findByCertificateHash("aaaa"));
+	QVERIFY(!index.findByEmail("alice@example.com"));
+	QCOMPARE(index.findByNamePrefix(""), IDs{ 2 });
+
+	index.clear();
+	QCOMPARE(index.size(), static_cast< std::size_t >(0));
+	QVERIFY(!index.findByName("Bob"));
+}
+
+QTEST_MAIN(TestRegisteredUserIndex)
+#include "TestRegisteredUserIndex.moc"
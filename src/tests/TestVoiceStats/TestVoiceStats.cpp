@@ -0,0 +1,172 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "VoiceStats.h"
+
+#include <QtCore>
+#include <QtTest>
+
+#include <cstdint>
+#include <string>
+
+class TestVoiceStats : public QObject {
+	Q_OBJECT
+private slots:
+	void bucketBoundaries();
+	void percentiles();
+	void emptyHistogram();
+	void merge();
+	void counters();
+	void prometheus();
+};
+
+void TestVoiceStats::bucketBoundaries() {
+	// Small values are recorded exactly
+	for (std::uint64_t value = 0; value < LatencyHistogram::SUB_BUCKET_COUNT * 2; ++value) {
+		QCOMPARE(LatencyHistogram::bucketUpperBound(LatencyHistogram::bucketIndex(value)), value);
+	}
+
+	// Every value falls into a bucket whose upper bound is at most 1/SUB_BUCKET_COUNT larger than the value itself and
+	// buckets are contiguous
+	for (std::uint64_t value = 1; value < (std::uint64_t(1) << 24); value = value * 3 / 2 + 1) {
+		const std::size_t index = LatencyHistogram::bucketIndex(value);
+
+		QVERIFY(LatencyHistogram::bucketUpperBound(index) >= value);
+		QVERIFY(LatencyHistogram::bucketUpperBound(index) - value <= value / LatencyHistogram::SUB_BUCKET_COUNT);
+		QVERIFY(LatencyHistogram::bucketUpperBound(index - 1) < value);
+		QCOMPARE(LatencyHistogram::bucketIndex(LatencyHistogram::bucketUpperBound(index)), index);
+		QCOMPARE(LatencyHistogram::bucketIndex(LatencyHistogram::bucketUpperBound(index) + 1), index + 1);
+	}
+
+	// Huge values are clamped to the last bucket
+	QCOMPARE(LatencyHistogram::bucketIndex(~std::uint64_t(0)), LatencyHistogram::BUCKET_COUNT - 1);
+	QCOMPARE(LatencyHistogram::bucketIndex(std::uint64_t(1) << LatencyHistogram::MAX_EXPONENT),
+			 LatencyHistogram::BUCKET_COUNT - 1);
+}
+
+void TestVoiceStats::percentiles() {
+	LatencyHistogram histogram;
+	for (std::uint64_t value = 1; value <= 1000; ++value) {
+		histogram.record(value * 1000);
+	}
+
+	LatencyHistogram::Snapshot snapshot;
+	histogram.addTo(snapshot);
+
+	QCOMPARE(snapshot.count, static_cast< std::uint64_t >(1000));
+	QCOMPARE(snapshot.sum, static_cast< std::uint64_t >(500500000));
+	QCOMPARE(snapshot.max, static_cast< std::uint64_t >(1000000));
+
+	const auto isClose = [](std::uint64_t actual, std::uint64_t expected) {
+		return actual >= expected && actual - expected <= expected / LatencyHistogram::SUB_BUCKET_COUNT;
+	};
+	QVERIFY(isClose(snapshot.percentile(0.5), 500000));
+	QVERIFY(isClose(snapshot.percentile(0.9), 900000));
+	QVERIFY(isClose(snapshot.percentile(0.99), 990000));
+	// Percentiles never exceed the largest recorded value
+	QCOMPARE(snapshot.percentile(1.0), static_cast< std::uint64_t >(1000000));
+	QCOMPARE(snapshot.percentile(0.0), LatencyHistogram::bucketUpperBound(LatencyHistogram::bucketIndex(1000)));
+
+	QCOMPARE(snapshot.countAtOrBelow(0), static_cast< std::uint64_t >(0));
+	QCOMPARE(snapshot.countAtOrBelow(1000000), static_cast< std::uint64_t >(1000));
+	QVERIFY(snapshot.countAtOrBelow(100000) >= 100);
+	QVERIFY(snapshot.countAtOrBelow(100000) <= 100 + 100 / LatencyHistogram::SUB_BUCKET_COUNT);
+}
+
+void TestVoiceStats::emptyHistogram() {
+	LatencyHistogram histogram;
+
+	LatencyHistogram::Snapshot snapshot;
+	histogram.addTo(snapshot);
+
+	QCOMPARE(snapshot.count, static_cast< std::uint64_t >(0));
+	QCOMPARE(snapshot.percentile(0.5), static_cast< std::uint64_t >(0));
+	QCOMPARE(snapshot.countAtOrBelow(1000), static_cast< std::uint64_t >(0));
+}
+
+void TestVoiceStats::merge() {
+	VoiceStats first;
+	VoiceStats second;
+
+	first.record(VoiceStage::Route, std::chrono::microseconds(10));
+	second.record(VoiceStage::Route, std::chrono::microseconds(30));
+	second.record(VoiceStage::Send, std::chrono::microseconds(5));
+
+	VoiceStats::Snapshot snapshot;
+	first.addTo(snapshot);
+	second.addTo(snapshot);
+
+	const LatencyHistogram::Snapshot &route = snapshot.stages[static_cast< std::size_t >(VoiceStage::Route)];
+	QCOMPARE(route.count, static_cast< std::uint64_t >(2));
+	QCOMPARE(route.sum, static_cast< std::uint64_t >(40000));
+	QCOMPARE(route.max, static_cast< std::uint64_t >(30000));
+	QCOMPARE(snapshot.stages[static_cast< std::size_t >(VoiceStage::Send)].count, static_cast< std::uint64_t >(1));
+	QCOMPARE(snapshot.stages[static_cast< std::size_t >(VoiceStage::Decrypt)].count, static_cast< std::uint64_t >(0));
+
+	// Merging snapshots is equivalent to adding both instances to the same snapshot
+	VoiceStats::Snapshot firstSnapshot;
+	VoiceStats::Snapshot secondSnapshot;
+	first.addTo(firstSnapshot);
+	second.addTo(secondSnapshot);
+	firstSnapshot.merge(secondSnapshot);
+
+	QCOMPARE(firstSnapshot.stages[static_cast< std::size_t >(VoiceStage::Route)].buckets, route.buckets);
+	QCOMPARE(firstSnapshot.stages[static_cast< std::size_t >(VoiceStage::Route)].max, route.max);
+}
+
+void TestVoiceStats::counters() {
+	VoiceStats stats;
+
+	stats.count(VoiceDrop::BandwidthLimit);
+	stats.count(VoiceDrop::BandwidthLimit);
+	stats.count(VoiceDrop::UnknownPeer);
+	stats.count(VoiceCounter::DatagramsReceived, 32);
+	stats.count(VoiceCounter::AudioPackets);
+
+	VoiceStats::Snapshot snapshot;
+	stats.addTo(snapshot);
+
+	QCOMPARE(snapshot.drops[static_cast< std::size_t >(VoiceDrop::BandwidthLimit)], static_cast< std::uint64_t >(2));
+	QCOMPARE(snapshot.drops[static_cast< std::size_t >(VoiceDrop::DecryptFailure)], static_cast< std::uint64_t >(0));
+	QCOMPARE(snapshot.drops[static_cast< std::size_t >(VoiceDrop::UnknownPeer)], static_cast< std::uint64_t >(1));
+	QCOMPARE(snapshot.counters[static_cast< std::size_t >(VoiceCounter::DatagramsReceived)],
+			 static_cast< std::uint64_t >(32));
+	QCOMPARE(snapshot.counters[static_cast< std::size_t >(VoiceCounter::AudioPackets)],
+			 static_cast< std::uint64_t >(1));
+}
+
+void TestVoiceStats::prometheus() {
+	VoiceStats stats;
+	stats.record(VoiceStage::Decrypt, std::chrono::microseconds(3));
+	stats.record(VoiceStage::Decrypt, std::chrono::milliseconds(2));
+	stats.count(VoiceDrop::DecryptFailure);
+
+	VoiceStats::Snapshot snapshot;
+	stats.addTo(snapshot);
+
+	PrometheusWriter writer;
+	VoiceStats::writeStatistics(writer, { { 1, snapshot }, { 2, snapshot } });
+	const QString text = QString::fromStdString(writer.text());
+
+	// Every metric family is only declared once, even if there are multiple servers
+	QCOMPARE(text.count("# TYPE murmur_voice_stage_seconds histogram"), 1);
+	QCOMPARE(text.count("# TYPE murmur_voice_dropped_total counter"), 1);
+	// ... and every one of them is described
+	QCOMPARE(text.count("# HELP "), text.count("# TYPE "));
+	QVERIFY(text.contains("# HELP murmur_voice_datagrams_received_total "));
+
+	QVERIFY(text.contains("murmur_voice_stage_seconds_bucket{server=\"1\",stage=\"decrypt\",le=\"1e-06\"} 0\n"));
+	QVERIFY(text.contains("murmur_voice_stage_seconds_bucket{server=\"1\",stage=\"decrypt\",le=\"5e-06\"} 1\n"));
+	QVERIFY(text.contains("murmur_voice_stage_seconds_bucket{server=\"2\",stage=\"decrypt\",le=\"0.0025\"} 2\n"));
+	QVERIFY(text.contains("murmur_voice_stage_seconds_bucket{server=\"2\",stage=\"decrypt\",le=\"+Inf\"} 2\n"));
+	QVERIFY(text.contains("murmur_voice_stage_seconds_sum{server=\"1\",stage=\"decrypt\"} 0.002003\n"));
+	QVERIFY(text.contains("murmur_voice_stage_seconds_count{server=\"1\",stage=\"decrypt\"} 2\n"));
+	QVERIFY(text.contains("murmur_voice_stage_seconds_count{server=\"1\",stage=\"route\"} 0\n"));
+	QVERIFY(text.contains("murmur_voice_dropped_total{server=\"2\",reason=\"decrypt_failure\"} 1\n"));
+	QVERIFY(text.contains("murmur_voice_datagrams_received_total{server=\"1\"} 0\n"));
+}
+
+QTEST_MAIN(TestVoiceStats)
+#include "TestVoiceStats.moc"
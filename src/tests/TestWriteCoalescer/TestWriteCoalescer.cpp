@@ -0,0 +1,178 @@
+// Copyright The Mumble Developers. All rights reserved.
+// Use of this source code is governed by a BSD-style license
+// that can be found in the LICENSE file at the root of the
+// Mumble source tree or at <https://www.mumble.info/LICENSE>.
+
+#include "Connection.h"
+#include "WriteCoalescer.h"
+
+#include <QtCore>
+#include <QtNetwork/QSslSocket>
+#include <QtTest>
+
+#include <chrono>
+#include <memory>
+
+class TestWriteCoalescer : public QObject {
+	Q_OBJECT
+private slots:
+	void burst();
+	void singleFlush();
+	void urgent();
+	void delay();
+	void fullRecord();
+	void disconnectSocket();
+	void destroyedConnection();
+	void disabled();
+};
+
+namespace {
+
+/// Records every write instead of sending anything
+class RecordingSocket : public QSslSocket {
+public:
+	QList< QByteArray > writes;
+
+	RecordingSocket() { setOpenMode(QIODevice::ReadWrite); }
+
+protected:
+	qint64 writeData(const char *data, qint64 len) override {
+		writes << QByteArray(data, static_cast< qsizetype >(len));
+		return len;
+	}
+};
+
+struct TestConnection {
+	/// Owned by the connection
+	RecordingSocket *socket = new RecordingSocket();
+	std::unique_ptr< Connection > connection = std::make_unique< Connection >(nullptr, socket);
+
+	TestConnection() = default;
+	explicit TestConnection(WriteCoalescer &coalescer) {
+		connection->setWriteCoalescing([&coalescer](Connection &c) { coalescer.add(c); });
+	}
+};
+
+} // namespace
+
+void TestWriteCoalescer::burst() {
+	WriteCoalescer coalescer(std::chrono::milliseconds(0));
+	TestConnection test(coalescer);
+
+	for (const char *message : { "a", "b", "c", "d", "e" }) {
+		test.connection->sendMessage(QByteArray(message));
+	}
+
+	QVERIFY(test.socket->writes.isEmpty());
+	QCOMPARE(coalescer.pending(), static_cast< std::size_t >(1));
+
+	// The whole burst is written at once, as soon as the event loop gets to it
+	QTRY_COMPARE(test.socket->writes, QList< QByteArray >{ "abcde" });
+	QCOMPARE(coalescer.pending(), static_cast< std::size_t >(0));
+}
+
+void TestWriteCoalescer::singleFlush() {
+	WriteCoalescer coalescer(std::chrono::milliseconds(0));
+	TestConnection first(coalescer);
+	TestConnection second(coalescer);
+
+	first.connection->sendMessage(QByteArray("a"));
+	second.connection->sendMessage(QByteArray("b"));
+	first.connection->sendMessage(QByteArray("c"));
+	second.connection->sendMessage(QByteArray("d"));
+
+	QCOMPARE(coalescer.pending(), static_cast< std::size_t >(2));
+
+	coalescer.flush();
+
+	QCOMPARE(first.socket->writes, QList< QByteArray >{ "ac" });
+	QCOMPARE(second.socket->writes, QList< QByteArray >{ "bd" });
+	QCOMPARE(coalescer.pending(), static_cast< std::size_t >(0));
+
+	// The flush has been done already, so there is nothing left for the event loop to do
+	QTest::qWait(10);
+	QCOMPARE(first.socket->writes.size(), 1);
+	QCOMPARE(second.socket->writes.size(), 1);
+}
+
+void TestWriteCoalescer::urgent() {
+	WriteCoalescer coalescer(std::chrono::hours(1));
+	TestConnection test(coalescer);
+
+	test.connection->sendMessage(QByteArray("gathered"));
+	test.connection->sendUrgentMessage(QByteArray("urgent"));
+
+	// Urgent messages neither wait for the delay nor for the gathered messages
+	QCOMPARE(test.socket->writes, QList< QByteArray >{ "urgent" });
+
+	coalescer.flush();
+	QCOMPARE(test.socket->writes, (QList< QByteArray >{ "urgent", "gathered" }));
+}
+
+void TestWriteCoalescer::delay() {
+	WriteCoalescer coalescer(std::chrono::hours(1));
+	TestConnection test(coalescer);
+
+	test.connection->sendMessage(QByteArray("a"));
+	QCoreApplication::processEvents();
+	test.connection->sendMessage(QByteArray("b"));
+	QCoreApplication::processEvents();
+
+	// Messages are held back for as long as the delay hasn't passed, even across iterations of the event loop
+	QVERIFY(test.socket->writes.isEmpty());
+
+	coalescer.flush();
+	QCOMPARE(test.socket->writes, QList< QByteArray >{ "ab" });
+}
+
+void TestWriteCoalescer::fullRecord() {
+	WriteCoalescer coalescer(std::chrono::hours(1));
+	TestConnection test(coalescer);
+
+	// Once the gathered messages fill a TLS record, waiting doesn't save anything
+	const QByteArray half(8 * 1024, 'x');
+	test.connection->sendMessage(half);
+	QVERIFY(test.socket->writes.isEmpty());
+	test.connection->sendMessage(half);
+	QCOMPARE(test.socket->writes, QList< QByteArray >{ half + half });
+
+	test.connection->sendMessage(QByteArray("a"));
+	coalescer.flush();
+	QCOMPARE(test.socket->writes, (QList< QByteArray >{ half + half, "a" }));
+}
+
+void TestWriteCoalescer::disconnectSocket() {
+	WriteCoalescer coalescer(std::chrono::hours(1));
+	TestConnection test(coalescer);
+
+	// E.g. the reason for rejecting a user must not get lost
+	test.connection->sendMessage(QByteArray("reject"));
+	test.connection->disconnectSocket();
+
+	QCOMPARE(test.socket->writes, QList< QByteArray >{ "reject" });
+}
+
+void TestWriteCoalescer::destroyedConnection() {
+	WriteCoalescer coalescer(std::chrono::milliseconds(0));
+
+	{
+		TestConnection test(coalescer);
+		test.connection->sendMessage(QByteArray("a"));
+	}
+
+	QCOMPARE(coalescer.pending(), static_cast< std::size_t >(1));
+	coalescer.flush();
+	QCOMPARE(coalescer.pending(), static_cast< std::size_t >(0));
+}
+
+void TestWriteCoalescer::disabled() {
+	TestConnection test;
+
+	test.connection->sendMessage(QByteArray("a"));
+	test.connection->sendMessage(QByteArray("b"));
+
+	QCOMPARE(test.socket->writes, (QList< QByteArray >{ "a", "b" }));
+}
+
+QTEST_MAIN(TestWriteCoalescer)
+#include "TestWriteCoalescer.moc"